@@ -0,0 +1,1064 @@
+/**
+ * @file bench_kernel.c
+ * @brief Kernel subsystem micro-benchmarks
+ */
+
+#include "aichat/cognitive.h"
+#include "aichat/kernel.h"
+#include <ggml.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Monotonic time in nanoseconds
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Empty task body */
+static void noop_task(void* data) {
+    (void)data;
+}
+
+/* Benchmark scheduler tick */
+static int bench_scheduler(void) {
+    printf("Benchmarking scheduler...\n");
+    
+    if (dtesn_sched_init() != 0) {
+        return 1;
+    }
+    
+    const int n_ticks = 10000;
+    
+    /* Empty ticks */
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_ticks; i++) {
+        dtesn_sched_tick();
+    }
+    uint64_t empty_ns = now_ns() - start;
+    
+    /* One task per tick */
+    start = now_ns();
+    for (int i = 0; i < n_ticks; i++) {
+        dtesn_sched_task(noop_task, NULL, (task_priority_t)(i % 4), 0);
+        dtesn_sched_tick();
+    }
+    uint64_t single_ns = now_ns() - start;
+    
+    /* Full queue */
+    int queued = 0;
+    while (dtesn_sched_task(noop_task, NULL, (task_priority_t)(queued % 4), 0) != 0) {
+        queued++;
+    }
+    start = now_ns();
+    int executed = dtesn_sched_tick();
+    uint64_t full_ns = now_ns() - start;
+    
+    printf("  empty tick: %.1f ns, 1-task tick: %.1f ns (target: %d us)\n",
+           (double)empty_ns / n_ticks, (double)single_ns / n_ticks, SCHED_TICK_TARGET_US);
+    printf("  full tick: %d tasks in %.1f us (%.1f ns/task)\n",
+           executed, full_ns / 1000.0, executed ? (double)full_ns / executed : 0.0);
+    
+    return 0;
+}
+
+/* Fixed amount of arithmetic per task */
+static void spin_task(void* data) {
+    volatile uint64_t x = (uint64_t)(uintptr_t)data;
+    for (int i = 0; i < 2000; i++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+}
+
+/* Benchmark work-stealing executor against inline ticks */
+static int bench_executor(unsigned n_workers) {
+    printf("Benchmarking executor (%u workers)...\n", n_workers);
+    
+    if (dtesn_sched_init() != 0) {
+        return 1;
+    }
+    
+    const int n_rounds = 200;
+    const int n_tasks = 1000;
+    
+    uint64_t start = now_ns();
+    for (int r = 0; r < n_rounds; r++) {
+        for (int i = 0; i < n_tasks; i++) {
+            dtesn_sched_task(spin_task, (void*)(uintptr_t)i, (task_priority_t)(i % 4), 0);
+        }
+        dtesn_sched_tick();
+    }
+    uint64_t inline_ns = now_ns() - start;
+    
+    if (dtesn_sched_exec_start(n_workers, SCHED_EXEC_BARRIER) != 0) {
+        return 1;
+    }
+    
+    start = now_ns();
+    for (int r = 0; r < n_rounds; r++) {
+        for (int i = 0; i < n_tasks; i++) {
+            dtesn_sched_task(spin_task, (void*)(uintptr_t)i, (task_priority_t)(i % 4), 0);
+        }
+        dtesn_sched_tick();
+    }
+    uint64_t parallel_ns = now_ns() - start;
+    
+    dtesn_sched_exec_stop();
+    
+    printf("  inline: %.1f us/tick, executor: %.1f us/tick, speedup %.2fx\n",
+           inline_ns / 1000.0 / n_rounds, parallel_ns / 1000.0 / n_rounds,
+           (double)inline_ns / (double)parallel_ns);
+    
+    return 0;
+}
+
+/* Benchmark a layered dependency graph: each task depends on two tasks of the layer above */
+static int bench_dag(unsigned n_workers) {
+    printf("Benchmarking dependency graph (%u workers)...\n", n_workers);
+    
+    if (dtesn_sched_init() != 0) {
+        return 1;
+    }
+    
+    enum { LAYERS = 8, WIDTH = 64, ROUNDS = 100 };
+    task_handle_t layer[2][WIDTH] = {{0}};
+    
+    if (n_workers > 0 && dtesn_sched_exec_start(n_workers, SCHED_EXEC_BARRIER) != 0) {
+        return 1;
+    }
+    dtesn_sched_profile(true);
+    
+    uint64_t total_ns = 0;
+    sched_graph_report_t report = {0};
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int l = 0; l < LAYERS; l++) {
+            for (int i = 0; i < WIDTH; i++) {
+                const task_handle_t* above = layer[(l - 1) & 1];
+                task_handle_t deps[2] = {above[i], above[(i + 1) % WIDTH]};
+                if (dtesn_sched_submit_deps(spin_task, (void*)(uintptr_t)i, PRIORITY_NORMAL,
+                                            (uint32_t)l, deps, l > 0 ? 2 : 0,
+                                            &layer[l & 1][i]) != SCHED_OK) {
+                    return 1;
+                }
+            }
+        }
+        
+        uint64_t start = now_ns();
+        dtesn_sched_tick();
+        total_ns += now_ns() - start;
+        dtesn_sched_graph_report(&report);
+    }
+    
+    dtesn_sched_profile(false);
+    if (n_workers > 0) {
+        dtesn_sched_exec_stop();
+    }
+    
+    printf("  %d tasks in %u waves: %.1f us/graph\n",
+           LAYERS * WIDTH, report.waves, total_ns / 1000.0 / ROUNDS);
+    printf("  work %.1f us, critical path %.1f us, parallelism %.1f\n",
+           report.work_ns / 1000.0, report.critical_path_ns / 1000.0,
+           report.critical_path_ns ? (double)report.work_ns / report.critical_path_ns : 0.0);
+    
+    return 0;
+}
+
+/* Periodic timer probe: records when each expiry actually ran */
+static uint64_t timer_first_ns = 0;
+static uint64_t timer_last_ns = 0;
+static int timer_runs = 0;
+
+static void timer_probe(void* data) {
+    (void)data;
+    timer_last_ns = now_ns();
+    if (timer_runs++ == 0) {
+        timer_first_ns = timer_last_ns;
+    }
+}
+
+static void* timer_loop(void* arg) {
+    (void)arg;
+    dtesn_sched_run();
+    return NULL;
+}
+
+/* Benchmark timer precision and drift */
+static int bench_timers(void) {
+    printf("Benchmarking timers...\n");
+    
+    if (dtesn_sched_init() != 0) {
+        return 1;
+    }
+    
+    const uint64_t period_us = 10000;
+    const int duration_ms = 2000;
+    
+    timer_handle_t t = dtesn_sched_every(timer_probe, NULL, PRIORITY_NORMAL, 0, period_us);
+    if (!t) {
+        return 1;
+    }
+    
+    pthread_t loop;
+    pthread_create(&loop, NULL, timer_loop, NULL);
+    struct timespec ts = {duration_ms / 1000, (duration_ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+    dtesn_sched_stop();
+    pthread_join(loop, NULL);
+    dtesn_sched_cancel(t);
+    
+    sched_timer_stats_t stats;
+    dtesn_sched_timer_stats(&stats);
+    
+    /* Drift: where the last run landed relative to the ideal schedule */
+    double ideal_us = (double)(timer_runs - 1) * period_us;
+    double actual_us = (timer_last_ns - timer_first_ns) / 1000.0;
+    
+    printf("  %d runs of a %llu us timer, lateness mean %.1f us, max %llu us\n",
+           timer_runs, (unsigned long long)period_us, stats.late_us_mean,
+           (unsigned long long)stats.late_us_max);
+    printf("  drift over run: %.1f us, missed periods: %llu (resolution: %d us)\n",
+           actual_us - ideal_us, (unsigned long long)stats.missed_periods,
+           SCHED_TIMER_RESOLUTION_US);
+    
+    return 0;
+}
+
+/* Benchmark memory allocator */
+static int bench_memory(void) {
+    printf("Benchmarking memory...\n");
+    
+    const int n_ops = 4096;
+    void** ptrs = (void**)calloc(n_ops, sizeof(void*));
+    if (!ptrs || dtesn_mem_init(0) != 0) {
+        free(ptrs);
+        return 1;
+    }
+    
+    dtesn_mem_stats_histogram(true);
+    
+    /* Mixed sizes across regions */
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_ops; i++) {
+        size_t size = (size_t)16 << (i % 10);
+        ptrs[i] = dtesn_mem_alloc(size, (mem_region_t)(i % MEM_REGION_COUNT));
+    }
+    uint64_t alloc_ns = now_ns() - start;
+    
+    /* Free every other block to leave holes */
+    start = now_ns();
+    for (int i = 0; i < n_ops; i += 2) {
+        dtesn_mem_free(ptrs[i]);
+        ptrs[i] = NULL;
+    }
+    uint64_t free_ns = now_ns() - start;
+    
+    printf("  alloc: %.1f ns/op, free: %.1f ns/op (target: %d ns)\n",
+           (double)alloc_ns / n_ops, (double)free_ns / (n_ops / 2), MEM_OP_TARGET_NS);
+    
+    /* Tensor pool churn: after the first round every tensor is a recycled slot */
+    struct ggml_tensor* tensors[64];
+    const int rounds = 1000;
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 64; i++) {
+            tensors[i] = dtesn_mem_tensor_alloc(i % 2 ? GGML_TYPE_F16 : GGML_TYPE_F32,
+                                                64 << (i % 6), 1 + i % 4);
+        }
+        for (int i = 0; i < 64; i++) {
+            dtesn_mem_tensor_free(tensors[i]);
+        }
+    }
+    uint64_t tensor_ns = now_ns() - start;
+    printf("  tensor pool: %.1f ns per alloc + free\n", (double)tensor_ns / (rounds * 64));
+    
+    dtesn_mem_stats_print();
+    
+    for (int i = 0; i < n_ops; i++) {
+        dtesn_mem_free(ptrs[i]);
+    }
+    free(ptrs);
+    
+    return 0;
+}
+
+/* Benchmark HGFS node and edge creation */
+static int bench_hgfs(void) {
+    printf("Benchmarking HGFS...\n");
+    
+    if (kern_bootstrap_init(STAGE1_HYPERGRAPH) != 0) {
+        return 1;
+    }
+    
+    const int n_nodes = 100000;
+    const int n_edges = 400000;
+    void** nodes = (void**)calloc(n_nodes, sizeof(void*));
+    if (!nodes) {
+        return 1;
+    }
+    
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_nodes; i++) {
+        nodes[i] = hgfs_alloc(64, (uint32_t)(i % 4));
+        if (!nodes[i]) {
+            free(nodes);
+            return 1;
+        }
+    }
+    uint64_t alloc_ns = now_ns() - start;
+    
+    /* Pseudo-random endpoints across the whole node set */
+    uint32_t x = 2463534242u;
+    start = now_ns();
+    for (int i = 0; i < n_edges; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if (!hgfs_edge(nodes[x % n_nodes], nodes[(x >> 12) % n_nodes], 1.0f)) {
+            free(nodes);
+            return 1;
+        }
+    }
+    uint64_t edge_ns = now_ns() - start;
+    
+    printf("  %d nodes: alloc %.1f ns/op (target: 1000 ns)\n",
+           n_nodes, (double)alloc_ns / n_nodes);
+    printf("  %d edges: %.1f ns/op (target: 500 ns)\n",
+           n_edges, (double)edge_ns / n_edges);
+    
+    /* Neighborhood queries (the first one folds the delta log into CSR) */
+    uint64_t nb[64];
+    size_t total = 0;
+    start = now_ns();
+    for (int i = 0; i < n_nodes; i++) {
+        total += hgfs_neighbors(hgfs_handle(nodes[i]), HGFS_DIR_BOTH, nb, 64);
+    }
+    uint64_t nb_ns = now_ns() - start;
+    
+    /* 2-hop neighborhoods */
+    const int n_walks = 256;
+    size_t visited = 0;
+    start = now_ns();
+    for (int i = 0; i < n_walks; i++) {
+        hgfs_iter_t* it = hgfs_iter_begin(hgfs_handle(nodes[i]), HGFS_WALK_BFS,
+                                          HGFS_DIR_BOTH, 2);
+        while (hgfs_iter_next(it, NULL, NULL)) {
+            visited++;
+        }
+        hgfs_iter_end(it);
+    }
+    uint64_t walk_ns = now_ns() - start;
+    
+    printf("  neighbors: %.1f ns/query (%.1f per node)\n",
+           (double)nb_ns / n_nodes, (double)total / n_nodes);
+    printf("  2-hop BFS: %.1f us/walk (%.1f nodes, %.1f ns/node)\n",
+           walk_ns / 1000.0 / n_walks, (double)visited / n_walks,
+           (double)walk_ns / visited);
+    
+    /* Delete every 10th node with its edges, then compact */
+    start = now_ns();
+    for (int i = 0; i < n_nodes; i += 10) {
+        hgfs_free(nodes[i]);
+    }
+    uint64_t free_ns = now_ns() - start;
+    
+    hgfs_stats_t stats;
+    hgfs_stats(&stats);
+    size_t edge_slots = stats.edge_slots;
+    
+    start = now_ns();
+    hgfs_compact();
+    uint64_t compact_ns = now_ns() - start;
+    hgfs_stats(&stats);
+    
+    printf("  free: %.1f ns/node, compact: %.2f ms (edge slots %zu -> %zu)\n",
+           (double)free_ns / (n_nodes / 10), compact_ns / 1e6, edge_slots, stats.edge_slots);
+    
+    /* Save, then reopen as a startup would */
+    const char* path = "/tmp/bench_hgfs.hgfs";
+    start = now_ns();
+    int saved = hgfs_save(path);
+    uint64_t save_ns = now_ns() - start;
+    
+    if (saved != 0 || hgfs_close() != 0 || hgfs_init(kern_get_ggml_context()) != 0) {
+        free(nodes);
+        return 1;
+    }
+    
+    start = now_ns();
+    int opened = hgfs_open(path);
+    uint64_t open_ns = now_ns() - start;
+    hgfs_stats(&stats);
+    remove(path);
+    
+    printf("  save: %.2f ms, open: %.2f ms (%zu nodes, %.1f MB mapped)\n",
+           save_ns / 1e6, open_ns / 1e6, stats.nodes, stats.mapped_bytes / 1e6);
+    
+    free(nodes);
+    return opened == 0 ? 0 : 1;
+}
+
+/* Insert edges between pseudo-random nodes; returns ns/edge */
+static double hgfs_ingest(void** nodes, int n_nodes, int n_edges, uint32_t* x) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_edges; i++) {
+        *x ^= *x << 13;
+        *x ^= *x >> 17;
+        *x ^= *x << 5;
+        hgfs_edge(nodes[*x % n_nodes], nodes[(*x >> 8) % n_nodes], 1.0f);
+    }
+    return (double)(now_ns() - start) / n_edges;
+}
+
+static int bench_wal(void) {
+    printf("Benchmarking HGFS write-ahead log...\n");
+    
+    if (kern_bootstrap_init(STAGE1_HYPERGRAPH) != 0) {
+        return 1;
+    }
+    
+    const int n_nodes = 50000;
+    const int n_edges = 200000;
+    void** nodes = (void**)calloc(n_nodes, sizeof(void*));
+    if (!nodes) {
+        return 1;
+    }
+    for (int i = 0; i < n_nodes; i++) {
+        nodes[i] = hgfs_alloc(64, 0);
+    }
+    
+    /* Same ingest without and with the log */
+    uint32_t x = 2463534242u;
+    double plain_ns = hgfs_ingest(nodes, n_nodes, n_edges, &x);
+    
+    const char* path = "/tmp/bench_wal.hgfs";
+    remove("/tmp/bench_wal.hgfs.wal");
+    if (hgfs_wal_start(path, NULL) != 0) {
+        free(nodes);
+        return 1;
+    }
+    
+    double logged_ns = hgfs_ingest(nodes, n_nodes, n_edges, &x);
+    
+    uint64_t start = now_ns();
+    hgfs_sync();
+    uint64_t sync_ns = now_ns() - start;
+    
+    hgfs_wal_stats_t stats;
+    hgfs_wal_stats(&stats);
+    printf("  edge insert: %.1f ns/op unlogged, %.1f ns/op logged\n", plain_ns, logged_ns);
+    printf("  %llu records in %llu group commits (%.0f per fdatasync), %.1f MB, final sync %.2f ms\n",
+           (unsigned long long)stats.lsn, (unsigned long long)stats.commits,
+           (double)stats.lsn / (stats.commits ? stats.commits : 1), stats.log_bytes / 1e6,
+           sync_ns / 1e6);
+    
+    start = now_ns();
+    int ret = hgfs_checkpoint();
+    printf("  checkpoint: %.2f ms\n", (now_ns() - start) / 1e6);
+    
+    hgfs_wal_stop();
+    remove(path);
+    remove("/tmp/bench_wal.hgfs.wal");
+    free(nodes);
+    return ret == 0 ? 0 : 1;
+}
+
+/* Benchmark AtomSpace bulk loading */
+static int bench_atomspace(void) {
+    printf("Benchmarking AtomSpace...\n");
+    
+    if (kern_bootstrap_init(STAGE3_COGNITIVE) != 0) {
+        return 1;
+    }
+    
+    const int n_atoms = 3000;
+    const int n_links = 3000;
+    atom_handle_t* atoms = (atom_handle_t*)calloc(n_atoms, sizeof(atom_handle_t));
+    if (!atoms) {
+        return 1;
+    }
+    
+    char name[32];
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_atoms; i++) {
+        snprintf(name, sizeof(name), "concept-%d", i);
+        atoms[i] = cog_atom_alloc(ATOM_CONCEPT, name);
+    }
+    uint64_t alloc_ns = now_ns() - start;
+    
+    uint32_t x = 2463534242u;
+    int created = 0;
+    start = now_ns();
+    for (int i = 0; i < n_links; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        atom_handle_t pair[2] = {atoms[x % n_atoms], atoms[(x >> 12) % n_atoms]};
+        created += cog_link_create(ATOM_LINK, pair, 2) != 0;
+    }
+    uint64_t link_ns = now_ns() - start;
+    
+    /* Ingest the same links again: every one is found, none is made */
+    x = 2463534242u;
+    int reused = 0;
+    start = now_ns();
+    for (int i = 0; i < n_links; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        atom_handle_t pair[2] = {atoms[x % n_atoms], atoms[(x >> 12) % n_atoms]};
+        reused += cog_link_create(ATOM_LINK, pair, 2) != 0;
+    }
+    uint64_t dedup_ns = now_ns() - start;
+    
+    /* Resolve every name again, in one batch */
+    char (*names)[32] = (char (*)[32])calloc(n_atoms, sizeof(*names));
+    const char** refs = (const char**)calloc(n_atoms, sizeof(const char*));
+    atom_handle_t* found = (atom_handle_t*)calloc(n_atoms, sizeof(atom_handle_t));
+    if (!names || !refs || !found) {
+        free(names);
+        free(refs);
+        free(found);
+        free(atoms);
+        return 1;
+    }
+    for (int i = 0; i < n_atoms; i++) {
+        snprintf(names[i], sizeof(names[i]), "concept-%d", i);
+        refs[i] = names[i];
+    }
+    const int reps = 100;
+    size_t hits = 0;
+    start = now_ns();
+    for (int r = 0; r < reps; r++) {
+        hits += cog_atom_lookup(refs, (size_t)n_atoms, found);
+    }
+    uint64_t lookup_ns = now_ns() - start;
+    
+    /* Two-hop pattern from each atom: (LINK a $0), (LINK $0 $1) */
+    const int n_queries = 1000;
+    cog_term_t first[2] = {{0, 0}, {0, 0}};
+    cog_term_t second[2] = {{0, 0}, {0, 1}};
+    cog_clause_t clauses[2] = {{ATOM_LINK, first, 2}, {ATOM_LINK, second, 2}};
+    int64_t matches = 0;
+    start = now_ns();
+    for (int i = 0; i < n_queries; i++) {
+        first[0].atom = atoms[i];
+        matches += cog_query(clauses, 2, 2, NULL, 0);
+    }
+    uint64_t query_ns = now_ns() - start;
+    
+    printf("  %d named atoms: %.2f us/op (target: 2 us)\n", n_atoms, alloc_ns / 1e3 / n_atoms);
+    printf("  %d links: %.2f us/op (target: 5 us), %.2f ms total\n",
+           created, link_ns / 1e3 / n_links, link_ns / 1e6);
+    printf("  %d duplicate links: %.2f us/op\n", reused, dedup_ns / 1e3 / n_links);
+    printf("  batch lookup: %.1f ns/name\n", (double)lookup_ns / ((double)reps * n_atoms));
+    printf("  2-hop query: %.2f us/query, %.1f matches/query\n",
+           query_ns / 1e3 / n_queries, (double)matches / n_queries);
+    
+    int ok = created == n_links && reused == n_links &&
+             hits == (size_t)reps * n_atoms && found[0] == atoms[0];
+    free(names);
+    free(refs);
+    free(found);
+    free(atoms);
+    return ok ? 0 : 1;
+}
+
+#define MT_NAMES 256                /* Atoms per stress worker and round */
+
+/* AtomSpace stress worker */
+typedef struct {
+    int id;
+    int rounds;
+    uint64_t ops;
+    int failures;
+} mt_worker_t;
+
+/* Make, link, look up, walk and free the worker's own atoms, round after round */
+static void* atomspace_mt_worker(void* arg) {
+    mt_worker_t* w = (mt_worker_t*)arg;
+    char names[MT_NAMES][32];
+    const char* refs[MT_NAMES];
+    atom_handle_t atoms[MT_NAMES], links[MT_NAMES], found[MT_NAMES];
+    for (int i = 0; i < MT_NAMES; i++) {
+        snprintf(names[i], sizeof(names[i]), "mt-%d-%d", w->id, i);
+        refs[i] = names[i];
+    }
+    
+    for (int r = 0; r < w->rounds; r++) {
+        for (int i = 0; i < MT_NAMES; i++) {
+            atoms[i] = cog_atom_alloc(ATOM_CONCEPT, refs[i]);
+            w->failures += atoms[i] == 0;
+        }
+        for (int i = 1; i < MT_NAMES; i++) {
+            atom_handle_t pair[2] = {atoms[i - 1], atoms[i]};
+            links[i] = cog_link_create(ATOM_LINK, pair, 2);
+            w->failures += links[i] == 0;
+        }
+        w->failures += cog_atom_lookup(refs, MT_NAMES, found) != (size_t)MT_NAMES;
+        for (int i = 0; i < MT_NAMES; i++) {
+            size_t expected = (size_t)((i > 0) + (i < MT_NAMES - 1));
+            w->failures += cog_atom_incoming(atoms[i], ATOM_LINK, NULL, 0) != expected;
+        }
+        for (int i = 1; i < MT_NAMES; i++) {
+            w->failures += cog_atom_free(links[i]) != 0;
+        }
+        for (int i = 0; i < MT_NAMES; i++) {
+            w->failures += cog_atom_free(atoms[i]) != 0;
+        }
+        w->ops += 6 * MT_NAMES - 2;
+    }
+    return NULL;
+}
+
+/* Benchmark AtomSpace throughput with every thread writing and reading at once */
+static int bench_atomspace_mt(unsigned max_threads) {
+    printf("Benchmarking AtomSpace on up to %u threads...\n", max_threads);
+    
+    if (kern_bootstrap_init(STAGE3_COGNITIVE) != 0 || max_threads == 0) {
+        return 1;
+    }
+    
+    const int rounds = 100;
+    pthread_t* threads = (pthread_t*)calloc(max_threads, sizeof(pthread_t));
+    mt_worker_t* workers = (mt_worker_t*)calloc(max_threads, sizeof(mt_worker_t));
+    if (!threads || !workers) {
+        free(threads);
+        free(workers);
+        return 1;
+    }
+    
+    /* Same work per thread, so perfect scaling keeps the time flat */
+    double base = 0.0;
+    int failures = 0;
+    for (unsigned n = 1; n <= max_threads; n *= 2) {
+        uint64_t start = now_ns();
+        for (unsigned t = 0; t < n; t++) {
+            workers[t] = (mt_worker_t){(int)t, rounds, 0, 0};
+            pthread_create(&threads[t], NULL, atomspace_mt_worker, &workers[t]);
+        }
+        uint64_t ops = 0;
+        for (unsigned t = 0; t < n; t++) {
+            pthread_join(threads[t], NULL);
+            ops += workers[t].ops;
+            failures += workers[t].failures;
+        }
+        uint64_t elapsed = now_ns() - start;
+        
+        double rate = ops / (elapsed / 1e9);
+        if (n == 1) {
+            base = rate;
+        }
+        printf("  %2u threads: %.2f Mops/s, %.0f ns/op per thread, %.2fx of 1 thread\n",
+               n, rate / 1e6, (double)elapsed * n / ops, rate / base);
+    }
+    printf("  ops: alloc, link, lookup, incoming, free (%d failed)\n", failures);
+    
+    free(threads);
+    free(workers);
+    return failures == 0 ? 0 : 1;
+}
+
+/* Free each line's link and its two concepts, returning how many atoms went */
+static int load_round_free(const char* prefix, int n_lines) {
+    char name_a[32], name_b[32];
+    int freed = 0;
+    for (int i = 0; i < n_lines; i++) {
+        snprintf(name_a, sizeof(name_a), "%s-%d", prefix, 2 * i);
+        snprintf(name_b, sizeof(name_b), "%s-%d", prefix, 2 * i + 1);
+        const char* names[2] = {name_a, name_b};
+        atom_handle_t pair[2];
+        if (cog_atom_lookup(names, 2, pair) != 2) {
+            continue;
+        }
+        atom_handle_t link;
+        if (cog_atom_incoming(pair[0], ATOM_LINK, &link, 1) == 1) {
+            freed += cog_atom_free(link) == 0;
+        }
+        freed += (cog_atom_free(pair[0]) == 0) + (cog_atom_free(pair[1]) == 0);
+    }
+    return freed;
+}
+
+/* Benchmark bulk import against one call per atom */
+static int bench_load(void) {
+    printf("Benchmarking AtomSpace bulk import...\n");
+    
+    if (kern_bootstrap_init(STAGE3_COGNITIVE) != 0) {
+        return 1;
+    }
+    
+    /*
+     * Every line links two concepts of its own, so each one creates three
+     * atoms rather than hitting names and links already present. A round
+     * fills most of the AtomSpace (8192 atoms) and is freed before the next.
+     */
+    const int n_lines = 2500;
+    const int rounds = 40;
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_atomspace_%d.txt", (int)getpid());
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        return 1;
+    }
+    for (int i = 0; i < n_lines; i++) {
+        if (i % 2) {
+            fprintf(f, "{\"type\": \"link\", \"outgoing\": [{\"type\": \"concept\", \"name\": "
+                       "\"load-%d\"}, {\"type\": \"concept\", \"name\": \"load-%d\"}]}\n",
+                    2 * i, 2 * i + 1);
+        } else {
+            fprintf(f, "(link (concept \"load-%d\") (concept \"load-%d\"))\n", 2 * i, 2 * i + 1);
+        }
+    }
+    long size = ftell(f);
+    fclose(f);
+    
+    uint64_t load_ns = 0;
+    int failures = 0;
+    for (int r = 0; r < rounds; r++) {
+        uint64_t start = now_ns();
+        int64_t loaded = atomspace_load(path);
+        load_ns += now_ns() - start;
+        failures += loaded != n_lines;
+        failures += load_round_free("load", n_lines) != 3 * n_lines;
+    }
+    unlink(path);
+    
+    /* The same atoms and links, one call each (no parsing) */
+    char name_a[32], name_b[32];
+    atom_handle_t* atoms = (atom_handle_t*)calloc(3 * (size_t)n_lines, sizeof(atom_handle_t));
+    if (!atoms) {
+        return 1;
+    }
+    uint64_t call_ns = 0;
+    for (int r = 0; r < rounds; r++) {
+        int created = 0;
+        uint64_t start = now_ns();
+        for (int i = 0; i < n_lines; i++) {
+            snprintf(name_a, sizeof(name_a), "call-%d", 2 * i);
+            snprintf(name_b, sizeof(name_b), "call-%d", 2 * i + 1);
+            atom_handle_t* pair = &atoms[3 * i];
+            pair[0] = cog_atom_alloc(ATOM_CONCEPT, name_a);
+            pair[1] = cog_atom_alloc(ATOM_CONCEPT, name_b);
+            pair[2] = cog_link_create(ATOM_LINK, pair, 2);
+            created += pair[2] != 0;
+        }
+        call_ns += now_ns() - start;
+        failures += created != n_lines;
+        for (int i = 3 * n_lines; i > 0; i--) {
+            cog_atom_free(atoms[i - 1]);
+        }
+    }
+    free(atoms);
+    
+    uint64_t total = (uint64_t)n_lines * rounds;
+    printf("  atomspace_load: %d rounds of %d lines (%.1f KB), %.0f ns/line, %.0f MB/s\n",
+           rounds, n_lines, size / 1e3, (double)load_ns / total,
+           size * rounds / 1e6 / (load_ns / 1e9));
+    printf("  single calls:   %d rounds of %d lines, %.0f ns/line\n",
+           rounds, n_lines, (double)call_ns / total);
+    
+    return failures == 0 ? 0 : 1;
+}
+
+/* Benchmark a sweep over one membrane depth */
+static int bench_depth(void) {
+    printf("Benchmarking HGFS depth sweeps...\n");
+    
+    if (kern_bootstrap_init(STAGE1_HYPERGRAPH) != 0) {
+        return 1;
+    }
+    
+    /* Depths interleaved as atoms of different membranes would be */
+    const int n_nodes = 400000;
+    const int n_depths = 8;
+    uint64_t* handles = (uint64_t*)calloc(n_nodes, sizeof(uint64_t));
+    if (!handles) {
+        return 1;
+    }
+    for (int i = 0; i < n_nodes; i++) {
+        float* data = (float*)hgfs_alloc(64, (uint32_t)(i % n_depths));
+        if (!data) {
+            free(handles);
+            return 1;
+        }
+        data[0] = 1.0f;
+        handles[i] = hgfs_handle(data);
+    }
+    
+    /* Same nodes: by handle in allocation order, then through the depth view */
+    const int reps = 20;
+    float sum = 0.0f;
+    uint64_t start = now_ns();
+    for (int r = 0; r < reps; r++) {
+        for (int i = 0; i < n_nodes; i += n_depths) {
+            sum += *(const float*)hgfs_data(handles[i]);
+        }
+    }
+    uint64_t handle_ns = now_ns() - start;
+    
+    hgfs_depth_view_t view;
+    hgfs_depth_view(0, &view);
+    start = now_ns();
+    for (int r = 0; r < reps; r++) {
+        for (size_t i = 0; i < view.count; i++) {
+            sum += *(const float*)view.data[i];
+        }
+    }
+    uint64_t view_ns = now_ns() - start;
+    
+    hgfs_stats_t stats;
+    hgfs_stats(&stats);
+    printf("  %zu nodes at depth 0: %.2f ns/node by handle, %.2f ns/node via depth view\n",
+           view.count, (double)handle_ns / reps / view.count, (double)view_ns / reps / view.count);
+    printf("  %zu depths, %.1f MB pooled (checksum %.0f)\n",
+           stats.depths, stats.pool_bytes / 1e6, sum);
+    
+    free(handles);
+    return 0;
+}
+
+/* Benchmark exact and approximate embedding search */
+static int bench_embed(void) {
+    const char* type = getenv("AICHAT_EMBED_TYPE");
+    printf("Benchmarking embedding search (%s)...\n", type ? type : "f32");
+    
+    if (kern_bootstrap_init(STAGE3_COGNITIVE) != 0) {
+        return 1;
+    }
+    
+    /* Clustered vectors, as concept embeddings tend to be */
+    const int n_atoms = 8000;
+    const int n_clusters = 64;
+    const int n_queries = 64;
+    const int k = 10;
+    float* vecs = (float*)malloc((size_t)n_atoms * COG_EMBED_DIM * sizeof(float));
+    atom_handle_t* atoms = (atom_handle_t*)calloc(n_atoms, sizeof(atom_handle_t));
+    atom_handle_t* exact = (atom_handle_t*)calloc((size_t)n_queries * k, sizeof(atom_handle_t));
+    atom_handle_t* approx = (atom_handle_t*)calloc((size_t)n_queries * k, sizeof(atom_handle_t));
+    if (!vecs || !atoms || !exact || !approx) {
+        free(vecs);
+        free(atoms);
+        free(exact);
+        free(approx);
+        return 1;
+    }
+    uint32_t x = 2463534242u;
+    for (int i = 0; i < n_atoms; i++) {
+        for (int d = 0; d < COG_EMBED_DIM; d++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            float noise = (float)(x >> 8) / (float)(1u << 24) - 0.5f;
+            float center = (float)(((i % n_clusters) * 31 + d * 7) % 17) / 17.0f - 0.5f;
+            vecs[(size_t)i * COG_EMBED_DIM + d] = center + 0.5f * noise;
+        }
+        atoms[i] = cog_atom_alloc(ATOM_NODE, NULL);
+        if (!atoms[i] || cog_atom_set_embedding(atoms[i], vecs + (size_t)i * COG_EMBED_DIM) != 0) {
+            printf("  only %d atoms fit\n", i);
+            return 1;
+        }
+    }
+    
+    /* Queries are perturbed atom vectors */
+    float* queries = (float*)malloc((size_t)n_queries * COG_EMBED_DIM * sizeof(float));
+    if (!queries) {
+        return 1;
+    }
+    for (int q = 0; q < n_queries; q++) {
+        for (int d = 0; d < COG_EMBED_DIM; d++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            float noise = (float)(x >> 8) / (float)(1u << 24) - 0.5f;
+            queries[(size_t)q * COG_EMBED_DIM + d] = vecs[(size_t)(q * 97) * COG_EMBED_DIM + d] + 0.2f * noise;
+        }
+    }
+    
+    uint64_t start = now_ns();
+    for (int q = 0; q < n_queries; q++) {
+        cog_embed_topk(queries + (size_t)q * COG_EMBED_DIM, 1, k, COG_SIM_COSINE, exact + q * k, NULL);
+    }
+    uint64_t single_ns = now_ns() - start;
+    
+    start = now_ns();
+    cog_embed_topk(queries, n_queries, k, COG_SIM_COSINE, exact, NULL);
+    uint64_t batch_ns = now_ns() - start;
+    
+    printf("  exact, %d atoms: %.1f us/query alone, %.1f us/query in a batch of %d\n",
+           n_atoms, single_ns / 1e3 / n_queries, batch_ns / 1e3 / n_queries, n_queries);
+    
+    cog_hnsw_params_t params = COG_HNSW_DEFAULT;
+    start = now_ns();
+    if (cog_embed_index_build(&params) != 0) {
+        return 1;
+    }
+    printf("  HNSW build (m %zu, ef_construction %zu): %.1f ms\n",
+           params.m, params.ef_construction, (now_ns() - start) / 1e6);
+    
+    const size_t efs[] = {16, 64, 256};
+    for (size_t e = 0; e < sizeof(efs) / sizeof(efs[0]); e++) {
+        cog_embed_index_set_ef(efs[e]);
+        start = now_ns();
+        cog_embed_index_search(queries, n_queries, k, approx, NULL);
+        uint64_t search_ns = now_ns() - start;
+        
+        int hits = 0;
+        for (int q = 0; q < n_queries; q++) {
+            for (int i = 0; i < k; i++) {
+                for (int j = 0; j < k; j++) {
+                    hits += approx[q * k + i] == exact[q * k + j];
+                }
+            }
+        }
+        printf("  HNSW ef %3zu: %.1f us/query, recall@%d %.3f\n",
+               efs[e], search_ns / 1e3 / n_queries, k, (double)hits / (n_queries * k));
+    }
+    
+    cog_embed_index_destroy();
+    free(queries);
+    free(vecs);
+    free(atoms);
+    free(exact);
+    free(approx);
+    return 0;
+}
+
+/* Benchmark adjacency export and one propagation step */
+static int bench_matrix(void) {
+    printf("Benchmarking HGFS matrix export...\n");
+    
+    if (kern_bootstrap_init(STAGE1_HYPERGRAPH) != 0) {
+        return 1;
+    }
+    
+    const int n_nodes = 100000;
+    const int n_edges = 400000;
+    void** nodes = (void**)calloc(n_nodes, sizeof(void*));
+    if (!nodes) {
+        return 1;
+    }
+    for (int i = 0; i < n_nodes; i++) {
+        nodes[i] = hgfs_alloc(sizeof(float), 0);
+        *(float*)nodes[i] = 1.0f;
+    }
+    uint32_t x = 2463534242u;
+    double plain_ns = hgfs_ingest(nodes, n_nodes, n_edges, &x);
+    
+    uint64_t start = now_ns();
+    hgfs_matrix_t* m = hgfs_matrix_create(0, 0, HGFS_DIR_OUT, 0);
+    uint64_t create_ns = now_ns() - start;
+    if (!m) {
+        free(nodes);
+        return 1;
+    }
+    
+    /* New edges are queued by the export until the sync merges them */
+    double tracked_ns = hgfs_ingest(nodes, n_nodes, 20000, &x);
+    start = now_ns();
+    hgfs_matrix_info_t info;
+    int ret = hgfs_matrix_sync(m, &info);
+    uint64_t sync_ns = now_ns() - start;
+    
+    printf("  export %u rows, %u entries: %.2f ms\n", info.rows, info.nnz, create_ns / 1e6);
+    printf("  edge insert: %.1f ns/op plain, %.1f ns/op with export; sync: %.2f ms\n",
+           plain_ns, tracked_ns, sync_ns / 1e6);
+    
+    /* y = A x: CSR loop vs adjacency queries and payload lookups */
+    float* in = (float*)malloc(info.rows * sizeof(float));
+    float* out = (float*)calloc(info.rows, sizeof(float));
+    hgfs_edge_info_t* edges = (hgfs_edge_info_t*)malloc(256 * sizeof(hgfs_edge_info_t));
+    if (!in || !out || !edges) {
+        free(in);
+        free(out);
+        free(edges);
+        free(nodes);
+        return 1;
+    }
+    for (uint32_t r = 0; r < info.rows; r++) {
+        in[r] = 1.0f;
+    }
+    
+    const int32_t* row_ptr = (const int32_t*)info.row_ptr->data;
+    const int32_t* cols = (const int32_t*)info.cols->data;
+    const float* values = (const float*)info.values->data;
+    start = now_ns();
+    for (uint32_t r = 0; r < info.rows; r++) {
+        float sum = 0.0f;
+        for (int32_t p = row_ptr[r]; p < row_ptr[r + 1]; p++) {
+            sum += values[p] * in[cols[p]];
+        }
+        out[r] = sum;
+    }
+    uint64_t csr_ns = now_ns() - start;
+    
+    float check = 0.0f;
+    start = now_ns();
+    for (int i = 0; i < n_nodes; i++) {
+        size_t n = hgfs_out_edges(hgfs_handle(nodes[i]), edges, 256);
+        float sum = 0.0f;
+        for (size_t k = 0; k < n; k++) {
+            sum += edges[k].weight * *(const float*)hgfs_data(edges[k].dst);
+        }
+        check += sum - out[i];
+    }
+    uint64_t chase_ns = now_ns() - start;
+    
+    printf("  propagation step: %.2f ms CSR, %.2f ms via adjacency queries (residual %.1f)\n",
+           csr_ns / 1e6, chase_ns / 1e6, check);
+    
+    hgfs_matrix_destroy(m);
+    free(in);
+    free(out);
+    free(edges);
+    free(nodes);
+    return ret == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <benchmark>\n", argv[0]);
+        return 1;
+    }
+    
+    int ret = 0;
+    
+    if (strcmp(argv[1], "scheduler") == 0) {
+        ret = bench_scheduler();
+    } else if (strcmp(argv[1], "executor") == 0) {
+        ret = bench_executor(argc > 2 ? (unsigned)atoi(argv[2]) : 4);
+    } else if (strcmp(argv[1], "dag") == 0) {
+        ret = bench_dag(argc > 2 ? (unsigned)atoi(argv[2]) : 0);
+    } else if (strcmp(argv[1], "timers") == 0) {
+        ret = bench_timers();
+    } else if (strcmp(argv[1], "memory") == 0) {
+        ret = bench_memory();
+    } else if (strcmp(argv[1], "hgfs") == 0) {
+        ret = bench_hgfs();
+    } else if (strcmp(argv[1], "wal") == 0) {
+        ret = bench_wal();
+    } else if (strcmp(argv[1], "atomspace") == 0) {
+        ret = bench_atomspace();
+    } else if (strcmp(argv[1], "atomspace_mt") == 0) {
+        ret = bench_atomspace_mt(argc > 2 ? (unsigned)atoi(argv[2]) : 8);
+    } else if (strcmp(argv[1], "load") == 0) {
+        ret = bench_load();
+    } else if (strcmp(argv[1], "depth") == 0) {
+        ret = bench_depth();
+    } else if (strcmp(argv[1], "matrix") == 0) {
+        ret = bench_matrix();
+    } else if (strcmp(argv[1], "embed") == 0) {
+        ret = bench_embed();
+    } else {
+        fprintf(stderr, "Unknown benchmark: %s\n", argv[1]);
+        return 1;
+    }
+    
+    return ret;
+}
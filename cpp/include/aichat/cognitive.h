@@ -21,6 +21,13 @@ struct ggml_tensor;
 
 /**
  * @defgroup AtomSpace Hypergraph AtomSpace
+ * 
+ * Every AtomSpace call is thread-safe once atomspace_init() has returned.
+ * Lookups, incoming sets and queries take no locks; writers lock only the
+ * shard of the name or link they change, so writers to different shards
+ * do not wait for each other. Embedding reads and searches share a
+ * reader-writer lock with embedding writes. A freed atom's slot is reused
+ * once every call that could have seen the atom has returned.
  * @{
  */
 
@@ -43,21 +50,246 @@ typedef enum {
  */
 atom_handle_t cog_atom_alloc(atom_type_t type, const char* name);
 
+/**
+ * Allocate atoms in one call
+ * 
+ * Capacity for the whole batch is checked first and the name index
+ * grows at most once, so either every atom is created or none is. Every
+ * shard is locked for the call, so other writers never see part of it. As
+ * with cog_atom_alloc, a name that already has an atom (or repeats in
+ * the batch) gives that atom.
+ * 
+ * @param types Atom types
+ * @param names Atom names (the array and its entries can be NULL)
+ * @param n Number of atoms
+ * @param atoms Output atom handles
+ * @return 0 on success, negative on error
+ */
+int cog_atom_alloc_batch(const atom_type_t* types, const char* const* names, size_t n,
+                         atom_handle_t* atoms);
+
+/**
+ * Look up named atoms
+ * @param names Atom names (NULL entries are not found)
+ * @param n Number of names
+ * @param atoms Output atom handles, 0 where no atom has the name
+ * @return Number of names found
+ */
+size_t cog_atom_lookup(const char* const* names, size_t n, atom_handle_t* atoms);
+
+/**
+ * Free an atom
+ * 
+ * The handle goes stale; links that contain the atom keep its handle.
+ * 
+ * @param atom Atom handle
+ * @return 0 on success, negative if the handle is stale or invalid
+ */
+int cog_atom_free(atom_handle_t atom);
+
 /**
  * Create link between atoms
+ * 
+ * Links are unique by type and outgoing atoms: if the link exists, its
+ * handle is returned.
+ * 
  * @param type Link type
  * @param atoms Array of atom handles
  * @param n_atoms Number of atoms
- * @return Link atom handle or 0 on error
+ * @return Link atom handle or 0 on error (including stale atom handles)
  */
 atom_handle_t cog_link_create(atom_type_t type, atom_handle_t* atoms, size_t n_atoms);
 
+/**
+ * Get the links of one type that contain an atom
+ * @param atom Atom handle
+ * @param type Link type
+ * @param links Output link handles (may be NULL)
+ * @param max_links Capacity of links
+ * @return Number of such links (may exceed max_links)
+ */
+size_t cog_atom_incoming(atom_handle_t atom, atom_type_t type,
+                         atom_handle_t* links, size_t max_links);
+
+/**
+ * Pattern term: a constant atom, or variable var when atom is 0
+ */
+typedef struct {
+    atom_handle_t atom;
+    uint32_t var;
+} cog_term_t;
+
+/**
+ * Pattern clause: a link of this type and arity over these terms
+ */
+typedef struct {
+    atom_type_t type;
+    const cog_term_t* outgoing;
+    size_t arity;
+} cog_clause_t;
+
+/**
+ * Find every binding of the variables that makes all clauses existing links
+ * 
+ * Search starts from the clause with the most selective known atom
+ * (smallest incoming set). Links over freed atoms never match.
+ * 
+ * @param clauses Pattern clauses (at most 32)
+ * @param n_clauses Number of clauses
+ * @param n_vars Number of variables; terms use var < n_vars
+ * @param results Output bindings, n_vars handles per match
+ * @param max_results Number of matches results can hold
+ * @return Number of matches (may exceed max_results), negative on error
+ */
+int64_t cog_query(const cog_clause_t* clauses, size_t n_clauses, size_t n_vars,
+                  atom_handle_t* results, size_t max_results);
+
+/** Embedding element type */
+typedef enum {
+    COG_EMBED_F32 = 0,
+    COG_EMBED_F16 = 1,
+    COG_EMBED_Q8_0 = 2,         /**< ggml Q8_0: int8 with an F16 scale per 32 values */
+} cog_embed_type_t;
+
 /**
  * Initialize AtomSpace
  * @param ctx GGML context
+ * @param embed_type Element type embeddings are stored as
  * @return 0 on success, negative on error
  */
-int atomspace_init(struct ggml_context* ctx);
+int atomspace_init(struct ggml_context* ctx, cog_embed_type_t embed_type);
+
+/**
+ * Load atoms and links from a file
+ * 
+ * One expression per line, as JSON or as an s-expression:
+ * 
+ *     {"type": "concept", "name": "cat"}
+ *     {"type": "link", "outgoing": [{"type": "concept", "name": "cat"},
+ *                                   {"type": "concept", "name": "animal"}]}
+ *     (link (concept "cat") (concept "animal"))
+ * 
+ * Types are node, link, concept and predicate. An expression with a
+ * name is a node (a name that has an atom gives that atom); one with
+ * outgoing atoms is a link. Blank lines and lines starting with '#' or
+ * ';' are skipped.
+ * 
+ * The file is mapped and split into chunks that are parsed, and their
+ * names resolved, on one thread per CPU. Chunks are then inserted in
+ * file order, each allocating its nodes in one batch.
+ * 
+ * The AtomSpace holds at most 8192 atoms (MAX_ATOMS), so a file that
+ * creates more atoms than are free loads partially: the chunks inserted
+ * before it filled up stay, along with any atoms the failing chunk had
+ * created, and the call returns an error.
+ * 
+ * @param path File path
+ * @return Number of expressions loaded, negative on error (nothing is
+ *         loaded if the file does not parse, part of it if the AtomSpace
+ *         fills up)
+ */
+int64_t atomspace_load(const char* path);
+
+/** @} */
+
+/**
+ * @defgroup Embeddings Atom Embeddings
+ * @{
+ * 
+ * Atom embeddings are rows of a row-major matrix, stored as the type
+ * given to atomspace_init. An atom gets a row on its first
+ * cog_atom_set_embedding; until then its embedding reads as zero and it
+ * is not searched. Rows are allocated in blocks as they are needed.
+ */
+
+/** Embedding dimension */
+#define COG_EMBED_DIM 512
+
+/** Similarity measure */
+typedef enum {
+    COG_SIM_DOT = 0,
+    COG_SIM_COSINE = 1,
+} cog_sim_t;
+
+/**
+ * Get an atom's embedding (dequantized)
+ * @param atom Atom handle
+ * @param vec Output, COG_EMBED_DIM floats
+ * @return 0 on success, negative if the handle is stale or invalid
+ */
+int cog_atom_embedding(atom_handle_t atom, float* vec);
+
+/**
+ * Set an atom's embedding (also updates the index, if built)
+ * @param atom Atom handle
+ * @param vec COG_EMBED_DIM floats
+ * @return 0 on success, negative on error
+ */
+int cog_atom_set_embedding(atom_handle_t atom, const float* vec);
+
+/**
+ * Exact top-k search over all atoms with an embedding
+ * 
+ * Queries are processed together, so each block of the matrix is read
+ * once per batch. Rows are scored in their stored type; for Q8_0 the
+ * queries are quantized too and blocks are multiplied as integers.
+ * 
+ * @param queries n_queries rows of COG_EMBED_DIM floats
+ * @param n_queries Number of queries
+ * @param k Results per query
+ * @param sim Similarity measure
+ * @param atoms Output, k atom handles per query, best first (0 past the end)
+ * @param scores Output, k similarities per query (may be NULL)
+ * @return Results per query (at most k), negative on error
+ */
+int cog_embed_topk(const float* queries, size_t n_queries, size_t k, cog_sim_t sim,
+                   atom_handle_t* atoms, float* scores);
+
+/** HNSW index parameters */
+typedef struct {
+    size_t m;                   /**< Links per node (2m on the bottom layer) */
+    size_t ef_construction;     /**< Candidate list size while inserting */
+    size_t ef_search;           /**< Candidate list size while searching (recall) */
+    cog_sim_t sim;              /**< Similarity measure */
+} cog_hnsw_params_t;
+
+/** Default HNSW parameters */
+#define COG_HNSW_DEFAULT {16, 200, 64, COG_SIM_COSINE}
+
+/**
+ * Build the approximate (HNSW) index over all atoms
+ * 
+ * Atoms whose embedding is set later are added; freed atoms are dropped
+ * from results. Rebuilding reclaims the nodes they leave behind.
+ * 
+ * @param params Index parameters (NULL for COG_HNSW_DEFAULT)
+ * @return 0 on success, negative on error
+ */
+int cog_embed_index_build(const cog_hnsw_params_t* params);
+
+/**
+ * Set the search candidate list size (higher is slower with better recall)
+ * @param ef_search Candidate list size
+ * @return 0 on success, negative if there is no index
+ */
+int cog_embed_index_set_ef(size_t ef_search);
+
+/**
+ * Approximate top-k search through the index
+ * @param queries n_queries rows of COG_EMBED_DIM floats
+ * @param n_queries Number of queries
+ * @param k Results per query
+ * @param atoms Output, k atom handles per query, best first (0 past the end)
+ * @param scores Output, k similarities per query (may be NULL)
+ * @return Fewest results for any query (at most k), negative if there is no index
+ */
+int cog_embed_index_search(const float* queries, size_t n_queries, size_t k,
+                           atom_handle_t* atoms, float* scores);
+
+/**
+ * Drop the index
+ */
+void cog_embed_index_destroy(void);
 
 /** @} */
 
@@ -0,0 +1,253 @@
+/**
+ * @file coro.h
+ * @brief Cooperative tasks - C++20 coroutines on the DTESN scheduler
+ * 
+ * A coro_task runs on the scheduler like any task_fn_t, but can suspend
+ * instead of running to completion:
+ * 
+ *   co_await aichat::yield();          resume on the next tick
+ *   co_await aichat::sleep_for(us);    resume from the timer wheel
+ *   co_await aichat::after(handle);    resume once a scheduled task completes
+ *   co_await child(args);              run a child coroutine to completion
+ * 
+ * Each resumption is an ordinary scheduler task at the coroutine's
+ * priority and membrane depth, submitted through the C API in kernel.h.
+ * Frames come from the DTESN heap (dtesn_coro_frame_alloc); allocation
+ * failure yields an empty coro_task rather than an exception.
+ */
+
+#ifndef AICHAT_CORO_H
+#define AICHAT_CORO_H
+
+#include "aichat/kernel.h"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+namespace aichat {
+
+/**
+ * Coroutine task (lazily started)
+ */
+class coro_task {
+public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+    
+    /** Resume the awaiting parent, or free a spawned frame */
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+        
+        std::coroutine_handle<> await_suspend(handle_type h) noexcept {
+            promise_type& p = h.promise();
+            if (p.continuation) {
+                return p.continuation;
+            }
+            if (p.detached) {
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+        
+        void await_resume() const noexcept {}
+    };
+    
+    struct promise_type {
+        task_priority_t priority = PRIORITY_NORMAL;
+        uint32_t depth = 0;
+        std::coroutine_handle<> continuation;  /* Awaiting parent, if any */
+        bool detached = false;                 /* Spawned: frame frees itself */
+        
+        static void* operator new(std::size_t size) noexcept {
+            return dtesn_coro_frame_alloc(size);
+        }
+        
+        static void operator delete(void* frame) noexcept {
+            dtesn_coro_frame_free(frame);
+        }
+        
+        static coro_task get_return_object_on_allocation_failure() noexcept {
+            return coro_task();
+        }
+        
+        coro_task get_return_object() noexcept {
+            return coro_task(handle_type::from_promise(*this));
+        }
+        
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+    
+    /** Run as a child of the awaiting coroutine, at its priority and depth */
+    struct child_awaiter {
+        handle_type child;
+        
+        bool await_ready() const noexcept { return !child; }
+        
+        handle_type await_suspend(handle_type parent) noexcept {
+            child.promise().priority = parent.promise().priority;
+            child.promise().depth = parent.promise().depth;
+            child.promise().continuation = parent;
+            return child;
+        }
+        
+        /** @return false if the child's frame could not be allocated */
+        bool await_resume() const noexcept { return static_cast<bool>(child); }
+    };
+    
+    coro_task() noexcept = default;
+    
+    coro_task(coro_task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+    
+    coro_task& operator=(coro_task&& other) noexcept {
+        if (this != &other) {
+            if (h_) {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    
+    ~coro_task() {
+        if (h_) {
+            h_.destroy();
+        }
+    }
+    
+    coro_task(const coro_task&) = delete;
+    coro_task& operator=(const coro_task&) = delete;
+    
+    /** False if the frame could not be allocated */
+    explicit operator bool() const noexcept { return static_cast<bool>(h_); }
+    
+    child_awaiter operator co_await() && noexcept { return child_awaiter{h_}; }
+    
+    /** Give up ownership of the frame */
+    handle_type release() noexcept { return std::exchange(h_, {}); }
+
+private:
+    explicit coro_task(handle_type h) noexcept : h_(h) {}
+    
+    handle_type h_;
+};
+
+namespace detail {
+
+/** task_fn_t trampoline: data is the coroutine frame address */
+inline void coro_resume(void* frame) {
+    std::coroutine_handle<>::from_address(frame).resume();
+}
+
+}  // namespace detail
+
+/**
+ * Suspension on the scheduler
+ * 
+ * await_suspend must not touch the awaiter once the resume task is
+ * submitted: a worker may resume (and even finish) the coroutine before
+ * it returns. If submission fails the coroutine carries on without
+ * suspending and co_await returns false.
+ */
+class sched_awaiter {
+public:
+    enum kind_t { YIELD, SLEEP, AFTER };
+    
+    sched_awaiter(kind_t kind, uint64_t arg) noexcept : kind_(kind), arg_(arg) {}
+    
+    bool await_ready() const noexcept { return false; }
+    
+    bool await_suspend(coro_task::handle_type h) noexcept {
+        task_priority_t priority = h.promise().priority;
+        uint32_t depth = h.promise().depth;
+        uint64_t arg = arg_;
+        void* frame = h.address();
+        
+        suspended_ = true;
+        
+        bool ok;
+        switch (kind_) {
+        case SLEEP:
+            ok = dtesn_sched_after(detail::coro_resume, frame, priority, depth, arg) != 0;
+            break;
+        case AFTER:
+            ok = dtesn_sched_submit_deps(detail::coro_resume, frame, priority, depth,
+                                         &arg, 1, nullptr) == SCHED_OK;
+            break;
+        default:
+            ok = dtesn_sched_submit_next(detail::coro_resume, frame, priority, depth,
+                                         nullptr) == SCHED_OK;
+            break;
+        }
+        
+        if (!ok) {
+            suspended_ = false;
+        }
+        return ok;
+    }
+    
+    /** @return true if the coroutine was suspended and resumed by the scheduler */
+    bool await_resume() const noexcept { return suspended_; }
+
+private:
+    kind_t kind_;
+    uint64_t arg_;
+    bool suspended_ = false;
+};
+
+/**
+ * Let other work run; resume on the next tick
+ */
+inline sched_awaiter yield() noexcept {
+    return sched_awaiter(sched_awaiter::YIELD, 0);
+}
+
+/**
+ * Resume after a delay (timer wheel resolution)
+ * @param delay_us Delay in microseconds
+ */
+inline sched_awaiter sleep_for(uint64_t delay_us) noexcept {
+    return sched_awaiter(sched_awaiter::SLEEP, delay_us);
+}
+
+/**
+ * Resume once a scheduled task has completed (immediately if it already has)
+ * @param task Task handle
+ */
+inline sched_awaiter after(task_handle_t task) noexcept {
+    return sched_awaiter(sched_awaiter::AFTER, task);
+}
+
+/**
+ * Start a coroutine on the scheduler
+ * 
+ * The frame frees itself when the coroutine finishes.
+ * 
+ * @param task Coroutine to run (consumed)
+ * @param priority Priority of every resumption
+ * @param depth Membrane depth (OEIS A000081)
+ * @return SCHED_OK, SCHED_ERR_FULL, or SCHED_ERR_INVALID for an empty task
+ */
+inline int spawn(coro_task&& task, task_priority_t priority, uint32_t depth) {
+    coro_task::handle_type h = task.release();
+    if (!h) {
+        return SCHED_ERR_INVALID;
+    }
+    
+    h.promise().priority = priority;
+    h.promise().depth = depth;
+    h.promise().detached = true;
+    
+    int ret = dtesn_sched_submit(detail::coro_resume, h.address(), priority, depth, nullptr);
+    if (ret != SCHED_OK) {
+        h.destroy();
+    }
+    return ret;
+}
+
+}  // namespace aichat
+
+#endif /* AICHAT_CORO_H */
@@ -41,6 +41,12 @@ typedef enum {
  */
 int kern_bootstrap_init(bootstrap_stage_t stage);
 
+/**
+ * Get the GGML context created by Stage 0
+ * @return Context, or NULL before Stage 0
+ */
+struct ggml_context* kern_get_ggml_context(void);
+
 /** @} */
 
 /**
@@ -51,6 +57,11 @@ int kern_bootstrap_init(bootstrap_stage_t stage);
 /** Scheduler tick target: ≤5µs per tick */
 #define SCHED_TICK_TARGET_US 5
 
+/** Scheduler status codes */
+#define SCHED_OK 0
+#define SCHED_ERR_INVALID -1  /**< Not initialized, NULL fn or bad priority */
+#define SCHED_ERR_FULL -2     /**< Every task slot is in use; back off and retry */
+
 /** Task priority levels */
 typedef enum {
     PRIORITY_CRITICAL = 0,
@@ -59,35 +70,310 @@ typedef enum {
     PRIORITY_LOW = 3,
 } task_priority_t;
 
-/** Task handle */
+/**
+ * Task handle
+ * 
+ * Never 0 and never reused. The low bits hold the task's slot and the
+ * bits above them a submission sequence number, so handles increase
+ * with submission order but are not consecutive.
+ */
 typedef uint64_t task_handle_t;
 
 /** Task callback function */
 typedef void (*task_fn_t)(void* data);
 
+/** Executor modes */
+typedef enum {
+    SCHED_EXEC_BARRIER = 0,       /**< dtesn_sched_tick dispatches and waits */
+    SCHED_EXEC_FREE_RUNNING = 1,  /**< Tasks run as soon as they are scheduled */
+} sched_exec_mode_t;
+
+/** Optional per-task scheduling attributes (zero-initialize unused fields) */
+typedef struct {
+    const task_handle_t* deps;  /**< Tasks that must complete first (can be NULL) */
+    size_t n_deps;              /**< Number of handles in deps */
+    uint64_t deadline_us;       /**< Deadline relative to submission (0 = none) */
+    uint32_t cost_us;           /**< Estimated run time (0 = unknown) */
+} sched_task_attr_t;
+
+/** Tick budget statistics */
+typedef struct {
+    uint32_t budget_us;        /**< Current budget (0 = unlimited) */
+    uint64_t ticks;            /**< Ticks executed */
+    uint64_t overruns;         /**< Ticks over budget (SCHED_TICK_TARGET_US if unlimited) */
+    uint64_t deferred;         /**< Task deferrals to a later tick */
+    uint64_t deadline_misses;  /**< Tasks that finished after their deadline */
+    uint64_t tick_us_max;      /**< Longest tick */
+} sched_budget_stats_t;
+
 /**
  * Initialize scheduler
  * @return 0 on success, negative on error
  */
 int dtesn_sched_init(void);
 
+/**
+ * Submit a task from any thread
+ * 
+ * Lock-free: the task is pushed onto a multi-producer submission queue
+ * that the next dtesn_sched_tick drains into the ready queues in one
+ * batch (in free-running executor mode, an idle worker drains it).
+ * 
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param handle Output task handle (can be NULL)
+ * @return SCHED_OK, SCHED_ERR_FULL when at capacity, or SCHED_ERR_INVALID
+ */
+int dtesn_sched_submit(task_fn_t fn, void* data, task_priority_t priority,
+                       uint32_t depth, task_handle_t* handle);
+
+/**
+ * Submit a task that runs after its dependencies (any thread)
+ * 
+ * The task is parked until every task in deps has completed, then queued
+ * like a fresh submission. Dependencies that have already completed count
+ * as satisfied. Within a tick, dependents released by one wave run in a
+ * later wave of the same tick.
+ * 
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param deps Handles of tasks that must complete first
+ * @param n_deps Number of handles in deps
+ * @param handle Output task handle (can be NULL)
+ * @return SCHED_OK, SCHED_ERR_FULL when out of task slots or dependency
+ *         edges, or SCHED_ERR_INVALID
+ */
+int dtesn_sched_submit_deps(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, const task_handle_t* deps, size_t n_deps,
+                            task_handle_t* handle);
+
+/**
+ * Submit a task with dependencies, a deadline and a cost estimate (any thread)
+ * 
+ * Tasks with a deadline run earliest-deadline-first within their wave,
+ * ahead of tasks without one. The cost estimate lets a tick budget defer
+ * a NORMAL or LOW task before it would overrun, rather than after.
+ * 
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param attr Attributes (NULL = none)
+ * @param handle Output task handle (can be NULL)
+ * @return SCHED_OK, SCHED_ERR_FULL, or SCHED_ERR_INVALID
+ */
+int dtesn_sched_submit_attr(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, const sched_task_attr_t* attr,
+                            task_handle_t* handle);
+
+/**
+ * Submit a task for the next tick, even from inside a running task
+ * 
+ * dtesn_sched_submit from an executor worker folds the task into the
+ * current tick; this always defers it, which is how a cooperative task
+ * (see aichat/coro.h) yields the rest of the tick to other work.
+ * 
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param handle Output task handle (can be NULL)
+ * @return SCHED_OK, SCHED_ERR_FULL, or SCHED_ERR_INVALID
+ */
+int dtesn_sched_submit_next(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, task_handle_t* handle);
+
 /**
  * Schedule a task
  * @param fn Task function
  * @param data Task data
  * @param priority Task priority
  * @param depth Membrane depth (OEIS A000081)
- * @return Task handle or 0 on error
+ * @return Task handle or 0 on error (see dtesn_sched_submit for the cause)
  */
 task_handle_t dtesn_sched_task(task_fn_t fn, void* data, 
                                 task_priority_t priority, uint32_t depth);
 
+/**
+ * Number of tasks scheduled and not yet completed
+ * @return Pending task count
+ */
+size_t dtesn_sched_pending(void);
+
 /**
  * Execute one scheduler tick
- * @return Number of tasks executed
+ * 
+ * Queued tasks run in waves: by priority, then by ascending membrane
+ * depth, each wave being every ready task of one (priority, depth) pair,
+ * earliest deadline first. Once a tick budget is spent, NORMAL and LOW
+ * tasks not yet started stay queued for the next tick; CRITICAL and HIGH
+ * tasks always run.
+ * Without the executor, waves run inline on the calling thread. With the
+ * executor in SCHED_EXEC_BARRIER mode each wave is handed to the workers
+ * and the tick waits for it, and any tasks it scheduled, before starting
+ * the next. In SCHED_EXEC_FREE_RUNNING mode it does not wait.
+ * 
+ * @return Number of tasks executed (completed since the last tick when
+ *         the executor is running)
  */
 int dtesn_sched_tick(void);
 
+/**
+ * Set the tick budget
+ * @param budget_us Budget in microseconds (0 = unlimited, the default)
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_set_budget(uint32_t budget_us);
+
+/**
+ * Get tick budget statistics
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_budget_stats(sched_budget_stats_t* stats);
+
+/** Task-graph profile of one tick */
+typedef struct {
+    uint32_t tasks;               /**< Tasks executed */
+    uint32_t waves;               /**< (priority, depth) waves executed */
+    uint64_t work_ns;             /**< Sum of task run times */
+    uint64_t critical_path_ns;    /**< Longest dependency chain, by run time */
+    task_handle_t critical_tail;  /**< Last task on the critical path */
+} sched_graph_report_t;
+
+/**
+ * Enable or disable task-graph profiling (times every task while on)
+ * @param enable true to profile
+ */
+void dtesn_sched_profile(bool enable);
+
+/**
+ * Get the task-graph profile of the last tick
+ * 
+ * The critical path follows dependency edges across ticks, so a chain
+ * started in an earlier tick reports its full length. work_ns divided by
+ * critical_path_ns is the graph's available parallelism.
+ * 
+ * @param report Output profile (zero unless profiling is enabled)
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_graph_report(sched_graph_report_t* report);
+
+/** Timer wheel granularity: delayed tasks fire within one slot of their deadline */
+#define SCHED_TIMER_RESOLUTION_US 100
+
+/** Timer handle */
+typedef uint64_t timer_handle_t;
+
+/** Timer precision statistics */
+typedef struct {
+    size_t armed;            /**< Timers currently armed */
+    uint64_t fired;          /**< Expirations dispatched to the scheduler */
+    uint64_t missed_periods; /**< Periods skipped because ticks fell behind */
+    uint64_t late_us_max;    /**< Worst lateness at dispatch */
+    float late_us_mean;      /**< Mean lateness at dispatch */
+} sched_timer_stats_t;
+
+/**
+ * Schedule a task to run once after a delay
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param delay_us Delay in microseconds
+ * @return Timer handle or 0 on error
+ */
+timer_handle_t dtesn_sched_after(task_fn_t fn, void* data, task_priority_t priority,
+                                 uint32_t depth, uint64_t delay_us);
+
+/**
+ * Schedule a task to run every period
+ * 
+ * Deadlines advance from the previous deadline, not from when the task
+ * ran, so the rate does not drift. Periods missed while ticks were late
+ * are skipped and counted.
+ * 
+ * @param fn Task function
+ * @param data Task data
+ * @param priority Task priority
+ * @param depth Membrane depth (OEIS A000081)
+ * @param period_us Period in microseconds
+ * @return Timer handle or 0 on error
+ */
+timer_handle_t dtesn_sched_every(task_fn_t fn, void* data, task_priority_t priority,
+                                 uint32_t depth, uint64_t period_us);
+
+/**
+ * Cancel a delayed or periodic task
+ * @param timer Timer handle
+ * @return 0 on success, negative if the timer is not armed
+ */
+int dtesn_sched_cancel(timer_handle_t timer);
+
+/**
+ * Get timer precision statistics
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_timer_stats(sched_timer_stats_t* stats);
+
+/**
+ * Block until the next timer deadline or task submission
+ * @param max_wait_us Upper bound on the wait (0 = no bound)
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_wait(uint64_t max_wait_us);
+
+/**
+ * Run ticks until dtesn_sched_stop, sleeping between them
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_run(void);
+
+/**
+ * Make dtesn_sched_run return after its current tick (any thread)
+ */
+void dtesn_sched_stop(void);
+
+/** Monotonic clock in nanoseconds */
+typedef uint64_t (*sched_clock_fn_t)(void);
+
+/**
+ * Replace the clock behind deadlines, timers and the tick budget
+ * 
+ * Lets tests and simulations step time by hand instead of sleeping. The
+ * timer wheel keeps its position, so a clock installed after
+ * dtesn_sched_init must not start behind the one it replaces.
+ * dtesn_sched_wait still sleeps on the system clock; drive ticks
+ * directly while a manual clock is installed.
+ * 
+ * @param now_ns Clock, or NULL for CLOCK_MONOTONIC (the default)
+ */
+void dtesn_sched_set_clock(sched_clock_fn_t now_ns);
+
+/**
+ * Start the work-stealing executor
+ * 
+ * Each worker owns a Chase-Lev deque per priority level and drains higher
+ * levels first, stealing from other workers when its own deques are
+ * empty. Tasks scheduled from inside a running task stay on that worker's
+ * deque.
+ * 
+ * @param n_workers Number of worker threads (1-64)
+ * @param mode Barrier or free-running
+ * @return 0 on success, negative on error
+ */
+int dtesn_sched_exec_start(unsigned n_workers, sched_exec_mode_t mode);
+
+/**
+ * Stop the executor after queued work has drained and join the workers
+ */
+void dtesn_sched_exec_stop(void);
+
 /** @} */
 
 /**
@@ -106,6 +392,51 @@ typedef enum {
     MEM_REGION_TENSOR = 3,
 } mem_region_t;
 
+/** Number of memory region types */
+#define MEM_REGION_COUNT 4
+
+/** Number of power-of-two buckets in the allocation-size histogram */
+#define MEM_HIST_BUCKETS 32
+
+/** Number of power-of-two slot sizes in the tensor pool */
+#define MEM_TENSOR_CLASSES 40
+
+/** Per-region usage counters */
+typedef struct {
+    size_t live_bytes;      /**< Bytes currently allocated */
+    size_t peak_bytes;      /**< High-water mark of live_bytes */
+    uint64_t alloc_count;   /**< Successful allocations */
+    uint64_t free_count;    /**< Frees */
+} mem_region_stats_t;
+
+/** Tensor pool usage */
+typedef struct {
+    size_t slab_bytes;      /**< Bytes reserved in slabs */
+    size_t live_bytes;      /**< Slot bytes held by live tensors */
+    size_t free_bytes;      /**< Slot bytes on the free lists */
+    uint64_t live_tensors;  /**< Tensors allocated and not freed */
+    uint64_t reused_count;  /**< Allocations served from a free list */
+    /** Class c counts free slots of 2^c bytes */
+    uint32_t free_slots[MEM_TENSOR_CLASSES];
+} mem_tensor_stats_t;
+
+/** Heap usage snapshot */
+typedef struct {
+    size_t heap_size;           /**< Total heap size in bytes */
+    size_t free_bytes;          /**< Bytes in free blocks */
+    size_t largest_free_block;  /**< Largest single free block */
+    size_t block_count;         /**< Blocks (free and allocated) */
+    size_t free_block_count;    /**< Free blocks */
+    float fragmentation;        /**< 1 - largest_free_block / free_bytes */
+    uint64_t alloc_count;       /**< Successful allocations, all regions */
+    uint64_t free_count;        /**< Frees, all regions */
+    uint64_t failed_count;      /**< Allocations that returned NULL */
+    mem_region_stats_t regions[MEM_REGION_COUNT];
+    /** Bucket i counts allocations of [2^i, 2^(i+1)) bytes (histogram only) */
+    uint64_t size_histogram[MEM_HIST_BUCKETS];
+    mem_tensor_stats_t tensors; /**< Tensor pool (dtesn_mem_tensor_alloc) */
+} mem_stats_t;
+
 /**
  * Initialize memory subsystem
  * @param heap_size Total heap size in bytes
@@ -115,6 +446,9 @@ int dtesn_mem_init(size_t heap_size);
 
 /**
  * Allocate memory with tensor backing
+ * 
+ * Thread-safe; the heap is guarded by a single lock.
+ * 
  * @param size Size in bytes
  * @param region Memory region type
  * @return Pointer to allocated memory or NULL on error
@@ -122,11 +456,74 @@ int dtesn_mem_init(size_t heap_size);
 void* dtesn_mem_alloc(size_t size, mem_region_t region);
 
 /**
- * Free memory
+ * Free memory (thread-safe)
  * @param ptr Pointer to memory
  */
 void dtesn_mem_free(void* ptr);
 
+/**
+ * Collect heap usage statistics
+ * 
+ * Allocation and free counts are kept per thread and summed here, so
+ * counting never touches shared cache lines. Live and peak bytes are
+ * kept per region under the heap lock, so they stay exact when memory is
+ * freed on another thread than allocated it. Block-level figures (free
+ * bytes, largest block, fragmentation) are computed by walking the heap.
+ * 
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int dtesn_mem_stats(mem_stats_t* stats);
+
+/**
+ * Enable or disable the allocation-size histogram
+ * @param enable true to record allocation sizes
+ */
+void dtesn_mem_stats_histogram(bool enable);
+
+/**
+ * Print heap usage statistics to stdout
+ */
+void dtesn_mem_stats_print(void);
+
+/**
+ * Allocate a tensor from the tensor pool (MEM_REGION_TENSOR)
+ * 
+ * Unlike tensors of a ggml context, pool tensors can be freed. Slots are
+ * power-of-two sizes carved from large slabs; a freed slot goes on its
+ * size class's free list and is reused for the next tensor of any type
+ * and shape that fits the class. Thread-safe.
+ * 
+ * @param type Element type (enum ggml_type)
+ * @param ne0 Elements per row
+ * @param ne1 Rows
+ * @return Tensor, or NULL on error
+ */
+struct ggml_tensor* dtesn_mem_tensor_alloc(int type, int64_t ne0, int64_t ne1);
+
+/**
+ * Return a tensor to the tensor pool
+ * @param tensor Tensor from dtesn_mem_tensor_alloc (can be NULL)
+ */
+void dtesn_mem_tensor_free(struct ggml_tensor* tensor);
+
+/**
+ * Allocate a coroutine frame from the heap (MEM_REGION_HEAP)
+ * 
+ * Like every heap allocation this is thread-safe, so coroutines may be
+ * created and finish on executor workers.
+ * 
+ * @param size Frame size in bytes
+ * @return Frame memory or NULL on error
+ */
+void* dtesn_coro_frame_alloc(size_t size);
+
+/**
+ * Free a coroutine frame
+ * @param frame Frame from dtesn_coro_frame_alloc
+ */
+void dtesn_coro_frame_free(void* frame);
+
 /** @} */
 
 /**
@@ -134,10 +531,107 @@ void dtesn_mem_free(void* ptr);
  * @{
  */
 
+/** Edge direction for adjacency queries (bit set) */
+typedef enum {
+    HGFS_DIR_OUT = 1,
+    HGFS_DIR_IN = 2,
+    HGFS_DIR_BOTH = 3,
+} hgfs_dir_t;
+
+/** Traversal order */
+typedef enum {
+    HGFS_WALK_BFS = 0,
+    HGFS_WALK_DFS = 1,
+} hgfs_walk_t;
+
+/** Edge as returned by adjacency queries */
+typedef struct {
+    uint64_t handle;
+    uint64_t src;           /* Source node handle */
+    uint64_t dst;           /* Destination node handle */
+    float weight;
+} hgfs_edge_info_t;
+
+/** Traversal iterator (opaque) */
+typedef struct hgfs_iter hgfs_iter_t;
+
+/** HGFS storage statistics */
+typedef struct {
+    size_t nodes;           /* Live nodes */
+    size_t edges;           /* Live edges */
+    size_t node_slots;      /* Node slots in use, including holes */
+    size_t edge_slots;      /* Edge slots in use, including holes */
+    size_t node_chunks;     /* Slab chunks backing nodes */
+    size_t edge_chunks;     /* Slab chunks backing edges */
+    size_t delta_edges;     /* Edges not yet folded into the adjacency CSR */
+    size_t mapped_bytes;    /* Size of the file mapped by hgfs_open */
+    size_t depths;          /* Depths with a node pool */
+    size_t pool_bytes;      /* Payload arena reserved by the depth pools */
+} hgfs_stats_t;
+
+/** Nodes of one depth as parallel arrays, valid until the next HGFS mutation */
+typedef struct {
+    size_t count;
+    const uint64_t* handles;        /* Node handles */
+    void* const* data;              /* Payloads, packed in the depth's pool */
+    const size_t* sizes;            /* Payload bytes */
+} hgfs_depth_view_t;
+
+/** Adjacency matrix export (opaque) */
+typedef struct hgfs_matrix hgfs_matrix_t;
+
+/** Export a dense adjacency tensor as well as the CSR */
+#define HGFS_MATRIX_DENSE 0x1
+
+/** Dense adjacency side is padded to a multiple of this */
+#define HGFS_MATRIX_BLOCK 32
+
+/** Largest dense adjacency side (rows beyond this export CSR only) */
+#define HGFS_MATRIX_DENSE_MAX 4096
+
+/** Adjacency matrix tensors, valid until the next sync */
+typedef struct {
+    uint32_t rows;                  /* Exported nodes (matrix is rows x rows) */
+    uint32_t nnz;                   /* CSR entries */
+    struct ggml_tensor* row_ptr;    /* I32 [rows + 1], entries of row r: [row_ptr[r], row_ptr[r + 1]) */
+    struct ggml_tensor* cols;       /* I32 [>= nnz], column of each entry, ascending per row */
+    struct ggml_tensor* values;     /* F32 [>= nnz], summed weight of parallel edges */
+    struct ggml_tensor* dense;      /* F32 [pad, pad], element (col, row); NULL if not exported */
+    uint64_t version;               /* Changes when rows are renumbered */
+} hgfs_matrix_info_t;
+
+/** Default group commit window (µs) */
+#define HGFS_WAL_COMMIT_US 2000
+
+/** Default log size that makes a checkpoint due */
+#define HGFS_CHECKPOINT_BYTES (64u << 20)
+
+/** Default time since the last checkpoint that makes one due (µs) */
+#define HGFS_CHECKPOINT_INTERVAL_US (300ull * 1000000)
+
+/** Write-ahead log settings (zero fields take the defaults above) */
+typedef struct {
+    uint32_t commit_interval_us;    /* Records gathered per fdatasync */
+    size_t checkpoint_bytes;        /* Log size that makes a checkpoint due */
+    uint64_t checkpoint_interval_us;/* Time since the last checkpoint that makes one due */
+} hgfs_wal_config_t;
+
+/** Write-ahead log statistics */
+typedef struct {
+    uint64_t lsn;           /* Last record logged */
+    uint64_t durable_lsn;   /* Last record on disk */
+    uint64_t checkpoint_lsn;/* Last record contained in the graph file */
+    uint64_t commits;       /* Group commits (one fdatasync each) */
+    uint64_t checkpoints;
+    size_t log_bytes;       /* Committed log size */
+    bool checkpoint_due;    /* Log size or age calls for hgfs_checkpoint */
+    bool failed;            /* A record was lost; hgfs_sync reports the error */
+} hgfs_wal_stats_t;
+
 /**
  * Allocate memory as a GGML tensor node in hypergraph
  * @param size Size in bytes
- * @param depth Membrane depth (OEIS A000081)
+ * @param depth Membrane depth (OEIS A000081); selects the node pool
  * @return Pointer to allocated memory or NULL on error
  */
 void* hgfs_alloc(size_t size, uint32_t depth);
@@ -151,13 +645,301 @@ void* hgfs_alloc(size_t size, uint32_t depth);
  */
 uint64_t hgfs_edge(void* src, void* dst, float weight);
 
+/**
+ * Delete a node and every edge incident to it
+ * 
+ * The node's handle goes stale; its slot and tensor memory are reused
+ * by later allocations. Not allowed while a traversal is open.
+ * 
+ * @param data Pointer returned by hgfs_alloc
+ * @return 0 on success, negative on error
+ */
+int hgfs_free(void* data);
+
+/**
+ * Delete an edge
+ * @param edge Edge handle
+ * @return 0 on success, negative if the handle is stale or a traversal is open
+ */
+int hgfs_edge_remove(uint64_t edge);
+
+/**
+ * Compact node and edge storage
+ * 
+ * Moves live nodes and edges over deleted slots, keeping their order,
+ * releases empty chunks and rebuilds the adjacency index. Handles stay
+ * valid. Not allowed while a traversal is open.
+ * 
+ * @return 0 on success, negative on error
+ */
+int hgfs_compact(void);
+
+/**
+ * Get storage statistics
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int hgfs_stats(hgfs_stats_t* stats);
+
+/**
+ * Get the node handle of HGFS memory
+ * @param data Pointer returned by hgfs_alloc
+ * @return Node handle or 0 if data is not an HGFS node
+ */
+uint64_t hgfs_handle(const void* data);
+
+/**
+ * Get the memory of an HGFS node
+ * @param handle Node handle
+ * @return Pointer to node memory or NULL if the handle is not live
+ */
+void* hgfs_data(uint64_t handle);
+
+/**
+ * Get the outgoing edges of a node
+ * @param node Node handle
+ * @param edges Output array (can be NULL to count)
+ * @param max Capacity of edges
+ * @return Number of outgoing edges (may exceed max)
+ */
+size_t hgfs_out_edges(uint64_t node, hgfs_edge_info_t* edges, size_t max);
+
+/**
+ * Get the incoming edges of a node
+ * @param node Node handle
+ * @param edges Output array (can be NULL to count)
+ * @param max Capacity of edges
+ * @return Number of incoming edges (may exceed max)
+ */
+size_t hgfs_in_edges(uint64_t node, hgfs_edge_info_t* edges, size_t max);
+
+/**
+ * Get the distinct neighbors of a node
+ * @param node Node handle
+ * @param dir Edge directions to follow
+ * @param neighbors Output node handles (can be NULL to count)
+ * @param max Capacity of neighbors
+ * @return Number of distinct neighbors (may exceed max)
+ */
+size_t hgfs_neighbors(uint64_t node, hgfs_dir_t dir, uint64_t* neighbors, size_t max);
+
+/**
+ * List the depths that have node pools, ascending
+ * @param depths Output depths (can be NULL if max is 0)
+ * @param max Capacity of depths
+ * @return Total number of depths (may exceed max)
+ */
+size_t hgfs_depths(uint32_t* depths, size_t max);
+
+/**
+ * Get the nodes of one depth for a sweep
+ * 
+ * Payloads of a depth come from its own pool, so walking data[] stays
+ * within that depth's memory. Deleting a node moves the last member into
+ * its place; hgfs_compact and hgfs_open put members in address order.
+ * 
+ * @param depth Membrane depth
+ * @param view Output arrays (count 0 if the depth has no nodes)
+ * @return 0 on success, negative on error
+ */
+int hgfs_depth_view(uint32_t depth, hgfs_depth_view_t* view);
+
+/**
+ * Start a BFS or DFS traversal
+ * 
+ * Each reachable node is visited once, starting with start at depth 0.
+ * A k-hop neighborhood is a traversal with max_depth k. All memory is
+ * allocated here; hgfs_iter_next never allocates. Edges added during a
+ * traversal may or may not be followed.
+ * 
+ * @param start Start node handle
+ * @param walk BFS (level order) or DFS (preorder)
+ * @param dir Edge directions to follow
+ * @param max_depth Deepest level to visit (UINT32_MAX = unbounded)
+ * @return Iterator, or NULL on error
+ */
+hgfs_iter_t* hgfs_iter_begin(uint64_t start, hgfs_walk_t walk, hgfs_dir_t dir,
+                             uint32_t max_depth);
+
+/**
+ * Visit the next node of a traversal
+ * @param it Iterator
+ * @param node Output node handle (can be NULL)
+ * @param depth Output hop count from the start node (can be NULL)
+ * @return false once the traversal is complete
+ */
+bool hgfs_iter_next(hgfs_iter_t* it, uint64_t* node, uint32_t* depth);
+
+/**
+ * End a traversal and free the iterator
+ * @param it Iterator
+ */
+void hgfs_iter_end(hgfs_iter_t* it);
+
+/**
+ * Export the adjacency of a depth range as a sparse (CSR) matrix
+ * 
+ * Nodes with min_depth <= depth <= max_depth become rows (and columns),
+ * numbered in slot order at creation and appended as they are allocated
+ * (hgfs_matrix_row maps a handle to its row). An edge between two of them
+ * sets the (src, dst) element for HGFS_DIR_OUT, (dst, src) for
+ * HGFS_DIR_IN and both for HGFS_DIR_BOTH. The tensors live in the
+ * export's own ggml context and follow the graph incrementally: weight
+ * changes are patched in place and new entries and rows are merged in by
+ * hgfs_matrix_sync.
+ * 
+ * @param min_depth Shallowest node depth exported
+ * @param max_depth Deepest node depth exported
+ * @param dir Edge orientation
+ * @param flags HGFS_MATRIX_DENSE for a dense tensor as well
+ * @return Export, or NULL on error
+ */
+hgfs_matrix_t* hgfs_matrix_create(uint32_t min_depth, uint32_t max_depth, hgfs_dir_t dir,
+                                  uint32_t flags);
+
+/**
+ * Bring an export up to date with the graph
+ * 
+ * Merges pending entries and rows, or renumbers the rows once deleted
+ * nodes and edges make up a large part of the matrix.
+ * 
+ * @param m Export
+ * @param info Output tensors (can be NULL)
+ * @return 0 on success, negative on error
+ */
+int hgfs_matrix_sync(hgfs_matrix_t* m, hgfs_matrix_info_t* info);
+
+/**
+ * Get the row of a node in an export
+ * @param m Export
+ * @param node Node handle
+ * @return Row, or UINT32_MAX if the node is not exported
+ */
+uint32_t hgfs_matrix_row(const hgfs_matrix_t* m, uint64_t node);
+
+/**
+ * Get the node of an export row
+ * @param m Export
+ * @param row Row
+ * @return Node handle, or 0 if the row is out of range or its node was deleted
+ */
+uint64_t hgfs_matrix_node(const hgfs_matrix_t* m, uint32_t row);
+
+/**
+ * Free an export and its tensors
+ * @param m Export
+ */
+void hgfs_matrix_destroy(hgfs_matrix_t* m);
+
 /**
  * Initialize hypergraph filesystem
+ * 
+ * Node tensors are not taken from ctx: their headers and payloads come
+ * from per-depth pools owned by HGFS.
+ * 
  * @param ctx GGML context
  * @return 0 on success, negative on error
  */
 int hgfs_init(struct ggml_context* ctx);
 
+/**
+ * Save the graph to a file
+ * 
+ * Writes nodes, edges, handle generations and tensor payloads in the
+ * versioned HGFS format, then renames the file over path, so an existing
+ * file (even one this process has open) is replaced atomically. Live
+ * nodes are stored in slot order, as if compacted.
+ * 
+ * @param path File path
+ * @return 0 on success, negative on error
+ */
+int hgfs_save(const char* path);
+
+/**
+ * Open a graph file saved by hgfs_save
+ * 
+ * The file is memory-mapped privately. Only node and edge records are
+ * read up front; tensor payloads are used in place and page in on first
+ * touch. Handles saved with the graph stay valid. Writes to node memory
+ * are not written back to the file; call hgfs_save to persist them.
+ * 
+ * @param path File path
+ * @return 0 on success, negative if the file is invalid or the graph
+ *         already has nodes or edges
+ */
+int hgfs_open(const char* path);
+
+/**
+ * Release all HGFS storage and unmap an opened file
+ * 
+ * Node memory becomes invalid. hgfs_init must be called again before
+ * further use. Adjacency exports stop following the graph; only
+ * hgfs_matrix_destroy remains valid for them. Not allowed while a
+ * traversal is open.
+ * 
+ * @return 0 on success, negative on error
+ */
+int hgfs_close(void);
+
+/**
+ * Recover from a write-ahead log, then log every mutation to it
+ * 
+ * The log is path + ".wal". Records newer than the graph's checkpoint
+ * (the file opened with hgfs_open, or none for an empty graph) are
+ * replayed with their original handles; a torn tail is discarded.
+ * Afterwards hgfs_alloc, hgfs_edge, hgfs_free, hgfs_edge_remove and
+ * hgfs_log_data append records to a memory buffer without any I/O; a
+ * background thread writes them in batches with one fdatasync per
+ * commit window. Call this before mutating an opened graph.
+ * 
+ * @param path Checkpoint file (written by hgfs_checkpoint)
+ * @param config Settings (NULL for defaults)
+ * @return 0 on success, negative if the log is unreadable or does not
+ *         apply to the graph
+ */
+int hgfs_wal_start(const char* path, const hgfs_wal_config_t* config);
+
+/**
+ * Commit outstanding records and stop logging
+ * @return 0 on success, negative if a record was lost
+ */
+int hgfs_wal_stop(void);
+
+/**
+ * Wait until every logged mutation is on disk
+ * @return 0 on success, negative if a record was lost or logging is off
+ */
+int hgfs_sync(void);
+
+/**
+ * Log the current contents of node memory
+ * 
+ * Node memory is written directly by callers, so the log only learns
+ * of new contents through this call (or the next checkpoint).
+ * 
+ * @param data Pointer returned by hgfs_alloc
+ * @return 0 on success, negative on error
+ */
+int hgfs_log_data(void* data);
+
+/**
+ * Save the graph to the checkpoint file and empty the log
+ * 
+ * Runs on the calling thread and, like every HGFS call, must not overlap
+ * other HGFS calls. Bootstrap polls hgfs_wal_stats from a PRIORITY_LOW
+ * timer and checkpoints once one is due.
+ * 
+ * @return 0 on success, negative on error
+ */
+int hgfs_checkpoint(void);
+
+/**
+ * Get write-ahead log statistics
+ * @param stats Output statistics
+ * @return 0 on success, negative if logging is off
+ */
+int hgfs_wal_stats(hgfs_wal_stats_t* stats);
+
 /** @} */
 
 #ifdef __cplusplus
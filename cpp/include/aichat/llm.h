@@ -13,6 +13,7 @@ extern "C" {
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "aichat/kernel.h"
 
 /**
  * @defgroup LLM LLM Integration
@@ -47,6 +48,29 @@ typedef struct {
 /** Streaming callback */
 typedef void (*stream_callback_t)(const char* token, void* user_data);
 
+/** Request handle */
+typedef struct llm_request* llm_request_t;
+
+/** Request state */
+typedef enum {
+    LLM_REQUEST_QUEUED = 0,     /* Waiting for a sequence slot */
+    LLM_REQUEST_RUNNING = 1,    /* Prefilling or decoding */
+    LLM_REQUEST_PAUSED = 2,     /* LOW request preempted, KV cache retained */
+    LLM_REQUEST_DONE = 3,
+    LLM_REQUEST_FAILED = 4,
+} llm_request_state_t;
+
+/** Request server statistics */
+typedef struct {
+    uint64_t steps;             /* Decode steps run */
+    uint64_t tokens;            /* Tokens generated */
+    uint64_t preemptions;       /* LOW sequences paused for interactive load */
+    uint64_t evictions;         /* Paused sequences whose KV cache was dropped */
+    uint32_t queued;
+    uint32_t running;
+    uint32_t paused;
+} llm_serve_stats_t;
+
 /**
  * Load LLM model
  * @param model_path Path to GGUF model file
@@ -56,6 +80,11 @@ llm_model_t llm_load_model(const char* model_path);
 
 /**
  * Generate chat completion
+ * 
+ * Decodes synchronously on the calling thread, bypassing the request
+ * server; do not call while requests submitted with llm_submit are in
+ * flight on the same model.
+ * 
  * @param model Model handle
  * @param messages Array of chat messages
  * @param n_messages Number of messages
@@ -68,8 +97,65 @@ char* llm_chat_completion(llm_model_t model, chat_message_t* messages,
                           size_t n_messages, generation_params_t* params,
                           stream_callback_t callback, void* user_data);
 
+/**
+ * Submit a chat completion request
+ * 
+ * Requests are decoded by scheduler tasks at the request's priority, so a
+ * thread must be running ticks (dtesn_sched_run). Each decode step batches
+ * all running requests, CRITICAL and HIGH first. While a CRITICAL or HIGH
+ * request is active, LOW requests are paused with their KV cache retained
+ * and resume once interactive load drains.
+ * 
+ * The callback runs on the scheduler thread.
+ * 
+ * @param model Model handle
+ * @param messages Array of chat messages (copied)
+ * @param n_messages Number of messages
+ * @param params Generation parameters (can be NULL)
+ * @param priority Request priority
+ * @param callback Streaming callback (can be NULL)
+ * @param user_data User data for callback
+ * @return Request handle, or NULL on error
+ */
+llm_request_t llm_submit(llm_model_t model, const chat_message_t* messages,
+                         size_t n_messages, const generation_params_t* params,
+                         task_priority_t priority,
+                         stream_callback_t callback, void* user_data);
+
+/**
+ * Get request state
+ * @param request Request handle
+ * @return Current state
+ */
+llm_request_state_t llm_request_state(llm_request_t request);
+
+/**
+ * Block until a request finishes
+ * @param request Request handle
+ * @return Generated response (caller must free), or NULL if the request failed
+ */
+char* llm_request_wait(llm_request_t request);
+
+/**
+ * Free a request, cancelling it if still in flight
+ * @param request Request handle
+ */
+void llm_request_free(llm_request_t request);
+
+/**
+ * Get request server statistics
+ * @param model Model handle
+ * @param stats Output statistics
+ * @return 0 on success, negative on error
+ */
+int llm_serve_stats(llm_model_t model, llm_serve_stats_t* stats);
+
 /**
  * Unload model
+ * 
+ * Requests still in flight are failed and freed; their handles become
+ * invalid.
+ * 
  * @param model Model handle
  */
 void llm_unload_model(llm_model_t model);
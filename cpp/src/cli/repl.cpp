@@ -4,10 +4,12 @@
  */
 
 #include "aichat/cli.h"
+#include "aichat/kernel.h"
 #include "aichat/llm.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <thread>
 #include <readline/readline.h>
 #include <readline/history.h>
 
@@ -17,6 +19,49 @@ static void stream_callback(const char* token, void* user_data) {
     fflush(stdout);
 }
 
+/* Scheduler tick thread: LLM requests are decoded by scheduler tasks */
+static std::thread sched_thread;
+
+static void sched_thread_start(void) {
+    sched_thread = std::thread([] { dtesn_sched_run(); });
+}
+
+static void sched_thread_stop(void) {
+    if (sched_thread.joinable()) {
+        dtesn_sched_stop();
+        sched_thread.join();
+    }
+}
+
+/**
+ * Stop the tick thread, then unload the model (destroying its request server)
+ */
+static void shutdown_model(llm_model_t model) {
+    sched_thread_stop();
+    llm_unload_model(model);
+    
+    /* Step tasks still queued see the stopped server; the last one frees it */
+    while (dtesn_sched_pending() > 0) {
+        dtesn_sched_tick();
+    }
+}
+
+/**
+ * Run one interactive turn at HIGH priority, ahead of background requests
+ */
+static char* run_turn(llm_model_t model, chat_message_t* msg, generation_params_t* params) {
+    llm_request_t request = llm_submit(model, msg, 1, params, PRIORITY_HIGH,
+                                       params->stream ? stream_callback : nullptr,
+                                       nullptr);
+    if (!request) {
+        return nullptr;
+    }
+    
+    char* response = llm_request_wait(request);
+    llm_request_free(request);
+    return response;
+}
+
 /**
  * Run REPL mode
  */
@@ -34,7 +79,10 @@ extern "C" int cli_run_repl(cli_config_t* config) {
     }
     
     printf("Model loaded successfully\n");
-    printf("AIChat REPL (type 'quit' to exit)\n\n");
+    printf("AIChat REPL (type 'quit' to exit, '.memstats' for heap usage, "
+           "'.llmstats' for request batching)\n\n");
+    
+    sched_thread_start();
     
     /* REPL loop */
     while (true) {
@@ -57,6 +105,28 @@ extern "C" int cli_run_repl(cli_config_t* config) {
             break;
         }
         
+        /* Kernel introspection commands */
+        if (strcmp(line, ".memstats") == 0) {
+            dtesn_mem_stats_print();
+            printf("\n");
+            free(line);
+            continue;
+        }
+        
+        if (strcmp(line, ".llmstats") == 0) {
+            llm_serve_stats_t stats;
+            if (llm_serve_stats(model, &stats) == 0) {
+                printf("steps=%llu tokens=%llu preemptions=%llu evictions=%llu "
+                       "queued=%u running=%u paused=%u\n\n",
+                       (unsigned long long)stats.steps, (unsigned long long)stats.tokens,
+                       (unsigned long long)stats.preemptions,
+                       (unsigned long long)stats.evictions,
+                       stats.queued, stats.running, stats.paused);
+            }
+            free(line);
+            continue;
+        }
+        
         /* Create message */
         chat_message_t msg = {ROLE_USER, line};
         
@@ -69,9 +139,7 @@ extern "C" int cli_run_repl(cli_config_t* config) {
         params.stream = config->stream;
         
         /* Generate response */
-        char* response = llm_chat_completion(model, &msg, 1, &params,
-                                            config->stream ? stream_callback : nullptr,
-                                            nullptr);
+        char* response = run_turn(model, &msg, &params);
         
         if (response) {
             if (!config->stream) {
@@ -89,7 +157,7 @@ extern "C" int cli_run_repl(cli_config_t* config) {
     }
     
     /* Cleanup */
-    llm_unload_model(model);
+    shutdown_model(model);
     printf("\nGoodbye!\n");
     
     return 0;
@@ -122,25 +190,21 @@ extern "C" int cli_run_command(cli_config_t* config, const char* query) {
     params.stream = config->stream;
     
     /* Generate response */
-    char* response = llm_chat_completion(model, &msg, 1, &params,
-                                        config->stream ? stream_callback : nullptr,
-                                        nullptr);
+    sched_thread_start();
+    char* response = run_turn(model, &msg, &params);
+    shutdown_model(model);
     
-    if (response) {
-        if (!config->stream) {
-            printf("%s\n", response);
-        } else {
-            printf("\n");
-        }
-        free(response);
-    } else {
+    if (!response) {
         fprintf(stderr, "Error generating response\n");
-        llm_unload_model(model);
         return -1;
     }
     
-    /* Cleanup */
-    llm_unload_model(model);
+    if (!config->stream) {
+        printf("%s\n", response);
+    } else {
+        printf("\n");
+    }
+    free(response);
     
     return 0;
 }
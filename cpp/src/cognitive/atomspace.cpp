@@ -3,59 +3,738 @@
  * @brief AtomSpace - Hypergraph knowledge representation
  * 
  * Implements OpenCog AtomSpace as GGML tensor hypergraph.
+ * 
+ * Atom embeddings are rows of a COG_EMBED_DIM-wide matrix stored as the
+ * type chosen at init. An atom takes a row on its first embedding write;
+ * rows are handed out lowest first and the matrix is allocated in blocks
+ * of EMBED_BLOCK_ROWS rows, so atoms without embeddings cost no storage.
+ * Blocks come from the kernel tensor pool and go back to it when their
+ * last row is freed.
+ * 
+ * Handles are (generation << 32) | (slot + 1), so resolving one is an
+ * index into the atom array plus a generation check; freeing an atom
+ * bumps its slot's generation so stale handles fail.
+ * 
+ * The store is split into ATOM_SHARDS shards by hash: a named atom
+ * belongs to the shard of its name, a link to the shard of its content
+ * hash, and an unnamed node to a shard picked per thread. Each shard has
+ * its own write lock, name index, link set and stack of free slots (a
+ * shard whose stack is empty takes a slot from another's; if every slot
+ * is taken but some freed ones still wait for readers, the writer yields
+ * and retries for a while). Readers take
+ * no locks: an atom is published by storing its handle last, its name and
+ * outgoing set do not change while it lives, and whatever a writer
+ * unlinks (a freed slot, an outgrown index, a replaced incoming set) is
+ * released by epoch-based reclamation once no reader can still hold it.
+ * Embedding rows are the exception: they sit behind one reader-writer
+ * lock, and changing an atom's row also takes its shard lock.
+ * 
+ * Names are interned: each distinct string is copied once into its
+ * shard's append-only arena with its hash, and each shard's name index is
+ * an open-addressing table (linear probing) of name ids tagged with hash
+ * bits, so a lookup touches the string only on a tag match. A bucket is
+ * one word, written once, so readers probe while a writer inserts; a grown
+ * index replaces the old one, which readers may still be probing. An
+ * interned name records the atom that has it; freeing the atom clears
+ * that, and the string stays for the next atom with the same name.
+ * 
+ * Links are hash-consed: each shard's table keyed by a hash of type and
+ * outgoing handles (open addressing, backward-shift deletion) finds an
+ * existing link with the same content, which cog_link_create() returns
+ * instead of making a duplicate. Only writers holding the shard lock use it.
+ * 
+ * Every atom keeps its incoming set (the links that contain it), kept up
+ * to date by cog_link_create() and cog_atom_free() under a per-atom spin
+ * lock. Links are appended past the size readers see; removing one, or
+ * growing a full set, writes a copy and retires the old set. The pattern
+ * matcher binds one clause at a time, always taking next the clause with
+ * the fewest candidate links: the smallest incoming set among its
+ * constant and already bound atoms, or a scan of all atoms if it has
+ * neither.
  */
 
 #include "aichat/cognitive.h"
 #include "aichat/kernel.h"
+#include "cognitive/internal.h"
 #include <ggml.h>
+#include <atomic>
 #include <cstring>
 #include <cstdlib>
-#include <map>
-#include <string>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #define MAX_ATOMS 8192
+#define ATOM_SLOT_NIL UINT32_MAX
+#define ATOM_WAIT_TRIES 1000        /* Yields a writer spends waiting for freed slots */
+
+#define ATOM_SHARD_BITS 4
+#define ATOM_SHARDS (1u << ATOM_SHARD_BITS)  /* Write-lock shards */
+
+#define EMBED_BLOCK_ROWS 256        /* Embedding rows per pool tensor */
+#define EMBED_ROW_NIL UINT32_MAX
+
+#define NAME_TABLE_MIN 64           /* Name index buckets per shard (power of two) */
+#define NAME_ARENA_CHUNK 65536      /* Arena chunk; longer names get their own */
+#define NAME_CHUNK_NAMES 4096       /* Names per chunk of a shard's name array */
+#define NAME_CHUNKS 1024            /* Name array chunks per shard */
+#define NAME_BATCH 16               /* Lookups hashed and prefetched together */
+#define NAME_PENDING UINT64_MAX     /* Name claimed by an atom of the batch being allocated */
+
+#define LINK_TABLE_MIN 64           /* Link set buckets per shard, at most half full */
+
+#define QUERY_MAX_CLAUSES 32        /* Clauses tracked in a 32-bit mask */
+
+/* Interned name */
+struct name_t {
+    const char* str;                /* In the arena, NUL-terminated */
+    uint32_t len;
+    std::atomic<atom_handle_t> atom;  /* Atom with this name, 0 if none */
+    size_t hash;
+};
+
+/* Name index of a shard; a bucket is (tag << 32) | local name id, or 0 if empty */
+struct name_table_t {
+    size_t mask;
+    std::atomic<uint64_t>* buckets;
+};
+
+/* Link set bucket */
+struct link_bucket_t {
+    uint32_t tag;                   /* High hash bits */
+    uint32_t slot;                  /* Link atom slot, or ATOM_SLOT_NIL if empty */
+};
+
+/* Incoming set, followed by cap handles; readers see the first size */
+struct atom_set_t {
+    std::atomic<uint32_t> size;
+    uint32_t cap;
+};
 
 /* Atom structure */
 struct atom_t {
     atom_type_t type;
-    char* name;
-    std::vector<atom_handle_t> outgoing;  /* For links */
-    struct ggml_tensor* tensor;
-    uint64_t handle;
-    bool active;
+    const char* name;               /* Interned */
+    uint32_t name_id;
+    uint32_t shard;                 /* Shard whose lock its writers hold */
+    std::vector<atom_handle_t> outgoing;  /* For links; fixed while the atom lives */
+    std::atomic<atom_set_t*> incoming;    /* Links that contain this atom */
+    std::atomic_flag incoming_lock;
+    size_t link_hash;               /* Content hash, if in the link set */
+    bool linked;                    /* In the link set */
+    uint32_t row;                   /* Embedding row, or EMBED_ROW_NIL */
+    std::atomic<atom_handle_t> handle;  /* 0 while free */
+    uint32_t generation;            /* Bumped on free */
+};
+
+/* Shard of the store */
+struct alignas(64) shard_t {
+    std::mutex lock;                /* Held by writers of the shard's atoms */
+    std::atomic<name_table_t*> table;
+    name_t* names[NAME_CHUNKS];     /* Local name id -> name; chunks never move */
+    uint32_t n_names;
+    char* arena;                    /* Current arena chunk; chunks are never freed */
+    size_t arena_used;
+    size_t arena_size;
+    std::vector<link_bucket_t> links;
+    size_t n_links;
+    std::mutex slot_lock;           /* Guards free_slots */
+    std::vector<uint32_t> free_slots;  /* Stack; lowest slots on top */
 };
 
 /* AtomSpace state */
 static struct {
     struct ggml_context* ctx;
+    cog_embed_type_t embed_type;
+    size_t row_bytes;
+    std::shared_mutex embed_lock;   /* Guards the rows below and atoms' rows */
+    struct ggml_tensor* embed_blocks[MAX_ATOMS / EMBED_BLOCK_ROWS];
+    uint32_t block_rows[MAX_ATOMS / EMBED_BLOCK_ROWS];  /* Live rows per block */
+    uint32_t row_slot[MAX_ATOMS];   /* Row -> atom slot, or ATOM_SLOT_NIL */
+    float row_norm[MAX_ATOMS];
+    uint32_t free_rows[MAX_ATOMS];  /* Stack; lowest rows on top */
+    size_t n_free_rows;
+    uint32_t n_rows;                /* Highest row used + 1 */
     atom_t atoms[MAX_ATOMS];
-    std::map<std::string, atom_handle_t> name_index;
-    size_t atom_count;
-    uint64_t next_handle;
+    std::atomic<size_t> atom_count;
     bool initialized;
-} atomspace = {nullptr, {}, {}, 0, 1, false};
+} atomspace;
+
+static shard_t shards[ATOM_SHARDS];
+
+/**
+ * Hash a name
+ */
+static size_t name_hash(std::string_view name) {
+    return std::hash<std::string_view>{}(name);
+}
+
+/**
+ * Tag stored beside the id to skip most string compares
+ */
+static uint32_t name_tag(size_t hash) {
+    return (uint32_t)((uint64_t)hash >> 32) | 1u;
+}
+
+/**
+ * Shard of a name or link hash (bits above those that pick a bucket)
+ */
+static uint32_t shard_of(size_t hash) {
+    return (uint32_t)(hash >> 24) & (ATOM_SHARDS - 1);
+}
+
+/**
+ * Shard that takes this thread's unnamed nodes
+ */
+static uint32_t thread_shard(void) {
+    static std::atomic<uint32_t> next{0};
+    static thread_local uint32_t shard = next.fetch_add(1, std::memory_order_relaxed) &
+                                         (ATOM_SHARDS - 1);
+    return shard;
+}
+
+/**
+ * Interned name of a shard by local id
+ */
+static name_t& shard_name(const shard_t& shard, uint32_t local) {
+    return shard.names[local / NAME_CHUNK_NAMES][local % NAME_CHUNK_NAMES];
+}
+
+/**
+ * Interned name by id ((local id << ATOM_SHARD_BITS) | shard)
+ */
+static name_t& name_at(uint32_t id) {
+    return shard_name(shards[id & (ATOM_SHARDS - 1)], id >> ATOM_SHARD_BITS);
+}
+
+/**
+ * Find an interned name (the caller is pinned; takes no lock)
+ * @return Name id, or NAME_NIL
+ */
+static uint32_t name_find(std::string_view name, size_t hash) {
+    uint32_t shard = shard_of(hash);
+    const name_table_t* table = shards[shard].table.load(std::memory_order_acquire);
+    if (!table) {
+        return NAME_NIL;
+    }
+    
+    uint32_t tag = name_tag(hash);
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        uint64_t bucket = table->buckets[i].load(std::memory_order_acquire);
+        if (bucket == 0) {
+            return NAME_NIL;
+        }
+        if ((uint32_t)(bucket >> 32) == tag) {
+            uint32_t id = ((uint32_t)bucket << ATOM_SHARD_BITS) | shard;
+            const name_t& entry = name_at(id);
+            if (entry.len == name.size() && memcmp(entry.str, name.data(), name.size()) == 0) {
+                return id;
+            }
+        }
+    }
+}
+
+/**
+ * Put a name in an index that has room
+ */
+static void name_table_put(name_table_t* table, size_t hash, uint32_t local) {
+    size_t i = hash & table->mask;
+    while (table->buckets[i].load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & table->mask;
+    }
+    table->buckets[i].store(((uint64_t)name_tag(hash) << 32) | local, std::memory_order_release);
+}
+
+/**
+ * Free a replaced name index
+ */
+static void name_table_free(void* arg) {
+    name_table_t* table = (name_table_t*)arg;
+    delete[] table->buckets;
+    delete table;
+}
+
+/**
+ * Replace a shard's name index by one of cap buckets holding every name
+ * (hashes are stored); the old one is retired, as readers may be in it
+ */
+static void name_rehash(shard_t& shard, size_t cap) {
+    name_table_t* table = new name_table_t{cap - 1, new std::atomic<uint64_t>[cap]()};
+    for (uint32_t local = 0; local < shard.n_names; local++) {
+        name_table_put(table, shard_name(shard, local).hash, local);
+    }
+    
+    name_table_t* old = shard.table.exchange(table, std::memory_order_acq_rel);
+    if (old) {
+        epoch_retire(name_table_free, old);
+    }
+}
+
+/**
+ * Copy a name into a shard's arena
+ */
+static const char* name_store(shard_t& shard, std::string_view name) {
+    size_t size = name.size() + 1;
+    
+    if (!shard.arena || shard.arena_used + size > shard.arena_size) {
+        size_t chunk_size = size > NAME_ARENA_CHUNK ? size : NAME_ARENA_CHUNK;
+        char* chunk = (char*)malloc(chunk_size);
+        if (!chunk) {
+            return nullptr;
+        }
+        shard.arena = chunk;
+        shard.arena_used = 0;
+        shard.arena_size = chunk_size;
+    }
+    
+    char* str = shard.arena + shard.arena_used;
+    memcpy(str, name.data(), name.size());
+    str[name.size()] = '\0';
+    shard.arena_used += size;
+    return str;
+}
+
+/**
+ * Grow a shard's name index so that n more names keep it at most half full
+ */
+static void name_reserve(shard_t& shard, size_t n) {
+    const name_table_t* table = shard.table.load(std::memory_order_relaxed);
+    size_t size = table ? table->mask + 1 : 0;
+    size_t cap = table ? size : NAME_TABLE_MIN;
+    while ((shard.n_names + n) * 2 > cap) {
+        cap *= 2;
+    }
+    if (cap != size) {
+        name_rehash(shard, cap);
+    }
+}
+
+/**
+ * Add a name that is not interned yet (the shard's index must have room)
+ * @return Name id, or NAME_NIL on error
+ */
+static uint32_t name_insert(uint32_t s, std::string_view name, size_t hash) {
+    shard_t& shard = shards[s];
+    uint32_t local = shard.n_names;
+    if (local == NAME_CHUNKS * NAME_CHUNK_NAMES) {
+        return NAME_NIL;
+    }
+    
+    name_t*& chunk = shard.names[local / NAME_CHUNK_NAMES];
+    if (!chunk) {
+        chunk = new (std::nothrow) name_t[NAME_CHUNK_NAMES]();
+        if (!chunk) {
+            return NAME_NIL;
+        }
+    }
+    const char* str = name_store(shard, name);
+    if (!str) {
+        return NAME_NIL;
+    }
+    
+    /* Fill the entry before the bucket that publishes it */
+    name_t& entry = chunk[local % NAME_CHUNK_NAMES];
+    entry.str = str;
+    entry.len = (uint32_t)name.size();
+    entry.hash = hash;
+    entry.atom.store(0, std::memory_order_relaxed);
+    shard.n_names++;
+    name_table_put(shard.table.load(std::memory_order_relaxed), hash, local);
+    
+    return (local << ATOM_SHARD_BITS) | s;
+}
+
+/**
+ * Resolve a handle to its atom (the caller is pinned)
+ * @return Atom, or nullptr if the handle is stale or invalid
+ */
+static atom_t* atom_get(atom_handle_t handle) {
+    uint32_t idx = (uint32_t)handle;
+    if (idx == 0 || idx > MAX_ATOMS) {
+        return nullptr;
+    }
+    
+    atom_t* atom = &atomspace.atoms[idx - 1];
+    return atom->handle.load(std::memory_order_acquire) == handle ? atom : nullptr;
+}
+
+/**
+ * Handles of an incoming set
+ */
+static atom_handle_t* set_items(atom_set_t* set) {
+    return reinterpret_cast<atom_handle_t*>(set + 1);
+}
+
+/**
+ * Allocate an incoming set with room for cap handles, holding items[0..n)
+ */
+static atom_set_t* set_alloc(uint32_t cap, const atom_handle_t* items, uint32_t n) {
+    void* mem = ::operator new(sizeof(atom_set_t) + (size_t)cap * sizeof(atom_handle_t));
+    atom_set_t* set = new (mem) atom_set_t;
+    set->size.store(n, std::memory_order_relaxed);
+    set->cap = cap;
+    if (n > 0) {
+        memcpy(set_items(set), items, n * sizeof(atom_handle_t));
+    }
+    return set;
+}
+
+/**
+ * Free an incoming set
+ */
+static void set_free(void* set) {
+    ::operator delete(set);
+}
+
+/**
+ * An atom's incoming set as readers see it (the caller is pinned)
+ * @param n Set to the number of links
+ */
+static const atom_handle_t* incoming_get(atom_t* atom, size_t* n) {
+    atom_set_t* set = atom->incoming.load(std::memory_order_acquire);
+    if (!set) {
+        *n = 0;
+        return nullptr;
+    }
+    *n = set->size.load(std::memory_order_acquire);
+    return set_items(set);
+}
+
+/**
+ * Take an atom's incoming set lock
+ */
+static void incoming_lock(atom_t* atom) {
+    while (atom->incoming_lock.test_and_set(std::memory_order_acquire)) {
+        while (atom->incoming_lock.test(std::memory_order_relaxed)) {
+        }
+    }
+}
+
+/**
+ * Release an atom's incoming set lock
+ */
+static void incoming_unlock(atom_t* atom) {
+    atom->incoming_lock.clear(std::memory_order_release);
+}
+
+/**
+ * Whether outgoing atom i already appeared earlier in the same link
+ */
+static bool outgoing_repeats(const atom_handle_t* atoms, size_t i) {
+    for (size_t j = 0; j < i; j++) {
+        if (atoms[j] == atoms[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Add a link to an atom's incoming set (callers add each link once)
+ */
+static void incoming_add(atom_t* atom, atom_handle_t link) {
+    incoming_lock(atom);
+    atom_set_t* set = atom->incoming.load(std::memory_order_relaxed);
+    uint32_t n = set ? set->size.load(std::memory_order_relaxed) : 0;
+    
+    if (set && n < set->cap) {
+        set_items(set)[n] = link;
+        set->size.store(n + 1, std::memory_order_release);
+    } else {
+        atom_set_t* grown = set_alloc(n > 0 ? n * 2 : 4, set ? set_items(set) : nullptr, n);
+        set_items(grown)[n] = link;
+        grown->size.store(n + 1, std::memory_order_relaxed);
+        atom->incoming.store(grown, std::memory_order_release);
+        if (set) {
+            epoch_retire(set_free, set);
+        }
+    }
+    incoming_unlock(atom);
+}
+
+/**
+ * Remove a link from an atom's incoming set
+ */
+static void incoming_remove(atom_t* atom, atom_handle_t link) {
+    incoming_lock(atom);
+    atom_set_t* set = atom->incoming.load(std::memory_order_relaxed);
+    uint32_t n = set ? set->size.load(std::memory_order_relaxed) : 0;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        if (set_items(set)[i] == link) {
+            /* Readers may be in the set: the last entry fills the gap in a copy */
+            atom_set_t* copy = set_alloc(set->cap, set_items(set), n - 1);
+            if (i < n - 1) {
+                set_items(copy)[i] = set_items(set)[n - 1];
+            }
+            atom->incoming.store(copy, std::memory_order_release);
+            epoch_retire(set_free, set);
+            break;
+        }
+    }
+    incoming_unlock(atom);
+}
+
+/**
+ * Hash a link's content
+ */
+static size_t link_hash(atom_type_t type, const atom_handle_t* atoms, size_t n_atoms) {
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ ((uint64_t)type << 32) ^ n_atoms;
+    for (size_t i = 0; i < n_atoms; i++) {
+        hash = (hash ^ atoms[i]) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return (size_t)(hash ^ (hash >> 29));
+}
+
+/**
+ * Grow a shard's link set so that one more link keeps it at most half full
+ */
+static void link_reserve(shard_t& shard) {
+    if ((shard.n_links + 1) * 2 <= shard.links.size()) {
+        return;
+    }
+    
+    std::vector<link_bucket_t> old;
+    old.swap(shard.links);
+    size_t cap = old.empty() ? LINK_TABLE_MIN : old.size() * 2;
+    shard.links.assign(cap, link_bucket_t{0, ATOM_SLOT_NIL});
+    
+    const size_t mask = cap - 1;
+    for (const link_bucket_t& bucket : old) {
+        if (bucket.slot == ATOM_SLOT_NIL) {
+            continue;
+        }
+        size_t i = atomspace.atoms[bucket.slot].link_hash & mask;
+        while (shard.links[i].slot != ATOM_SLOT_NIL) {
+            i = (i + 1) & mask;
+        }
+        shard.links[i] = bucket;
+    }
+}
+
+/**
+ * Find the link with this content in a shard's link set (which must not be empty)
+ * @param index Set to the bucket found, or to the empty bucket that ended the probe
+ * @return Slot, or ATOM_SLOT_NIL
+ */
+static uint32_t link_find(const shard_t& shard, atom_type_t type, const atom_handle_t* atoms,
+                          size_t n_atoms, size_t hash, size_t* index) {
+    const size_t mask = shard.links.size() - 1;
+    uint32_t tag = name_tag(hash);
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const link_bucket_t& bucket = shard.links[i];
+        if (bucket.slot == ATOM_SLOT_NIL) {
+            *index = i;
+            return ATOM_SLOT_NIL;
+        }
+        if (bucket.tag == tag) {
+            const atom_t& link = atomspace.atoms[bucket.slot];
+            if (link.type == type && link.outgoing.size() == n_atoms &&
+                (n_atoms == 0 || memcmp(link.outgoing.data(), atoms, n_atoms * sizeof(atom_handle_t)) == 0)) {
+                *index = i;
+                return bucket.slot;
+            }
+        }
+    }
+}
+
+/**
+ * Remove a link from its shard's link set, shifting later entries of its run back
+ */
+static void link_remove(shard_t& shard, atom_t* link) {
+    const size_t mask = shard.links.size() - 1;
+    uint32_t slot = (uint32_t)(link - atomspace.atoms);
+    
+    size_t hole = link->link_hash & mask;
+    while (shard.links[hole].slot != slot) {
+        hole = (hole + 1) & mask;
+    }
+    
+    for (size_t i = (hole + 1) & mask; shard.links[i].slot != ATOM_SLOT_NIL; i = (i + 1) & mask) {
+        /* An entry may move back to the hole only if its home is not after the hole */
+        size_t home = atomspace.atoms[shard.links[i].slot].link_hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            shard.links[hole] = shard.links[i];
+            hole = i;
+        }
+    }
+    shard.links[hole].slot = ATOM_SLOT_NIL;
+    shard.n_links--;
+    link->linked = false;
+}
 
 /**
  * Initialize AtomSpace
  */
-extern "C" int atomspace_init(struct ggml_context* ctx) {
+extern "C" int atomspace_init(struct ggml_context* ctx, cog_embed_type_t embed_type) {
     if (atomspace.initialized) {
         return 0;
     }
     
-    if (!ctx) {
+    if (!ctx || embed_row_bytes(embed_type) == 0) {
         return -1;
     }
     
     atomspace.ctx = ctx;
-    atomspace.atom_count = 0;
-    atomspace.next_handle = 1;
+    atomspace.embed_type = embed_type;
+    atomspace.row_bytes = embed_row_bytes(embed_type);
+    atomspace.n_rows = 0;
+    atomspace.n_free_rows = 0;
+    for (uint32_t row = MAX_ATOMS; row > 0; row--) {
+        atomspace.free_rows[atomspace.n_free_rows++] = row - 1;
+        atomspace.row_slot[row - 1] = ATOM_SLOT_NIL;
+    }
+    for (uint32_t slot = 0; slot < MAX_ATOMS; slot++) {
+        atomspace.atoms[slot].row = EMBED_ROW_NIL;
+    }
+    atomspace.atom_count.store(0, std::memory_order_relaxed);
+    
+    /* Each shard starts with an equal run of slots */
+    const uint32_t per_shard = MAX_ATOMS / ATOM_SHARDS;
+    for (uint32_t s = 0; s < ATOM_SHARDS; s++) {
+        shards[s].free_slots.reserve(per_shard);
+        for (uint32_t slot = (s + 1) * per_shard; slot > s * per_shard; slot--) {
+            shards[s].free_slots.push_back(slot - 1);
+        }
+    }
     atomspace.initialized = true;
     
     return 0;
 }
 
+/**
+ * Take a free slot, from a shard's stack or else from the others'
+ * @return Slot, or ATOM_SLOT_NIL if every slot is taken
+ */
+static uint32_t slot_take(uint32_t first) {
+    for (uint32_t i = 0; i < ATOM_SHARDS; i++) {
+        shard_t& shard = shards[(first + i) & (ATOM_SHARDS - 1)];
+        std::lock_guard<std::mutex> lock(shard.slot_lock);
+        if (!shard.free_slots.empty()) {
+            uint32_t slot = shard.free_slots.back();
+            shard.free_slots.pop_back();
+            return slot;
+        }
+    }
+    return ATOM_SLOT_NIL;
+}
+
+/**
+ * Put a free slot on a shard's stack
+ */
+static void slot_put(uint32_t s, uint32_t slot) {
+    std::lock_guard<std::mutex> lock(shards[s].slot_lock);
+    shards[s].free_slots.push_back(slot);
+}
+
+/**
+ * Reuse a freed atom's slot, once no reader can still see the atom
+ */
+static void slot_release(void* arg) {
+    uint32_t slot = (uint32_t)(uintptr_t)arg;
+    atom_t* atom = &atomspace.atoms[slot];
+    
+    set_free(atom->incoming.exchange(nullptr, std::memory_order_relaxed));
+    atom->outgoing.clear();
+    slot_put(atom->shard, slot);
+}
+
+/**
+ * Wait for freed slots, when every slot was taken (the caller is unpinned and holds no lock)
+ * @param tries Waits so far
+ * @return true to try again
+ */
+static bool slot_wait(int* tries) {
+    if (++*tries > ATOM_WAIT_TRIES || epoch_collect() == 0) {
+        return false;
+    }
+    std::this_thread::yield();
+    return true;
+}
+
+/**
+ * Initialize and publish the atom in a taken slot
+ * @param name_id Name id, or NAME_NIL
+ * @param shard Shard of the atom; its lock is held unless the atom is an unnamed node
+ * @return Atom handle
+ */
+static atom_handle_t atom_init(uint32_t slot, atom_type_t type, uint32_t name_id, uint32_t shard,
+                               const atom_handle_t* outgoing, size_t n_outgoing) {
+    atom_t* atom = &atomspace.atoms[slot];
+    
+    atom->type = type;
+    atom->name = name_id != NAME_NIL ? name_at(name_id).str : nullptr;
+    atom->name_id = name_id;
+    atom->shard = shard;
+    atom->outgoing.assign(outgoing, outgoing + n_outgoing);
+    atom->linked = false;
+    
+    /* The handle goes last: a reader that sees it sees the rest */
+    atom_handle_t handle = ((uint64_t)atom->generation << 32) | (slot + 1);
+    atom->handle.store(handle, std::memory_order_release);
+    atomspace.atom_count.fetch_add(1, std::memory_order_relaxed);
+    
+    /* Add to name index */
+    if (name_id != NAME_NIL) {
+        name_at(name_id).atom.store(handle, std::memory_order_release);
+    }
+    
+    return handle;
+}
+
+/**
+ * Allocate an atom (named atoms are returned if they exist)
+ * @param full Set if there was no free slot
+ * @return Atom handle, or 0 on error
+ */
+static atom_handle_t atom_alloc(atom_type_t type, const char* name, bool* full) {
+    epoch_guard_t guard;
+    if (!name) {
+        uint32_t shard = thread_shard();
+        uint32_t slot = slot_take(shard);
+        *full = slot == ATOM_SLOT_NIL;
+        return !*full ? atom_init(slot, type, NAME_NIL, shard, nullptr, 0) : 0;
+    }
+    
+    /* An atom that has the name already is found without locking */
+    std::string_view view(name);
+    size_t hash = name_hash(view);
+    uint32_t id = name_find(view, hash);
+    atom_handle_t found = id != NAME_NIL ? name_at(id).atom.load(std::memory_order_acquire) : 0;
+    if (found != 0 && found != NAME_PENDING) {
+        return found;
+    }
+    
+    uint32_t s = shard_of(hash);
+    std::lock_guard<std::mutex> lock(shards[s].lock);
+    if (id == NAME_NIL) {
+        id = name_find(view, hash);
+    }
+    if (id == NAME_NIL) {
+        name_reserve(shards[s], 1);
+        id = name_insert(s, view, hash);
+        if (id == NAME_NIL) {
+            return 0;
+        }
+    }
+    
+    /* Another writer may have given it an atom before the lock was ours */
+    found = name_at(id).atom.load(std::memory_order_relaxed);
+    if (found != 0) {
+        return found;
+    }
+    
+    uint32_t slot = slot_take(s);
+    *full = slot == ATOM_SLOT_NIL;
+    return !*full ? atom_init(slot, type, id, s, nullptr, 0) : 0;
+}
+
 /**
  * Allocate a new atom
  */
@@ -64,99 +743,672 @@ extern "C" atom_handle_t cog_atom_alloc(atom_type_t type, const char* name) {
         return 0;
     }
     
-    if (atomspace.atom_count >= MAX_ATOMS) {
-        return 0;
+    atom_handle_t handle;
+    bool full = false;
+    int tries = 0;
+    do {
+        handle = atom_alloc(type, name, &full);
+    } while (!handle && full && slot_wait(&tries));
+    return handle;
+}
+
+/**
+ * Hash a name as the name index does
+ */
+size_t atomspace_name_hash(const char* str, size_t len) {
+    return name_hash(std::string_view(str, len));
+}
+
+/**
+ * Find an interned name without changing the index
+ */
+uint32_t atomspace_name_find(const char* str, size_t len, size_t hash) {
+    epoch_guard_t guard;
+    return name_find(std::string_view(str, len), hash);
+}
+
+/**
+ * Allocate a batch of atoms, or none of them
+ * @param full Set if there were not enough free slots
+ */
+static int alloc_batch(const atom_spec_t* specs, size_t n, atom_handle_t* atoms, bool* full) {
+    /* Every shard is locked, in order, so no other writer sees part of the batch */
+    epoch_guard_t guard;
+    std::unique_lock<std::mutex> locks[ATOM_SHARDS];
+    for (uint32_t s = 0; s < ATOM_SHARDS; s++) {
+        locks[s] = std::unique_lock<std::mutex>(shards[s].lock);
     }
     
-    /* Check if named atom already exists */
-    if (name) {
-        auto it = atomspace.name_index.find(name);
-        if (it != atomspace.name_index.end()) {
-            return it->second;
+    /* Intern every name at once; names without an atom are claimed for the batch */
+    std::vector<uint32_t> ids(n, NAME_NIL);
+    size_t n_named[ATOM_SHARDS] = {};
+    for (size_t i = 0; i < n; i++) {
+        if (specs[i].str) {
+            n_named[shard_of(specs[i].hash)]++;
         }
     }
+    for (uint32_t s = 0; s < ATOM_SHARDS; s++) {
+        name_reserve(shards[s], n_named[s]);
+    }
     
-    /* Find free slot */
-    size_t idx = 0;
-    for (idx = 0; idx < MAX_ATOMS; idx++) {
-        if (!atomspace.atoms[idx].active) {
-            break;
+    size_t needed = 0;
+    bool failed = false;
+    for (size_t i = 0; i < n && !failed; i++) {
+        if (!specs[i].str) {
+            needed++;
+            continue;
+        }
+        
+        std::string_view name(specs[i].str, specs[i].len);
+        uint32_t id = specs[i].name_id;
+        if (id == NAME_NIL) {
+            id = name_find(name, specs[i].hash);
+        }
+        if (id == NAME_NIL) {
+            id = name_insert(shard_of(specs[i].hash), name, specs[i].hash);
+            failed = id == NAME_NIL;
         }
+        if (id != NAME_NIL && name_at(id).atom.load(std::memory_order_relaxed) == 0) {
+            name_at(id).atom.store(NAME_PENDING, std::memory_order_relaxed);
+            needed++;
+        }
+        ids[i] = id;
     }
     
-    if (idx >= MAX_ATOMS) {
-        return 0;
+    /* Take every slot the batch needs before initializing any atom */
+    uint32_t home = thread_shard();
+    std::vector<uint32_t> slots;
+    slots.reserve(failed ? 0 : needed);
+    while (!failed && slots.size() < needed) {
+        uint32_t slot = slot_take(home);
+        *full = failed = slot == ATOM_SLOT_NIL;
+        if (!failed) {
+            slots.push_back(slot);
+        }
+    }
+    
+    if (failed) {
+        for (size_t i = slots.size(); i > 0; i--) {
+            slot_put(home, slots[i - 1]);
+        }
+        for (uint32_t id : ids) {
+            if (id != NAME_NIL && name_at(id).atom.load(std::memory_order_relaxed) == NAME_PENDING) {
+                name_at(id).atom.store(0, std::memory_order_relaxed);
+            }
+        }
+        return -1;
+    }
+    
+    size_t next = 0;
+    for (size_t i = 0; i < n; i++) {
+        atom_handle_t atom = ids[i] != NAME_NIL ? name_at(ids[i]).atom.load(std::memory_order_relaxed)
+                                                : NAME_PENDING;
+        if (atom != NAME_PENDING) {
+            atoms[i] = atom;
+        } else {
+            uint32_t shard = ids[i] != NAME_NIL ? ids[i] & (ATOM_SHARDS - 1) : home;
+            atoms[i] = atom_init(slots[next++], specs[i].type, ids[i], shard, nullptr, 0);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Allocate a batch of atoms, or none of them
+ */
+int atomspace_alloc_batch(const atom_spec_t* specs, size_t n, atom_handle_t* atoms) {
+    if (!atomspace.initialized) {
+        return -1;
+    }
+    
+    int ret;
+    bool full = false;
+    int tries = 0;
+    do {
+        ret = alloc_batch(specs, n, atoms, &full);
+    } while (ret != 0 && full && slot_wait(&tries));
+    return ret;
+}
+
+/**
+ * Allocate atoms in one call
+ */
+extern "C" int cog_atom_alloc_batch(const atom_type_t* types, const char* const* names,
+                                    size_t n, atom_handle_t* atoms) {
+    if (n > 0 && (!types || !atoms)) {
+        return -1;
+    }
+    
+    std::vector<atom_spec_t> specs(n);
+    for (size_t i = 0; i < n; i++) {
+        const char* name = names ? names[i] : nullptr;
+        size_t len = name ? strlen(name) : 0;
+        size_t hash = name ? name_hash(std::string_view(name, len)) : 0;
+        specs[i] = atom_spec_t{types[i], name, len, hash, NAME_NIL};
     }
     
-    /* Create tensor for atom (embed as 512-dim vector) */
-    struct ggml_tensor* t = ggml_new_tensor_1d(atomspace.ctx, GGML_TYPE_F32, 512);
-    if (!t) {
+    return atomspace_alloc_batch(specs.data(), n, atoms);
+}
+
+/**
+ * Look up named atoms
+ */
+extern "C" size_t cog_atom_lookup(const char* const* names, size_t n, atom_handle_t* atoms) {
+    if (!atomspace.initialized || (n > 0 && (!names || !atoms))) {
         return 0;
     }
     
-    /* Initialize atom */
-    atom_t* atom = &atomspace.atoms[idx];
-    atom->type = type;
-    atom->name = name ? strdup(name) : nullptr;
-    atom->outgoing.clear();
-    atom->tensor = t;
-    atom->handle = atomspace.next_handle++;
-    atom->active = true;
+    epoch_guard_t guard;
+    size_t found = 0;
+    std::string_view views[NAME_BATCH];
+    size_t hashes[NAME_BATCH];
     
-    atomspace.atom_count++;
+    for (size_t base = 0; base < n; base += NAME_BATCH) {
+        size_t count = n - base < NAME_BATCH ? n - base : NAME_BATCH;
+        
+        /* Hash the batch and prefetch its buckets before probing any */
+        for (size_t i = 0; i < count; i++) {
+            const char* name = names[base + i];
+            views[i] = name ? std::string_view(name) : std::string_view();
+            hashes[i] = name_hash(views[i]);
+            const name_table_t* table = shards[shard_of(hashes[i])].table.load(std::memory_order_acquire);
+            if (table) {
+                __builtin_prefetch(&table->buckets[hashes[i] & table->mask]);
+            }
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            uint32_t id = names[base + i] ? name_find(views[i], hashes[i]) : NAME_NIL;
+            atom_handle_t atom = id != NAME_NIL ? name_at(id).atom.load(std::memory_order_acquire) : 0;
+            atoms[base + i] = atom != NAME_PENDING ? atom : 0;
+            found += atoms[base + i] != 0;
+        }
+    }
     
-    /* Add to name index */
-    if (name) {
-        atomspace.name_index[name] = atom->handle;
+    return found;
+}
+
+/**
+ * Embedding row storage
+ */
+static void* row_data(uint32_t row) {
+    struct ggml_tensor* block = atomspace.embed_blocks[row / EMBED_BLOCK_ROWS];
+    return (char*)block->data + (size_t)(row % EMBED_BLOCK_ROWS) * atomspace.row_bytes;
+}
+
+/**
+ * Give an atom an embedding row, allocating its block if needed
+ * @return 0 on success, negative if out of rows or memory
+ */
+static int row_attach(atom_t* atom) {
+    if (atomspace.n_free_rows == 0) {
+        return -1;
+    }
+    
+    uint32_t row = atomspace.free_rows[atomspace.n_free_rows - 1];
+    struct ggml_tensor** block = &atomspace.embed_blocks[row / EMBED_BLOCK_ROWS];
+    if (!*block) {
+        static const enum ggml_type types[] = {GGML_TYPE_F32, GGML_TYPE_F16, GGML_TYPE_Q8_0};
+        *block = dtesn_mem_tensor_alloc(types[atomspace.embed_type], COG_EMBED_DIM,
+                                        EMBED_BLOCK_ROWS);
+        if (!*block) {
+            return -1;
+        }
+    }
+    
+    atomspace.block_rows[row / EMBED_BLOCK_ROWS]++;
+    atomspace.n_free_rows--;
+    atomspace.row_slot[row] = (uint32_t)(atom - atomspace.atoms);
+    if (row >= atomspace.n_rows) {
+        atomspace.n_rows = row + 1;
+    }
+    atom->row = row;
+    return 0;
+}
+
+/**
+ * Take an atom's embedding row away, releasing its block if it empties
+ */
+static void row_detach(atom_t* atom) {
+    uint32_t row = atom->row;
+    embed_index_remove(row);
+    atomspace.row_slot[row] = ATOM_SLOT_NIL;
+    atomspace.free_rows[atomspace.n_free_rows++] = row;
+    atom->row = EMBED_ROW_NIL;
+    
+    uint32_t b = row / EMBED_BLOCK_ROWS;
+    if (--atomspace.block_rows[b] == 0) {
+        dtesn_mem_tensor_free(atomspace.embed_blocks[b]);
+        atomspace.embed_blocks[b] = nullptr;
+    }
+}
+
+/**
+ * Free an atom
+ */
+extern "C" int cog_atom_free(atom_handle_t handle) {
+    if (!atomspace.initialized) {
+        return -1;
+    }
+    
+    {
+        epoch_guard_t guard;
+        atom_t* atom = atom_get(handle);
+        if (!atom) {
+            return -1;
+        }
+        
+        /* Another writer may have freed it before the lock was ours */
+        std::lock_guard<std::mutex> lock(shards[atom->shard].lock);
+        if (atom->handle.load(std::memory_order_relaxed) != handle) {
+            return -1;
+        }
+        
+        /* Readers stop resolving the handle; atoms they resolved already stay until released */
+        atom->handle.store(0, std::memory_order_release);
+        atom->generation++;
+        
+        if (atom->name) {
+            name_at(atom->name_id).atom.store(0, std::memory_order_release);
+            atom->name = nullptr;
+        }
+        
+        if (atom->linked) {
+            link_remove(shards[atom->shard], atom);
+        }
+        if (atom->row != EMBED_ROW_NIL) {
+            std::unique_lock<std::shared_mutex> embed(atomspace.embed_lock);
+            row_detach(atom);
+        }
+        
+        /* Leave the incoming sets of the atoms this link contains */
+        const atom_handle_t* outgoing = atom->outgoing.data();
+        for (size_t i = 0; i < atom->outgoing.size(); i++) {
+            atom_t* target = outgoing_repeats(outgoing, i) ? nullptr : atom_get(outgoing[i]);
+            if (target) {
+                incoming_remove(target, handle);
+            }
+        }
+        
+        atomspace.atom_count.fetch_sub(1, std::memory_order_relaxed);
+        epoch_retire(slot_release, (void*)(uintptr_t)(atom - atomspace.atoms));
     }
     
-    return atom->handle;
+    /* Unpinned, so with no reader in the way the slot is free again on return */
+    epoch_collect();
+    return 0;
+}
+
+/**
+ * Create a link, or find the one with this content
+ * @param full Set if there was no free slot
+ * @return Link handle, or 0 on error
+ */
+static atom_handle_t link_create(atom_type_t type, const atom_handle_t* atoms, size_t n_atoms,
+                                 bool* full) {
+    epoch_guard_t guard;
+    
+    /* Every outgoing atom must exist */
+    for (size_t i = 0; i < n_atoms; i++) {
+        if (!atom_get(atoms[i])) {
+            return 0;
+        }
+    }
+    
+    size_t hash = link_hash(type, atoms, n_atoms);
+    uint32_t s = shard_of(hash);
+    shard_t& shard = shards[s];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    
+    /* Return the existing link with this content */
+    link_reserve(shard);
+    size_t index;
+    uint32_t slot = link_find(shard, type, atoms, n_atoms, hash, &index);
+    if (slot != ATOM_SLOT_NIL) {
+        return atomspace.atoms[slot].handle.load(std::memory_order_relaxed);
+    }
+    
+    /* Create link atom */
+    slot = slot_take(s);
+    *full = slot == ATOM_SLOT_NIL;
+    if (*full) {
+        return 0;
+    }
+    atom_handle_t handle = atom_init(slot, type, NAME_NIL, s, atoms, n_atoms);
+    atom_t* link_atom = &atomspace.atoms[slot];
+    shard.links[index] = link_bucket_t{name_tag(hash), slot};
+    shard.n_links++;
+    link_atom->link_hash = hash;
+    link_atom->linked = true;
+    
+    /*
+     * Join the incoming sets of its atoms, once per distinct atom (one freed
+     * since the check is skipped)
+     */
+    for (size_t i = 0; i < n_atoms; i++) {
+        atom_t* target = outgoing_repeats(atoms, i) ? nullptr : atom_get(atoms[i]);
+        if (target) {
+            incoming_add(target, handle);
+        }
+    }
+    
+    return handle;
 }
 
 /**
  * Create link between atoms
  */
 extern "C" atom_handle_t cog_link_create(atom_type_t type, atom_handle_t* atoms, size_t n_atoms) {
+    if (!atomspace.initialized || (n_atoms > 0 && !atoms)) {
+        return 0;
+    }
+    
+    atom_handle_t handle;
+    bool full = false;
+    int tries = 0;
+    do {
+        handle = link_create(type, atoms, n_atoms, &full);
+    } while (!handle && full && slot_wait(&tries));
+    
+    /* Release incoming sets this outgrew */
+    epoch_collect();
+    return handle;
+}
+
+/**
+ * Get an atom's embedding
+ */
+extern "C" int cog_atom_embedding(atom_handle_t handle, float* vec) {
+    if (!atomspace.initialized || !vec) {
+        return -1;
+    }
+    
+    epoch_guard_t guard;
+    atom_t* atom = atom_get(handle);
+    if (!atom) {
+        return -1;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(atomspace.embed_lock);
+    if (atom->row == EMBED_ROW_NIL) {
+        memset(vec, 0, COG_EMBED_DIM * sizeof(float));
+    } else {
+        embed_load(atomspace.embed_type, row_data(atom->row), vec);
+    }
+    return 0;
+}
+
+/**
+ * Set an atom's embedding
+ */
+extern "C" int cog_atom_set_embedding(atom_handle_t handle, const float* vec) {
+    if (!atomspace.initialized || !vec) {
+        return -1;
+    }
+    
+    epoch_guard_t guard;
+    atom_t* atom = atom_get(handle);
+    if (!atom) {
+        return -1;
+    }
+    
+    /* The shard lock keeps the atom alive; the embedding lock keeps readers out */
+    std::lock_guard<std::mutex> lock(shards[atom->shard].lock);
+    std::unique_lock<std::shared_mutex> embed(atomspace.embed_lock);
+    if (atom->handle.load(std::memory_order_relaxed) != handle ||
+        (atom->row == EMBED_ROW_NIL && row_attach(atom) != 0)) {
+        return -1;
+    }
+    
+    /* The norm is of the stored values, so cosine matches what is scored */
+    void* data = row_data(atom->row);
+    embed_store(atomspace.embed_type, vec, data);
+    atomspace.row_norm[atom->row] = embed_row_norm(atomspace.embed_type, data);
+    embed_index_update(atom->row);
+    return 0;
+}
+
+/**
+ * Lock of the embedding matrix
+ */
+std::shared_mutex& atomspace_embed_lock(void) {
+    return atomspace.embed_lock;
+}
+
+/**
+ * Element type of the embedding matrix
+ */
+cog_embed_type_t atomspace_embed_type(void) {
+    return atomspace.embed_type;
+}
+
+/**
+ * Number of matrix rows ever used
+ */
+uint32_t atomspace_rows(void) {
+    return atomspace.n_rows;
+}
+
+/**
+ * Atom stored in a matrix row
+ */
+atom_handle_t atomspace_row_atom(uint32_t row) {
+    uint32_t slot = atomspace.row_slot[row];
+    return slot != ATOM_SLOT_NIL ? atomspace.atoms[slot].handle.load(std::memory_order_acquire) : 0;
+}
+
+/**
+ * Embedding in a matrix row
+ */
+const void* atomspace_row(uint32_t row) {
+    return row_data(row);
+}
+
+/**
+ * Euclidean norm of the embedding in a matrix row
+ */
+float atomspace_row_norm(uint32_t row) {
+    return atomspace.row_norm[row];
+}
+
+/**
+ * Get the links of one type that contain an atom
+ */
+extern "C" size_t cog_atom_incoming(atom_handle_t handle, atom_type_t type,
+                                    atom_handle_t* links, size_t max_links) {
     if (!atomspace.initialized) {
         return 0;
     }
     
-    /* Create link atom */
-    atom_handle_t link = cog_atom_alloc(type, nullptr);
-    if (!link) {
+    epoch_guard_t guard;
+    atom_t* atom = atom_get(handle);
+    if (!atom) {
         return 0;
     }
     
-    /* Find link atom */
-    atom_t* link_atom = nullptr;
-    for (size_t i = 0; i < MAX_ATOMS; i++) {
-        if (atomspace.atoms[i].active && atomspace.atoms[i].handle == link) {
-            link_atom = &atomspace.atoms[i];
-            break;
+    size_t n;
+    const atom_handle_t* incoming = incoming_get(atom, &n);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        const atom_t* link = atom_get(incoming[i]);
+        if (link && link->type == type) {
+            if (links && count < max_links) {
+                links[count] = incoming[i];
+            }
+            count++;
         }
     }
     
-    if (!link_atom) {
-        return 0;
+    return count;
+}
+
+/* Pattern match in progress */
+struct query_t {
+    const cog_clause_t* clauses;
+    size_t n_clauses;
+    size_t n_vars;
+    atom_handle_t* bindings;        /* Per variable, 0 while unbound */
+    std::vector<uint32_t> trail;    /* Bound variables, for undo */
+    atom_handle_t* results;
+    size_t max_results;
+    int64_t count;
+};
+
+/**
+ * Atom a term refers to under the current bindings
+ * @return Atom handle, or 0 for an unbound variable
+ */
+static atom_handle_t query_term(const query_t& q, const cog_term_t& term) {
+    return term.atom ? term.atom : q.bindings[term.var];
+}
+
+/**
+ * Pick where to look for a clause's links
+ * @param anchor Set to the known atom with the smallest incoming set
+ *               (nullptr if that atom is stale: nothing can match)
+ * @return Number of candidates, or MAX_ATOMS if the clause has no known atom
+ */
+static size_t query_plan(const query_t& q, const cog_clause_t& clause, atom_t** anchor) {
+    size_t cost = MAX_ATOMS;
+    for (size_t i = 0; i < clause.arity; i++) {
+        atom_handle_t known = query_term(q, clause.outgoing[i]);
+        if (!known) {
+            continue;
+        }
+        atom_t* atom = atom_get(known);
+        size_t size = 0;
+        if (atom) {
+            incoming_get(atom, &size);
+        }
+        if (size < cost) {
+            *anchor = atom;
+            cost = size;
+        }
+    }
+    return cost;
+}
+
+/**
+ * Try a link against a clause, binding its unbound variables
+ * @return true if the link matches (bindings are on the trail either way)
+ */
+static bool query_unify(query_t& q, const cog_clause_t& clause, const atom_t* link) {
+    if (link->type != clause.type || link->outgoing.size() != clause.arity) {
+        return false;
     }
     
-    /* Add outgoing atoms */
-    for (size_t i = 0; i < n_atoms; i++) {
-        link_atom->outgoing.push_back(atoms[i]);
-        
-        /* Create hypergraph edge */
-        atom_t* target = nullptr;
-        for (size_t j = 0; j < MAX_ATOMS; j++) {
-            if (atomspace.atoms[j].active && atomspace.atoms[j].handle == atoms[i]) {
-                target = &atomspace.atoms[j];
-                break;
+    for (size_t i = 0; i < clause.arity; i++) {
+        const cog_term_t& term = clause.outgoing[i];
+        atom_handle_t out = link->outgoing[i];
+        atom_handle_t known = query_term(q, term);
+        if (known) {
+            if (known != out) {
+                return false;
             }
+        } else if (atom_get(out)) {
+            q.bindings[term.var] = out;
+            q.trail.push_back(term.var);
+        } else {
+            /* Freed atoms never bind */
+            return false;
         }
-        
-        if (target) {
-            hgfs_edge(link_atom->tensor->data, target->tensor->data, 1.0f);
+    }
+    return true;
+}
+
+/**
+ * Match the clauses not yet in done, cheapest first
+ */
+static void query_match(query_t& q, uint32_t done, uint32_t all) {
+    if (done == all) {
+        if ((size_t)q.count < q.max_results) {
+            memcpy(q.results + q.count * q.n_vars, q.bindings, q.n_vars * sizeof(atom_handle_t));
+        }
+        q.count++;
+        return;
+    }
+    
+    /* The remaining clause with the fewest candidates goes next */
+    size_t next = 0;
+    size_t best = SIZE_MAX;
+    atom_t* anchor = nullptr;
+    for (size_t c = 0; c < q.n_clauses; c++) {
+        if (done & (1u << c)) {
+            continue;
+        }
+        atom_t* atom = nullptr;
+        size_t cost = query_plan(q, q.clauses[c], &atom);
+        if (cost < best) {
+            next = c;
+            best = cost;
+            anchor = atom;
         }
     }
     
-    return link;
+    const cog_clause_t& clause = q.clauses[next];
+    size_t mark = q.trail.size();
+    auto visit = [&](const atom_t* link) {
+        if (query_unify(q, clause, link)) {
+            query_match(q, done | (1u << next), all);
+        }
+        while (q.trail.size() > mark) {
+            q.bindings[q.trail.back()] = 0;
+            q.trail.pop_back();
+        }
+    };
+    
+    if (best < MAX_ATOMS) {
+        if (!anchor) {
+            return;
+        }
+        size_t n;
+        const atom_handle_t* incoming = incoming_get(anchor, &n);
+        for (size_t i = 0; i < n; i++) {
+            const atom_t* link = atom_get(incoming[i]);
+            if (link) {
+                visit(link);
+            }
+        }
+    } else {
+        for (size_t slot = 0; slot < MAX_ATOMS; slot++) {
+            if (atomspace.atoms[slot].handle.load(std::memory_order_acquire) != 0) {
+                visit(&atomspace.atoms[slot]);
+            }
+        }
+    }
+}
+
+/**
+ * Find all bindings of a pattern
+ */
+extern "C" int64_t cog_query(const cog_clause_t* clauses, size_t n_clauses, size_t n_vars,
+                             atom_handle_t* results, size_t max_results) {
+    if (!atomspace.initialized || !clauses || n_clauses == 0 || n_clauses > QUERY_MAX_CLAUSES ||
+        (max_results > 0 && n_vars > 0 && !results)) {
+        return -1;
+    }
+    
+    /* Every variable index must be in range */
+    for (size_t c = 0; c < n_clauses; c++) {
+        if (clauses[c].arity > 0 && !clauses[c].outgoing) {
+            return -1;
+        }
+        for (size_t i = 0; i < clauses[c].arity; i++) {
+            if (!clauses[c].outgoing[i].atom && clauses[c].outgoing[i].var >= n_vars) {
+                return -1;
+            }
+        }
+    }
+    
+    std::vector<atom_handle_t> bindings(n_vars, 0);
+    query_t q = {clauses, n_clauses, n_vars, bindings.data(), {}, results,
+                 n_vars > 0 ? max_results : 0, 0};
+    q.trail.reserve(n_vars);
+    
+    uint32_t all = n_clauses == QUERY_MAX_CLAUSES ? UINT32_MAX : (1u << n_clauses) - 1;
+    epoch_guard_t guard;
+    query_match(q, 0, all);
+    
+    return q.count;
 }
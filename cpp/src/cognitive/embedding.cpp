@@ -0,0 +1,854 @@
+/**
+ * @file embedding.cpp
+ * @brief Similarity search over atom embeddings
+ * 
+ * Rows are stored as F32, F16 or ggml's Q8_0 blocks and scored in that
+ * form: F16 rows are widened inside the dot kernel, and for Q8_0 the
+ * query is quantized once and blocks are multiplied as integers. The dot
+ * kernels keep EMBED_LANES independent partial sums so the compiler can
+ * vectorize them without reassociating floats.
+ * 
+ * Exact search scans the matrix once per batch of EMBED_BATCH queries,
+ * scoring each row against every query of the batch while it is in cache.
+ * 
+ * The approximate index is a hierarchical navigable small world graph
+ * (Malkov & Yashunin). Nodes keep a copy of their row, so updating an
+ * embedding retires the row's node (still used for routing, never
+ * returned) and inserts a new one; rebuilding drops retired nodes.
+ * 
+ * Searches hold the AtomSpace's embedding lock shared, so any number run
+ * at once (each thread keeps its own visited marks); building the index
+ * and changing rows hold it exclusive.
+ */
+
+#include "aichat/cognitive.h"
+#include "cognitive/internal.h"
+#include <ggml.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+#define EMBED_LANES 16              /* Partial sums in the dot kernel */
+#define EMBED_BATCH 64              /* Queries scored per pass over the matrix */
+#define EMBED_QUERY_TILE 4          /* Queries scored together against one row */
+#define QK8_0 32                    /* Values per Q8_0 block */
+#define EMBED_Q8_BLOCKS (COG_EMBED_DIM / QK8_0)
+#define HNSW_MAX_LEVEL 16           /* Highest level of an HNSW node */
+#define NODE_NIL UINT32_MAX
+
+/* ggml Q8_0 block */
+struct block_q8_0_t {
+    ggml_fp16_t d;                  /* Scale */
+    int8_t qs[QK8_0];
+};
+static_assert(sizeof(block_q8_0_t) == sizeof(ggml_fp16_t) + QK8_0, "Q8_0 block layout");
+
+/* Half precision element: native where the compiler has it */
+#if defined(__FLT16_MAX__)
+typedef _Float16 half_t;
+static inline float half_to_float(half_t h) {
+    return (float)h;
+}
+static inline half_t float_to_half(float f) {
+    return (half_t)f;
+}
+#else
+typedef ggml_fp16_t half_t;
+static inline float half_to_float(half_t h) {
+    return ggml_fp16_to_fp32(h);
+}
+static inline half_t float_to_half(float f) {
+    return ggml_fp32_to_fp16(f);
+}
+#endif
+static_assert(sizeof(half_t) == sizeof(ggml_fp16_t), "F16 element size");
+
+/**
+ * Q8_0 block scale as float
+ */
+static inline float scale_to_float(ggml_fp16_t d) {
+    half_t h;
+    memcpy(&h, &d, sizeof(h));
+    return half_to_float(h);
+}
+
+/* EMBED_LANES floats, one SIMD register (or a few) wide */
+typedef float lanes_t __attribute__((vector_size(EMBED_LANES * sizeof(float))));
+
+/**
+ * Load EMBED_LANES values as floats (out parameter: no vector ABI at calls)
+ */
+static inline void load_lanes(lanes_t* v, const float* p) {
+    memcpy(v, p, sizeof(*v));
+}
+
+static inline void load_lanes(lanes_t* v, const half_t* p) {
+#if defined(__AVX512F__) && EMBED_LANES == 16
+    /* Compilers widen half vectors one element at a time; convert in one go */
+    __m512 f = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)p));
+    memcpy(v, &f, sizeof(f));
+#elif defined(__F16C__)
+    for (size_t j = 0; j < EMBED_LANES; j += 8) {
+        __m256 f = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(p + j)));
+        memcpy((float*)v + j, &f, sizeof(f));
+    }
+#else
+    for (size_t j = 0; j < EMBED_LANES; j++) {
+        (*v)[j] = half_to_float(p[j]);
+    }
+#endif
+}
+
+/**
+ * Sum of the lanes
+ */
+static inline float sum_lanes(const lanes_t& v) {
+    float sum = 0.0f;
+    for (size_t j = 0; j < EMBED_LANES; j++) {
+        sum += v[j];
+    }
+    return sum;
+}
+
+/* Query in every form a row type is scored against */
+struct embed_query_t {
+    float f32[COG_EMBED_DIM];
+    block_q8_0_t q8[EMBED_Q8_BLOCKS];
+    float norm;                     /* Of the values actually scored */
+};
+
+/* Scored candidate */
+struct scored_t {
+    float score;
+    uint32_t id;
+};
+
+/* Orders a heap with the worst score on top */
+static bool worse_on_top(const scored_t& a, const scored_t& b) {
+    return a.score > b.score;
+}
+
+/* Orders a heap with the best score on top */
+static bool best_on_top(const scored_t& a, const scored_t& b) {
+    return a.score < b.score;
+}
+
+/* HNSW node */
+struct hnsw_node_t {
+    uint32_t row;                   /* Matrix row it was built from */
+    atom_handle_t atom;             /* 0 once retired */
+    int level;
+    float norm;
+    std::vector<uint32_t> upper;    /* Links on levels 1..level, m per level */
+    uint8_t n_upper[HNSW_MAX_LEVEL];
+};
+
+/* HNSW index */
+static struct {
+    bool built;
+    cog_hnsw_params_t params;
+    double level_mult;              /* 1 / ln(m) */
+    std::vector<hnsw_node_t> nodes;
+    cog_embed_type_t type;
+    size_t row_bytes;
+    std::vector<uint8_t> vectors;   /* Node rows, row_bytes each */
+    std::vector<uint32_t> base;     /* Level-0 links, 2m per node */
+    std::vector<uint32_t> n_base;
+    std::vector<uint32_t> row_node; /* Row -> live node, or NODE_NIL */
+    uint32_t entry;
+    int max_level;
+    std::mt19937 rng;
+} hnsw;
+
+/* This thread's search marks: a node is visited if its mark is the stamp */
+static thread_local struct {
+    std::vector<uint32_t> marks;
+    uint32_t stamp;
+} visited;
+
+/**
+ * Dot product of two embeddings, either element type
+ */
+template <typename A, typename B>
+static float embed_dot(const A* a, const B* b) {
+    lanes_t acc = {};
+    for (size_t i = 0; i < COG_EMBED_DIM; i += EMBED_LANES) {
+        lanes_t va, vb;
+        load_lanes(&va, a + i);
+        load_lanes(&vb, b + i);
+        acc += va * vb;
+    }
+    return sum_lanes(acc);
+}
+
+/**
+ * Dot products of EMBED_QUERY_TILE queries with one row
+ */
+template <typename B>
+static void embed_dot_tile(const embed_query_t* queries, const B* b, float* out) {
+    lanes_t acc[EMBED_QUERY_TILE] = {};
+    for (size_t i = 0; i < COG_EMBED_DIM; i += EMBED_LANES) {
+        lanes_t row;
+        load_lanes(&row, b + i);
+        for (size_t t = 0; t < EMBED_QUERY_TILE; t++) {
+            lanes_t query;
+            load_lanes(&query, queries[t].f32 + i);
+            acc[t] += query * row;
+        }
+    }
+    
+    for (size_t t = 0; t < EMBED_QUERY_TILE; t++) {
+        out[t] = sum_lanes(acc[t]);
+    }
+}
+
+/**
+ * Dot product of two Q8_0 rows: integer sums scaled per block
+ */
+static float embed_dot_q8(const block_q8_0_t* a, const block_q8_0_t* b) {
+    float sum = 0.0f;
+    for (size_t blk = 0; blk < EMBED_Q8_BLOCKS; blk++) {
+        int32_t isum = 0;
+        for (size_t j = 0; j < QK8_0; j++) {
+            isum += (int32_t)a[blk].qs[j] * (int32_t)b[blk].qs[j];
+        }
+        sum += (float)isum * scale_to_float(a[blk].d) * scale_to_float(b[blk].d);
+    }
+    return sum;
+}
+
+/**
+ * Dot products of EMBED_QUERY_TILE quantized queries with one Q8_0 row
+ */
+static void embed_dot_q8_tile(const embed_query_t* queries, const block_q8_0_t* b, float* out) {
+    float sum[EMBED_QUERY_TILE] = {};
+    for (size_t blk = 0; blk < EMBED_Q8_BLOCKS; blk++) {
+        float d = scale_to_float(b[blk].d);
+        for (size_t t = 0; t < EMBED_QUERY_TILE; t++) {
+            const block_q8_0_t& a = queries[t].q8[blk];
+            int32_t isum = 0;
+            for (size_t j = 0; j < QK8_0; j++) {
+                isum += (int32_t)a.qs[j] * (int32_t)b[blk].qs[j];
+            }
+            sum[t] += (float)isum * scale_to_float(a.d) * d;
+        }
+    }
+    memcpy(out, sum, sizeof(sum));
+}
+
+/**
+ * Quantize COG_EMBED_DIM floats to Q8_0 (as ggml's reference quantizer)
+ */
+static void embed_quantize_q8(const float* vec, block_q8_0_t* out) {
+    for (size_t blk = 0; blk < EMBED_Q8_BLOCKS; blk++) {
+        const float* x = vec + blk * QK8_0;
+        float amax = 0.0f;
+        for (size_t j = 0; j < QK8_0; j++) {
+            amax = std::max(amax, fabsf(x[j]));
+        }
+        
+        float d = amax / 127.0f;
+        float id = d != 0.0f ? 1.0f / d : 0.0f;
+        out[blk].d = ggml_fp32_to_fp16(d);
+        for (size_t j = 0; j < QK8_0; j++) {
+            out[blk].qs[j] = (int8_t)roundf(x[j] * id);
+        }
+    }
+}
+
+/**
+ * Euclidean norm of an embedding
+ */
+static float embed_norm(const float* a) {
+    return sqrtf(embed_dot(a, a));
+}
+
+/**
+ * Bytes in one embedding row
+ */
+size_t embed_row_bytes(cog_embed_type_t type) {
+    switch (type) {
+    case COG_EMBED_F32:
+        return COG_EMBED_DIM * sizeof(float);
+    case COG_EMBED_F16:
+        return COG_EMBED_DIM * sizeof(half_t);
+    case COG_EMBED_Q8_0:
+        return EMBED_Q8_BLOCKS * sizeof(block_q8_0_t);
+    }
+    return 0;
+}
+
+/**
+ * Encode COG_EMBED_DIM floats as a row
+ */
+void embed_store(cog_embed_type_t type, const float* vec, void* row) {
+    switch (type) {
+    case COG_EMBED_F32:
+        memcpy(row, vec, COG_EMBED_DIM * sizeof(float));
+        break;
+    case COG_EMBED_F16:
+        for (size_t i = 0; i < COG_EMBED_DIM; i++) {
+            ((half_t*)row)[i] = float_to_half(vec[i]);
+        }
+        break;
+    case COG_EMBED_Q8_0:
+        embed_quantize_q8(vec, (block_q8_0_t*)row);
+        break;
+    }
+}
+
+/**
+ * Decode a row to COG_EMBED_DIM floats
+ */
+void embed_load(cog_embed_type_t type, const void* row, float* vec) {
+    switch (type) {
+    case COG_EMBED_F32:
+        memcpy(vec, row, COG_EMBED_DIM * sizeof(float));
+        break;
+    case COG_EMBED_F16:
+        for (size_t i = 0; i < COG_EMBED_DIM; i++) {
+            vec[i] = half_to_float(((const half_t*)row)[i]);
+        }
+        break;
+    case COG_EMBED_Q8_0:
+        for (size_t blk = 0; blk < EMBED_Q8_BLOCKS; blk++) {
+            const block_q8_0_t& b = ((const block_q8_0_t*)row)[blk];
+            float d = scale_to_float(b.d);
+            for (size_t j = 0; j < QK8_0; j++) {
+                vec[blk * QK8_0 + j] = (float)b.qs[j] * d;
+            }
+        }
+        break;
+    }
+}
+
+/**
+ * Euclidean norm of a row's stored values
+ */
+float embed_row_norm(cog_embed_type_t type, const void* row) {
+    float vec[COG_EMBED_DIM];
+    embed_load(type, row, vec);
+    return embed_norm(vec);
+}
+
+/**
+ * Prepare a query for scoring against rows of a type
+ */
+static void embed_prepare(cog_embed_type_t type, const float* vec, embed_query_t* q) {
+    memcpy(q->f32, vec, sizeof(q->f32));
+    if (type == COG_EMBED_Q8_0) {
+        embed_quantize_q8(vec, q->q8);
+        q->norm = embed_row_norm(type, q->q8);
+    } else {
+        q->norm = embed_norm(vec);
+    }
+}
+
+/**
+ * Dot products of queries with one row
+ */
+static void embed_dot_queries(cog_embed_type_t type, const embed_query_t* queries, size_t n,
+                              const void* row, float* out) {
+    size_t q = 0;
+    switch (type) {
+    case COG_EMBED_F32:
+        for (; q + EMBED_QUERY_TILE <= n; q += EMBED_QUERY_TILE) {
+            embed_dot_tile(queries + q, (const float*)row, out + q);
+        }
+        for (; q < n; q++) {
+            out[q] = embed_dot(queries[q].f32, (const float*)row);
+        }
+        break;
+    case COG_EMBED_F16:
+        for (; q + EMBED_QUERY_TILE <= n; q += EMBED_QUERY_TILE) {
+            embed_dot_tile(queries + q, (const half_t*)row, out + q);
+        }
+        for (; q < n; q++) {
+            out[q] = embed_dot(queries[q].f32, (const half_t*)row);
+        }
+        break;
+    case COG_EMBED_Q8_0:
+        for (; q + EMBED_QUERY_TILE <= n; q += EMBED_QUERY_TILE) {
+            embed_dot_q8_tile(queries + q, (const block_q8_0_t*)row, out + q);
+        }
+        for (; q < n; q++) {
+            out[q] = embed_dot_q8(queries[q].q8, (const block_q8_0_t*)row);
+        }
+        break;
+    }
+}
+
+/**
+ * Dot product of two rows of the same type
+ */
+static float embed_dot_rows(cog_embed_type_t type, const void* a, const void* b) {
+    switch (type) {
+    case COG_EMBED_F32:
+        return embed_dot((const float*)a, (const float*)b);
+    case COG_EMBED_F16:
+        return embed_dot((const half_t*)a, (const half_t*)b);
+    case COG_EMBED_Q8_0:
+        return embed_dot_q8((const block_q8_0_t*)a, (const block_q8_0_t*)b);
+    }
+    return 0.0f;
+}
+
+/**
+ * Similarity from a dot product and the two norms
+ */
+static float embed_score(cog_sim_t sim, float dot, float norm_a, float norm_b) {
+    if (sim == COG_SIM_DOT) {
+        return dot;
+    }
+    float denom = norm_a * norm_b;
+    return denom > 0.0f ? dot / denom : 0.0f;
+}
+
+/**
+ * Write one query's results, best first, padding past the end
+ * @param heap Worst-on-top heap of results (consumed)
+ */
+static size_t embed_emit(std::vector<scored_t>& heap, size_t k, atom_handle_t* atoms,
+                         float* scores, atom_handle_t (*atom_of)(uint32_t)) {
+    std::sort_heap(heap.begin(), heap.end(), worse_on_top);
+    size_t n = heap.size();
+    for (size_t i = 0; i < k; i++) {
+        atoms[i] = i < n ? atom_of(heap[i].id) : 0;
+        if (scores) {
+            scores[i] = i < n ? heap[i].score : -INFINITY;
+        }
+    }
+    heap.clear();
+    return n;
+}
+
+/**
+ * Offer a candidate to a bounded worst-on-top heap
+ */
+static void embed_offer(std::vector<scored_t>& heap, size_t k, scored_t c) {
+    if (heap.size() < k) {
+        heap.push_back(c);
+        std::push_heap(heap.begin(), heap.end(), worse_on_top);
+    } else if (c.score > heap.front().score) {
+        std::pop_heap(heap.begin(), heap.end(), worse_on_top);
+        heap.back() = c;
+        std::push_heap(heap.begin(), heap.end(), worse_on_top);
+    }
+}
+
+/**
+ * Exact top-k search over all atoms
+ */
+extern "C" int cog_embed_topk(const float* queries, size_t n_queries, size_t k, cog_sim_t sim,
+                              atom_handle_t* atoms, float* scores) {
+    if (!queries || !atoms || k == 0 || (sim != COG_SIM_DOT && sim != COG_SIM_COSINE)) {
+        return -1;
+    }
+    
+    std::shared_lock<std::shared_mutex> lock(atomspace_embed_lock());
+    cog_embed_type_t type = atomspace_embed_type();
+    uint32_t n_rows = atomspace_rows();
+    std::vector<embed_query_t> batch(std::min<size_t>(n_queries, EMBED_BATCH));
+    std::vector<std::vector<scored_t>> heaps(batch.size());
+    float dot[EMBED_BATCH];
+    size_t found = n_queries > 0 ? k : 0;
+    
+    for (size_t first = 0; first < n_queries; first += EMBED_BATCH) {
+        size_t n = std::min<size_t>(n_queries - first, EMBED_BATCH);
+        for (size_t q = 0; q < n; q++) {
+            embed_prepare(type, queries + (first + q) * COG_EMBED_DIM, &batch[q]);
+        }
+        
+        for (uint32_t row = 0; row < n_rows; row++) {
+            if (!atomspace_row_atom(row)) {
+                continue;
+            }
+            embed_dot_queries(type, batch.data(), n, atomspace_row(row), dot);
+            float norm = atomspace_row_norm(row);
+            for (size_t q = 0; q < n; q++) {
+                embed_offer(heaps[q], k, scored_t{embed_score(sim, dot[q], batch[q].norm, norm), row});
+            }
+        }
+        
+        for (size_t q = 0; q < n; q++) {
+            size_t out = (first + q) * k;
+            size_t got = embed_emit(heaps[q], k, atoms + out, scores ? scores + out : nullptr,
+                                    atomspace_row_atom);
+            found = std::min(found, got);
+        }
+    }
+    return (int)found;
+}
+
+/**
+ * Row of an index node
+ */
+static const void* node_row(uint32_t id) {
+    return hnsw.vectors.data() + (size_t)id * hnsw.row_bytes;
+}
+
+/**
+ * Links of a node on a level
+ */
+static uint32_t* node_links(uint32_t id, int level, uint32_t** count_base, uint8_t** count_upper) {
+    if (level == 0) {
+        *count_base = &hnsw.n_base[id];
+        return hnsw.base.data() + (size_t)id * 2 * hnsw.params.m;
+    }
+    *count_upper = &hnsw.nodes[id].n_upper[level - 1];
+    return hnsw.nodes[id].upper.data() + (size_t)(level - 1) * hnsw.params.m;
+}
+
+/**
+ * Number of links of a node on a level
+ */
+static size_t node_degree(uint32_t id, int level) {
+    return level == 0 ? hnsw.n_base[id] : hnsw.nodes[id].n_upper[level - 1];
+}
+
+/**
+ * Similarity of a query to a node
+ */
+static float node_score(const embed_query_t& query, uint32_t id) {
+    float dot;
+    embed_dot_queries(hnsw.type, &query, 1, node_row(id), &dot);
+    return embed_score(hnsw.params.sim, dot, query.norm, hnsw.nodes[id].norm);
+}
+
+/**
+ * Similarity of two nodes
+ */
+static float node_pair_score(uint32_t a, uint32_t b) {
+    float dot = embed_dot_rows(hnsw.type, node_row(a), node_row(b));
+    return embed_score(hnsw.params.sim, dot, hnsw.nodes[a].norm, hnsw.nodes[b].norm);
+}
+
+/**
+ * Best ef nodes on one level reachable from the entry points
+ * @param found In: entry points; out: results, worst-on-top heap
+ */
+static void hnsw_search_level(const embed_query_t& query, size_t ef, int level,
+                              std::vector<scored_t>& found) {
+    if (visited.marks.size() < hnsw.nodes.size()) {
+        visited.marks.resize(hnsw.nodes.size(), 0);
+    }
+    if (++visited.stamp == 0) {
+        std::fill(visited.marks.begin(), visited.marks.end(), 0);
+        visited.stamp = 1;
+    }
+    
+    std::vector<scored_t> frontier(found);
+    std::make_heap(frontier.begin(), frontier.end(), best_on_top);
+    std::make_heap(found.begin(), found.end(), worse_on_top);
+    for (const scored_t& c : found) {
+        visited.marks[c.id] = visited.stamp;
+    }
+    
+    while (!frontier.empty()) {
+        std::pop_heap(frontier.begin(), frontier.end(), best_on_top);
+        scored_t cur = frontier.back();
+        frontier.pop_back();
+        if (found.size() >= ef && cur.score < found.front().score) {
+            break;
+        }
+        
+        uint32_t* count_base = nullptr;
+        uint8_t* count_upper = nullptr;
+        const uint32_t* links = node_links(cur.id, level, &count_base, &count_upper);
+        size_t degree = node_degree(cur.id, level);
+        for (size_t i = 0; i < degree; i++) {
+            uint32_t next = links[i];
+            if (visited.marks[next] == visited.stamp) {
+                continue;
+            }
+            visited.marks[next] = visited.stamp;
+            
+            scored_t c = {node_score(query, next), next};
+            if (found.size() < ef || c.score > found.front().score) {
+                frontier.push_back(c);
+                std::push_heap(frontier.begin(), frontier.end(), best_on_top);
+                embed_offer(found, ef, c);
+            }
+        }
+    }
+}
+
+/**
+ * Pick up to max diverse neighbors: a candidate is kept only if it is
+ * closer to the base than to every neighbor kept so far
+ * @param candidates Scored against the base; replaced by the selection
+ */
+static void hnsw_select(std::vector<scored_t>& candidates, size_t max) {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const scored_t& a, const scored_t& b) { return a.score > b.score; });
+    
+    std::vector<scored_t> kept;
+    for (const scored_t& c : candidates) {
+        if (kept.size() >= max) {
+            break;
+        }
+        bool diverse = true;
+        for (const scored_t& n : kept) {
+            if (node_pair_score(c.id, n.id) > c.score) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            kept.push_back(c);
+        }
+    }
+    candidates.swap(kept);
+}
+
+/**
+ * Set a node's links on a level
+ */
+static void hnsw_set_links(uint32_t id, int level, const std::vector<scored_t>& links) {
+    uint32_t* count_base = nullptr;
+    uint8_t* count_upper = nullptr;
+    uint32_t* out = node_links(id, level, &count_base, &count_upper);
+    for (size_t i = 0; i < links.size(); i++) {
+        out[i] = links[i].id;
+    }
+    if (count_base) {
+        *count_base = (uint32_t)links.size();
+    } else {
+        *count_upper = (uint8_t)links.size();
+    }
+}
+
+/**
+ * Link a node back from a neighbor, pruning the neighbor's list if full
+ */
+static void hnsw_link_back(uint32_t from, uint32_t to, int level) {
+    size_t max = level == 0 ? 2 * hnsw.params.m : hnsw.params.m;
+    uint32_t* count_base = nullptr;
+    uint8_t* count_upper = nullptr;
+    uint32_t* links = node_links(from, level, &count_base, &count_upper);
+    size_t degree = node_degree(from, level);
+    
+    if (degree < max) {
+        links[degree] = to;
+        if (count_base) {
+            (*count_base)++;
+        } else {
+            (*count_upper)++;
+        }
+        return;
+    }
+    
+    std::vector<scored_t> candidates;
+    candidates.reserve(degree + 1);
+    for (size_t i = 0; i < degree; i++) {
+        candidates.push_back(scored_t{node_pair_score(from, links[i]), links[i]});
+    }
+    candidates.push_back(scored_t{node_pair_score(from, to), to});
+    hnsw_select(candidates, max);
+    hnsw_set_links(from, level, candidates);
+}
+
+/**
+ * Insert a matrix row as a new node
+ */
+static void hnsw_insert(uint32_t row) {
+    uint32_t id = (uint32_t)hnsw.nodes.size();
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    int level = (int)(-std::log(1.0 - unit(hnsw.rng)) * hnsw.level_mult);
+    level = std::min(level, HNSW_MAX_LEVEL);
+    
+    hnsw_node_t node = {};
+    node.row = row;
+    node.atom = atomspace_row_atom(row);
+    node.level = level;
+    node.upper.resize((size_t)level * hnsw.params.m);
+    node.norm = atomspace_row_norm(row);
+    hnsw.nodes.push_back(std::move(node));
+    const uint8_t* data = (const uint8_t*)atomspace_row(row);
+    hnsw.vectors.insert(hnsw.vectors.end(), data, data + hnsw.row_bytes);
+    hnsw.base.resize(hnsw.base.size() + 2 * hnsw.params.m);
+    hnsw.n_base.push_back(0);
+    if (row >= hnsw.row_node.size()) {
+        hnsw.row_node.resize(row + 1, NODE_NIL);
+    }
+    hnsw.row_node[row] = id;
+    
+    if (hnsw.entry == NODE_NIL) {
+        hnsw.entry = id;
+        hnsw.max_level = level;
+        return;
+    }
+    
+    /* Requantizing a decoded Q8_0 row reproduces it, so the node scores as itself */
+    float vec[COG_EMBED_DIM];
+    embed_query_t query;
+    embed_load(hnsw.type, node_row(id), vec);
+    embed_prepare(hnsw.type, vec, &query);
+    std::vector<scored_t> found = {{node_score(query, hnsw.entry), hnsw.entry}};
+    
+    /* Greedy descent through the levels above the new node */
+    for (int l = hnsw.max_level; l > level; l--) {
+        hnsw_search_level(query, 1, l, found);
+    }
+    
+    for (int l = std::min(level, hnsw.max_level); l >= 0; l--) {
+        hnsw_search_level(query, hnsw.params.ef_construction, l, found);
+        std::vector<scored_t> neighbors(found);
+        hnsw_select(neighbors, hnsw.params.m);
+        hnsw_set_links(id, l, neighbors);
+        for (const scored_t& n : neighbors) {
+            hnsw_link_back(n.id, id, l);
+        }
+    }
+    
+    if (level > hnsw.max_level) {
+        hnsw.entry = id;
+        hnsw.max_level = level;
+    }
+}
+
+/**
+ * Retire a row's node: it keeps routing searches but is never returned
+ */
+void embed_index_remove(uint32_t row) {
+    if (!hnsw.built || row >= hnsw.row_node.size() || hnsw.row_node[row] == NODE_NIL) {
+        return;
+    }
+    hnsw.nodes[hnsw.row_node[row]].atom = 0;
+    hnsw.row_node[row] = NODE_NIL;
+}
+
+/**
+ * Re-insert a row whose embedding changed
+ */
+void embed_index_update(uint32_t row) {
+    if (!hnsw.built) {
+        return;
+    }
+    embed_index_remove(row);
+    hnsw_insert(row);
+}
+
+/**
+ * Drop the index (the embedding lock is held exclusive)
+ */
+static void hnsw_clear(void) {
+    hnsw.built = false;
+    hnsw.nodes = std::vector<hnsw_node_t>();
+    hnsw.vectors = std::vector<uint8_t>();
+    hnsw.base = std::vector<uint32_t>();
+    hnsw.n_base = std::vector<uint32_t>();
+    hnsw.row_node = std::vector<uint32_t>();
+    hnsw.entry = NODE_NIL;
+}
+
+/**
+ * Build the approximate index over all atoms
+ */
+extern "C" int cog_embed_index_build(const cog_hnsw_params_t* params) {
+    cog_hnsw_params_t p = COG_HNSW_DEFAULT;
+    if (params) {
+        p = *params;
+    }
+    if (p.m < 2 || p.m > 255 || p.ef_construction == 0 || p.ef_search == 0 ||
+        (p.sim != COG_SIM_DOT && p.sim != COG_SIM_COSINE)) {
+        return -1;
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(atomspace_embed_lock());
+    hnsw_clear();
+    hnsw.params = p;
+    hnsw.type = atomspace_embed_type();
+    hnsw.row_bytes = embed_row_bytes(hnsw.type);
+    hnsw.level_mult = 1.0 / std::log((double)p.m);
+    hnsw.entry = NODE_NIL;
+    hnsw.max_level = 0;
+    hnsw.rng.seed(0x5eed);
+    hnsw.built = true;
+    
+    uint32_t n_rows = atomspace_rows();
+    hnsw.nodes.reserve(n_rows);
+    hnsw.vectors.reserve((size_t)n_rows * hnsw.row_bytes);
+    for (uint32_t row = 0; row < n_rows; row++) {
+        if (atomspace_row_atom(row)) {
+            hnsw_insert(row);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Set the search candidate list size
+ */
+extern "C" int cog_embed_index_set_ef(size_t ef_search) {
+    std::unique_lock<std::shared_mutex> lock(atomspace_embed_lock());
+    if (!hnsw.built || ef_search == 0) {
+        return -1;
+    }
+    hnsw.params.ef_search = ef_search;
+    return 0;
+}
+
+/**
+ * Atom of a live index node
+ */
+static atom_handle_t node_atom(uint32_t id) {
+    return hnsw.nodes[id].atom;
+}
+
+/**
+ * Approximate top-k search through the index
+ */
+extern "C" int cog_embed_index_search(const float* queries, size_t n_queries, size_t k,
+                                      atom_handle_t* atoms, float* scores) {
+    std::shared_lock<std::shared_mutex> lock(atomspace_embed_lock());
+    if (!hnsw.built || !queries || !atoms || k == 0) {
+        return -1;
+    }
+    
+    size_t found_min = n_queries > 0 ? k : 0;
+    std::vector<scored_t> found;
+    std::vector<scored_t> best;
+    embed_query_t query;
+    for (size_t q = 0; q < n_queries; q++) {
+        embed_prepare(hnsw.type, queries + q * COG_EMBED_DIM, &query);
+        
+        if (hnsw.entry != NODE_NIL) {
+            found.assign(1, scored_t{node_score(query, hnsw.entry), hnsw.entry});
+            for (int l = hnsw.max_level; l > 0; l--) {
+                hnsw_search_level(query, 1, l, found);
+            }
+            hnsw_search_level(query, std::max(hnsw.params.ef_search, k), 0, found);
+            
+            /* Retired nodes routed the search but are not results */
+            for (const scored_t& c : found) {
+                const hnsw_node_t& node = hnsw.nodes[c.id];
+                if (node.atom && atomspace_row_atom(node.row) == node.atom) {
+                    embed_offer(best, k, c);
+                }
+            }
+        }
+        
+        size_t n = embed_emit(best, k, atoms + q * k, scores ? scores + q * k : nullptr, node_atom);
+        found_min = std::min(found_min, n);
+    }
+    return (int)found_min;
+}
+
+/**
+ * Drop the index
+ */
+extern "C" void cog_embed_index_destroy(void) {
+    std::unique_lock<std::shared_mutex> lock(atomspace_embed_lock());
+    hnsw_clear();
+}
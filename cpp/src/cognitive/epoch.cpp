@@ -0,0 +1,163 @@
+/**
+ * @file epoch.cpp
+ * @brief Epoch-based reclamation for lock-free AtomSpace readers
+ * 
+ * Every AtomSpace call pins the global epoch while it runs. Memory a
+ * writer unlinks is retired with the epoch current at that point and
+ * released once the epoch has advanced twice past it: the epoch advances
+ * only when every pinned thread has seen the current one, so by then no
+ * thread that could still hold a pointer to it is pinned. Readers never
+ * wait; a stalled reader only delays reclamation.
+ * 
+ * Threads get a record on their first pin. Records are never freed; an
+ * exiting thread releases its record for the next new thread.
+ */
+
+#include "cognitive/internal.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#define EPOCH_PINNED 1ull           /* Low bit of a record's state */
+
+/* Per-thread record */
+struct epoch_record_t {
+    alignas(64) std::atomic<uint64_t> state;  /* (epoch << 1) | EPOCH_PINNED, or 0 */
+    std::atomic<bool> used;
+    epoch_record_t* next;
+};
+
+/* Memory waiting for its grace period */
+struct epoch_retired_t {
+    uint64_t epoch;
+    void (*release)(void*);
+    void* arg;
+};
+
+/* Reclamation state */
+struct epoch_state_t {
+    std::atomic<uint64_t> epoch;
+    std::atomic<epoch_record_t*> records;
+    std::mutex lock;                /* Guards limbo */
+    std::deque<epoch_retired_t> limbo;  /* Oldest first */
+    std::atomic<size_t> n_waiting;  /* Retired and not yet released */
+};
+
+/* Never destroyed: threads may still pin and retire while the process exits */
+static epoch_state_t& epochs = *new epoch_state_t();
+
+/* This thread's record and pin depth */
+static thread_local struct epoch_local_t {
+    epoch_record_t* record = nullptr;
+    uint32_t depth = 0;
+    
+    ~epoch_local_t() {
+        if (record) {
+            record->state.store(0, std::memory_order_release);
+            record->used.store(false, std::memory_order_release);
+        }
+    }
+} local;
+
+/**
+ * Claim a free record, or add one
+ */
+static epoch_record_t* epoch_register(void) {
+    for (epoch_record_t* r = epochs.records.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->used.load(std::memory_order_relaxed) &&
+            r->used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return r;
+        }
+    }
+    
+    epoch_record_t* r = new epoch_record_t();
+    r->used.store(true, std::memory_order_relaxed);
+    r->next = epochs.records.load(std::memory_order_relaxed);
+    while (!epochs.records.compare_exchange_weak(r->next, r, std::memory_order_release,
+                                                 std::memory_order_relaxed)) {
+    }
+    return r;
+}
+
+/**
+ * Pin the current epoch (nests)
+ */
+void epoch_enter(void) {
+    if (local.depth++ > 0) {
+        return;
+    }
+    if (!local.record) {
+        local.record = epoch_register();
+    }
+    
+    /* A full barrier: nothing this thread reads next is read before the pin is seen */
+    uint64_t epoch = epochs.epoch.load(std::memory_order_relaxed);
+    local.record->state.exchange((epoch << 1) | EPOCH_PINNED, std::memory_order_seq_cst);
+}
+
+/**
+ * Unpin
+ */
+void epoch_exit(void) {
+    if (--local.depth == 0) {
+        local.record->state.store(0, std::memory_order_release);
+    }
+}
+
+/**
+ * Advance the epoch if every pinned thread has seen it
+ */
+static void epoch_advance(void) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t epoch = epochs.epoch.load(std::memory_order_relaxed);
+    for (epoch_record_t* r = epochs.records.load(std::memory_order_acquire); r; r = r->next) {
+        uint64_t state = r->state.load(std::memory_order_acquire);
+        if ((state & EPOCH_PINNED) && (state >> 1) != epoch) {
+            return;
+        }
+    }
+    epochs.epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_release,
+                                         std::memory_order_relaxed);
+}
+
+/**
+ * Release memory after the grace period
+ */
+void epoch_retire(void (*release)(void*), void* arg) {
+    std::lock_guard<std::mutex> lock(epochs.lock);
+    epochs.limbo.push_back(epoch_retired_t{epochs.epoch.load(std::memory_order_relaxed),
+                                           release, arg});
+    epochs.n_waiting.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Try to advance the epoch and release what has outlived its readers
+ */
+size_t epoch_collect(void) {
+    size_t waiting = epochs.n_waiting.load(std::memory_order_acquire);
+    if (waiting == 0) {
+        return 0;
+    }
+    
+    epoch_advance();
+    epoch_advance();
+    
+    std::vector<epoch_retired_t> ripe;
+    {
+        std::lock_guard<std::mutex> lock(epochs.lock);
+        uint64_t epoch = epochs.epoch.load(std::memory_order_acquire);
+        while (!epochs.limbo.empty() && epochs.limbo.front().epoch + 2 <= epoch) {
+            ripe.push_back(epochs.limbo.front());
+            epochs.limbo.pop_front();
+        }
+    }
+    
+    /* Outside the lock: releasing may retire more */
+    for (const epoch_retired_t& r : ripe) {
+        r.release(r.arg);
+    }
+    epochs.n_waiting.fetch_sub(ripe.size(), std::memory_order_release);
+    return waiting;
+}
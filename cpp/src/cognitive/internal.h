@@ -0,0 +1,157 @@
+/**
+ * @file internal.h
+ * @brief Cognitive-private interfaces shared between cognitive translation units
+ */
+
+#ifndef AICHAT_COGNITIVE_INTERNAL_H
+#define AICHAT_COGNITIVE_INTERNAL_H
+
+#include "aichat/cognitive.h"
+#include <shared_mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Epoch-based reclamation (epoch.cpp) */
+
+/**
+ * Pin the current epoch: memory retired from now on outlives this pin
+ * 
+ * Pins nest; only the outermost exit unpins.
+ */
+void epoch_enter(void);
+
+/**
+ * Unpin
+ */
+void epoch_exit(void);
+
+/**
+ * Call release(arg) once no thread pinned now is still pinned
+ */
+void epoch_retire(void (*release)(void*), void* arg);
+
+/**
+ * Advance the epoch if possible and run the releases that are due
+ * 
+ * Best called unpinned: a pinned caller holds the epoch back itself.
+ * 
+ * @return Number of releases that were waiting (0 if there was nothing to do)
+ */
+size_t epoch_collect(void);
+
+/** Pin for a scope */
+struct epoch_guard_t {
+    epoch_guard_t() { epoch_enter(); }
+    ~epoch_guard_t() { epoch_exit(); }
+    epoch_guard_t(const epoch_guard_t&) = delete;
+    epoch_guard_t& operator=(const epoch_guard_t&) = delete;
+};
+
+/* Bulk insertion (atomspace.cpp) */
+
+/** Name id of no interned name */
+#define NAME_NIL UINT32_MAX
+
+/** Atom of a batch */
+struct atom_spec_t {
+    atom_type_t type;
+    const char* str;                /* Name, not NUL-terminated; NULL for no name */
+    size_t len;
+    size_t hash;                    /* atomspace_name_hash(str, len) */
+    uint32_t name_id;               /* Interned name id if known, else NAME_NIL */
+};
+
+/**
+ * Hash a name as the name index does (thread-safe)
+ */
+size_t atomspace_name_hash(const char* str, size_t len);
+
+/**
+ * Find an interned name without changing the index (thread-safe)
+ * 
+ * @return Name id, or NAME_NIL
+ */
+uint32_t atomspace_name_find(const char* str, size_t len, size_t hash);
+
+/**
+ * Allocate a batch of atoms, or none of them
+ * 
+ * Each shard's name index grows at most once. Named atoms that exist, or appear
+ * earlier in the batch, are returned instead of allocated.
+ * 
+ * @param specs Atoms
+ * @param n Number of atoms
+ * @param atoms Output atom handles
+ * @return 0 on success, negative if the atoms do not fit
+ */
+int atomspace_alloc_batch(const atom_spec_t* specs, size_t n, atom_handle_t* atoms);
+
+/* Embedding matrix (atomspace.cpp) */
+
+/**
+ * Lock of the embedding matrix: hold it shared to read rows, exclusive to change them
+ * 
+ * Row changes call embed_index_update() and embed_index_remove() with it held exclusive.
+ */
+std::shared_mutex& atomspace_embed_lock(void);
+
+/**
+ * Element type of the embedding matrix
+ */
+cog_embed_type_t atomspace_embed_type(void);
+
+/**
+ * Number of matrix rows ever used (rows past this belong to no atom)
+ */
+uint32_t atomspace_rows(void);
+
+/**
+ * Atom stored in a matrix row
+ * @return Atom handle, or 0 if the row is free
+ */
+atom_handle_t atomspace_row_atom(uint32_t row);
+
+/**
+ * Embedding in a matrix row, in the matrix element type
+ */
+const void* atomspace_row(uint32_t row);
+
+/**
+ * Euclidean norm of the embedding in a matrix row (kept on update)
+ */
+float atomspace_row_norm(uint32_t row);
+
+/* Row encoding and search (embedding.cpp) */
+
+/**
+ * Bytes in one embedding row
+ * @return Row size, or 0 for an unknown type
+ */
+size_t embed_row_bytes(cog_embed_type_t type);
+
+/**
+ * Encode COG_EMBED_DIM floats as a row
+ */
+void embed_store(cog_embed_type_t type, const float* vec, void* row);
+
+/**
+ * Decode a row to COG_EMBED_DIM floats
+ */
+void embed_load(cog_embed_type_t type, const void* row, float* vec);
+
+/**
+ * Euclidean norm of a row's stored values
+ */
+float embed_row_norm(cog_embed_type_t type, const void* row);
+
+/**
+ * Add or refresh a row in the index, if built
+ */
+void embed_index_update(uint32_t row);
+
+/**
+ * Drop a row from the index, if built
+ */
+void embed_index_remove(uint32_t row);
+
+#endif /* AICHAT_COGNITIVE_INTERNAL_H */
@@ -0,0 +1,622 @@
+/**
+ * @file loader.cpp
+ * @brief AtomSpace bulk import from JSONL and s-expression files
+ * 
+ * The file is memory-mapped and cut into chunks at line boundaries.
+ * Worker threads parse chunks into a list of nodes and a postfix program
+ * that builds each line's links from them; workers also hash every name
+ * and look it up in the name index, which readers share without locks.
+ * Chunks are then inserted in file order: a chunk's nodes are
+ * allocated in one batch, and the program is run on a stack of handles.
+ */
+
+#include "aichat/cognitive.h"
+#include "cognitive/internal.h"
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define LOAD_CHUNK_MIN (1 << 20)    /* Smallest chunk in bytes */
+#define LOAD_CHUNKS_PER_THREAD 4    /* Chunks per worker, so workers finish together */
+#define LOAD_MAX_DEPTH 64           /* Expression nesting limit */
+#define LOAD_NAMES_MIN 256          /* Initial buckets of a chunk's name table */
+
+/* Program step */
+enum load_op_kind_t : uint32_t {
+    LOAD_NODE,                      /* Push a node of the chunk */
+    LOAD_LINK,                      /* Replace the top arity handles by their link */
+    LOAD_END,                       /* End of a line's expression */
+};
+
+struct load_op_t {
+    load_op_kind_t kind;
+    atom_type_t type;               /* LOAD_LINK */
+    uint32_t arg;                   /* Node index (LOAD_NODE) or arity (LOAD_LINK) */
+};
+
+/* Chunk of the file and its parse */
+struct load_chunk_t {
+    const char* begin;
+    const char* end;
+    std::vector<atom_spec_t> nodes;
+    std::vector<load_op_t> ops;
+    std::deque<std::string> names;  /* Names that had escapes */
+    std::vector<uint32_t> named;    /* Open addressing: named node index + 1, or 0 */
+    size_t n_named;
+    size_t n_exprs;
+    bool failed;
+};
+
+/* Cursor over one line */
+struct load_cursor_t {
+    const char* p;
+    const char* end;
+    load_chunk_t* chunk;
+};
+
+/**
+ * Skip blanks
+ */
+static void skip_space(load_cursor_t* c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r')) {
+        c->p++;
+    }
+}
+
+/**
+ * Consume a character after blanks
+ */
+static bool expect(load_cursor_t* c, char ch) {
+    skip_space(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Atom type by name (case-insensitive)
+ * @return false if the name is not a type
+ */
+static bool parse_type(const char* str, size_t len, atom_type_t* type) {
+    static const struct {
+        const char* name;
+        size_t len;
+        atom_type_t type;
+    } types[] = {
+        {"link", 4, ATOM_LINK},
+        {"concept", 7, ATOM_CONCEPT},
+        {"node", 4, ATOM_NODE},
+        {"predicate", 9, ATOM_PREDICATE},
+    };
+    
+    /* The names are lowercase letters, so setting bit 5 folds case */
+    for (const auto& t : types) {
+        if (t.len != len) {
+            continue;
+        }
+        size_t i = 0;
+        while (i < len && (str[i] | 0x20) == t.name[i]) {
+            i++;
+        }
+        if (i == len) {
+            *type = t.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Append a code point as UTF-8
+ */
+static void append_utf8(std::string* out, uint32_t cp) {
+    if (cp < 0x80) {
+        out->push_back((char)cp);
+    } else if (cp < 0x800) {
+        out->push_back((char)(0xc0 | (cp >> 6)));
+        out->push_back((char)(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out->push_back((char)(0xe0 | (cp >> 12)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out->push_back((char)(0x80 | (cp & 0x3f)));
+    } else {
+        out->push_back((char)(0xf0 | (cp >> 18)));
+        out->push_back((char)(0x80 | ((cp >> 12) & 0x3f)));
+        out->push_back((char)(0x80 | ((cp >> 6) & 0x3f)));
+        out->push_back((char)(0x80 | (cp & 0x3f)));
+    }
+}
+
+/**
+ * Four hex digits of a \u escape
+ */
+static bool parse_hex4(const char* p, const char* end, uint32_t* value) {
+    if (end - p < 4) {
+        return false;
+    }
+    
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        char ch = p[i];
+        uint32_t digit;
+        if (ch >= '0' && ch <= '9') {
+            digit = (uint32_t)(ch - '0');
+        } else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f') {
+            digit = (uint32_t)((ch | 0x20) - 'a' + 10);
+        } else {
+            return false;
+        }
+        *value = *value << 4 | digit;
+    }
+    return true;
+}
+
+/**
+ * Parse a quoted string (JSON escapes; s-expressions use the same quoting)
+ * 
+ * Strings without escapes point into the file; others are unescaped into
+ * the chunk.
+ */
+static bool parse_string(load_cursor_t* c, const char** str, size_t* len) {
+    if (!expect(c, '"')) {
+        return false;
+    }
+    
+    const char* start = c->p;
+    while (c->p < c->end && *c->p != '"' && *c->p != '\\') {
+        c->p++;
+    }
+    if (c->p < c->end && *c->p == '"') {
+        *str = start;
+        *len = (size_t)(c->p - start);
+        c->p++;
+        return true;
+    }
+    
+    std::string out(start, (size_t)(c->p - start));
+    while (c->p < c->end && *c->p != '"') {
+        if (*c->p != '\\') {
+            out.push_back(*c->p++);
+            continue;
+        }
+        
+        if (++c->p == c->end) {
+            return false;
+        }
+        char esc = *c->p++;
+        switch (esc) {
+        case '"': case '\\': case '/': out.push_back(esc); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+            uint32_t cp;
+            if (!parse_hex4(c->p, c->end, &cp)) {
+                return false;
+            }
+            c->p += 4;
+            
+            /* A high surrogate must be followed by the low half of the pair */
+            if (cp >= 0xd800 && cp < 0xdc00) {
+                uint32_t low;
+                if (c->end - c->p < 6 || c->p[0] != '\\' || c->p[1] != 'u' ||
+                    !parse_hex4(c->p + 2, c->end, &low) || low < 0xdc00 || low >= 0xe000) {
+                    return false;
+                }
+                c->p += 6;
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            } else if (cp >= 0xdc00 && cp < 0xe000) {
+                return false;
+            }
+            append_utf8(&out, cp);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    if (c->p == c->end) {
+        return false;
+    }
+    c->p++;
+    
+    c->chunk->names.push_back(std::move(out));
+    *str = c->chunk->names.back().data();
+    *len = c->chunk->names.back().size();
+    return true;
+}
+
+/**
+ * Re-insert a chunk's named nodes into a name table of cap buckets
+ */
+static void names_rehash(load_chunk_t* chunk, size_t cap) {
+    chunk->named.assign(cap, 0);
+    for (uint32_t i = 0; i < chunk->nodes.size(); i++) {
+        if (!chunk->nodes[i].str) {
+            continue;
+        }
+        size_t b = chunk->nodes[i].hash & (cap - 1);
+        while (chunk->named[b]) {
+            b = (b + 1) & (cap - 1);
+        }
+        chunk->named[b] = i + 1;
+    }
+}
+
+/**
+ * Add a node to the chunk, hashing and resolving its name
+ * 
+ * A name repeated in the chunk refers back to its first node, so the
+ * insert phase sees each name of a chunk once.
+ */
+static void emit_node(load_chunk_t* chunk, atom_type_t type, const char* str, size_t len) {
+    atom_spec_t spec = {type, str, len, 0, NAME_NIL};
+    if (!str) {
+        chunk->ops.push_back(load_op_t{LOAD_NODE, type, (uint32_t)chunk->nodes.size()});
+        chunk->nodes.push_back(spec);
+        return;
+    }
+    
+    spec.hash = atomspace_name_hash(str, len);
+    if ((chunk->n_named + 1) * 2 > chunk->named.size()) {
+        names_rehash(chunk, chunk->named.empty() ? LOAD_NAMES_MIN : chunk->named.size() * 2);
+    }
+    
+    size_t mask = chunk->named.size() - 1;
+    size_t b = spec.hash & mask;
+    for (; chunk->named[b]; b = (b + 1) & mask) {
+        uint32_t i = chunk->named[b] - 1;
+        const atom_spec_t& node = chunk->nodes[i];
+        if (node.hash == spec.hash && node.len == len && memcmp(node.str, str, len) == 0) {
+            chunk->ops.push_back(load_op_t{LOAD_NODE, type, i});
+            return;
+        }
+    }
+    
+    spec.name_id = atomspace_name_find(str, len, spec.hash);
+    chunk->named[b] = (uint32_t)chunk->nodes.size() + 1;
+    chunk->n_named++;
+    chunk->ops.push_back(load_op_t{LOAD_NODE, type, (uint32_t)chunk->nodes.size()});
+    chunk->nodes.push_back(spec);
+}
+
+/**
+ * Add a link over the last arity atoms to the chunk
+ */
+static void emit_link(load_chunk_t* chunk, atom_type_t type, uint32_t arity) {
+    chunk->ops.push_back(load_op_t{LOAD_LINK, type, arity});
+}
+
+/**
+ * Parse an s-expression: (type "name") or (type child...)
+ */
+static bool parse_sexpr(load_cursor_t* c, int depth) {
+    if (depth > LOAD_MAX_DEPTH || !expect(c, '(')) {
+        return false;
+    }
+    
+    skip_space(c);
+    const char* word = c->p;
+    while (c->p < c->end && *c->p != ' ' && *c->p != '\t' && *c->p != '\r' &&
+           *c->p != '(' && *c->p != ')' && *c->p != '"') {
+        c->p++;
+    }
+    atom_type_t type;
+    if (!parse_type(word, (size_t)(c->p - word), &type)) {
+        return false;
+    }
+    
+    skip_space(c);
+    if (c->p < c->end && *c->p == '"') {
+        const char* name;
+        size_t len;
+        if (!parse_string(c, &name, &len) || !expect(c, ')')) {
+            return false;
+        }
+        emit_node(c->chunk, type, name, len);
+        return true;
+    }
+    
+    uint32_t arity = 0;
+    while (skip_space(c), c->p < c->end && *c->p == '(') {
+        if (!parse_sexpr(c, depth + 1)) {
+            return false;
+        }
+        arity++;
+    }
+    if (!expect(c, ')')) {
+        return false;
+    }
+    
+    /* Neither name nor outgoing atoms: an unnamed node */
+    if (arity == 0) {
+        emit_node(c->chunk, type, nullptr, 0);
+    } else {
+        emit_link(c->chunk, type, arity);
+    }
+    return true;
+}
+
+/**
+ * Skip a JSON value this format does not use
+ */
+static bool skip_json(load_cursor_t* c, int depth) {
+    skip_space(c);
+    if (depth > LOAD_MAX_DEPTH || c->p == c->end) {
+        return false;
+    }
+    
+    const char* str;
+    size_t len;
+    switch (*c->p) {
+    case '"':
+        return parse_string(c, &str, &len);
+    case '{':
+    case '[': {
+        char close = *c->p == '{' ? '}' : ']';
+        c->p++;
+        if (expect(c, close)) {
+            return true;
+        }
+        do {
+            if (close == '}' && (!parse_string(c, &str, &len) || !expect(c, ':'))) {
+                return false;
+            }
+            if (!skip_json(c, depth + 1)) {
+                return false;
+            }
+        } while (expect(c, ','));
+        return expect(c, close);
+    }
+    default: {
+        /* Number, true, false or null */
+        const char* start = c->p;
+        while (c->p < c->end && *c->p != ',' && *c->p != '}' && *c->p != ']' &&
+               *c->p != ' ' && *c->p != '\t' && *c->p != '\r') {
+            c->p++;
+        }
+        return c->p > start;
+    }
+    }
+}
+
+/**
+ * Parse a JSON atom: {"type": ..., "name": ...} or {"type": ..., "outgoing": [...]}
+ */
+static bool parse_json(load_cursor_t* c, int depth) {
+    if (depth > LOAD_MAX_DEPTH || !expect(c, '{')) {
+        return false;
+    }
+    
+    bool has_type = false;
+    atom_type_t type = ATOM_NODE;
+    const char* name = nullptr;
+    size_t name_len = 0;
+    bool has_outgoing = false;
+    uint32_t arity = 0;
+    
+    if (!expect(c, '}')) {
+        do {
+            const char* key;
+            size_t key_len;
+            if (!parse_string(c, &key, &key_len) || !expect(c, ':')) {
+                return false;
+            }
+            std::string_view k(key, key_len);
+            
+            if (k == "type") {
+                const char* str;
+                size_t len;
+                if (!parse_string(c, &str, &len) || !parse_type(str, len, &type)) {
+                    return false;
+                }
+                has_type = true;
+            } else if (k == "name") {
+                if (!parse_string(c, &name, &name_len)) {
+                    return false;
+                }
+            } else if (k == "outgoing") {
+                /* Children are emitted as they are read; the link follows them */
+                if (has_outgoing || !expect(c, '[')) {
+                    return false;
+                }
+                has_outgoing = true;
+                if (!expect(c, ']')) {
+                    do {
+                        if (!parse_json(c, depth + 1)) {
+                            return false;
+                        }
+                        arity++;
+                    } while (expect(c, ','));
+                    if (!expect(c, ']')) {
+                        return false;
+                    }
+                }
+            } else if (!skip_json(c, depth + 1)) {
+                return false;
+            }
+        } while (expect(c, ','));
+        
+        if (!expect(c, '}')) {
+            return false;
+        }
+    }
+    
+    if (!has_type || (name && arity > 0)) {
+        return false;
+    }
+    if (arity > 0) {
+        emit_link(c->chunk, type, arity);
+    } else {
+        emit_node(c->chunk, type, name, name_len);
+    }
+    return true;
+}
+
+/**
+ * Parse every line of a chunk (stops at the first bad line)
+ */
+static void parse_chunk(load_chunk_t* chunk) {
+    const char* line = chunk->begin;
+    while (line < chunk->end) {
+        const char* eol = (const char*)memchr(line, '\n', (size_t)(chunk->end - line));
+        if (!eol) {
+            eol = chunk->end;
+        }
+        
+        load_cursor_t c = {line, eol, chunk};
+        line = eol + 1;
+        
+        skip_space(&c);
+        if (c.p == c.end || *c.p == '#' || *c.p == ';') {
+            continue;
+        }
+        
+        bool ok = *c.p == '{' ? parse_json(&c, 0) : parse_sexpr(&c, 0);
+        skip_space(&c);
+        if (!ok || c.p != c.end) {
+            chunk->failed = true;
+            return;
+        }
+        chunk->ops.push_back(load_op_t{LOAD_END, ATOM_NODE, 0});
+        chunk->n_exprs++;
+    }
+}
+
+/**
+ * Insert a parsed chunk
+ * @return 0 on success, negative if it does not fit
+ */
+static int insert_chunk(const load_chunk_t* chunk, std::vector<atom_handle_t>* stack) {
+    std::vector<atom_handle_t> nodes(chunk->nodes.size());
+    if (atomspace_alloc_batch(chunk->nodes.data(), chunk->nodes.size(), nodes.data()) != 0) {
+        return -1;
+    }
+    
+    stack->clear();
+    for (const load_op_t& op : chunk->ops) {
+        switch (op.kind) {
+        case LOAD_NODE:
+            stack->push_back(nodes[op.arg]);
+            break;
+        case LOAD_LINK: {
+            atom_handle_t* outgoing = stack->data() + stack->size() - op.arg;
+            atom_handle_t link = cog_link_create(op.type, outgoing, op.arg);
+            if (link == 0) {
+                return -1;
+            }
+            stack->resize(stack->size() - op.arg);
+            stack->push_back(link);
+            break;
+        }
+        case LOAD_END:
+            stack->clear();
+            break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Load atoms and links from a file
+ */
+extern "C" int64_t atomspace_load(const char* path) {
+    if (!path) {
+        return -1;
+    }
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+    
+    /* Cut at line boundaries into enough chunks to keep every worker busy */
+    unsigned n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) {
+        n_threads = 1;
+    }
+    size_t target = size / ((size_t)n_threads * LOAD_CHUNKS_PER_THREAD);
+    if (target < LOAD_CHUNK_MIN) {
+        target = LOAD_CHUNK_MIN;
+    }
+    
+    const char* data = (const char*)map;
+    const char* end = data + size;
+    std::deque<load_chunk_t> chunks;
+    for (const char* p = data; p < end;) {
+        const char* cut = (size_t)(end - p) > target ? p + target : end;
+        const char* eol = cut < end ? (const char*)memchr(cut, '\n', (size_t)(end - cut)) : nullptr;
+        cut = eol ? eol + 1 : end;
+        
+        load_chunk_t chunk = {};
+        chunk.begin = p;
+        chunk.end = cut;
+        chunks.push_back(std::move(chunk));
+        p = cut;
+    }
+    
+    /* Parse in parallel; the AtomSpace is only read until every worker is done */
+    std::atomic<size_t> next{0};
+    auto worker = [&chunks, &next] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < chunks.size();) {
+            parse_chunk(&chunks[i]);
+        }
+    };
+    
+    if (n_threads > chunks.size()) {
+        n_threads = (unsigned)chunks.size();
+    }
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < n_threads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    
+    int64_t loaded = 0;
+    bool failed = false;
+    for (const load_chunk_t& chunk : chunks) {
+        failed |= chunk.failed;
+    }
+    
+    std::vector<atom_handle_t> stack;
+    for (size_t i = 0; i < chunks.size() && !failed; i++) {
+        failed = insert_chunk(&chunks[i], &stack) != 0;
+        loaded += failed ? 0 : (int64_t)chunks[i].n_exprs;
+    }
+    
+    munmap(map, size);
+    return failed ? -1 : loaded;
+}
@@ -4,15 +4,19 @@
  * 
  * Implements Echo.Kern bootstrap sequence:
  * - Stage 0: Hardware/tensor initialization
- * - Stage 1: Hypergraph filesystem setup
+ * - Stage 1: Hypergraph filesystem setup (AICHAT_HGFS_PATH: mapped, log replayed)
  * - Stage 2: Scheduler initialization
- * - Stage 3: Cognitive components
+ * - Stage 3: Cognitive components (AICHAT_EMBED_TYPE: f32, f16 or q8_0;
+ *   AICHAT_ATOMSPACE_PATH: atoms loaded)
  */
 
 #include "aichat/kernel.h"
+#include "aichat/cognitive.h"
 #include <ggml.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 /* Global GGML context */
 static struct ggml_context* g_ggml_ctx = NULL;
@@ -20,6 +24,9 @@ static struct ggml_context* g_ggml_ctx = NULL;
 /* Bootstrap state */
 static bootstrap_stage_t g_current_stage = STAGE0_INIT;
 
+/* How often the checkpoint policy is polled */
+#define HGFS_CHECKPOINT_POLL_US (1000 * 1000)
+
 /**
  * Stage 0: Initialize hardware and tensor context
  */
@@ -54,10 +61,44 @@ static int bootstrap_stage1(void) {
         return -1;
     }
     
-    printf("[STAGE1] Hypergraph filesystem initialized\n");
+    const char* path = getenv("AICHAT_HGFS_PATH");
+    if (!path) {
+        printf("[STAGE1] Hypergraph filesystem initialized\n");
+        return 0;
+    }
+    
+    /* Map the last checkpoint instead of rebuilding it, then replay the log */
+    if (access(path, F_OK) == 0 && hgfs_open(path) != 0) {
+        fprintf(stderr, "Failed to open hypergraph file %s\n", path);
+        return -1;
+    }
+    if (hgfs_wal_start(path, NULL) != 0) {
+        fprintf(stderr, "Failed to recover hypergraph log %s.wal\n", path);
+        return -1;
+    }
+    
+    hgfs_stats_t stats;
+    hgfs_wal_stats_t wal;
+    hgfs_stats(&stats);
+    hgfs_wal_stats(&wal);
+    printf("[STAGE1] Hypergraph filesystem recovered from %s "
+           "(%zu nodes, %zu edges, %llu log records)\n",
+           path, stats.nodes, stats.edges, (unsigned long long)(wal.lsn - wal.checkpoint_lsn));
     return 0;
 }
 
+/**
+ * Checkpoint the hypergraph once its log is large or old enough
+ */
+static void hgfs_checkpoint_tick(void* data) {
+    (void)data;
+    
+    hgfs_wal_stats_t stats;
+    if (hgfs_wal_stats(&stats) == 0 && stats.checkpoint_due && hgfs_checkpoint() != 0) {
+        fprintf(stderr, "Hypergraph checkpoint failed\n");
+    }
+}
+
 /**
  * Stage 2: Initialize scheduler
  */
@@ -67,6 +108,14 @@ static int bootstrap_stage2(void) {
         return -1;
     }
     
+    hgfs_wal_stats_t stats;
+    if (hgfs_wal_stats(&stats) == 0 &&
+        dtesn_sched_every(hgfs_checkpoint_tick, NULL, PRIORITY_LOW, 0,
+                          HGFS_CHECKPOINT_POLL_US) == 0) {
+        fprintf(stderr, "Failed to schedule hypergraph checkpoints\n");
+        return -1;
+    }
+    
     printf("[STAGE2] Scheduler initialized (target: %d µs/tick)\n", SCHED_TICK_TARGET_US);
     return 0;
 }
@@ -80,12 +129,33 @@ static int bootstrap_stage3(void) {
         return -1;
     }
     
-    /* Initialize AtomSpace */
-    if (atomspace_init(g_ggml_ctx) != 0) {
+    /* Initialize AtomSpace, with embeddings stored as configured */
+    cog_embed_type_t embed_type = COG_EMBED_F32;
+    const char* type = getenv("AICHAT_EMBED_TYPE");
+    if (type && strcmp(type, "f16") == 0) {
+        embed_type = COG_EMBED_F16;
+    } else if (type && strcmp(type, "q8_0") == 0) {
+        embed_type = COG_EMBED_Q8_0;
+    } else if (type && strcmp(type, "f32") != 0) {
+        fprintf(stderr, "Unknown embedding type %s\n", type);
+        return -1;
+    }
+    
+    if (atomspace_init(g_ggml_ctx, embed_type) != 0) {
         fprintf(stderr, "Failed to initialize AtomSpace\n");
         return -1;
     }
     
+    const char* atoms = getenv("AICHAT_ATOMSPACE_PATH");
+    if (atoms) {
+        int64_t loaded = atomspace_load(atoms);
+        if (loaded < 0) {
+            fprintf(stderr, "Failed to load atoms from %s\n", atoms);
+            return -1;
+        }
+        printf("[STAGE3] Loaded %lld atom expressions from %s\n", (long long)loaded, atoms);
+    }
+    
     /* Initialize ECAN */
     if (ecan_init(g_ggml_ctx) != 0) {
         fprintf(stderr, "Failed to initialize ECAN\n");
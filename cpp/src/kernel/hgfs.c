@@ -3,170 +3,2998 @@
  * @brief Hypergraph Filesystem - GGML tensor-based hypergraph
  * 
  * Implements hypergraph filesystem using GGML tensors as nodes.
+ * 
+ * Node payloads come from one pool per membrane depth: a chunked arena
+ * (tensor headers live apart, in no_alloc contexts) so same-depth
+ * payloads sit together, with deleted nodes' tensors kept on per-pool
+ * free lists by size class. Each pool also keeps its members' handles,
+ * payload pointers and sizes as parallel arrays for depth sweeps.
+ * 
+ * Nodes and edges live in chunked slabs that grow on demand. Chunks
+ * never move, so deleted slots are reused in place and only
+ * hgfs_compact relocates items. Handles are (generation << 32) | (id + 1)
+ * and resolve through a dense id -> slot table: deleting an item bumps
+ * its generation so stale handles fail, and compaction updates the table
+ * so handles survive relocation.
+ * 
+ * Adjacency is kept per direction as CSR (edge slots grouped by node
+ * slot) plus a delta log: edges inserted since the last build are
+ * chained per node. Deleted CSR entries become tombstones. Queries read
+ * both; the CSR is rebuilt lazily by the next query once the delta log
+ * and tombstones outgrow a fraction of the graph.
+ * 
+ * hgfs_save writes the graph as a versioned little-endian file with
+ * page-aligned sections: header, node records, edge records, handle
+ * generations and tensor payloads. hgfs_open maps it privately and reads
+ * only the records; node tensors point straight into the mapping, so
+ * payloads page in on first touch and writes stay in memory.
+ * 
+ * Adjacency matrix exports (hgfs_matrix_create) number the nodes of a
+ * depth range as rows in slot order, appending new nodes, map handle ids
+ * to rows and keep CSR tensors in their own ggml context. Mutations
+ * patch existing entries (and the dense tensor) in place and queue new
+ * entries, which hgfs_matrix_sync merges into the CSR in one backward
+ * pass; rows are renumbered from the graph only once deleted nodes and
+ * edges make up a large part of the matrix.
+ * 
+ * With hgfs_wal_start, every mutation is also appended to a write-ahead
+ * log (wal.c) carrying the handles it produced, so replay over the last
+ * checkpoint recreates the same handles. hgfs_checkpoint saves the file
+ * with the last LSN it contains and empties the log.
  */
 
 #include "aichat/kernel.h"
+#include "kernel/internal.h"
 #include <ggml.h>
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Slab storage */
+#define SLAB_CHUNK_BITS 12
+#define SLAB_CHUNK (1u << SLAB_CHUNK_BITS)
+#define SLOT_NIL UINT32_MAX
+
+/* Data pointer index: open addressing at load factor <= 0.5 */
+#define PTR_TABLE_MIN 1024
+#define PTR_EMPTY UINT32_MAX
 
-#define MAX_NODES 4096
-#define MAX_EDGES 16384
+/* Adjacency */
+#define ADJ_NIL UINT32_MAX
+#define ADJ_DELTA_MIN 256           /* Delta edges + tombstones tolerated before a rebuild */
+#define ADJ_DIRS 2                  /* 0 = out (by src), 1 = in (by dst) */
+
+/* Depth pools */
+#define POOL_NIL UINT32_MAX
+#define POOL_ALIGN 16u              /* Payload alignment (GGML_MEM_ALIGN) */
+#define POOL_CHUNK_MIN 4096u        /* First arena chunk of a depth; chunks double */
+#define POOL_CHUNK_MAX (1u << 20)
+#define POOL_CLASSES 32             /* Released tensors by floor(log2(elements)) */
+#define POOL_HEADERS 1024u          /* Tensor headers per header context */
+
+/* Adjacency matrix exports */
+#define MATRIX_NIL UINT32_MAX
+#define MATRIX_CSR_MIN 64           /* Smallest CSR capacity */
+
+/* File format */
+#define HGFS_FILE_MAGIC 0x53464748u /* "HGFS" */
+#define HGFS_FILE_VERSION 2u          /* 2: header records the checkpoint LSN */
+#define HGFS_FILE_ALIGN 4096u       /* Section alignment */
+#define HGFS_DATA_ALIGN 64u         /* Payload alignment */
+#define HGFS_FILE_MAX_IDS (1u << 31)
+
+/* Records are stored in host order, so files are usable on little-endian hosts only */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HGFS_FILE_NATIVE 0
+#else
+#define HGFS_FILE_NATIVE 1
+#endif
+
+/* Slab item header (first member of nodes and edges) */
+typedef struct {
+    uint32_t id;                    /* Handle id */
+    bool active;
+} hg_item_t;
 
 /* Hypergraph node */
 typedef struct {
-    struct ggml_tensor* tensor;
+    hg_item_t item;
+    struct ggml_tensor* tensor;     /* Payload in the depth pool */
     uint32_t depth;
-    uint64_t handle;
-    bool active;
+    uint32_t pool_pos;              /* Index in the depth pool's member arrays */
+    uint32_t head[ADJ_DIRS];        /* Delta log: newest edge per direction */
+    uint32_t mark;                  /* hgfs_neighbors dedup stamp */
 } hg_node_t;
 
 /* Hypergraph edge */
 typedef struct {
-    uint64_t src_handle;
-    uint64_t dst_handle;
+    hg_item_t item;
+    uint32_t node[ADJ_DIRS];        /* Source and destination node slots */
+    uint32_t next[ADJ_DIRS];        /* Delta log chain per direction */
     float weight;
-    uint64_t handle;
-    bool active;
+    bool in_csr;                    /* Indexed by the CSR, else by the delta log */
 } hg_edge_t;
 
+/* Chunked slab with generation-tagged handles */
+typedef struct {
+    size_t item_size;
+    uint8_t** chunks;
+    uint32_t n_chunks;
+    uint32_t high;                  /* Slots [0, high) have been handed out */
+    uint32_t live;
+    uint32_t* free_slots;           /* Free slots below high */
+    uint32_t n_free;
+    uint32_t* id_slot;              /* Handle id -> slot */
+    uint32_t* id_gen;               /* Handle id -> generation */
+    uint32_t* free_ids;
+    uint32_t n_free_ids;
+    uint32_t n_ids;                 /* Ids handed out */
+    uint32_t id_cap;
+    bool replay;                    /* Log replay assigns ids; free ids are rebuilt after */
+} hg_slab_t;
+
+/* Per-depth node pool */
+typedef struct {
+    uint32_t depth;
+    
+    /* Members as parallel arrays, indexed by hg_node_t.pool_pos */
+    uint64_t* handles;
+    void** data;
+    size_t* sizes;
+    uint32_t* slots;
+    uint32_t count;
+    uint32_t cap;
+    
+    /* Payload arena; chunks never move */
+    uint8_t** chunks;
+    uint32_t n_chunks;
+    size_t chunk_size;              /* Size of the newest chunk */
+    size_t chunk_used;
+    size_t bytes;                   /* Arena bytes reserved */
+    struct ggml_tensor* free[POOL_CLASSES];     /* Released tensors, linked through payloads */
+} hg_pool_t;
+
+/* CSR for one direction */
+typedef struct {
+    uint32_t* offset;               /* Edges of node slot i: [offset[i], offset[i + 1]) */
+    uint32_t* edges;                /* Edge slots, ADJ_NIL for tombstones */
+    uint32_t offset_cap;
+    uint32_t edges_cap;
+} hg_csr_t;
+
+/* Adjacency cursor over one node's edges */
+typedef struct {
+    uint32_t slot;
+    uint8_t dirs;                   /* Directions still to visit (hgfs_dir_t bits) */
+    uint8_t dir;                    /* Current direction */
+    uint32_t pos;                   /* CSR position */
+    uint32_t end;
+    uint32_t delta;                 /* Next delta edge, or ADJ_NIL */
+} hg_cursor_t;
+
+/* File header (offset 0) */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_nodes;               /* Node records; record i opens as node slot i */
+    uint32_t n_edges;               /* Edge records */
+    uint32_t node_ids;              /* Node handle generations */
+    uint32_t edge_ids;              /* Edge handle generations */
+    uint64_t nodes_off;             /* hg_file_node_t[n_nodes] */
+    uint64_t edges_off;             /* hg_file_edge_t[n_edges] */
+    uint64_t node_gen_off;          /* uint32_t[node_ids] */
+    uint64_t edge_gen_off;          /* uint32_t[edge_ids] */
+    uint64_t data_off;              /* Tensor payloads */
+    uint64_t file_size;
+    uint64_t wal_lsn;               /* Last write-ahead log record contained */
+} hg_file_header_t;
+
+/* Node record */
+typedef struct {
+    uint32_t id;                    /* Handle id (first, as in hg_item_t) */
+    uint32_t depth;
+    uint64_t offset;                /* Payload offset from data_off */
+    uint64_t n_elements;            /* F32 elements */
+} hg_file_node_t;
+
+/* Edge record */
+typedef struct {
+    uint32_t id;                    /* Handle id */
+    uint32_t node[ADJ_DIRS];        /* Source and destination node records */
+    float weight;
+} hg_file_edge_t;
+
+_Static_assert(sizeof(hg_file_header_t) == 80, "HGFS header layout");
+_Static_assert(sizeof(hg_file_node_t) == 24, "HGFS node record layout");
+_Static_assert(sizeof(hg_file_edge_t) == 16, "HGFS edge record layout");
+
+/* WAL_REC_ALLOC body */
+typedef struct {
+    uint64_t handle;
+    uint64_t n_elements;
+    uint32_t depth;
+    uint32_t reserved;
+} hg_wal_alloc_t;
+
+/* WAL_REC_EDGE body */
+typedef struct {
+    uint64_t handle;
+    uint64_t node[ADJ_DIRS];        /* Source and destination node handles */
+    float weight;
+    uint32_t reserved;
+} hg_wal_edge_t;
+
+/* Matrix entry awaiting a merge */
+typedef struct {
+    uint32_t row;
+    uint32_t col;
+    float weight;
+} hg_entry_t;
+
+/* Adjacency matrix export */
+struct hgfs_matrix {
+    struct hgfs_matrix* next;       /* hgfs.matrices */
+    uint32_t min_depth;
+    uint32_t max_depth;
+    uint8_t dirs;                   /* hgfs_dir_t bits */
+    bool dense_on;
+    bool attached;                  /* Cleared by hgfs_close */
+    bool rebuild;                   /* Renumber from the graph at the next sync */
+    uint64_t version;
+    
+    /* Rows */
+    uint32_t* row_of;               /* Node id -> row, or MATRIX_NIL */
+    uint32_t row_of_cap;
+    uint64_t* row_node;             /* Row -> node handle, 0 once deleted */
+    uint32_t rows;
+    uint32_t rows_cap;
+    uint32_t dead_rows;
+    
+    /* CSR over rows [0, csr_rows) */
+    struct ggml_context* csr_ctx;
+    struct ggml_tensor* row_ptr;
+    struct ggml_tensor* cols;
+    struct ggml_tensor* values;
+    uint32_t csr_rows;
+    uint32_t nnz;
+    uint32_t row_ptr_cap;
+    uint32_t nnz_cap;
+    uint32_t removed;               /* Edge removals since the last renumbering */
+    hg_entry_t* pending;            /* Entries not in the CSR, which holds none of them */
+    uint32_t n_pending;
+    uint32_t pending_cap;
+    
+    /* Dense rows [0, pad) x [0, pad), current between syncs */
+    struct ggml_context* dense_ctx;
+    struct ggml_tensor* dense;
+    uint32_t pad;
+};
+
+/* Traversal frame */
+typedef struct {
+    uint32_t depth;
+    hg_cursor_t cursor;
+} hg_frame_t;
+
+/* Traversal iterator */
+struct hgfs_iter {
+    hgfs_walk_t walk;
+    hgfs_dir_t dirs;
+    uint32_t max_depth;
+    uint32_t n_slots;               /* Node slots when the traversal began */
+    uint32_t head;                  /* BFS queue head */
+    uint32_t top;                   /* BFS queue tail / DFS stack size */
+    bool started;
+    uint64_t* visited;
+    hg_frame_t* frames;             /* Each node is queued at most once */
+};
+
 /* HGFS state */
 static struct {
     struct ggml_context* ctx;
-    hg_node_t nodes[MAX_NODES];
-    hg_edge_t edges[MAX_EDGES];
-    size_t node_count;
-    size_t edge_count;
-    uint64_t next_node_handle;
-    uint64_t next_edge_handle;
+    hg_slab_t nodes;
+    hg_slab_t edges;
+    
+    /* Depth pools, sorted by depth */
+    hg_pool_t* pools;
+    uint32_t n_pools;
+    uint32_t pools_cap;
+    struct ggml_context** header_ctx;   /* Tensor headers of pool payloads */
+    uint32_t n_header_ctx;
+    uint32_t header_left;           /* Headers left in the newest header context */
+    
+    /* Tensor data pointer -> node slot */
+    uint32_t* ptr_table;
+    uint32_t ptr_cap;
+    
+    /* Adjacency */
+    hg_csr_t csr[ADJ_DIRS];
+    uint32_t csr_nodes;             /* Node slots covered by the CSR */
+    size_t csr_count;               /* Edges in the CSR, including tombstones */
+    size_t csr_dead;                /* Tombstoned CSR edges */
+    size_t delta_count;             /* Edges in the delta log */
+    uint32_t iters;                 /* Open traversals (CSR must not move) */
+    uint32_t mark_epoch;
+    
+    /* Adjacency matrix exports following mutations */
+    hgfs_matrix_t* matrices;
+    
+    /* File opened by hgfs_open */
+    uint8_t* map;
+    size_t map_size;
+    struct ggml_context* map_ctx;   /* Tensor headers over the mapping */
+    
+    /* Write-ahead log (hgfs_wal_start) */
+    bool logging;
+    char* wal_path;                 /* Checkpoint file; the log is wal_path + ".wal" */
+    hgfs_wal_config_t wal_config;
+    uint64_t checkpoint_lsn;        /* Last log record contained in the graph file */
+    uint64_t checkpoints;
+    uint64_t checkpoint_us;         /* Time of the last checkpoint (or log start) */
+    
     bool initialized;
 } hgfs = {0};
 
+/* Slab item by slot */
+static void* slab_at(const hg_slab_t* slab, uint32_t slot) {
+    return slab->chunks[slot >> SLAB_CHUNK_BITS] +
+           (size_t)(slot & (SLAB_CHUNK - 1)) * slab->item_size;
+}
+
+static hg_node_t* node_at(uint32_t slot) {
+    return (hg_node_t*)slab_at(&hgfs.nodes, slot);
+}
+
+static hg_edge_t* edge_at(uint32_t slot) {
+    return (hg_edge_t*)slab_at(&hgfs.edges, slot);
+}
+
 /**
- * Initialize hypergraph filesystem
+ * Add a chunk of slots
  */
-int hgfs_init(struct ggml_context* ctx) {
-    if (hgfs.initialized) {
-        return 0;
+static bool slab_grow(hg_slab_t* slab) {
+    uint32_t n = slab->n_chunks + 1;
+    
+    uint8_t** chunks = (uint8_t**)realloc(slab->chunks, n * sizeof(uint8_t*));
+    if (!chunks) {
+        return false;
     }
+    slab->chunks = chunks;
     
-    if (!ctx) {
-        return -1;
+    uint32_t* free_slots = (uint32_t*)realloc(slab->free_slots,
+                                              (size_t)n * SLAB_CHUNK * sizeof(uint32_t));
+    if (!free_slots) {
+        return false;
     }
+    slab->free_slots = free_slots;
     
-    memset(&hgfs, 0, sizeof(hgfs));
-    hgfs.ctx = ctx;
-    hgfs.next_node_handle = 1;
-    hgfs.next_edge_handle = 1;
-    hgfs.initialized = true;
+    chunks[n - 1] = (uint8_t*)calloc(SLAB_CHUNK, slab->item_size);
+    if (!chunks[n - 1]) {
+        return false;
+    }
     
-    return 0;
+    slab->n_chunks = n;
+    return true;
 }
 
 /**
- * Allocate memory as GGML tensor node
+ * Make room for n handle ids
  */
-void* hgfs_alloc(size_t size, uint32_t depth) {
-    if (!hgfs.initialized) {
-        return NULL;
+static bool slab_reserve_ids(hg_slab_t* slab, uint32_t n) {
+    if (n <= slab->id_cap) {
+        return true;
     }
     
-    if (hgfs.node_count >= MAX_NODES) {
-        return NULL;
+    uint32_t cap = slab->id_cap ? slab->id_cap : SLAB_CHUNK;
+    while (cap < n) {
+        cap *= 2;
+    }
+    uint32_t* id_slot = (uint32_t*)realloc(slab->id_slot, cap * sizeof(uint32_t));
+    if (id_slot) {
+        slab->id_slot = id_slot;
+    }
+    uint32_t* id_gen = (uint32_t*)realloc(slab->id_gen, cap * sizeof(uint32_t));
+    if (id_gen) {
+        slab->id_gen = id_gen;
+    }
+    uint32_t* free_ids = (uint32_t*)realloc(slab->free_ids, cap * sizeof(uint32_t));
+    if (free_ids) {
+        slab->free_ids = free_ids;
     }
     
-    /* Find free node slot */
-    size_t idx = 0;
-    for (idx = 0; idx < MAX_NODES; idx++) {
-        if (!hgfs.nodes[idx].active) {
-            break;
-        }
+    if (!id_slot || !id_gen || !free_ids) {
+        return false;
     }
     
-    if (idx >= MAX_NODES) {
-        return NULL;
+    slab->id_cap = cap;
+    return true;
+}
+
+/**
+ * Take a free slot, or the next unused one
+ * @return Slot, or SLOT_NIL when out of memory
+ */
+static uint32_t slab_take_slot(hg_slab_t* slab) {
+    if (slab->n_free > 0) {
+        return slab->free_slots[--slab->n_free];
+    }
+    if (slab->high == slab->n_chunks * SLAB_CHUNK && !slab_grow(slab)) {
+        return SLOT_NIL;
+    }
+    return slab->high++;
+}
+
+/**
+ * Allocate a slot and its handle id
+ * @return Slot, or SLOT_NIL when out of memory
+ */
+static uint32_t slab_alloc(hg_slab_t* slab) {
+    if (slab->n_free_ids == 0 && !slab_reserve_ids(slab, slab->n_ids + 1)) {
+        return SLOT_NIL;
     }
     
-    /* Create GGML tensor for this node */
-    /* Use 1D tensor with float32 elements */
-    size_t n_elements = (size + sizeof(float) - 1) / sizeof(float);
-    struct ggml_tensor* t = ggml_new_tensor_1d(hgfs.ctx, GGML_TYPE_F32, n_elements);
+    uint32_t slot = slab_take_slot(slab);
+    if (slot == SLOT_NIL) {
+        return SLOT_NIL;
+    }
     
-    if (!t) {
-        return NULL;
+    uint32_t id;
+    if (slab->n_free_ids > 0) {
+        id = slab->free_ids[--slab->n_free_ids];
+    } else {
+        id = slab->n_ids++;
+        slab->id_gen[id] = 0;
     }
+    slab->id_slot[id] = slot;
     
-    /* Initialize node */
-    hg_node_t* node = &hgfs.nodes[idx];
-    node->tensor = t;
-    node->depth = depth;
-    node->handle = hgfs.next_node_handle++;
-    node->active = true;
+    hg_item_t* item = (hg_item_t*)slab_at(slab, slot);
+    item->id = id;
+    item->active = true;
+    slab->live++;
     
-    hgfs.node_count++;
+    return slot;
+}
+
+/**
+ * Free a slot; its handle goes stale
+ */
+static void slab_free(hg_slab_t* slab, uint32_t slot) {
+    hg_item_t* item = (hg_item_t*)slab_at(slab, slot);
     
-    /* Return pointer to tensor data */
-    return (void*)t->data;
+    item->active = false;
+    slab->id_gen[item->id]++;
+    if (!slab->replay) {
+        slab->free_ids[slab->n_free_ids++] = item->id;
+    }
+    slab->free_slots[slab->n_free++] = slot;
+    slab->live--;
 }
 
 /**
- * Create edge in hypergraph
+ * Resolve a handle
+ * @return Slot, or SLOT_NIL if the handle is not live
  */
-uint64_t hgfs_edge(void* src, void* dst, float weight) {
-    if (!hgfs.initialized) {
-        return 0;
+static uint32_t slab_lookup(const hg_slab_t* slab, uint64_t handle) {
+    uint32_t id = (uint32_t)handle - 1;
+    
+    if ((uint32_t)handle == 0 || id >= slab->n_ids ||
+        slab->id_gen[id] != (uint32_t)(handle >> 32)) {
+        return SLOT_NIL;
     }
     
-    if (hgfs.edge_count >= MAX_EDGES) {
-        return 0;
+    /* A free id's slot may since have been reused or released */
+    uint32_t slot = slab->id_slot[id];
+    if (slot >= slab->high) {
+        return SLOT_NIL;
+    }
+    const hg_item_t* item = (const hg_item_t*)slab_at(slab, slot);
+    return item->active && item->id == id ? slot : SLOT_NIL;
+}
+
+/* Handle of a live slot */
+static uint64_t slab_handle(const hg_slab_t* slab, uint32_t slot) {
+    uint32_t id = ((const hg_item_t*)slab_at(slab, slot))->id;
+    return ((uint64_t)slab->id_gen[id] << 32) | (id + 1);
+}
+
+/* Whether a handle id belongs to a live item */
+static bool slab_id_live(const hg_slab_t* slab, uint32_t id) {
+    if (id >= slab->n_ids || slab->id_slot[id] >= slab->high) {
+        return false;
+    }
+    const hg_item_t* item = (const hg_item_t*)slab_at(slab, slab->id_slot[id]);
+    return item->active && item->id == id;
+}
+
+/**
+ * Rebuild the free id stack from the id table; lowest ids are reused first
+ */
+static void slab_rebuild_free_ids(hg_slab_t* slab) {
+    slab->n_free_ids = 0;
+    for (uint32_t id = slab->n_ids; id > 0; id--) {
+        if (!slab_id_live(slab, id - 1)) {
+            slab->free_ids[slab->n_free_ids++] = id - 1;
+        }
+    }
+}
+
+/**
+ * Allocate a slot under a given handle (log replay)
+ * @return Slot, or SLOT_NIL if the id is live or out of memory
+ */
+static uint32_t slab_alloc_handle(hg_slab_t* slab, uint64_t handle) {
+    uint32_t id = (uint32_t)handle - 1;
+    
+    if ((uint32_t)handle == 0 || id >= HGFS_FILE_MAX_IDS || slab_id_live(slab, id) ||
+        !slab_reserve_ids(slab, id + 1)) {
+        return SLOT_NIL;
+    }
+    
+    uint32_t slot = slab_take_slot(slab);
+    if (slot == SLOT_NIL) {
+        return SLOT_NIL;
     }
     
-    /* Find node handles for src and dst */
-    uint64_t src_handle = 0;
-    uint64_t dst_handle = 0;
+    /* Ids skipped over are free */
+    for (; slab->n_ids <= id; slab->n_ids++) {
+        slab->id_gen[slab->n_ids] = 0;
+        slab->id_slot[slab->n_ids] = SLOT_NIL;
+    }
+    slab->id_gen[id] = (uint32_t)(handle >> 32);
+    slab->id_slot[id] = slot;
+    
+    hg_item_t* item = (hg_item_t*)slab_at(slab, slot);
+    item->id = id;
+    item->active = true;
+    slab->live++;
+    
+    return slot;
+}
+
+/**
+ * Move live items down over the holes, keeping their order
+ * @param slab Slab
+ * @param remap Output old slot -> new slot (can be NULL)
+ */
+static void slab_compact(hg_slab_t* slab, uint32_t* remap) {
+    uint32_t old_high = slab->high;
+    uint32_t w = 0;
     
-    for (size_t i = 0; i < MAX_NODES; i++) {
-        if (!hgfs.nodes[i].active) {
+    for (uint32_t s = 0; s < old_high; s++) {
+        hg_item_t* item = (hg_item_t*)slab_at(slab, s);
+        if (!item->active) {
+            if (remap) {
+                remap[s] = SLOT_NIL;
+            }
             continue;
         }
         
-        if (hgfs.nodes[i].tensor->data == src) {
-            src_handle = hgfs.nodes[i].handle;
+        if (remap) {
+            remap[s] = w;
+        }
+        if (s != w) {
+            memcpy(slab_at(slab, w), item, slab->item_size);
+            slab->id_slot[item->id] = w;
+        }
+        w++;
+    }
+    
+    slab->high = w;
+    slab->n_free = 0;
+    
+    /* Release chunks past the live range, keeping one */
+    uint32_t keep = w ? (w + SLAB_CHUNK - 1) / SLAB_CHUNK : 1;
+    while (slab->n_chunks > keep) {
+        free(slab->chunks[--slab->n_chunks]);
+    }
+    
+    /* Vacated slots start clean */
+    uint32_t end = old_high < keep * SLAB_CHUNK ? old_high : keep * SLAB_CHUNK;
+    for (uint32_t s = w; s < end; s++) {
+        memset(slab_at(slab, s), 0, slab->item_size);
+    }
+}
+
+/**
+ * Fill an empty slab from file records
+ * @param slab Slab
+ * @param records Records, each starting with its uint32_t handle id
+ * @param stride Record size
+ * @param n Records; record i goes to slot i
+ * @param gens Generation of every handle id
+ * @param n_ids Handle ids
+ * @return false on allocation failure or a duplicate id
+ */
+static bool slab_restore(hg_slab_t* slab, const uint8_t* records, size_t stride, uint32_t n,
+                         const uint32_t* gens, uint32_t n_ids) {
+    while (slab->n_chunks * SLAB_CHUNK < n) {
+        if (!slab_grow(slab)) {
+            return false;
         }
-        if (hgfs.nodes[i].tensor->data == dst) {
-            dst_handle = hgfs.nodes[i].handle;
+    }
+    if (!slab_reserve_ids(slab, n_ids)) {
+        return false;
+    }
+    
+    memcpy(slab->id_gen, gens, (size_t)n_ids * sizeof(uint32_t));
+    memset(slab->id_slot, 0xff, (size_t)n_ids * sizeof(uint32_t));
+    slab->n_ids = n_ids;
+    
+    for (uint32_t s = 0; s < n; s++) {
+        uint32_t id;
+        memcpy(&id, records + (size_t)s * stride, sizeof(id));
+        if (slab->id_slot[id] != SLOT_NIL) {
+            return false;
         }
+        slab->id_slot[id] = s;
         
-        if (src_handle && dst_handle) {
-            break;
+        hg_item_t* item = (hg_item_t*)slab_at(slab, s);
+        item->id = id;
+        item->active = true;
+    }
+    slab->high = n;
+    slab->live = n;
+    slab_rebuild_free_ids(slab);
+    
+    return true;
+}
+
+/**
+ * Hash a tensor data pointer (Fibonacci hashing; low bits are alignment)
+ */
+static uint32_t ptr_hash(const void* data) {
+    uint64_t key = (uint64_t)(uintptr_t)data >> 4;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (hgfs.ptr_cap - 1);
+}
+
+/* Insert without growing */
+static void ptr_place(const void* data, uint32_t slot) {
+    uint32_t i = ptr_hash(data);
+    while (hgfs.ptr_table[i] != PTR_EMPTY) {
+        i = (i + 1) & (hgfs.ptr_cap - 1);
+    }
+    hgfs.ptr_table[i] = slot;
+}
+
+/**
+ * Resize the pointer index and re-insert every live node
+ */
+static bool ptr_rehash(uint32_t cap) {
+    uint32_t* table = (uint32_t*)malloc(cap * sizeof(uint32_t));
+    if (!table) {
+        return false;
+    }
+    
+    free(hgfs.ptr_table);
+    hgfs.ptr_table = table;
+    hgfs.ptr_cap = cap;
+    memset(table, 0xff, cap * sizeof(uint32_t));
+    
+    for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+        hg_node_t* node = node_at(s);
+        if (node->item.active) {
+            ptr_place(node->tensor->data, s);
         }
     }
     
-    if (!src_handle || !dst_handle) {
-        return 0;
+    return true;
+}
+
+/**
+ * Index a node by its tensor data pointer
+ */
+static bool ptr_insert(const void* data, uint32_t slot) {
+    if ((size_t)hgfs.nodes.live * 2 > hgfs.ptr_cap && !ptr_rehash(hgfs.ptr_cap * 2)) {
+        return false;
     }
     
-    /* Find free edge slot */
-    size_t idx = 0;
-    for (idx = 0; idx < MAX_EDGES; idx++) {
-        if (!hgfs.edges[idx].active) {
-            break;
+    ptr_place(data, slot);
+    return true;
+}
+
+/**
+ * Find a node by its tensor data pointer
+ * @return Slot, or SLOT_NIL if data is not an HGFS node
+ */
+static uint32_t ptr_find(const void* data, uint32_t* pos) {
+    if (!data) {
+        return SLOT_NIL;
+    }
+    
+    for (uint32_t i = ptr_hash(data); hgfs.ptr_table[i] != PTR_EMPTY;
+         i = (i + 1) & (hgfs.ptr_cap - 1)) {
+        uint32_t slot = hgfs.ptr_table[i];
+        if (node_at(slot)->tensor->data == data) {
+            if (pos) {
+                *pos = i;
+            }
+            return slot;
         }
     }
     
-    if (idx >= MAX_EDGES) {
-        return 0;
+    return SLOT_NIL;
+}
+
+/**
+ * Remove a node from the pointer index (backward-shift deletion)
+ */
+static void ptr_remove(const void* data) {
+    uint32_t mask = hgfs.ptr_cap - 1;
+    uint32_t i;
+    
+    if (ptr_find(data, &i) == SLOT_NIL) {
+        return;
     }
     
-    /* Create edge */
-    hg_edge_t* edge = &hgfs.edges[idx];
-    edge->src_handle = src_handle;
-    edge->dst_handle = dst_handle;
-    edge->weight = weight;
-    edge->handle = hgfs.next_edge_handle++;
-    edge->active = true;
+    hgfs.ptr_table[i] = PTR_EMPTY;
+    for (uint32_t j = (i + 1) & mask; hgfs.ptr_table[j] != PTR_EMPTY; j = (j + 1) & mask) {
+        uint32_t home = ptr_hash(node_at(hgfs.ptr_table[j])->tensor->data);
+        
+        /* Entry j may move into the hole unless its home lies in (i, j] */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            hgfs.ptr_table[i] = hgfs.ptr_table[j];
+            hgfs.ptr_table[j] = PTR_EMPTY;
+            i = j;
+        }
+    }
+}
+
+/**
+ * Find the pool of a depth (pools are sorted by depth)
+ * @return Pool index, or POOL_NIL
+ */
+static uint32_t pool_find(uint32_t depth) {
+    uint32_t lo = 0;
+    uint32_t hi = hgfs.n_pools;
+    
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (hgfs.pools[mid].depth < depth) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    
+    return lo < hgfs.n_pools && hgfs.pools[lo].depth == depth ? lo : POOL_NIL;
+}
+
+/**
+ * Find or create the pool of a depth
+ * @return Pool, or NULL if out of memory (pointer valid until the next pool is created)
+ */
+static hg_pool_t* pool_get(uint32_t depth) {
+    uint32_t p = pool_find(depth);
+    if (p != POOL_NIL) {
+        return &hgfs.pools[p];
+    }
+    
+    if (hgfs.n_pools == hgfs.pools_cap) {
+        uint32_t cap = hgfs.pools_cap ? hgfs.pools_cap * 2 : 8;
+        hg_pool_t* pools = (hg_pool_t*)realloc(hgfs.pools, cap * sizeof(hg_pool_t));
+        if (!pools) {
+            return NULL;
+        }
+        hgfs.pools = pools;
+        hgfs.pools_cap = cap;
+    }
+    
+    for (p = 0; p < hgfs.n_pools && hgfs.pools[p].depth < depth; p++) {
+    }
+    memmove(&hgfs.pools[p + 1], &hgfs.pools[p], (hgfs.n_pools - p) * sizeof(hg_pool_t));
+    memset(&hgfs.pools[p], 0, sizeof(hg_pool_t));
+    hgfs.pools[p].depth = depth;
+    hgfs.n_pools++;
+    
+    return &hgfs.pools[p];
+}
+
+/**
+ * Free list class of a tensor: floor(log2(elements))
+ */
+static int pool_class(int64_t n_elements) {
+    int c = 0;
+    while (c < POOL_CLASSES - 1 && (n_elements >> (c + 1)) > 0) {
+        c++;
+    }
+    return c;
+}
+
+/**
+ * Carve payload bytes from a pool's arena
+ */
+static void* pool_carve(hg_pool_t* pool, size_t size) {
+    size = (size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+    if (size == 0) {
+        size = POOL_ALIGN;
+    }
+    
+    if (pool->n_chunks == 0 || pool->chunk_used + size > pool->chunk_size) {
+        /* Chunks double up to POOL_CHUNK_MAX; larger payloads get their own */
+        size_t chunk_size = pool->chunk_size ? pool->chunk_size * 2 : POOL_CHUNK_MIN;
+        if (chunk_size > POOL_CHUNK_MAX) {
+            chunk_size = POOL_CHUNK_MAX;
+        }
+        if (chunk_size < size) {
+            chunk_size = size;
+        }
+        
+        uint8_t** chunks = (uint8_t**)realloc(pool->chunks, (pool->n_chunks + 1) * sizeof(uint8_t*));
+        if (!chunks) {
+            return NULL;
+        }
+        pool->chunks = chunks;
+        
+        uint8_t* chunk = (uint8_t*)aligned_alloc(POOL_ALIGN, chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunks[pool->n_chunks++] = chunk;
+        pool->chunk_size = chunk_size;
+        pool->chunk_used = 0;
+        pool->bytes += chunk_size;
+    }
+    
+    void* data = pool->chunks[pool->n_chunks - 1] + pool->chunk_used;
+    pool->chunk_used += size;
+    return data;
+}
+
+/**
+ * Get a tensor for a node of a pool: a released one of fitting size, or a new one
+ */
+static struct ggml_tensor* pool_take(hg_pool_t* pool, int64_t n_elements) {
+    /* Class c holds at least 2^c elements, so class c + 1 always fits */
+    int c = pool_class(n_elements);
+    for (int k = c; k <= c + 1 && k < POOL_CLASSES; k++) {
+        struct ggml_tensor* t = pool->free[k];
+        if (t && ggml_nelements(t) >= n_elements) {
+            memcpy(&pool->free[k], t->data, sizeof(t));
+            return t;
+        }
+    }
+    
+    if (hgfs.header_left == 0) {
+        struct ggml_context** header_ctx = (struct ggml_context**)realloc(
+            hgfs.header_ctx, (hgfs.n_header_ctx + 1) * sizeof(struct ggml_context*));
+        if (!header_ctx) {
+            return NULL;
+        }
+        hgfs.header_ctx = header_ctx;
+        
+        struct ggml_init_params params = {
+            .mem_size = POOL_HEADERS * ggml_tensor_overhead(),
+            .mem_buffer = NULL,
+            .no_alloc = true,
+        };
+        header_ctx[hgfs.n_header_ctx] = ggml_init(params);
+        if (!header_ctx[hgfs.n_header_ctx]) {
+            return NULL;
+        }
+        hgfs.n_header_ctx++;
+        hgfs.header_left = POOL_HEADERS;
+    }
     
-    hgfs.edge_count++;
+    void* data = pool_carve(pool, (size_t)n_elements * sizeof(float));
+    if (!data) {
+        return NULL;
+    }
     
-    return edge->handle;
+    struct ggml_tensor* t = ggml_new_tensor_1d(hgfs.header_ctx[hgfs.n_header_ctx - 1],
+                                               GGML_TYPE_F32, n_elements);
+    hgfs.header_left--;
+    t->data = data;
+    return t;
+}
+
+/**
+ * Return a deleted node's tensor to its pool (the free link lives in the payload)
+ */
+static void pool_release(hg_pool_t* pool, struct ggml_tensor* t) {
+    int c = pool_class(ggml_nelements(t));
+    memcpy(t->data, &pool->free[c], sizeof(t));
+    pool->free[c] = t;
+}
+
+/**
+ * Add a node to its pool's member arrays
+ */
+static bool pool_join(hg_pool_t* pool, uint32_t slot) {
+    if (pool->count == pool->cap) {
+        uint32_t cap = pool->cap ? pool->cap * 2 : 64;
+        uint64_t* handles = (uint64_t*)realloc(pool->handles, cap * sizeof(uint64_t));
+        if (handles) {
+            pool->handles = handles;
+        }
+        void** data = (void**)realloc(pool->data, cap * sizeof(void*));
+        if (data) {
+            pool->data = data;
+        }
+        size_t* sizes = (size_t*)realloc(pool->sizes, cap * sizeof(size_t));
+        if (sizes) {
+            pool->sizes = sizes;
+        }
+        uint32_t* slots = (uint32_t*)realloc(pool->slots, cap * sizeof(uint32_t));
+        if (slots) {
+            pool->slots = slots;
+        }
+        if (!handles || !data || !sizes || !slots) {
+            return false;
+        }
+        pool->cap = cap;
+    }
+    
+    hg_node_t* node = node_at(slot);
+    uint32_t i = pool->count++;
+    pool->handles[i] = slab_handle(&hgfs.nodes, slot);
+    pool->data[i] = node->tensor->data;
+    pool->sizes[i] = ggml_nbytes(node->tensor);
+    pool->slots[i] = slot;
+    node->pool_pos = i;
+    return true;
+}
+
+/**
+ * Remove a node from its pool's member arrays (the last member fills the gap)
+ */
+static void pool_leave(hg_pool_t* pool, uint32_t slot) {
+    uint32_t i = node_at(slot)->pool_pos;
+    uint32_t last = --pool->count;
+    
+    if (i != last) {
+        pool->handles[i] = pool->handles[last];
+        pool->data[i] = pool->data[last];
+        pool->sizes[i] = pool->sizes[last];
+        pool->slots[i] = pool->slots[last];
+        node_at(pool->slots[i])->pool_pos = i;
+    }
+}
+
+/* Pool member sort key */
+typedef struct {
+    uintptr_t addr;
+    uint32_t slot;
+} hg_member_t;
+
+static int member_cmp(const void* a, const void* b) {
+    uintptr_t x = ((const hg_member_t*)a)->addr;
+    uintptr_t y = ((const hg_member_t*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Reorder every pool's members by payload address, so sweeps run
+ * through memory in order (slots[] must be current)
+ */
+static void pool_sort_all(void) {
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        hg_pool_t* pool = &hgfs.pools[p];
+        hg_member_t* members = (hg_member_t*)malloc((size_t)pool->count * sizeof(hg_member_t) + 1);
+        if (!members) {
+            continue;
+        }
+        
+        for (uint32_t i = 0; i < pool->count; i++) {
+            members[i].addr = (uintptr_t)pool->data[i];
+            members[i].slot = pool->slots[i];
+        }
+        qsort(members, pool->count, sizeof(hg_member_t), member_cmp);
+        
+        uint32_t n = pool->count;
+        pool->count = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            pool_join(pool, members[i].slot);
+        }
+        free(members);
+    }
+}
+
+/**
+ * Row of a node id in an export
+ */
+static uint32_t matrix_row_of(const hgfs_matrix_t* m, uint32_t id) {
+    return id < m->row_of_cap ? m->row_of[id] : MATRIX_NIL;
+}
+
+/**
+ * Append a node to an export's rows
+ */
+static bool matrix_row_add(hgfs_matrix_t* m, uint32_t slot) {
+    uint32_t id = node_at(slot)->item.id;
+    
+    if (id >= m->row_of_cap) {
+        uint32_t cap = hgfs.nodes.id_cap > id ? hgfs.nodes.id_cap : id + 1;
+        uint32_t* row_of = (uint32_t*)realloc(m->row_of, cap * sizeof(uint32_t));
+        if (!row_of) {
+            return false;
+        }
+        memset(row_of + m->row_of_cap, 0xff, (cap - m->row_of_cap) * sizeof(uint32_t));
+        m->row_of = row_of;
+        m->row_of_cap = cap;
+    }
+    
+    if (m->rows == m->rows_cap) {
+        uint32_t cap = m->rows_cap ? m->rows_cap * 2 : MATRIX_CSR_MIN;
+        uint64_t* row_node = (uint64_t*)realloc(m->row_node, cap * sizeof(uint64_t));
+        if (!row_node) {
+            return false;
+        }
+        m->row_node = row_node;
+        m->rows_cap = cap;
+    }
+    
+    m->row_of[id] = m->rows;
+    m->row_node[m->rows++] = slab_handle(&hgfs.nodes, slot);
+    return true;
+}
+
+/**
+ * Queue an entry for the next merge
+ */
+static bool matrix_push(hgfs_matrix_t* m, uint32_t row, uint32_t col, float weight) {
+    if (m->n_pending == m->pending_cap) {
+        uint32_t cap = m->pending_cap ? m->pending_cap * 2 : MATRIX_CSR_MIN;
+        hg_entry_t* pending = (hg_entry_t*)realloc(m->pending, cap * sizeof(hg_entry_t));
+        if (!pending) {
+            return false;
+        }
+        m->pending = pending;
+        m->pending_cap = cap;
+    }
+    
+    m->pending[m->n_pending++] = (hg_entry_t){row, col, weight};
+    return true;
+}
+
+/**
+ * Add weight to one element: in place if the CSR has it, else queued
+ */
+static void matrix_add(hgfs_matrix_t* m, uint32_t row, uint32_t col, float weight) {
+    if (m->dense && row < m->pad && col < m->pad) {
+        ((float*)m->dense->data)[(size_t)row * m->pad + col] += weight;
+    }
+    
+    if (row < m->csr_rows) {
+        const int32_t* row_ptr = (const int32_t*)m->row_ptr->data;
+        const int32_t* cols = (const int32_t*)m->cols->data;
+        uint32_t lo = (uint32_t)row_ptr[row];
+        uint32_t hi = (uint32_t)row_ptr[row + 1];
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if ((uint32_t)cols[mid] < col) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < (uint32_t)row_ptr[row + 1] && (uint32_t)cols[lo] == col) {
+            ((float*)m->values->data)[lo] += weight;
+            return;
+        }
+    }
+    
+    if (!matrix_push(m, row, col, weight)) {
+        m->rebuild = true;
+    }
+}
+
+/**
+ * Apply an edge insert (weight) or removal (-weight) to every export
+ */
+static void matrix_edge(const hg_edge_t* edge, float weight, bool removal) {
+    uint32_t src_id = node_at(edge->node[0])->item.id;
+    uint32_t dst_id = node_at(edge->node[1])->item.id;
+    
+    for (hgfs_matrix_t* m = hgfs.matrices; m; m = m->next) {
+        if (m->rebuild) {
+            continue;
+        }
+        
+        uint32_t src = matrix_row_of(m, src_id);
+        uint32_t dst = matrix_row_of(m, dst_id);
+        if (src == MATRIX_NIL || dst == MATRIX_NIL) {
+            continue;
+        }
+        
+        if (m->dirs & HGFS_DIR_OUT) {
+            matrix_add(m, src, dst, weight);
+        }
+        if ((m->dirs & HGFS_DIR_IN) && !(src == dst && (m->dirs & HGFS_DIR_OUT))) {
+            matrix_add(m, dst, src, weight);
+        }
+        m->removed += removal;
+    }
+}
+
+/**
+ * Give a new node a row in every export covering its depth
+ */
+static void matrix_node_add(uint32_t slot) {
+    uint32_t depth = node_at(slot)->depth;
+    
+    for (hgfs_matrix_t* m = hgfs.matrices; m; m = m->next) {
+        if (!m->rebuild && depth >= m->min_depth && depth <= m->max_depth &&
+            !matrix_row_add(m, slot)) {
+            m->rebuild = true;
+        }
+    }
+}
+
+/**
+ * Retire a deleted node's rows (its edges are already subtracted)
+ */
+static void matrix_node_remove(uint32_t slot) {
+    uint32_t id = node_at(slot)->item.id;
+    
+    for (hgfs_matrix_t* m = hgfs.matrices; m; m = m->next) {
+        if (matrix_row_of(m, id) != MATRIX_NIL) {
+            m->row_node[m->row_of[id]] = 0;
+            m->row_of[id] = MATRIX_NIL;
+            m->dead_rows++;
+        }
+    }
+}
+
+/**
+ * Initialize hypergraph filesystem
+ */
+int hgfs_init(struct ggml_context* ctx) {
+    if (hgfs.initialized) {
+        return 0;
+    }
+    
+    if (!ctx) {
+        return -1;
+    }
+    
+    memset(&hgfs, 0, sizeof(hgfs));
+    hgfs.ctx = ctx;
+    hgfs.nodes.item_size = sizeof(hg_node_t);
+    hgfs.edges.item_size = sizeof(hg_edge_t);
+    
+    if (!ptr_rehash(PTR_TABLE_MIN)) {
+        return -1;
+    }
+    
+    hgfs.initialized = true;
+    
+    return 0;
+}
+
+/**
+ * Set up a newly allocated node slot; the slot is freed on failure
+ */
+static bool node_init(uint32_t slot, int64_t n_elements, uint32_t depth) {
+    /* 1D F32 tensor from the depth's pool, packed with its neighbors in depth */
+    hg_node_t* node = node_at(slot);
+    hg_pool_t* pool = pool_get(depth);
+    struct ggml_tensor* t = pool ? pool_take(pool, n_elements) : NULL;
+    
+    if (!t) {
+        slab_free(&hgfs.nodes, slot);
+        return false;
+    }
+    
+    /* Initialize node */
+    node->tensor = t;
+    node->depth = depth;
+    node->head[0] = ADJ_NIL;
+    node->head[1] = ADJ_NIL;
+    node->mark = 0;
+    
+    if (!pool_join(pool, slot)) {
+        pool_release(pool, t);
+        slab_free(&hgfs.nodes, slot);
+        return false;
+    }
+    
+    if (!ptr_insert(t->data, slot)) {
+        pool_leave(pool, slot);
+        pool_release(pool, t);
+        slab_free(&hgfs.nodes, slot);
+        return false;
+    }
+    
+    if (hgfs.matrices) {
+        matrix_node_add(slot);
+    }
+    
+    return true;
+}
+
+/**
+ * Link a newly allocated edge slot into the adjacency delta log
+ */
+static void edge_init(uint32_t idx, uint32_t src_slot, uint32_t dst_slot, float weight) {
+    hg_edge_t* edge = edge_at(idx);
+    edge->node[0] = src_slot;
+    edge->node[1] = dst_slot;
+    edge->weight = weight;
+    edge->in_csr = false;
+    
+    /* Delta log; the CSR catches up on a later query */
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        hg_node_t* node = node_at(edge->node[d]);
+        edge->next[d] = node->head[d];
+        node->head[d] = idx;
+    }
+    hgfs.delta_count++;
+    
+    if (hgfs.matrices) {
+        matrix_edge(edge, weight, false);
+    }
+}
+
+/**
+ * Allocate memory as GGML tensor node
+ */
+void* hgfs_alloc(size_t size, uint32_t depth) {
+    if (!hgfs.initialized) {
+        return NULL;
+    }
+    
+    uint32_t slot = slab_alloc(&hgfs.nodes);
+    int64_t n_elements = (int64_t)((size + sizeof(float) - 1) / sizeof(float));
+    if (slot == SLOT_NIL || !node_init(slot, n_elements, depth)) {
+        return NULL;
+    }
+    
+    if (hgfs.logging) {
+        hg_wal_alloc_t rec = {
+            .handle = slab_handle(&hgfs.nodes, slot),
+            .n_elements = (uint64_t)n_elements,
+            .depth = depth,
+        };
+        wal_append(WAL_REC_ALLOC, &rec, sizeof(rec), NULL, 0);
+    }
+    
+    /* Return pointer to tensor data */
+    return node_at(slot)->tensor->data;
+}
+
+/**
+ * Create edge in hypergraph
+ */
+uint64_t hgfs_edge(void* src, void* dst, float weight) {
+    if (!hgfs.initialized) {
+        return 0;
+    }
+    
+    /* Resolve src and dst nodes */
+    uint32_t src_slot = ptr_find(src, NULL);
+    uint32_t dst_slot = ptr_find(dst, NULL);
+    
+    if (src_slot == SLOT_NIL || dst_slot == SLOT_NIL) {
+        return 0;
+    }
+    
+    uint32_t idx = slab_alloc(&hgfs.edges);
+    if (idx == SLOT_NIL) {
+        return 0;
+    }
+    
+    edge_init(idx, src_slot, dst_slot, weight);
+    uint64_t handle = slab_handle(&hgfs.edges, idx);
+    
+    if (hgfs.logging) {
+        hg_wal_edge_t rec = {
+            .handle = handle,
+            .node = {slab_handle(&hgfs.nodes, src_slot), slab_handle(&hgfs.nodes, dst_slot)},
+            .weight = weight,
+        };
+        wal_append(WAL_REC_EDGE, &rec, sizeof(rec), NULL, 0);
+    }
+    
+    return handle;
+}
+
+/**
+ * Get the node handle of HGFS memory
+ */
+uint64_t hgfs_handle(const void* data) {
+    if (!hgfs.initialized) {
+        return 0;
+    }
+    
+    uint32_t slot = ptr_find(data, NULL);
+    return slot != SLOT_NIL ? slab_handle(&hgfs.nodes, slot) : 0;
+}
+
+/**
+ * Get the memory of an HGFS node
+ */
+void* hgfs_data(uint64_t handle) {
+    if (!hgfs.initialized) {
+        return NULL;
+    }
+    
+    uint32_t slot = slab_lookup(&hgfs.nodes, handle);
+    return slot != SLOT_NIL ? node_at(slot)->tensor->data : NULL;
+}
+
+/**
+ * Reserve CSR arrays for the given node slots and edges
+ */
+static bool adj_reserve(uint32_t n_nodes, uint32_t n_edges) {
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        hg_csr_t* csr = &hgfs.csr[d];
+        
+        if (csr->offset_cap < n_nodes + 1) {
+            uint32_t* offset = (uint32_t*)realloc(csr->offset, (n_nodes + 1) * sizeof(uint32_t));
+            if (!offset) {
+                return false;
+            }
+            csr->offset = offset;
+            csr->offset_cap = n_nodes + 1;
+        }
+        
+        if (csr->edges_cap < n_edges) {
+            uint32_t* edges = (uint32_t*)realloc(csr->edges, n_edges * sizeof(uint32_t));
+            if (!edges) {
+                return false;
+            }
+            csr->edges = edges;
+            csr->edges_cap = n_edges;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Rebuild the CSR from every live edge and empty the delta log
+ * (arrays reserved by adj_reserve)
+ */
+static void adj_build(void) {
+    uint32_t n_nodes = hgfs.nodes.high;
+    uint32_t n_edges = hgfs.edges.high;
+    
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        hg_csr_t* csr = &hgfs.csr[d];
+        
+        /* Counting sort of edge slots by node slot */
+        memset(csr->offset, 0, (n_nodes + 1) * sizeof(uint32_t));
+        for (uint32_t e = 0; e < n_edges; e++) {
+            hg_edge_t* edge = edge_at(e);
+            if (edge->item.active) {
+                csr->offset[edge->node[d] + 1]++;
+            }
+        }
+        for (uint32_t n = 0; n < n_nodes; n++) {
+            csr->offset[n + 1] += csr->offset[n];
+        }
+        
+        /* offset[n] serves as the fill cursor, then shifts back */
+        for (uint32_t e = 0; e < n_edges; e++) {
+            hg_edge_t* edge = edge_at(e);
+            if (edge->item.active) {
+                csr->edges[csr->offset[edge->node[d]]++] = e;
+            }
+        }
+        for (uint32_t n = n_nodes; n > 0; n--) {
+            csr->offset[n] = csr->offset[n - 1];
+        }
+        csr->offset[0] = 0;
+    }
+    
+    for (uint32_t n = 0; n < n_nodes; n++) {
+        hg_node_t* node = node_at(n);
+        node->head[0] = ADJ_NIL;
+        node->head[1] = ADJ_NIL;
+    }
+    for (uint32_t e = 0; e < n_edges; e++) {
+        hg_edge_t* edge = edge_at(e);
+        edge->in_csr = edge->item.active;
+    }
+    
+    hgfs.csr_nodes = n_nodes;
+    hgfs.csr_count = hgfs.edges.live;
+    hgfs.csr_dead = 0;
+    hgfs.delta_count = 0;
+}
+
+/**
+ * Fold the delta log and tombstones into the CSR once they are large
+ * (query entry points)
+ */
+static void adj_refresh(void) {
+    size_t pending = hgfs.delta_count + hgfs.csr_dead;
+    
+    if (hgfs.iters == 0 && pending > ADJ_DELTA_MIN && pending * 4 > hgfs.csr_count &&
+        adj_reserve(hgfs.nodes.high, hgfs.edges.live)) {
+        adj_build();
+    }
+}
+
+/**
+ * Remove an edge from the adjacency lists of its endpoints
+ * @param e Edge slot
+ * @param skip Node slot whose lists the caller clears itself (or SLOT_NIL)
+ */
+static void adj_unlink(uint32_t e, uint32_t skip) {
+    hg_edge_t* edge = edge_at(e);
+    
+    if (hgfs.matrices) {
+        matrix_edge(edge, -edge->weight, true);
+    }
+    
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        uint32_t n = edge->node[d];
+        if (n == skip) {
+            continue;
+        }
+        
+        if (edge->in_csr) {
+            hg_csr_t* csr = &hgfs.csr[d];
+            for (uint32_t p = csr->offset[n]; p < csr->offset[n + 1]; p++) {
+                if (csr->edges[p] == e) {
+                    csr->edges[p] = ADJ_NIL;
+                    break;
+                }
+            }
+        } else {
+            uint32_t* link = &node_at(n)->head[d];
+            while (*link != e) {
+                link = &edge_at(*link)->next[d];
+            }
+            *link = edge->next[d];
+        }
+    }
+    
+    if (edge->in_csr) {
+        hgfs.csr_dead++;
+    } else {
+        hgfs.delta_count--;
+    }
+}
+
+/**
+ * Delete a node slot and its edges
+ */
+static void node_delete(uint32_t slot) {
+    hg_node_t* node = node_at(slot);
+    
+    /* Unlink incident edges from the far ends; this node's lists go wholesale */
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        if (slot < hgfs.csr_nodes) {
+            hg_csr_t* csr = &hgfs.csr[d];
+            for (uint32_t p = csr->offset[slot]; p < csr->offset[slot + 1]; p++) {
+                uint32_t e = csr->edges[p];
+                csr->edges[p] = ADJ_NIL;
+                if (e != ADJ_NIL && edge_at(e)->item.active) {
+                    adj_unlink(e, slot);
+                    slab_free(&hgfs.edges, e);
+                }
+            }
+        }
+        
+        for (uint32_t e = node->head[d]; e != ADJ_NIL; e = edge_at(e)->next[d]) {
+            if (edge_at(e)->item.active) {
+                adj_unlink(e, slot);
+                slab_free(&hgfs.edges, e);
+            }
+        }
+        node->head[d] = ADJ_NIL;
+    }
+    
+    if (hgfs.matrices) {
+        matrix_node_remove(slot);
+    }
+    
+    ptr_remove(node->tensor->data);
+    
+    hg_pool_t* pool = &hgfs.pools[pool_find(node->depth)];
+    pool_leave(pool, slot);
+    pool_release(pool, node->tensor);
+    node->tensor = NULL;
+    
+    slab_free(&hgfs.nodes, slot);
+}
+
+/**
+ * Delete a node and its edges
+ */
+int hgfs_free(void* data) {
+    if (!hgfs.initialized || hgfs.iters > 0) {
+        return -1;
+    }
+    
+    uint32_t slot = ptr_find(data, NULL);
+    if (slot == SLOT_NIL) {
+        return -1;
+    }
+    
+    if (hgfs.logging) {
+        uint64_t handle = slab_handle(&hgfs.nodes, slot);
+        wal_append(WAL_REC_FREE, &handle, sizeof(handle), NULL, 0);
+    }
+    
+    node_delete(slot);
+    return 0;
+}
+
+/**
+ * Delete an edge
+ */
+int hgfs_edge_remove(uint64_t edge) {
+    if (!hgfs.initialized || hgfs.iters > 0) {
+        return -1;
+    }
+    
+    uint32_t e = slab_lookup(&hgfs.edges, edge);
+    if (e == SLOT_NIL) {
+        return -1;
+    }
+    
+    if (hgfs.logging) {
+        wal_append(WAL_REC_EDGE_REMOVE, &edge, sizeof(edge), NULL, 0);
+    }
+    
+    adj_unlink(e, SLOT_NIL);
+    slab_free(&hgfs.edges, e);
+    
+    return 0;
+}
+
+/**
+ * Compact node and edge storage
+ */
+int hgfs_compact(void) {
+    if (!hgfs.initialized || hgfs.iters > 0) {
+        return -1;
+    }
+    
+    /* Everything that can fail happens before anything moves */
+    uint32_t* remap = (uint32_t*)malloc(((size_t)hgfs.nodes.high + 1) * sizeof(uint32_t));
+    if (!remap || !adj_reserve(hgfs.nodes.live, hgfs.edges.live)) {
+        free(remap);
+        return -1;
+    }
+    
+    slab_compact(&hgfs.nodes, remap);
+    for (uint32_t e = 0; e < hgfs.edges.high; e++) {
+        hg_edge_t* edge = edge_at(e);
+        if (edge->item.active) {
+            edge->node[0] = remap[edge->node[0]];
+            edge->node[1] = remap[edge->node[1]];
+        }
+    }
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        hg_pool_t* pool = &hgfs.pools[p];
+        for (uint32_t i = 0; i < pool->count; i++) {
+            pool->slots[i] = remap[pool->slots[i]];
+        }
+    }
+    free(remap);
+    pool_sort_all();
+    
+    slab_compact(&hgfs.edges, NULL);
+    adj_build();
+    
+    /* Shrink the pointer index if mostly empty; on failure re-home in place */
+    uint32_t cap = hgfs.ptr_cap;
+    while (cap > PTR_TABLE_MIN && (size_t)hgfs.nodes.live * 8 < cap) {
+        cap /= 2;
+    }
+    if (!ptr_rehash(cap)) {
+        memset(hgfs.ptr_table, 0xff, hgfs.ptr_cap * sizeof(uint32_t));
+        for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+            ptr_place(node_at(s)->tensor->data, s);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Get storage statistics
+ */
+int hgfs_stats(hgfs_stats_t* stats) {
+    if (!hgfs.initialized || !stats) {
+        return -1;
+    }
+    
+    stats->nodes = hgfs.nodes.live;
+    stats->edges = hgfs.edges.live;
+    stats->node_slots = hgfs.nodes.high;
+    stats->edge_slots = hgfs.edges.high;
+    stats->node_chunks = hgfs.nodes.n_chunks;
+    stats->edge_chunks = hgfs.edges.n_chunks;
+    stats->delta_edges = hgfs.delta_count;
+    stats->mapped_bytes = hgfs.map_size;
+    stats->depths = hgfs.n_pools;
+    stats->pool_bytes = 0;
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        stats->pool_bytes += hgfs.pools[p].bytes;
+    }
+    
+    return 0;
+}
+
+/**
+ * List the depths that have node pools
+ */
+size_t hgfs_depths(uint32_t* depths, size_t max) {
+    if (!hgfs.initialized) {
+        return 0;
+    }
+    
+    for (uint32_t p = 0; p < hgfs.n_pools && p < max; p++) {
+        depths[p] = hgfs.pools[p].depth;
+    }
+    return hgfs.n_pools;
+}
+
+/**
+ * Get the nodes of one depth as parallel arrays
+ */
+int hgfs_depth_view(uint32_t depth, hgfs_depth_view_t* view) {
+    if (!hgfs.initialized || !view) {
+        return -1;
+    }
+    
+    uint32_t p = pool_find(depth);
+    if (p == POOL_NIL) {
+        memset(view, 0, sizeof(*view));
+        return 0;
+    }
+    
+    hg_pool_t* pool = &hgfs.pools[p];
+    view->count = pool->count;
+    view->handles = pool->handles;
+    view->data = pool->data;
+    view->sizes = pool->sizes;
+    return 0;
+}
+
+/**
+ * Start a cursor over a node's edges in the given directions
+ */
+static void cursor_init(hg_cursor_t* cur, uint32_t slot, hgfs_dir_t dirs) {
+    cur->slot = slot;
+    cur->dirs = (uint8_t)dirs;
+    cur->dir = 0;
+    cur->pos = 0;
+    cur->end = 0;
+    cur->delta = ADJ_NIL;
+}
+
+/**
+ * Advance a cursor
+ * @param cur Cursor
+ * @param edge Output edge slot
+ * @param other Output node slot at the far end
+ * @return false once every direction is exhausted
+ */
+static bool cursor_next(hg_cursor_t* cur, uint32_t* edge, uint32_t* other) {
+    for (;;) {
+        uint32_t e = ADJ_NIL;
+        
+        while (e == ADJ_NIL && cur->pos < cur->end) {
+            e = hgfs.csr[cur->dir].edges[cur->pos++];
+        }
+        if (e == ADJ_NIL && cur->delta != ADJ_NIL) {
+            e = cur->delta;
+            cur->delta = edge_at(e)->next[cur->dir];
+        }
+        
+        if (e != ADJ_NIL) {
+            *edge = e;
+            *other = edge_at(e)->node[cur->dir ^ 1];
+            return true;
+        }
+        
+        /* Next direction: out (bit 0) before in (bit 1) */
+        if (cur->dirs == 0) {
+            return false;
+        }
+        cur->dir = (cur->dirs & HGFS_DIR_OUT) ? 0 : 1;
+        cur->dirs &= (uint8_t)~(1u << cur->dir);
+        
+        if (cur->slot < hgfs.csr_nodes) {
+            cur->pos = hgfs.csr[cur->dir].offset[cur->slot];
+            cur->end = hgfs.csr[cur->dir].offset[cur->slot + 1];
+        } else {
+            cur->pos = 0;
+            cur->end = 0;
+        }
+        cur->delta = node_at(cur->slot)->head[cur->dir];
+    }
+}
+
+/**
+ * Copy the edges of a node in one direction
+ */
+static size_t node_edges(uint64_t node, hgfs_dir_t dir, hgfs_edge_info_t* edges, size_t max) {
+    if (!hgfs.initialized) {
+        return 0;
+    }
+    
+    uint32_t slot = slab_lookup(&hgfs.nodes, node);
+    if (slot == SLOT_NIL) {
+        return 0;
+    }
+    
+    adj_refresh();
+    
+    hg_cursor_t cur;
+    cursor_init(&cur, slot, dir);
+    
+    size_t count = 0;
+    uint32_t e;
+    uint32_t other;
+    while (cursor_next(&cur, &e, &other)) {
+        if (edges && count < max) {
+            const hg_edge_t* edge = edge_at(e);
+            edges[count].handle = slab_handle(&hgfs.edges, e);
+            edges[count].src = slab_handle(&hgfs.nodes, edge->node[0]);
+            edges[count].dst = slab_handle(&hgfs.nodes, edge->node[1]);
+            edges[count].weight = edge->weight;
+        }
+        count++;
+    }
+    
+    return count;
+}
+
+/**
+ * Get the outgoing edges of a node
+ */
+size_t hgfs_out_edges(uint64_t node, hgfs_edge_info_t* edges, size_t max) {
+    return node_edges(node, HGFS_DIR_OUT, edges, max);
+}
+
+/**
+ * Get the incoming edges of a node
+ */
+size_t hgfs_in_edges(uint64_t node, hgfs_edge_info_t* edges, size_t max) {
+    return node_edges(node, HGFS_DIR_IN, edges, max);
+}
+
+/**
+ * Get the distinct neighbors of a node
+ */
+size_t hgfs_neighbors(uint64_t node, hgfs_dir_t dir, uint64_t* neighbors, size_t max) {
+    if (!hgfs.initialized || (dir & ~HGFS_DIR_BOTH) || dir == 0) {
+        return 0;
+    }
+    
+    uint32_t slot = slab_lookup(&hgfs.nodes, node);
+    if (slot == SLOT_NIL) {
+        return 0;
+    }
+    
+    adj_refresh();
+    
+    /* Stamp-based dedup: no clearing between calls */
+    if (++hgfs.mark_epoch == 0) {
+        for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+            node_at(s)->mark = 0;
+        }
+        hgfs.mark_epoch = 1;
+    }
+    
+    hg_cursor_t cur;
+    cursor_init(&cur, slot, dir);
+    
+    size_t count = 0;
+    uint32_t e;
+    uint32_t other;
+    while (cursor_next(&cur, &e, &other)) {
+        hg_node_t* n = node_at(other);
+        if (n->mark == hgfs.mark_epoch) {
+            continue;
+        }
+        n->mark = hgfs.mark_epoch;
+        
+        if (neighbors && count < max) {
+            neighbors[count] = slab_handle(&hgfs.nodes, other);
+        }
+        count++;
+    }
+    
+    return count;
+}
+
+/* Traversal visited set; nodes added after hgfs_iter_begin are skipped */
+static bool iter_visit(hgfs_iter_t* it, uint32_t slot) {
+    uint64_t bit = 1ull << (slot & 63);
+    if (slot >= it->n_slots || (it->visited[slot >> 6] & bit)) {
+        return false;
+    }
+    it->visited[slot >> 6] |= bit;
+    return true;
+}
+
+/**
+ * Start a traversal
+ */
+hgfs_iter_t* hgfs_iter_begin(uint64_t start, hgfs_walk_t walk, hgfs_dir_t dir,
+                             uint32_t max_depth) {
+    if (!hgfs.initialized || (dir & ~HGFS_DIR_BOTH) || dir == 0 ||
+        (walk != HGFS_WALK_BFS && walk != HGFS_WALK_DFS)) {
+        return NULL;
+    }
+    
+    uint32_t slot = slab_lookup(&hgfs.nodes, start);
+    if (slot == SLOT_NIL) {
+        return NULL;
+    }
+    
+    /* All memory up front: a traversal never allocates per step */
+    uint32_t n_slots = hgfs.nodes.high;
+    size_t words = (n_slots + 63) / 64;
+    hgfs_iter_t* it = (hgfs_iter_t*)malloc(sizeof(hgfs_iter_t) + words * sizeof(uint64_t) +
+                                           n_slots * sizeof(hg_frame_t));
+    if (!it) {
+        return NULL;
+    }
+    
+    adj_refresh();
+    hgfs.iters++;
+    
+    it->walk = walk;
+    it->dirs = dir;
+    it->max_depth = max_depth;
+    it->n_slots = n_slots;
+    it->head = 0;
+    it->top = 0;
+    it->started = false;
+    it->visited = (uint64_t*)(it + 1);
+    it->frames = (hg_frame_t*)(it->visited + words);
+    memset(it->visited, 0, words * sizeof(uint64_t));
+    
+    iter_visit(it, slot);
+    it->frames[0].depth = 0;
+    cursor_init(&it->frames[0].cursor, slot, dir);
+    it->top = 1;
+    
+    return it;
+}
+
+/**
+ * Advance a traversal
+ */
+bool hgfs_iter_next(hgfs_iter_t* it, uint64_t* node, uint32_t* depth) {
+    if (!it) {
+        return false;
+    }
+    
+    hg_frame_t* visit = NULL;
+    
+    if (!it->started) {
+        /* The start node comes first in both orders */
+        it->started = true;
+        visit = &it->frames[0];
+        if (it->walk == HGFS_WALK_BFS) {
+            it->head = 1;
+        }
+    } else if (it->walk == HGFS_WALK_BFS) {
+        if (it->head < it->top) {
+            visit = &it->frames[it->head++];
+        }
+    } else {
+        /* DFS preorder: descend through the first unvisited neighbor */
+        while (it->top > 0 && !visit) {
+            hg_frame_t* f = &it->frames[it->top - 1];
+            uint32_t e;
+            uint32_t other;
+            
+            if (f->depth >= it->max_depth || !cursor_next(&f->cursor, &e, &other)) {
+                it->top--;
+                continue;
+            }
+            if (!iter_visit(it, other)) {
+                continue;
+            }
+            
+            visit = &it->frames[it->top++];
+            visit->depth = f->depth + 1;
+            cursor_init(&visit->cursor, other, it->dirs);
+        }
+    }
+    
+    if (!visit) {
+        return false;
+    }
+    
+    /* BFS: enqueue the next level while visiting this node */
+    if (it->walk == HGFS_WALK_BFS && visit->depth < it->max_depth) {
+        hg_cursor_t cur = visit->cursor;
+        uint32_t e;
+        uint32_t other;
+        while (cursor_next(&cur, &e, &other)) {
+            if (iter_visit(it, other)) {
+                hg_frame_t* f = &it->frames[it->top++];
+                f->depth = visit->depth + 1;
+                cursor_init(&f->cursor, other, it->dirs);
+            }
+        }
+    }
+    
+    if (node) {
+        *node = slab_handle(&hgfs.nodes, visit->cursor.slot);
+    }
+    if (depth) {
+        *depth = visit->depth;
+    }
+    return true;
+}
+
+/**
+ * End a traversal
+ */
+void hgfs_iter_end(hgfs_iter_t* it) {
+    if (!it) {
+        return;
+    }
+    
+    hgfs.iters--;
+    free(it);
+}
+
+/**
+ * Order matrix entries by row, then column
+ */
+static int entry_cmp(const void* a, const void* b) {
+    const hg_entry_t* x = (const hg_entry_t*)a;
+    const hg_entry_t* y = (const hg_entry_t*)b;
+    
+    if (x->row != y->row) {
+        return x->row < y->row ? -1 : 1;
+    }
+    return x->col < y->col ? -1 : x->col > y->col;
+}
+
+/**
+ * Sort pending entries: counting sort by row, then by column within rows
+ * (qsort for long rows, or for everything if scratch memory is short)
+ */
+static void matrix_sort(hgfs_matrix_t* m) {
+    uint32_t* start = (uint32_t*)calloc((size_t)m->rows + 1, sizeof(uint32_t));
+    hg_entry_t* sorted = (hg_entry_t*)malloc((size_t)m->pending_cap * sizeof(hg_entry_t));
+    if (!start || !sorted) {
+        free(start);
+        free(sorted);
+        qsort(m->pending, m->n_pending, sizeof(hg_entry_t), entry_cmp);
+        return;
+    }
+    
+    for (uint32_t i = 0; i < m->n_pending; i++) {
+        start[m->pending[i].row + 1]++;
+    }
+    for (uint32_t r = 0; r < m->rows; r++) {
+        start[r + 1] += start[r];
+    }
+    for (uint32_t i = 0; i < m->n_pending; i++) {
+        sorted[start[m->pending[i].row]++] = m->pending[i];
+    }
+    
+    /* start[r] now ends row r */
+    uint32_t begin = 0;
+    for (uint32_t r = 0; r < m->rows; r++) {
+        uint32_t end = start[r];
+        if (end - begin > 32) {
+            qsort(sorted + begin, end - begin, sizeof(hg_entry_t), entry_cmp);
+        } else {
+            for (uint32_t i = begin + 1; i < end; i++) {
+                hg_entry_t entry = sorted[i];
+                uint32_t j = i;
+                while (j > begin && sorted[j - 1].col > entry.col) {
+                    sorted[j] = sorted[j - 1];
+                    j--;
+                }
+                sorted[j] = entry;
+            }
+        }
+        begin = end;
+    }
+    
+    free(start);
+    free(m->pending);
+    m->pending = sorted;
+}
+
+/**
+ * Make room for the CSR of rows x nnz entries, keeping its contents
+ */
+static bool matrix_reserve(hgfs_matrix_t* m, uint32_t rows, uint32_t nnz) {
+    if (m->csr_ctx && rows + 1 <= m->row_ptr_cap && nnz <= m->nnz_cap) {
+        return true;
+    }
+    
+    uint32_t row_ptr_cap = m->row_ptr_cap > MATRIX_CSR_MIN ? m->row_ptr_cap : MATRIX_CSR_MIN;
+    uint32_t nnz_cap = m->nnz_cap > MATRIX_CSR_MIN ? m->nnz_cap : MATRIX_CSR_MIN;
+    while (row_ptr_cap < rows + 1) {
+        row_ptr_cap += row_ptr_cap / 2;
+    }
+    while (nnz_cap < nnz) {
+        nnz_cap += nnz_cap / 2;
+    }
+    
+    struct ggml_init_params params = {
+        .mem_size = 3 * ggml_tensor_overhead() + ((size_t)row_ptr_cap + 2 * (size_t)nnz_cap) * 4 + 256,
+        .mem_buffer = NULL,
+        .no_alloc = false,
+    };
+    struct ggml_context* ctx = ggml_init(params);
+    if (!ctx) {
+        return false;
+    }
+    
+    struct ggml_tensor* row_ptr = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, row_ptr_cap);
+    struct ggml_tensor* cols = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, nnz_cap);
+    struct ggml_tensor* values = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, nnz_cap);
+    if (!row_ptr || !cols || !values) {
+        ggml_free(ctx);
+        return false;
+    }
+    
+    if (m->csr_ctx) {
+        memcpy(row_ptr->data, m->row_ptr->data, ((size_t)m->csr_rows + 1) * sizeof(int32_t));
+        memcpy(cols->data, m->cols->data, (size_t)m->nnz * sizeof(int32_t));
+        memcpy(values->data, m->values->data, (size_t)m->nnz * sizeof(float));
+        ggml_free(m->csr_ctx);
+    } else {
+        ((int32_t*)row_ptr->data)[0] = 0;
+    }
+    
+    m->csr_ctx = ctx;
+    m->row_ptr = row_ptr;
+    m->cols = cols;
+    m->values = values;
+    m->row_ptr_cap = row_ptr_cap;
+    m->nnz_cap = nnz_cap;
+    return true;
+}
+
+/**
+ * Merge pending entries and new rows into the CSR
+ */
+static bool matrix_merge(hgfs_matrix_t* m) {
+    /* Sort and sum duplicates; entries that cancelled out are dropped */
+    matrix_sort(m);
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < m->n_pending; i++) {
+        if (k > 0 && m->pending[k - 1].row == m->pending[i].row &&
+            m->pending[k - 1].col == m->pending[i].col) {
+            m->pending[k - 1].weight += m->pending[i].weight;
+        } else {
+            if (k > 0 && m->pending[k - 1].weight == 0.0f) {
+                k--;
+            }
+            m->pending[k++] = m->pending[i];
+        }
+    }
+    if (k > 0 && m->pending[k - 1].weight == 0.0f) {
+        k--;
+    }
+    
+    if (!matrix_reserve(m, m->rows, m->nnz + k)) {
+        return false;
+    }
+    
+    /* Backward in place: output position never falls below input position */
+    int32_t* row_ptr = (int32_t*)m->row_ptr->data;
+    int32_t* cols = (int32_t*)m->cols->data;
+    float* values = (float*)m->values->data;
+    int64_t out = (int64_t)m->nnz + k;
+    int64_t j = (int64_t)k - 1;
+    
+    for (int64_t r = (int64_t)m->rows - 1; r >= 0; r--) {
+        int64_t begin = r < m->csr_rows ? (int64_t)row_ptr[r] : (int64_t)m->nnz;
+        int64_t i = (r < m->csr_rows ? (int64_t)row_ptr[r + 1] : (int64_t)m->nnz) - 1;
+        row_ptr[r + 1] = (int32_t)out;
+        
+        while (i >= begin || (j >= 0 && m->pending[j].row == r)) {
+            out--;
+            if (j >= 0 && m->pending[j].row == r && (i < begin || m->pending[j].col > (uint32_t)cols[i])) {
+                cols[out] = (int32_t)m->pending[j].col;
+                values[out] = m->pending[j].weight;
+                j--;
+            } else {
+                cols[out] = cols[i];
+                values[out] = values[i];
+                i--;
+            }
+        }
+    }
+    row_ptr[0] = 0;
+    
+    m->csr_rows = m->rows;
+    m->nnz += k;
+    m->n_pending = 0;
+    return true;
+}
+
+/**
+ * Renumber rows from the graph and rebuild the CSR
+ */
+static bool matrix_rebuild(hgfs_matrix_t* m) {
+    if (m->row_of_cap > 0) {
+        memset(m->row_of, 0xff, m->row_of_cap * sizeof(uint32_t));
+    }
+    m->rows = 0;
+    m->dead_rows = 0;
+    m->csr_rows = 0;
+    m->nnz = 0;
+    m->removed = 0;
+    m->n_pending = 0;
+    m->version++;
+    
+    for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+        hg_node_t* node = node_at(s);
+        if (node->item.active && node->depth >= m->min_depth && node->depth <= m->max_depth &&
+            !matrix_row_add(m, s)) {
+            return false;
+        }
+    }
+    
+    for (uint32_t e = 0; e < hgfs.edges.high; e++) {
+        hg_edge_t* edge = edge_at(e);
+        if (!edge->item.active) {
+            continue;
+        }
+        
+        uint32_t src = matrix_row_of(m, node_at(edge->node[0])->item.id);
+        uint32_t dst = matrix_row_of(m, node_at(edge->node[1])->item.id);
+        if (src == MATRIX_NIL || dst == MATRIX_NIL) {
+            continue;
+        }
+        
+        if ((m->dirs & HGFS_DIR_OUT) && !matrix_push(m, src, dst, edge->weight)) {
+            return false;
+        }
+        if ((m->dirs & HGFS_DIR_IN) && !(src == dst && (m->dirs & HGFS_DIR_OUT)) &&
+            !matrix_push(m, dst, src, edge->weight)) {
+            return false;
+        }
+    }
+    
+    return matrix_merge(m);
+}
+
+/**
+ * Size the dense tensor to the rows and, if needed, refill it from the CSR
+ */
+static bool matrix_dense_fit(hgfs_matrix_t* m, bool refill) {
+    if (m->dense && m->rows <= m->pad && !refill) {
+        return true;
+    }
+    
+    if (m->rows > m->pad || !m->dense) {
+        if (m->dense_ctx) {
+            ggml_free(m->dense_ctx);
+        }
+        m->dense_ctx = NULL;
+        m->dense = NULL;
+        m->pad = 0;
+        
+        if (m->rows > HGFS_MATRIX_DENSE_MAX) {
+            return true;
+        }
+        
+        uint32_t pad = m->rows + m->rows / 2;
+        pad = (pad + HGFS_MATRIX_BLOCK - 1) / HGFS_MATRIX_BLOCK * HGFS_MATRIX_BLOCK;
+        if (pad == 0) {
+            pad = HGFS_MATRIX_BLOCK;
+        } else if (pad > HGFS_MATRIX_DENSE_MAX) {
+            pad = HGFS_MATRIX_DENSE_MAX;
+        }
+        
+        struct ggml_init_params params = {
+            .mem_size = ggml_tensor_overhead() + (size_t)pad * pad * sizeof(float) + 256,
+            .mem_buffer = NULL,
+            .no_alloc = false,
+        };
+        m->dense_ctx = ggml_init(params);
+        if (!m->dense_ctx) {
+            return false;
+        }
+        m->dense = ggml_new_tensor_2d(m->dense_ctx, GGML_TYPE_F32, pad, pad);
+        if (!m->dense) {
+            ggml_free(m->dense_ctx);
+            m->dense_ctx = NULL;
+            return false;
+        }
+        m->pad = pad;
+    }
+    
+    float* dense = (float*)m->dense->data;
+    const int32_t* row_ptr = (const int32_t*)m->row_ptr->data;
+    const int32_t* cols = (const int32_t*)m->cols->data;
+    const float* values = (const float*)m->values->data;
+    
+    memset(dense, 0, (size_t)m->pad * m->pad * sizeof(float));
+    for (uint32_t r = 0; r < m->csr_rows; r++) {
+        for (int32_t p = row_ptr[r]; p < row_ptr[r + 1]; p++) {
+            dense[(size_t)r * m->pad + (uint32_t)cols[p]] = values[p];
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Export the adjacency of a depth range
+ */
+hgfs_matrix_t* hgfs_matrix_create(uint32_t min_depth, uint32_t max_depth, hgfs_dir_t dir,
+                                  uint32_t flags) {
+    if (!hgfs.initialized || min_depth > max_depth || (dir & HGFS_DIR_BOTH) == 0 ||
+        (dir & ~HGFS_DIR_BOTH) != 0) {
+        return NULL;
+    }
+    
+    hgfs_matrix_t* m = (hgfs_matrix_t*)calloc(1, sizeof(hgfs_matrix_t));
+    if (!m) {
+        return NULL;
+    }
+    
+    m->min_depth = min_depth;
+    m->max_depth = max_depth;
+    m->dirs = (uint8_t)dir;
+    m->dense_on = (flags & HGFS_MATRIX_DENSE) != 0;
+    m->attached = true;
+    m->rebuild = true;
+    m->next = hgfs.matrices;
+    hgfs.matrices = m;
+    
+    if (hgfs_matrix_sync(m, NULL) != 0) {
+        hgfs_matrix_destroy(m);
+        return NULL;
+    }
+    
+    return m;
+}
+
+/**
+ * Bring an export up to date with the graph
+ */
+int hgfs_matrix_sync(hgfs_matrix_t* m, hgfs_matrix_info_t* info) {
+    if (!m || !m->attached) {
+        return -1;
+    }
+    
+    /* Renumber once stale rows or removals reach a quarter of the matrix */
+    bool refill = m->rebuild ||
+                  (m->dead_rows > ADJ_DELTA_MIN && (size_t)m->dead_rows * 4 > m->rows) ||
+                  (m->removed > ADJ_DELTA_MIN && (size_t)m->removed * 4 > m->nnz);
+    
+    if (refill) {
+        m->rebuild = true;
+        if (!matrix_rebuild(m)) {
+            return -1;
+        }
+        m->rebuild = false;
+    } else if ((m->n_pending > 0 || m->rows > m->csr_rows) && !matrix_merge(m)) {
+        m->rebuild = true;
+        return -1;
+    }
+    
+    if (m->dense_on && !matrix_dense_fit(m, refill)) {
+        return -1;
+    }
+    
+    if (info) {
+        info->rows = m->csr_rows;
+        info->nnz = m->nnz;
+        info->row_ptr = m->row_ptr;
+        info->cols = m->cols;
+        info->values = m->values;
+        info->dense = m->dense;
+        info->version = m->version;
+    }
+    
+    return 0;
+}
+
+/**
+ * Get the row of a node in an export
+ */
+uint32_t hgfs_matrix_row(const hgfs_matrix_t* m, uint64_t node) {
+    if (!m || !m->attached) {
+        return MATRIX_NIL;
+    }
+    
+    uint32_t slot = slab_lookup(&hgfs.nodes, node);
+    if (slot == SLOT_NIL) {
+        return MATRIX_NIL;
+    }
+    
+    return matrix_row_of(m, node_at(slot)->item.id);
+}
+
+/**
+ * Get the node of an export row
+ */
+uint64_t hgfs_matrix_node(const hgfs_matrix_t* m, uint32_t row) {
+    if (!m || !m->attached || row >= m->rows) {
+        return 0;
+    }
+    
+    return m->row_node[row];
+}
+
+/**
+ * Free an export
+ */
+void hgfs_matrix_destroy(hgfs_matrix_t* m) {
+    if (!m) {
+        return;
+    }
+    
+    if (m->attached) {
+        hgfs_matrix_t** link = &hgfs.matrices;
+        while (*link != m) {
+            link = &(*link)->next;
+        }
+        *link = m->next;
+    }
+    
+    if (m->csr_ctx) {
+        ggml_free(m->csr_ctx);
+    }
+    if (m->dense_ctx) {
+        ggml_free(m->dense_ctx);
+    }
+    free(m->row_of);
+    free(m->row_node);
+    free(m->pending);
+    free(m);
+}
+
+/* Round up to a power-of-two alignment */
+static uint64_t file_align(uint64_t off, uint64_t align) {
+    return (off + align - 1) & ~(align - 1);
+}
+
+/* Payload bytes of a node in the file; every node gets a distinct address */
+static uint64_t file_span(const struct ggml_tensor* t) {
+    size_t size = ggml_nbytes(t);
+    return file_align(size > 0 ? size : 1, HGFS_DATA_ALIGN);
+}
+
+/**
+ * Write at a file offset at or past the current position, zero-filling the gap
+ */
+static bool file_write_at(FILE* f, uint64_t* pos, uint64_t off, const void* data, size_t size) {
+    static const uint8_t zero[HGFS_FILE_ALIGN];
+    
+    while (*pos < off) {
+        size_t n = off - *pos < sizeof(zero) ? (size_t)(off - *pos) : sizeof(zero);
+        if (fwrite(zero, 1, n, f) != n) {
+            return false;
+        }
+        *pos += n;
+    }
+    
+    if (size > 0 && fwrite(data, 1, size, f) != size) {
+        return false;
+    }
+    *pos += size;
+    return true;
+}
+
+/**
+ * Write the graph file
+ * @param remap Node slot -> record index
+ * @param offset Node slot -> payload offset (ascending in pool member order)
+ */
+static bool file_write(FILE* f, const hg_file_header_t* hdr, const uint32_t* remap,
+                       const uint64_t* offset) {
+    uint64_t pos = 0;
+    
+    if (!file_write_at(f, &pos, 0, hdr, sizeof(*hdr))) {
+        return false;
+    }
+    
+    uint64_t off = hdr->nodes_off;
+    for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+        hg_node_t* node = node_at(s);
+        if (!node->item.active) {
+            continue;
+        }
+        
+        hg_file_node_t rec = {
+            .id = node->item.id,
+            .depth = node->depth,
+            .offset = offset[s],
+            .n_elements = (uint64_t)ggml_nelements(node->tensor),
+        };
+        if (!file_write_at(f, &pos, off, &rec, sizeof(rec))) {
+            return false;
+        }
+        off += sizeof(rec);
+    }
+    
+    off = hdr->edges_off;
+    for (uint32_t e = 0; e < hgfs.edges.high; e++) {
+        hg_edge_t* edge = edge_at(e);
+        if (!edge->item.active) {
+            continue;
+        }
+        
+        hg_file_edge_t rec = {
+            .id = edge->item.id,
+            .node = {remap[edge->node[0]], remap[edge->node[1]]},
+            .weight = edge->weight,
+        };
+        if (!file_write_at(f, &pos, off, &rec, sizeof(rec))) {
+            return false;
+        }
+        off += sizeof(rec);
+    }
+    
+    if (!file_write_at(f, &pos, hdr->node_gen_off, hgfs.nodes.id_gen,
+                       (size_t)hdr->node_ids * sizeof(uint32_t)) ||
+        !file_write_at(f, &pos, hdr->edge_gen_off, hgfs.edges.id_gen,
+                       (size_t)hdr->edge_ids * sizeof(uint32_t))) {
+        return false;
+    }
+    
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        const hg_pool_t* pool = &hgfs.pools[p];
+        for (uint32_t i = 0; i < pool->count; i++) {
+            const struct ggml_tensor* t = node_at(pool->slots[i])->tensor;
+            if (!file_write_at(f, &pos, hdr->data_off + offset[pool->slots[i]], t->data,
+                               ggml_nbytes(t))) {
+                return false;
+            }
+        }
+    }
+    
+    return file_write_at(f, &pos, hdr->file_size, NULL, 0);
+}
+
+/**
+ * Save the graph to a file recording the last log record it contains
+ */
+static int file_save(const char* path, uint64_t wal_lsn) {
+    /* Live nodes become records 0..n-1 in slot order */
+    uint32_t* remap = (uint32_t*)malloc(((size_t)hgfs.nodes.high + 1) * sizeof(uint32_t));
+    uint64_t* offset = (uint64_t*)malloc(((size_t)hgfs.nodes.high + 1) * sizeof(uint64_t));
+    size_t path_len = strlen(path);
+    char* tmp = (char*)malloc(path_len + 5);
+    if (!remap || !offset || !tmp) {
+        free(remap);
+        free(offset);
+        free(tmp);
+        return -1;
+    }
+    memcpy(tmp, path, path_len);
+    memcpy(tmp + path_len, ".tmp", 5);
+    
+    uint32_t n = 0;
+    for (uint32_t s = 0; s < hgfs.nodes.high; s++) {
+        remap[s] = node_at(s)->item.active ? n++ : SLOT_NIL;
+    }
+    
+    /* Payloads are grouped by depth, so an opened file keeps the pools' locality */
+    uint64_t data_size = 0;
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        const hg_pool_t* pool = &hgfs.pools[p];
+        for (uint32_t i = 0; i < pool->count; i++) {
+            offset[pool->slots[i]] = data_size;
+            data_size += file_span(node_at(pool->slots[i])->tensor);
+        }
+    }
+    
+    hg_file_header_t hdr = {
+        .magic = HGFS_FILE_MAGIC,
+        .version = HGFS_FILE_VERSION,
+        .n_nodes = hgfs.nodes.live,
+        .n_edges = hgfs.edges.live,
+        .node_ids = hgfs.nodes.n_ids,
+        .edge_ids = hgfs.edges.n_ids,
+        .wal_lsn = wal_lsn,
+    };
+    hdr.nodes_off = HGFS_FILE_ALIGN;
+    hdr.edges_off = file_align(hdr.nodes_off + (uint64_t)hdr.n_nodes * sizeof(hg_file_node_t),
+                               HGFS_FILE_ALIGN);
+    hdr.node_gen_off = file_align(hdr.edges_off + (uint64_t)hdr.n_edges * sizeof(hg_file_edge_t),
+                                  HGFS_FILE_ALIGN);
+    hdr.edge_gen_off = file_align(hdr.node_gen_off + (uint64_t)hdr.node_ids * sizeof(uint32_t),
+                                  HGFS_FILE_ALIGN);
+    hdr.data_off = file_align(hdr.edge_gen_off + (uint64_t)hdr.edge_ids * sizeof(uint32_t),
+                              HGFS_FILE_ALIGN);
+    hdr.file_size = hdr.data_off + data_size;
+    
+    /* Write a temporary file and rename it over path, so readers (and this
+     * process's own mapping) keep the old file */
+    int ret = -1;
+    FILE* f = fopen(tmp, "wb");
+    if (f) {
+        bool ok = file_write(f, &hdr, remap, offset);
+        ok = fflush(f) == 0 && ok;
+        ok = fsync(fileno(f)) == 0 && ok;
+        ok = fclose(f) == 0 && ok;
+        
+        if (ok && rename(tmp, path) == 0) {
+            ret = 0;
+        } else {
+            unlink(tmp);
+        }
+    }
+    
+    free(remap);
+    free(offset);
+    free(tmp);
+    return ret;
+}
+
+/**
+ * Save the graph to a file
+ */
+int hgfs_save(const char* path) {
+    if (!hgfs.initialized || !path || !HGFS_FILE_NATIVE) {
+        return -1;
+    }
+    
+    return file_save(path, hgfs.logging ? wal_last_lsn() : hgfs.checkpoint_lsn);
+}
+
+/* A section of count records of the given size lies within the file */
+static bool file_section_ok(uint64_t off, uint64_t count, uint64_t size, uint64_t file_size) {
+    return off % HGFS_FILE_ALIGN == 0 && off <= file_size && count <= (file_size - off) / size;
+}
+
+/**
+ * Validate a mapped file before anything is loaded from it
+ */
+static bool file_check(const uint8_t* map, size_t size) {
+    const hg_file_header_t* hdr = (const hg_file_header_t*)map;
+    
+    if (size < sizeof(*hdr) || hdr->magic != HGFS_FILE_MAGIC ||
+        hdr->version != HGFS_FILE_VERSION || hdr->file_size != size ||
+        hdr->node_ids > HGFS_FILE_MAX_IDS || hdr->edge_ids > HGFS_FILE_MAX_IDS ||
+        hdr->n_nodes > hdr->node_ids || hdr->n_edges > hdr->edge_ids) {
+        return false;
+    }
+    
+    if (!file_section_ok(hdr->nodes_off, hdr->n_nodes, sizeof(hg_file_node_t), size) ||
+        !file_section_ok(hdr->edges_off, hdr->n_edges, sizeof(hg_file_edge_t), size) ||
+        !file_section_ok(hdr->node_gen_off, hdr->node_ids, sizeof(uint32_t), size) ||
+        !file_section_ok(hdr->edge_gen_off, hdr->edge_ids, sizeof(uint32_t), size) ||
+        !file_section_ok(hdr->data_off, 0, 1, size)) {
+        return false;
+    }
+    
+    uint64_t data_size = size - hdr->data_off;
+    const hg_file_node_t* nodes = (const hg_file_node_t*)(map + hdr->nodes_off);
+    for (uint32_t i = 0; i < hdr->n_nodes; i++) {
+        if (nodes[i].id >= hdr->node_ids || nodes[i].offset % HGFS_DATA_ALIGN != 0 ||
+            nodes[i].offset > data_size ||
+            nodes[i].n_elements > (data_size - nodes[i].offset) / sizeof(float)) {
+            return false;
+        }
+    }
+    
+    const hg_file_edge_t* edges = (const hg_file_edge_t*)(map + hdr->edges_off);
+    for (uint32_t i = 0; i < hdr->n_edges; i++) {
+        if (edges[i].id >= hdr->edge_ids || edges[i].node[0] >= hdr->n_nodes ||
+            edges[i].node[1] >= hdr->n_nodes) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+/**
+ * Build the graph from a validated mapping
+ */
+static bool file_load(void) {
+    const hg_file_header_t* hdr = (const hg_file_header_t*)hgfs.map;
+    const hg_file_node_t* nodes = (const hg_file_node_t*)(hgfs.map + hdr->nodes_off);
+    const hg_file_edge_t* edges = (const hg_file_edge_t*)(hgfs.map + hdr->edges_off);
+    
+    if (!slab_restore(&hgfs.nodes, (const uint8_t*)nodes, sizeof(*nodes), hdr->n_nodes,
+                      (const uint32_t*)(hgfs.map + hdr->node_gen_off), hdr->node_ids) ||
+        !slab_restore(&hgfs.edges, (const uint8_t*)edges, sizeof(*edges), hdr->n_edges,
+                      (const uint32_t*)(hgfs.map + hdr->edge_gen_off), hdr->edge_ids)) {
+        return false;
+    }
+    
+    /* Tensor headers only; data stays in the mapping */
+    if (hdr->n_nodes > 0) {
+        struct ggml_init_params params = {
+            .mem_size = (size_t)hdr->n_nodes * ggml_tensor_overhead(),
+            .mem_buffer = NULL,
+            .no_alloc = true,
+        };
+        hgfs.map_ctx = ggml_init(params);
+        if (!hgfs.map_ctx) {
+            return false;
+        }
+    }
+    
+    for (uint32_t s = 0; s < hdr->n_nodes; s++) {
+        struct ggml_tensor* t = ggml_new_tensor_1d(hgfs.map_ctx, GGML_TYPE_F32,
+                                                   (int64_t)nodes[s].n_elements);
+        if (!t) {
+            return false;
+        }
+        t->data = hgfs.map + hdr->data_off + nodes[s].offset;
+        
+        hg_node_t* node = node_at(s);
+        node->tensor = t;
+        node->depth = nodes[s].depth;
+        node->head[0] = ADJ_NIL;
+        node->head[1] = ADJ_NIL;
+        node->mark = 0;
+        
+        hg_pool_t* pool = pool_get(nodes[s].depth);
+        if (!pool || !pool_join(pool, s)) {
+            return false;
+        }
+    }
+    pool_sort_all();
+    
+    for (uint32_t e = 0; e < hdr->n_edges; e++) {
+        hg_edge_t* edge = edge_at(e);
+        edge->node[0] = edges[e].node[0];
+        edge->node[1] = edges[e].node[1];
+        edge->weight = edges[e].weight;
+    }
+    
+    uint32_t cap = PTR_TABLE_MIN;
+    while ((size_t)cap < (size_t)hdr->n_nodes * 2) {
+        cap *= 2;
+    }
+    if (!ptr_rehash(cap) || !adj_reserve(hdr->n_nodes, hdr->n_edges)) {
+        return false;
+    }
+    adj_build();
+    
+    return true;
+}
+
+/**
+ * Open a graph file
+ */
+int hgfs_open(const char* path) {
+    if (!hgfs.initialized || !path || !HGFS_FILE_NATIVE || hgfs.map ||
+        hgfs.nodes.n_ids > 0 || hgfs.edges.n_ids > 0) {
+        return -1;
+    }
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(hg_file_header_t)) {
+        close(fd);
+        return -1;
+    }
+    
+    /* Private mapping: pages load on first touch and writes never reach the file */
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    
+    if (!file_check((const uint8_t*)map, size)) {
+        munmap(map, size);
+        return -1;
+    }
+    
+    /* Records are read now; payloads wait until touched */
+    const hg_file_header_t* hdr = (const hg_file_header_t*)map;
+    madvise(map, hdr->data_off, MADV_WILLNEED);
+    
+    hgfs.map = (uint8_t*)map;
+    hgfs.map_size = size;
+    hgfs.checkpoint_lsn = hdr->wal_lsn;
+    
+    if (!file_load()) {
+        struct ggml_context* ctx = hgfs.ctx;
+        hgfs_close();
+        hgfs_init(ctx);
+        return -1;
+    }
+    
+    /* Loaded nodes bypass the export hooks */
+    for (hgfs_matrix_t* m = hgfs.matrices; m; m = m->next) {
+        m->rebuild = true;
+    }
+    
+    return 0;
+}
+
+/**
+ * Release all HGFS storage
+ */
+int hgfs_close(void) {
+    if (!hgfs.initialized || hgfs.iters > 0) {
+        return -1;
+    }
+    
+    if (hgfs.logging) {
+        hgfs_wal_stop();
+    }
+    
+    for (hgfs_matrix_t* m = hgfs.matrices; m; m = m->next) {
+        m->attached = false;
+    }
+    
+    hg_slab_t* slabs[2] = {&hgfs.nodes, &hgfs.edges};
+    for (int i = 0; i < 2; i++) {
+        hg_slab_t* slab = slabs[i];
+        for (uint32_t c = 0; c < slab->n_chunks; c++) {
+            free(slab->chunks[c]);
+        }
+        free(slab->chunks);
+        free(slab->free_slots);
+        free(slab->id_slot);
+        free(slab->id_gen);
+        free(slab->free_ids);
+    }
+    
+    for (int d = 0; d < ADJ_DIRS; d++) {
+        free(hgfs.csr[d].offset);
+        free(hgfs.csr[d].edges);
+    }
+    free(hgfs.ptr_table);
+    
+    for (uint32_t p = 0; p < hgfs.n_pools; p++) {
+        hg_pool_t* pool = &hgfs.pools[p];
+        for (uint32_t c = 0; c < pool->n_chunks; c++) {
+            free(pool->chunks[c]);
+        }
+        free(pool->chunks);
+        free(pool->handles);
+        free(pool->data);
+        free(pool->sizes);
+        free(pool->slots);
+    }
+    free(hgfs.pools);
+    for (uint32_t c = 0; c < hgfs.n_header_ctx; c++) {
+        ggml_free(hgfs.header_ctx[c]);
+    }
+    free(hgfs.header_ctx);
+    
+    if (hgfs.map_ctx) {
+        ggml_free(hgfs.map_ctx);
+    }
+    if (hgfs.map) {
+        munmap(hgfs.map, hgfs.map_size);
+    }
+    
+    memset(&hgfs, 0, sizeof(hgfs));
+    return 0;
+}
+
+/**
+ * Apply a recovered log record
+ */
+static bool wal_replay(uint32_t type, const void* body, size_t size) {
+    uint64_t handle;
+    if (size < sizeof(handle)) {
+        return false;
+    }
+    memcpy(&handle, body, sizeof(handle));
+    
+    switch (type) {
+    case WAL_REC_ALLOC: {
+        hg_wal_alloc_t rec;
+        if (size != sizeof(rec)) {
+            return false;
+        }
+        memcpy(&rec, body, sizeof(rec));
+        
+        uint32_t slot = slab_alloc_handle(&hgfs.nodes, rec.handle);
+        if (slot == SLOT_NIL || !node_init(slot, (int64_t)rec.n_elements, rec.depth)) {
+            return false;
+        }
+        
+        /* Contents come from later data records */
+        struct ggml_tensor* t = node_at(slot)->tensor;
+        memset(t->data, 0, ggml_nbytes(t));
+        return true;
+    }
+    
+    case WAL_REC_EDGE: {
+        hg_wal_edge_t rec;
+        if (size != sizeof(rec)) {
+            return false;
+        }
+        memcpy(&rec, body, sizeof(rec));
+        
+        uint32_t src = slab_lookup(&hgfs.nodes, rec.node[0]);
+        uint32_t dst = slab_lookup(&hgfs.nodes, rec.node[1]);
+        if (src == SLOT_NIL || dst == SLOT_NIL) {
+            return false;
+        }
+        
+        uint32_t idx = slab_alloc_handle(&hgfs.edges, rec.handle);
+        if (idx == SLOT_NIL) {
+            return false;
+        }
+        edge_init(idx, src, dst, rec.weight);
+        return true;
+    }
+    
+    case WAL_REC_FREE: {
+        uint32_t slot = slab_lookup(&hgfs.nodes, handle);
+        if (slot == SLOT_NIL) {
+            return false;
+        }
+        node_delete(slot);
+        return true;
+    }
+    
+    case WAL_REC_EDGE_REMOVE: {
+        uint32_t e = slab_lookup(&hgfs.edges, handle);
+        if (e == SLOT_NIL) {
+            return false;
+        }
+        adj_unlink(e, SLOT_NIL);
+        slab_free(&hgfs.edges, e);
+        return true;
+    }
+    
+    case WAL_REC_DATA: {
+        uint32_t slot = slab_lookup(&hgfs.nodes, handle);
+        if (slot == SLOT_NIL) {
+            return false;
+        }
+        struct ggml_tensor* t = node_at(slot)->tensor;
+        size_t n = size - sizeof(handle);
+        memcpy(t->data, (const uint8_t*)body + sizeof(handle), n < ggml_nbytes(t) ? n : ggml_nbytes(t));
+        return true;
+    }
+    
+    default:
+        return false;
+    }
+}
+
+/**
+ * Recover from a write-ahead log and log every mutation to it
+ */
+int hgfs_wal_start(const char* path, const hgfs_wal_config_t* config) {
+    if (!hgfs.initialized || !path || hgfs.logging || hgfs.iters > 0) {
+        return -1;
+    }
+    
+    hgfs_wal_config_t cfg = config ? *config : (hgfs_wal_config_t){0};
+    if (cfg.commit_interval_us == 0) {
+        cfg.commit_interval_us = HGFS_WAL_COMMIT_US;
+    }
+    if (cfg.checkpoint_bytes == 0) {
+        cfg.checkpoint_bytes = HGFS_CHECKPOINT_BYTES;
+    }
+    if (cfg.checkpoint_interval_us == 0) {
+        cfg.checkpoint_interval_us = HGFS_CHECKPOINT_INTERVAL_US;
+    }
+    
+    size_t path_len = strlen(path);
+    char* wal_path = (char*)malloc(path_len + 1);
+    char* log_path = (char*)malloc(path_len + 5);
+    if (!wal_path || !log_path) {
+        free(wal_path);
+        free(log_path);
+        return -1;
+    }
+    memcpy(wal_path, path, path_len + 1);
+    memcpy(log_path, path, path_len);
+    memcpy(log_path + path_len, ".wal", 5);
+    
+    /* Replay assigns the logged handles; free ids are recomputed after */
+    hgfs.nodes.replay = true;
+    hgfs.edges.replay = true;
+    int ret = wal_open(log_path, hgfs.checkpoint_lsn, cfg.commit_interval_us, wal_replay);
+    hgfs.nodes.replay = false;
+    hgfs.edges.replay = false;
+    slab_rebuild_free_ids(&hgfs.nodes);
+    slab_rebuild_free_ids(&hgfs.edges);
+    free(log_path);
+    
+    if (ret != 0) {
+        free(wal_path);
+        return -1;
+    }
+    
+    hgfs.logging = true;
+    hgfs.wal_path = wal_path;
+    hgfs.wal_config = cfg;
+    hgfs.checkpoint_us = kern_now_us();
+    
+    return 0;
+}
+
+/**
+ * Commit the log and stop logging
+ */
+int hgfs_wal_stop(void) {
+    if (!hgfs.initialized || !hgfs.logging) {
+        return -1;
+    }
+    
+    hgfs_wal_stats_t stats;
+    wal_get_stats(&stats);
+    wal_close();
+    
+    hgfs.logging = false;
+    free(hgfs.wal_path);
+    hgfs.wal_path = NULL;
+    
+    return stats.failed ? -1 : 0;
+}
+
+/**
+ * Wait until every logged mutation is durable
+ */
+int hgfs_sync(void) {
+    if (!hgfs.initialized || !hgfs.logging) {
+        return -1;
+    }
+    
+    return wal_sync();
+}
+
+/**
+ * Log the current contents of node memory
+ */
+int hgfs_log_data(void* data) {
+    if (!hgfs.initialized || !hgfs.logging) {
+        return -1;
+    }
+    
+    uint32_t slot = ptr_find(data, NULL);
+    if (slot == SLOT_NIL) {
+        return -1;
+    }
+    
+    uint64_t handle = slab_handle(&hgfs.nodes, slot);
+    struct ggml_tensor* t = node_at(slot)->tensor;
+    return wal_append(WAL_REC_DATA, &handle, sizeof(handle), t->data, ggml_nbytes(t)) ? 0 : -1;
+}
+
+/**
+ * Save the graph file and empty the log
+ */
+int hgfs_checkpoint(void) {
+    if (!hgfs.initialized || !hgfs.logging) {
+        return -1;
+    }
+    
+    uint64_t lsn = wal_last_lsn();
+    if (file_save(hgfs.wal_path, lsn) != 0) {
+        return -1;
+    }
+    
+    hgfs.checkpoint_lsn = lsn;
+    hgfs.checkpoints++;
+    hgfs.checkpoint_us = kern_now_us();
+    
+    /* A crash before the log is emptied only leaves records the file already holds */
+    return wal_truncate(lsn);
+}
+
+/**
+ * Get write-ahead log statistics
+ */
+int hgfs_wal_stats(hgfs_wal_stats_t* stats) {
+    if (!hgfs.initialized || !hgfs.logging || !stats) {
+        return -1;
+    }
+    
+    wal_get_stats(stats);
+    stats->checkpoint_lsn = hgfs.checkpoint_lsn;
+    stats->checkpoints = hgfs.checkpoints;
+    stats->checkpoint_due = stats->lsn > hgfs.checkpoint_lsn &&
+                            (stats->log_bytes >= hgfs.wal_config.checkpoint_bytes ||
+                             kern_now_us() - hgfs.checkpoint_us >=
+                                 hgfs.wal_config.checkpoint_interval_us);
+    
+    return 0;
 }
@@ -0,0 +1,128 @@
+/**
+ * @file internal.h
+ * @brief Kernel-private interfaces shared between kernel translation units
+ */
+
+#ifndef AICHAT_KERNEL_INTERNAL_H
+#define AICHAT_KERNEL_INTERNAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aichat/kernel.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Monotonic clock in microseconds
+ */
+uint64_t kern_now_us(void);
+
+/**
+ * Monotonic clock in nanoseconds
+ */
+uint64_t kern_now_ns(void);
+
+/**
+ * Reset the timer wheel (called by dtesn_sched_init)
+ */
+void timer_init(void);
+
+/**
+ * Dispatch every timer due at now_us into the scheduler
+ * @param now_us Current monotonic time
+ * @return Number of timers dispatched
+ */
+int timer_advance(uint64_t now_us);
+
+/**
+ * Earliest time the timer wheel needs servicing
+ * @return Monotonic time in µs, or UINT64_MAX if no timer is armed
+ */
+uint64_t timer_next_deadline_us(void);
+
+/**
+ * Wake a thread blocked in dtesn_sched_wait
+ */
+void sched_wake(void);
+
+/* HGFS write-ahead log (wal.c) */
+
+/** Log record types */
+enum {
+    WAL_REC_ALLOC = 1,          /* hg_wal_alloc_t */
+    WAL_REC_EDGE = 2,           /* hg_wal_edge_t */
+    WAL_REC_FREE = 3,           /* Node handle */
+    WAL_REC_EDGE_REMOVE = 4,    /* Edge handle */
+    WAL_REC_DATA = 5,           /* Node handle, then node memory */
+};
+
+/**
+ * Apply one recovered record
+ * @return false to abort recovery
+ */
+typedef bool (*wal_apply_fn)(uint32_t type, const void* body, size_t size);
+
+/**
+ * Open a log, replay records after from_lsn and start the commit thread
+ * @param path Log file (created if missing)
+ * @param from_lsn Last LSN already contained in the graph
+ * @param commit_interval_us Group commit window
+ * @param apply Record replay callback
+ * @return 0 on success, negative on error
+ */
+int wal_open(const char* path, uint64_t from_lsn, uint32_t commit_interval_us,
+             wal_apply_fn apply);
+
+/**
+ * Commit everything appended, stop the commit thread and close the log
+ */
+void wal_close(void);
+
+/**
+ * Whether a log is open
+ */
+bool wal_is_open(void);
+
+/**
+ * Append a record without waiting for I/O
+ * @param type Record type
+ * @param body Record body
+ * @param size Body size
+ * @param extra Bytes appended to the body (can be NULL)
+ * @param extra_size Size of extra
+ * @return LSN, or 0 if the record was lost
+ */
+uint64_t wal_append(uint32_t type, const void* body, size_t size, const void* extra,
+                    size_t extra_size);
+
+/**
+ * Wait until every appended record is durable
+ * @return 0 on success, negative if a record was lost
+ */
+int wal_sync(void);
+
+/**
+ * Last LSN handed out
+ */
+uint64_t wal_last_lsn(void);
+
+/**
+ * Empty the log once a checkpoint contains everything up to lsn
+ * @param lsn Last LSN in the checkpoint (must be the last appended)
+ * @return 0 on success, negative on error
+ */
+int wal_truncate(uint64_t lsn);
+
+/**
+ * Fill the log counters of HGFS WAL statistics
+ */
+void wal_get_stats(hgfs_wal_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AICHAT_KERNEL_INTERNAL_H */
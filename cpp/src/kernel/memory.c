@@ -8,12 +8,20 @@
 
 #include "aichat/kernel.h"
 #include <ggml.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define HEAP_SIZE_DEFAULT (64 * 1024 * 1024)  /* 64 MB */
 #define ALIGNMENT 64  /* 64-byte alignment for SIMD */
 
+#define TENSOR_SLAB_SIZE (4 * 1024 * 1024)  /* Smaller slots share slabs of this size */
+#define TENSOR_MIN_CLASS 6                  /* Smallest slot: 64 bytes */
+#define TENSOR_HEADERS 256                  /* Tensor headers per ggml context */
+
 /* Memory block header */
 typedef struct mem_block {
     size_t size;
@@ -23,18 +31,164 @@ typedef struct mem_block {
     uint8_t alignment_padding[48];  /* Ensure 64-byte alignment */
 } mem_block_t;
 
-/* Memory subsystem state */
+/*
+ * Per-thread usage counters
+ * 
+ * Each thread owns one block and is its only writer; relaxed atomics let
+ * dtesn_mem_stats() sum them from another thread without locking the
+ * allocation path. Blocks are never freed so counts from exited threads
+ * stay in the totals. Only monotonic counters live here: memory freed on
+ * another thread than allocated it would skew any per-thread live figure.
+ */
+typedef struct mem_thread_stats {
+    atomic_uint_fast64_t alloc_count[MEM_REGION_COUNT];
+    atomic_uint_fast64_t free_count[MEM_REGION_COUNT];
+    atomic_uint_fast64_t failed_count;
+    atomic_uint_fast64_t histogram[MEM_HIST_BUCKETS];
+    struct mem_thread_stats* next;
+} mem_thread_stats_t;
+
+static _Thread_local mem_thread_stats_t* tls_stats = NULL;
+
+/* Memory subsystem state; the lock guards the heap and its free list */
 static struct {
+    pthread_mutex_t lock;
     void* heap_base;
     size_t heap_size;
     mem_block_t* free_list;
+    size_t live_bytes[MEM_REGION_COUNT];    /* Heap and tensor pool, under the lock */
+    size_t peak_bytes[MEM_REGION_COUNT];
+    _Atomic(mem_thread_stats_t*) stats_list;
+    atomic_bool histogram;
     bool initialized;
-} memory = {0};
+} memory = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/*
+ * Tensor pool
+ * 
+ * Slots are carved from slabs that are never returned, so the pool only
+ * grows to its peak working set. A free slot links to the next one through
+ * its first bytes, and keeps its tensor header for the next tensor of its
+ * class.
+ */
+static struct {
+    pthread_mutex_t lock;
+    struct ggml_tensor* free[MEM_TENSOR_CLASSES];
+    uint32_t n_free[MEM_TENSOR_CLASSES];
+    uint8_t* slab;                  /* Newest shared slab */
+    size_t slab_left;
+    struct ggml_context* headers;   /* Newest header context */
+    uint32_t headers_left;
+    size_t slab_bytes;
+    size_t live_bytes;
+    uint64_t live_tensors;
+    uint64_t reused_count;
+} tensor_pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
 
 /**
- * Initialize memory subsystem
+ * Get (and on first use register) the calling thread's counters
  */
-int dtesn_mem_init(size_t heap_size) {
+static mem_thread_stats_t* mem_thread_stats(void) {
+    mem_thread_stats_t* ts = tls_stats;
+    if (ts) {
+        return ts;
+    }
+    
+    ts = (mem_thread_stats_t*)calloc(1, sizeof(mem_thread_stats_t));
+    if (!ts) {
+        return NULL;
+    }
+    
+    ts->next = atomic_load_explicit(&memory.stats_list, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&memory.stats_list, &ts->next, ts,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    
+    tls_stats = ts;
+    return ts;
+}
+
+/**
+ * Add to a counter owned by the calling thread
+ */
+static inline void stat_add(atomic_uint_fast64_t* counter, uint64_t n) {
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
+}
+
+/**
+ * Histogram bucket for an allocation size: floor(log2(size))
+ */
+static inline unsigned hist_bucket(size_t size) {
+    unsigned b = 0;
+    while (size > 1 && b < MEM_HIST_BUCKETS - 1) {
+        size >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/**
+ * Account live bytes of a new allocation; called with the heap locked
+ */
+static void live_add(size_t size, mem_region_t region) {
+    memory.live_bytes[region] += size;
+    if (memory.live_bytes[region] > memory.peak_bytes[region]) {
+        memory.peak_bytes[region] = memory.live_bytes[region];
+    }
+}
+
+/**
+ * Account live bytes of a free; called with the heap locked
+ */
+static void live_sub(size_t size, mem_region_t region) {
+    memory.live_bytes[region] -= size;
+}
+
+/**
+ * Record a successful allocation
+ */
+static void stats_on_alloc(size_t size, mem_region_t region) {
+    mem_thread_stats_t* ts = mem_thread_stats();
+    if (!ts) {
+        return;
+    }
+    
+    stat_add(&ts->alloc_count[region], 1);
+    
+    if (atomic_load_explicit(&memory.histogram, memory_order_relaxed)) {
+        stat_add(&ts->histogram[hist_bucket(size)], 1);
+    }
+}
+
+/**
+ * Record a free
+ */
+static void stats_on_free(mem_region_t region) {
+    mem_thread_stats_t* ts = mem_thread_stats();
+    if (!ts) {
+        return;
+    }
+    
+    stat_add(&ts->free_count[region], 1);
+}
+
+/**
+ * Record a failed allocation
+ */
+static void stats_on_fail(void) {
+    mem_thread_stats_t* ts = mem_thread_stats();
+    if (ts) {
+        stat_add(&ts->failed_count, 1);
+    }
+}
+
+/**
+ * Set up the heap; called with the heap locked
+ */
+static int mem_heap_init(size_t heap_size) {
     if (memory.initialized) {
         return 0;
     }
@@ -63,19 +217,34 @@ int dtesn_mem_init(size_t heap_size) {
     return 0;
 }
 
+/**
+ * Initialize memory subsystem
+ */
+int dtesn_mem_init(size_t heap_size) {
+    pthread_mutex_lock(&memory.lock);
+    int ret = mem_heap_init(heap_size);
+    pthread_mutex_unlock(&memory.lock);
+    
+    return ret;
+}
+
 /**
  * Allocate memory with tensor backing
  */
 void* dtesn_mem_alloc(size_t size, mem_region_t region) {
-    if (!memory.initialized) {
-        if (dtesn_mem_init(0) != 0) {
-            return NULL;
-        }
+    if ((unsigned)region >= MEM_REGION_COUNT) {
+        return NULL;
     }
     
     /* Align size to 64 bytes */
     size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
     
+    pthread_mutex_lock(&memory.lock);
+    if (mem_heap_init(0) != 0) {
+        pthread_mutex_unlock(&memory.lock);
+        return NULL;
+    }
+    
     /* Find suitable block in free list */
     mem_block_t* prev = NULL;
     mem_block_t* curr = memory.free_list;
@@ -98,6 +267,11 @@ void* dtesn_mem_alloc(size_t size, mem_region_t region) {
                 curr->next = new_block;
             }
             
+            size_t block_size = curr->size;
+            live_add(block_size, region);
+            pthread_mutex_unlock(&memory.lock);
+            stats_on_alloc(block_size, region);
+            
             /* Return pointer after header */
             return (void*)((uint8_t*)curr + sizeof(mem_block_t));
         }
@@ -105,7 +279,9 @@ void* dtesn_mem_alloc(size_t size, mem_region_t region) {
         prev = curr;
         curr = curr->next;
     }
+    pthread_mutex_unlock(&memory.lock);
     
+    stats_on_fail();
     return NULL;
 }
 
@@ -113,7 +289,13 @@ void* dtesn_mem_alloc(size_t size, mem_region_t region) {
  * Free memory
  */
 void dtesn_mem_free(void* ptr) {
-    if (!ptr || !memory.initialized) {
+    if (!ptr) {
+        return;
+    }
+    
+    pthread_mutex_lock(&memory.lock);
+    if (!memory.initialized) {
+        pthread_mutex_unlock(&memory.lock);
         return;
     }
     
@@ -121,10 +303,13 @@ void dtesn_mem_free(void* ptr) {
     mem_block_t* block = (mem_block_t*)((uint8_t*)ptr - sizeof(mem_block_t));
     
     if (!block->allocated) {
+        pthread_mutex_unlock(&memory.lock);
         return;  /* Double free protection */
     }
     
     block->allocated = false;
+    mem_region_t region = block->region;
+    live_sub(block->size, region);
     
     /* Coalesce adjacent free blocks */
     mem_block_t* curr = memory.free_list;
@@ -137,4 +322,322 @@ void dtesn_mem_free(void* ptr) {
             curr = curr->next;
         }
     }
+    pthread_mutex_unlock(&memory.lock);
+    
+    stats_on_free(region);
+}
+
+/**
+ * Size class of a tensor: the smallest power-of-two slot that holds it
+ */
+static unsigned tensor_class(size_t size) {
+    unsigned c = TENSOR_MIN_CLASS;
+    while (c < MEM_TENSOR_CLASSES && ((size_t)1 << c) < size) {
+        c++;
+    }
+    return c;
+}
+
+/**
+ * Carve a new slot; called with the pool locked
+ */
+static void* tensor_slot_carve(size_t slot_size) {
+    if (slot_size > TENSOR_SLAB_SIZE) {
+        void* data = aligned_alloc(ALIGNMENT, slot_size);
+        if (data) {
+            tensor_pool.slab_bytes += slot_size;
+        }
+        return data;
+    }
+    
+    /* A slab tail too short for the slot is abandoned */
+    if (tensor_pool.slab_left < slot_size) {
+        uint8_t* slab = (uint8_t*)aligned_alloc(ALIGNMENT, TENSOR_SLAB_SIZE);
+        if (!slab) {
+            return NULL;
+        }
+        tensor_pool.slab = slab;
+        tensor_pool.slab_left = TENSOR_SLAB_SIZE;
+        tensor_pool.slab_bytes += TENSOR_SLAB_SIZE;
+    }
+    
+    void* data = tensor_pool.slab;
+    tensor_pool.slab += slot_size;
+    tensor_pool.slab_left -= slot_size;
+    return data;
+}
+
+/**
+ * Allocate a tensor header; called with the pool locked
+ */
+static struct ggml_tensor* tensor_header_new(enum ggml_type type, int64_t ne0, int64_t ne1) {
+    if (tensor_pool.headers_left == 0) {
+        struct ggml_init_params params = {
+            .mem_size = TENSOR_HEADERS * ggml_tensor_overhead(),
+            .mem_buffer = NULL,
+            .no_alloc = true,
+        };
+        struct ggml_context* headers = ggml_init(params);
+        if (!headers) {
+            return NULL;
+        }
+        tensor_pool.headers = headers;
+        tensor_pool.headers_left = TENSOR_HEADERS;
+    }
+    
+    struct ggml_tensor* t = ggml_new_tensor_2d(tensor_pool.headers, type, ne0, ne1);
+    if (t) {
+        tensor_pool.headers_left--;
+    }
+    return t;
+}
+
+/**
+ * Allocate a tensor from the tensor pool
+ */
+struct ggml_tensor* dtesn_mem_tensor_alloc(int type, int64_t ne0, int64_t ne1) {
+    if (type < 0 || type >= GGML_TYPE_COUNT || ne0 <= 0 || ne1 <= 0) {
+        return NULL;
+    }
+    
+    enum ggml_type t_type = (enum ggml_type)type;
+    int64_t blck = ggml_blck_size(t_type);
+    if (blck <= 0 || ne0 % blck != 0) {
+        return NULL;
+    }
+    
+    size_t row_size = ggml_row_size(t_type, ne0);
+    if (row_size == 0 || (size_t)ne1 > SIZE_MAX / row_size) {
+        return NULL;
+    }
+    
+    unsigned c = tensor_class(row_size * (size_t)ne1);
+    if (c >= MEM_TENSOR_CLASSES) {
+        stats_on_fail();
+        return NULL;
+    }
+    size_t slot_size = (size_t)1 << c;
+    
+    pthread_mutex_lock(&tensor_pool.lock);
+    
+    struct ggml_tensor* t = tensor_pool.free[c];
+    if (t) {
+        memcpy(&tensor_pool.free[c], t->data, sizeof(t));
+        tensor_pool.n_free[c]--;
+        tensor_pool.reused_count++;
+        
+        /* Nothing of the previous tensor survives but its slot: op, sources, name, flags */
+        void* data = t->data;
+        memset(t, 0, sizeof(*t));
+        t->data = data;
+        
+        /* Re-key the header for this type and shape */
+        t->type = t_type;
+        t->ne[0] = ne0;
+        t->ne[1] = ne1;
+        t->ne[2] = 1;
+        t->ne[3] = 1;
+        t->nb[0] = ggml_type_size(t_type);
+        t->nb[1] = row_size;
+        t->nb[2] = row_size * (size_t)ne1;
+        t->nb[3] = t->nb[2];
+    } else {
+        t = tensor_header_new(t_type, ne0, ne1);
+        void* data = t ? tensor_slot_carve(slot_size) : NULL;
+        if (!data) {
+            pthread_mutex_unlock(&tensor_pool.lock);
+            stats_on_fail();
+            return NULL;
+        }
+        t->data = data;
+    }
+    
+    tensor_pool.live_bytes += slot_size;
+    tensor_pool.live_tensors++;
+    pthread_mutex_unlock(&tensor_pool.lock);
+    
+    pthread_mutex_lock(&memory.lock);
+    live_add(slot_size, MEM_REGION_TENSOR);
+    pthread_mutex_unlock(&memory.lock);
+    
+    stats_on_alloc(slot_size, MEM_REGION_TENSOR);
+    return t;
+}
+
+/**
+ * Return a tensor to the tensor pool
+ */
+void dtesn_mem_tensor_free(struct ggml_tensor* tensor) {
+    if (!tensor) {
+        return;
+    }
+    
+    unsigned c = tensor_class(ggml_nbytes(tensor));
+    size_t slot_size = (size_t)1 << c;
+    
+    pthread_mutex_lock(&tensor_pool.lock);
+    memcpy(tensor->data, &tensor_pool.free[c], sizeof(tensor));
+    tensor_pool.free[c] = tensor;
+    tensor_pool.n_free[c]++;
+    tensor_pool.live_bytes -= slot_size;
+    tensor_pool.live_tensors--;
+    pthread_mutex_unlock(&tensor_pool.lock);
+    
+    pthread_mutex_lock(&memory.lock);
+    live_sub(slot_size, MEM_REGION_TENSOR);
+    pthread_mutex_unlock(&memory.lock);
+    
+    stats_on_free(MEM_REGION_TENSOR);
+}
+
+/**
+ * Fill the tensor pool part of the statistics
+ */
+static void tensor_pool_stats(mem_tensor_stats_t* stats) {
+    pthread_mutex_lock(&tensor_pool.lock);
+    stats->slab_bytes = tensor_pool.slab_bytes;
+    stats->live_bytes = tensor_pool.live_bytes;
+    stats->live_tensors = tensor_pool.live_tensors;
+    stats->reused_count = tensor_pool.reused_count;
+    for (unsigned c = 0; c < MEM_TENSOR_CLASSES; c++) {
+        stats->free_slots[c] = tensor_pool.n_free[c];
+        stats->free_bytes += (size_t)tensor_pool.n_free[c] << c;
+    }
+    pthread_mutex_unlock(&tensor_pool.lock);
+}
+
+/**
+ * Collect heap usage statistics
+ */
+int dtesn_mem_stats(mem_stats_t* stats) {
+    if (!stats) {
+        return -1;
+    }
+    
+    memset(stats, 0, sizeof(*stats));
+    tensor_pool_stats(&stats->tensors);
+    
+    pthread_mutex_lock(&memory.lock);
+    if (!memory.initialized) {
+        pthread_mutex_unlock(&memory.lock);
+        return -1;
+    }
+    
+    stats->heap_size = memory.heap_size;
+    
+    /* Walk the heap for block-level figures */
+    for (mem_block_t* b = memory.free_list; b != NULL; b = b->next) {
+        stats->block_count++;
+        if (!b->allocated) {
+            stats->free_block_count++;
+            stats->free_bytes += b->size;
+            if (b->size > stats->largest_free_block) {
+                stats->largest_free_block = b->size;
+            }
+        }
+    }
+    for (int r = 0; r < MEM_REGION_COUNT; r++) {
+        stats->regions[r].live_bytes = memory.live_bytes[r];
+        stats->regions[r].peak_bytes = memory.peak_bytes[r];
+    }
+    pthread_mutex_unlock(&memory.lock);
+    
+    stats->fragmentation = stats->free_bytes > 0
+        ? 1.0f - (float)stats->largest_free_block / (float)stats->free_bytes
+        : 0.0f;
+    
+    /* Aggregate per-thread counters */
+    mem_thread_stats_t* ts = atomic_load_explicit(&memory.stats_list, memory_order_acquire);
+    for (; ts != NULL; ts = ts->next) {
+        for (int r = 0; r < MEM_REGION_COUNT; r++) {
+            stats->regions[r].alloc_count += atomic_load_explicit(&ts->alloc_count[r],
+                                                                  memory_order_relaxed);
+            stats->regions[r].free_count += atomic_load_explicit(&ts->free_count[r],
+                                                                 memory_order_relaxed);
+        }
+        stats->failed_count += atomic_load_explicit(&ts->failed_count, memory_order_relaxed);
+        for (int i = 0; i < MEM_HIST_BUCKETS; i++) {
+            stats->size_histogram[i] += atomic_load_explicit(&ts->histogram[i],
+                                                             memory_order_relaxed);
+        }
+    }
+    
+    for (int r = 0; r < MEM_REGION_COUNT; r++) {
+        mem_region_stats_t* rs = &stats->regions[r];
+        stats->alloc_count += rs->alloc_count;
+        stats->free_count += rs->free_count;
+    }
+    
+    return 0;
+}
+
+/**
+ * Enable or disable the allocation-size histogram
+ */
+void dtesn_mem_stats_histogram(bool enable) {
+    atomic_store_explicit(&memory.histogram, enable, memory_order_relaxed);
+}
+
+/**
+ * Print heap usage statistics to stdout
+ */
+void dtesn_mem_stats_print(void) {
+    static const char* region_names[MEM_REGION_COUNT] = {
+        "code", "data", "heap", "tensor"
+    };
+    
+    mem_stats_t stats;
+    if (dtesn_mem_stats(&stats) != 0) {
+        printf("[MEM] Memory subsystem not initialized\n");
+        return;
+    }
+    
+    printf("[MEM] heap %zu B, free %zu B in %zu/%zu blocks, largest %zu B, "
+           "fragmentation %.3f\n",
+           stats.heap_size, stats.free_bytes, stats.free_block_count,
+           stats.block_count, stats.largest_free_block, stats.fragmentation);
+    printf("[MEM] allocs %llu, frees %llu, failed %llu\n",
+           (unsigned long long)stats.alloc_count,
+           (unsigned long long)stats.free_count,
+           (unsigned long long)stats.failed_count);
+    
+    for (int r = 0; r < MEM_REGION_COUNT; r++) {
+        const mem_region_stats_t* rs = &stats.regions[r];
+        printf("[MEM]   %-6s live %zu B, peak %zu B, allocs %llu, frees %llu\n",
+               region_names[r], rs->live_bytes, rs->peak_bytes,
+               (unsigned long long)rs->alloc_count,
+               (unsigned long long)rs->free_count);
+    }
+    
+    const mem_tensor_stats_t* tp = &stats.tensors;
+    printf("[MEM] tensor pool: slabs %zu B, live %llu tensors in %zu B, free %zu B, "
+           "reused %llu\n",
+           tp->slab_bytes, (unsigned long long)tp->live_tensors, tp->live_bytes,
+           tp->free_bytes, (unsigned long long)tp->reused_count);
+    for (int c = 0; c < MEM_TENSOR_CLASSES; c++) {
+        if (tp->free_slots[c]) {
+            printf("[MEM]   2^%d B slots free %u\n", c, tp->free_slots[c]);
+        }
+    }
+    
+    for (int i = 0; i < MEM_HIST_BUCKETS; i++) {
+        if (stats.size_histogram[i]) {
+            printf("[MEM]   [2^%d, 2^%d) %llu\n", i, i + 1,
+                   (unsigned long long)stats.size_histogram[i]);
+        }
+    }
+}
+
+/**
+ * Allocate a coroutine frame
+ */
+void* dtesn_coro_frame_alloc(size_t size) {
+    return dtesn_mem_alloc(size, MEM_REGION_HEAP);
+}
+
+/**
+ * Free a coroutine frame
+ */
+void dtesn_coro_frame_free(void* frame) {
+    dtesn_mem_free(frame);
 }
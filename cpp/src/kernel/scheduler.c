@@ -3,18 +3,38 @@
  * @brief Membrane-aware task scheduler
  * 
  * Implements Echo.Kern scheduler with:
- * - Priority-based task execution
- * - Membrane depth tracking (OEIS A000081)
+ * - Priority-based task execution (O(1) per-priority FIFO ready queues)
+ * - Lock-free multi-producer submission, drained in batches by the tick
+ * - Delayed/periodic tasks via the timer wheel (timer.c)
+ * - Optional work-stealing executor (Chase-Lev deque per worker and level)
+ * - Task dependencies released by atomic counters (DAG execution)
+ * - Membrane depth waves (OEIS A000081): shallower depths run first
+ * - Earliest-deadline-first order within a wave
+ * - Tick budget: NORMAL/LOW work is deferred once the budget is spent
  * - Target: ≤5µs per tick
  */
 
 #include "aichat/kernel.h"
+#include "kernel/internal.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #define MAX_TASKS 1024
+#define SLOT_BITS 10  /* Handle = (sequence << SLOT_BITS) | slot */
+#define SLOT_MASK (MAX_TASKS - 1)
 #define PRIORITY_LEVELS 4
+#define DEPTH_WAVES 32  /* Depth buckets per level; deeper tasks share the last */
+#define MAX_EDGES (MAX_TASKS * 4)
+#define SLOT_NONE UINT32_MAX
+#define EDGE_NONE UINT32_MAX
+#define EDGE_CLOSED (UINT32_MAX - 1)  /* Successor list of a completed task */
+#define NO_DEADLINE UINT64_MAX
+#define DEFER_FROM PRIORITY_NORMAL  /* Levels from here down can be deferred */
+#define MAX_WORKERS 64
+#define STEAL_SPINS 64  /* Empty scans before a worker sleeps */
 
 /* Task structure */
 typedef struct {
@@ -23,17 +43,654 @@ typedef struct {
     task_priority_t priority;
     uint32_t depth;
     uint64_t handle;
+    uint64_t deadline_us;  /* Absolute monotonic deadline (NO_DEADLINE = none) */
+    uint32_t cost_us;      /* Estimated run time (0 = unknown) */
+    uint32_t next;  /* Next slot in submission/ready queue (SLOT_NONE = end) */
     bool active;
+    atomic_uint_fast32_t deps_pending;  /* Unfinished predecessors */
+    atomic_uint_fast64_t succ;          /* (handle tag << 32) | first successor edge */
+    atomic_uint_fast64_t path_ns;       /* Longest predecessor chain (profiling) */
 } task_t;
 
+_Static_assert(MAX_TASKS == 1 << SLOT_BITS, "slot must fit in the handle's low bits");
+
+/* Intrusive FIFO of task slots */
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    bool edf;  /* Holds a task with a deadline: sort before running */
+} ready_queue_t;
+
+/*
+ * Chase-Lev work-stealing deque of task slots
+ * 
+ * The owner pushes and takes at the bottom; other threads steal from the
+ * top. Capacity is MAX_TASKS because no more slots than that exist, so
+ * the buffer never grows.
+ */
+typedef struct {
+    atomic_int_fast64_t top;
+    atomic_int_fast64_t bottom;
+    atomic_uint_least32_t buf[MAX_TASKS];
+} ws_deque_t;
+
+/* Executor worker */
+typedef struct {
+    pthread_t thread;
+    ws_deque_t deques[PRIORITY_LEVELS];
+    unsigned id;
+    uint32_t rng;  /* Victim selection */
+} sched_worker_t;
+
 /* Scheduler state */
 static struct {
     task_t tasks[MAX_TASKS];
-    size_t task_count;
-    uint64_t next_handle;
+    ready_queue_t ready[PRIORITY_LEVELS][DEPTH_WAVES];  /* Owned by the tick thread */
+    uint32_t ready_mask[PRIORITY_LEVELS];  /* Bit d set when ready[prio][d] is non-empty */
+    uint32_t ready_count[PRIORITY_LEVELS];  /* Tasks queued per level */
+    atomic_uint_least32_t submitted;  /* MPSC submission stack (newest first) */
+    atomic_uint_least32_t released;   /* MPSC stack of tasks whose dependencies completed */
+    atomic_uint_least32_t free_next[MAX_TASKS];  /* Free-slot stack links */
+    atomic_uint_fast64_t free_head;  /* (ABA tag << 32) | top slot */
+    uint32_t edge_succ[MAX_EDGES];   /* Dependent slot of each edge */
+    atomic_uint_least32_t edge_next[MAX_EDGES];  /* Successor-list / free-stack links */
+    atomic_uint_fast64_t edge_free;  /* (ABA tag << 32) | top edge */
+    atomic_size_t task_count;
+    atomic_uint_fast64_t next_handle;
     bool initialized;
 } scheduler = {0};
 
+/* Executor state */
+static struct {
+    sched_worker_t* workers;
+    unsigned n_workers;
+    sched_exec_mode_t mode;
+    ws_deque_t inject[PRIORITY_LEVELS];  /* Pushed by the scheduling thread */
+    atomic_bool running;
+    atomic_int_fast64_t pending;     /* Dispatched, not yet completed */
+    atomic_int_fast64_t completed;   /* Completed since last tick */
+    atomic_int sleepers;
+    uint64_t epoch;                  /* Bumped under lock to wake workers */
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;
+    pthread_cond_t done_cv;
+} executor = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cv = PTHREAD_COND_INITIALIZER,
+    .done_cv = PTHREAD_COND_INITIALIZER,
+};
+
+/* Tick-thread sleep state for dtesn_sched_wait */
+static struct {
+    atomic_bool waiting;
+    atomic_bool stop;
+    uint64_t wake_seq;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+} waiter = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cv = PTHREAD_COND_INITIALIZER,
+};
+
+/* Tick budget and its accounting */
+static struct {
+    atomic_uint budget_us;  /* 0 = unlimited */
+    atomic_uint_fast64_t ticks;
+    atomic_uint_fast64_t overruns;
+    atomic_uint_fast64_t deferred;
+    atomic_uint_fast64_t deadline_misses;
+    atomic_uint_fast64_t tick_us_max;
+} budget;
+
+/* Task-graph profile */
+static struct {
+    atomic_bool enabled;
+    uint32_t tasks;
+    uint64_t work_ns;
+    uint64_t critical_path_ns;
+    task_handle_t critical_tail;
+    sched_graph_report_t last;  /* Published at the end of each tick */
+    pthread_mutex_t lock;
+} profile = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Worker owning the calling thread, NULL off the executor */
+static _Thread_local sched_worker_t* tls_worker = NULL;
+
+/**
+ * Append slot to the tail of a ready queue
+ */
+static inline void ready_push(ready_queue_t* q, uint32_t slot) {
+    scheduler.tasks[slot].next = SLOT_NONE;
+    if (q->tail == SLOT_NONE) {
+        q->head = slot;
+    } else {
+        scheduler.tasks[q->tail].next = slot;
+    }
+    q->tail = slot;
+}
+
+/**
+ * Queue a slot by priority and membrane depth (tick thread)
+ */
+static inline void ready_enqueue(uint32_t slot) {
+    task_t* task = &scheduler.tasks[slot];
+    uint32_t wave = task->depth < DEPTH_WAVES ? task->depth : DEPTH_WAVES - 1;
+    
+    ready_queue_t* q = &scheduler.ready[task->priority][wave];
+    
+    ready_push(q, slot);
+    q->edf |= task->deadline_us != NO_DEADLINE;
+    scheduler.ready_mask[task->priority] |= 1u << wave;
+    scheduler.ready_count[task->priority]++;
+}
+
+/**
+ * Merge two deadline-ordered slot lists (stable: a wins ties)
+ */
+static uint32_t edf_merge(uint32_t a, uint32_t b) {
+    uint32_t head = SLOT_NONE;
+    uint32_t* link = &head;
+    
+    while (a != SLOT_NONE && b != SLOT_NONE) {
+        if (scheduler.tasks[b].deadline_us < scheduler.tasks[a].deadline_us) {
+            *link = b;
+            link = &scheduler.tasks[b].next;
+            b = *link;
+        } else {
+            *link = a;
+            link = &scheduler.tasks[a].next;
+            a = *link;
+        }
+    }
+    *link = a != SLOT_NONE ? a : b;
+    
+    return head;
+}
+
+/**
+ * Sort a ready queue earliest deadline first; tasks without one keep FIFO order last
+ */
+static void ready_sort_edf(ready_queue_t* q) {
+    /* Bottom-up merge sort over the intrusive list: O(n log n), no allocation */
+    uint32_t runs[32];
+    int n_runs = 0;
+    uint32_t slot = q->head;
+    
+    while (slot != SLOT_NONE) {
+        uint32_t next = scheduler.tasks[slot].next;
+        scheduler.tasks[slot].next = SLOT_NONE;
+        
+        /* runs[i] holds a sorted list of 2^i items, or SLOT_NONE */
+        uint32_t run = slot;
+        int i = 0;
+        for (; i < n_runs && runs[i] != SLOT_NONE; i++) {
+            run = edf_merge(runs[i], run);
+            runs[i] = SLOT_NONE;
+        }
+        runs[i] = run;
+        if (i == n_runs) {
+            n_runs++;
+        }
+        slot = next;
+    }
+    
+    uint32_t sorted = SLOT_NONE;
+    for (int i = 0; i < n_runs; i++) {
+        if (runs[i] != SLOT_NONE) {
+            sorted = edf_merge(runs[i], sorted);
+        }
+    }
+    
+    q->head = sorted;
+    q->tail = sorted;
+    while (q->tail != SLOT_NONE && scheduler.tasks[q->tail].next != SLOT_NONE) {
+        q->tail = scheduler.tasks[q->tail].next;
+    }
+    q->edf = false;
+}
+
+/**
+ * Pop an index from a tagged Treiber stack (lock-free, tagged against ABA)
+ */
+static uint32_t stack_pop(atomic_uint_fast64_t* head, atomic_uint_least32_t* links) {
+    uint_fast64_t old = atomic_load_explicit(head, memory_order_acquire);
+    uint_fast64_t new_head;
+    uint32_t idx;
+    
+    do {
+        idx = (uint32_t)old;
+        if (idx == SLOT_NONE) {
+            return SLOT_NONE;
+        }
+        uint32_t next = atomic_load_explicit(&links[idx], memory_order_relaxed);
+        new_head = (((old >> 32) + 1) << 32) | next;
+    } while (!atomic_compare_exchange_weak_explicit(head, &old, new_head,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+    
+    return idx;
+}
+
+/**
+ * Push an index onto a tagged Treiber stack
+ */
+static void stack_push(atomic_uint_fast64_t* head, atomic_uint_least32_t* links, uint32_t idx) {
+    uint_fast64_t old = atomic_load_explicit(head, memory_order_relaxed);
+    uint_fast64_t new_head;
+    
+    do {
+        atomic_store_explicit(&links[idx], (uint32_t)old, memory_order_relaxed);
+        new_head = (((old >> 32) + 1) << 32) | idx;
+    } while (!atomic_compare_exchange_weak_explicit(head, &old, new_head,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/**
+ * Pop a slot from the free-slot stack
+ */
+static inline uint32_t slot_alloc(void) {
+    return stack_pop(&scheduler.free_head, scheduler.free_next);
+}
+
+/**
+ * Push a slot back onto the free-slot stack
+ */
+static inline void slot_release(uint32_t slot) {
+    stack_push(&scheduler.free_head, scheduler.free_next, slot);
+}
+
+/**
+ * MPSC stack: push a slot (any thread, lock-free)
+ */
+static void mpsc_push(atomic_uint_least32_t* stack, uint32_t slot) {
+    uint32_t head = atomic_load_explicit(stack, memory_order_relaxed);
+    
+    do {
+        scheduler.tasks[slot].next = head;
+    } while (!atomic_compare_exchange_weak_explicit(stack, &head, slot,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+/**
+ * MPSC stack: detach every queued slot, oldest first
+ */
+static uint32_t mpsc_take_all(atomic_uint_least32_t* stack) {
+    uint32_t slot = atomic_exchange_explicit(stack, SLOT_NONE, memory_order_acquire);
+    
+    /* Reverse the stack into push order */
+    uint32_t fifo = SLOT_NONE;
+    while (slot != SLOT_NONE) {
+        uint32_t next = scheduler.tasks[slot].next;
+        scheduler.tasks[slot].next = fifo;
+        fifo = slot;
+        slot = next;
+    }
+    
+    return fifo;
+}
+
+/**
+ * Successor-list tag of a handle
+ */
+static inline uint_fast64_t handle_tag(task_handle_t handle) {
+    return (uint32_t)(handle >> SLOT_BITS);
+}
+
+/**
+ * Add edge to the successor list of dep
+ * @return false if dep has already completed (its slot was closed or reused)
+ */
+static bool dep_link(task_handle_t dep, uint32_t edge) {
+    task_t* pred = &scheduler.tasks[dep & SLOT_MASK];
+    uint_fast64_t tag = handle_tag(dep);
+    uint_fast64_t old = atomic_load_explicit(&pred->succ, memory_order_acquire);
+    
+    do {
+        if ((old >> 32) != tag || (uint32_t)old == EDGE_CLOSED) {
+            return false;
+        }
+        atomic_store_explicit(&scheduler.edge_next[edge], (uint32_t)old, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pred->succ, &old, (tag << 32) | edge,
+                                                    memory_order_release,
+                                                    memory_order_acquire));
+    
+    return true;
+}
+
+static void executor_dispatch(uint32_t slot, task_priority_t priority);
+
+/**
+ * Hand over a task whose dependencies have all completed (any thread)
+ */
+static void task_ready(uint32_t slot) {
+    if (tls_worker && executor.mode == SCHED_EXEC_FREE_RUNNING) {
+        executor_dispatch(slot, scheduler.tasks[slot].priority);
+    } else {
+        /* The tick picks it up before its next wave */
+        mpsc_push(&scheduler.released, slot);
+    }
+}
+
+/**
+ * Decrement the dependency counters of a completed task's successors
+ */
+static void deps_release(uint32_t edge, uint64_t path_ns) {
+    while (edge != EDGE_NONE) {
+        uint32_t next = atomic_load_explicit(&scheduler.edge_next[edge], memory_order_relaxed);
+        task_t* dependent = &scheduler.tasks[scheduler.edge_succ[edge]];
+        
+        if (path_ns > 0) {
+            uint_fast64_t cur = atomic_load_explicit(&dependent->path_ns, memory_order_relaxed);
+            while (cur < path_ns &&
+                   !atomic_compare_exchange_weak_explicit(&dependent->path_ns, &cur, path_ns,
+                                                          memory_order_relaxed,
+                                                          memory_order_relaxed)) {
+            }
+        }
+        
+        if (atomic_fetch_sub_explicit(&dependent->deps_pending, 1, memory_order_acq_rel) == 1) {
+            task_ready(scheduler.edge_succ[edge]);
+        }
+        
+        stack_push(&scheduler.edge_free, scheduler.edge_next, edge);
+        edge = next;
+    }
+}
+
+/**
+ * Add a task's run time to the graph profile
+ * @return Length of the dependency chain ending at this task
+ */
+static uint64_t profile_record(task_t* task, uint64_t run_ns) {
+    uint64_t path = atomic_load_explicit(&task->path_ns, memory_order_relaxed) + run_ns;
+    
+    pthread_mutex_lock(&profile.lock);
+    profile.tasks++;
+    profile.work_ns += run_ns;
+    if (path > profile.critical_path_ns) {
+        profile.critical_path_ns = path;
+        profile.critical_tail = task->handle;
+    }
+    pthread_mutex_unlock(&profile.lock);
+    
+    return path;
+}
+
+/**
+ * Run a task, release its slot and then its dependents
+ */
+static inline void task_run(uint32_t slot) {
+    task_t* task = &scheduler.tasks[slot];
+    uint64_t path = 0;
+    
+    if (atomic_load_explicit(&profile.enabled, memory_order_relaxed)) {
+        uint64_t begin = kern_now_ns();
+        task->fn(task->data);
+        /* At least 1ns so a non-zero path tells deps_release to propagate it */
+        path = profile_record(task, kern_now_ns() - begin + 1);
+    } else {
+        task->fn(task->data);
+    }
+    
+    if (task->deadline_us != NO_DEADLINE && kern_now_us() > task->deadline_us) {
+        atomic_fetch_add_explicit(&budget.deadline_misses, 1, memory_order_relaxed);
+    }
+    
+    /* Close the successor list: later dep_link calls see the task as done */
+    uint_fast64_t succ = atomic_exchange_explicit(&task->succ,
+                                                  (handle_tag(task->handle) << 32) | EDGE_CLOSED,
+                                                  memory_order_acq_rel);
+    
+    task->active = false;
+    atomic_fetch_sub_explicit(&scheduler.task_count, 1, memory_order_relaxed);
+    slot_release(slot);
+    
+    deps_release((uint32_t)succ, path);
+}
+
+/**
+ * Deque: push at bottom (owner only)
+ */
+static void deque_push(ws_deque_t* d, uint32_t slot) {
+    int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    atomic_store_explicit(&d->buf[b % MAX_TASKS], slot, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+}
+
+/**
+ * Deque: take from bottom (owner only)
+ */
+static uint32_t deque_take(ws_deque_t* d) {
+    int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int_fast64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return SLOT_NONE;
+    }
+    
+    uint32_t slot = atomic_load_explicit(&d->buf[b % MAX_TASKS], memory_order_relaxed);
+    if (t == b) {
+        /* Last element: race thieves for it */
+        if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            slot = SLOT_NONE;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    
+    return slot;
+}
+
+/**
+ * Deque: steal from top (any thread)
+ */
+static uint32_t deque_steal(ws_deque_t* d) {
+    for (;;) {
+        int_fast64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        int_fast64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+        
+        if (t >= b) {
+            return SLOT_NONE;
+        }
+        
+        uint32_t slot = atomic_load_explicit(&d->buf[t % MAX_TASKS], memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                    memory_order_seq_cst,
+                                                    memory_order_relaxed)) {
+            return slot;
+        }
+        /* Lost the race: retry */
+    }
+}
+
+/**
+ * Deque: non-empty check (racy hint)
+ */
+static inline bool deque_nonempty(ws_deque_t* d) {
+    return atomic_load_explicit(&d->top, memory_order_relaxed) <
+           atomic_load_explicit(&d->bottom, memory_order_relaxed);
+}
+
+/**
+ * Wake sleeping workers
+ */
+static void executor_notify(void) {
+    pthread_mutex_lock(&executor.lock);
+    executor.epoch++;
+    pthread_cond_broadcast(&executor.work_cv);
+    pthread_mutex_unlock(&executor.lock);
+}
+
+/**
+ * Move queued submissions onto a worker's deques (free-running mode)
+ */
+static void worker_drain_submissions(sched_worker_t* w) {
+    uint32_t slot = mpsc_take_all(&scheduler.submitted);
+    
+    while (slot != SLOT_NONE) {
+        uint32_t next = scheduler.tasks[slot].next;
+        atomic_fetch_add_explicit(&executor.pending, 1, memory_order_relaxed);
+        deque_push(&w->deques[scheduler.tasks[slot].priority], slot);
+        slot = next;
+    }
+}
+
+/**
+ * Find work, highest priority first: own deque, injector, then victims
+ */
+static uint32_t worker_find(sched_worker_t* w) {
+    if (executor.mode == SCHED_EXEC_FREE_RUNNING &&
+        atomic_load_explicit(&scheduler.submitted, memory_order_relaxed) != SLOT_NONE) {
+        worker_drain_submissions(w);
+    }
+    
+    for (int prio = PRIORITY_CRITICAL; prio <= PRIORITY_LOW; prio++) {
+        uint32_t slot = deque_take(&w->deques[prio]);
+        if (slot != SLOT_NONE) {
+            return slot;
+        }
+        
+        slot = deque_steal(&executor.inject[prio]);
+        if (slot != SLOT_NONE) {
+            return slot;
+        }
+        
+        /* xorshift victim start so thieves spread out */
+        w->rng ^= w->rng << 13;
+        w->rng ^= w->rng >> 17;
+        w->rng ^= w->rng << 5;
+        unsigned start = w->rng % executor.n_workers;
+        
+        for (unsigned i = 0; i < executor.n_workers; i++) {
+            sched_worker_t* victim = &executor.workers[(start + i) % executor.n_workers];
+            if (victim == w) {
+                continue;
+            }
+            slot = deque_steal(&victim->deques[prio]);
+            if (slot != SLOT_NONE) {
+                return slot;
+            }
+        }
+    }
+    
+    return SLOT_NONE;
+}
+
+/**
+ * Any queued executor work (racy hint used before sleeping)
+ */
+static bool executor_has_work(void) {
+    if (executor.mode == SCHED_EXEC_FREE_RUNNING &&
+        atomic_load_explicit(&scheduler.submitted, memory_order_relaxed) != SLOT_NONE) {
+        return true;
+    }
+    
+    for (int prio = 0; prio < PRIORITY_LEVELS; prio++) {
+        if (deque_nonempty(&executor.inject[prio])) {
+            return true;
+        }
+        for (unsigned i = 0; i < executor.n_workers; i++) {
+            if (deque_nonempty(&executor.workers[i].deques[prio])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Worker thread main loop
+ */
+static void* worker_main(void* arg) {
+    sched_worker_t* w = (sched_worker_t*)arg;
+    tls_worker = w;
+    int idle = 0;
+    
+    for (;;) {
+        uint32_t slot = worker_find(w);
+        
+        if (slot != SLOT_NONE) {
+            idle = 0;
+            task_run(slot);
+            atomic_fetch_add_explicit(&executor.completed, 1, memory_order_relaxed);
+            
+            if (atomic_fetch_sub_explicit(&executor.pending, 1, memory_order_acq_rel) == 1) {
+                pthread_mutex_lock(&executor.lock);
+                pthread_cond_broadcast(&executor.done_cv);
+                pthread_mutex_unlock(&executor.lock);
+            }
+            continue;
+        }
+        
+        if (++idle < STEAL_SPINS) {
+            continue;
+        }
+        
+        /* Sleep until new work is published or the executor stops */
+        pthread_mutex_lock(&executor.lock);
+        uint64_t seen = executor.epoch;
+        atomic_fetch_add_explicit(&executor.sleepers, 1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        
+        bool stop = false;
+        if (!executor_has_work()) {
+            if (!atomic_load_explicit(&executor.running, memory_order_acquire)) {
+                stop = true;
+            } else {
+                while (executor.epoch == seen &&
+                       atomic_load_explicit(&executor.running, memory_order_acquire)) {
+                    pthread_cond_wait(&executor.work_cv, &executor.lock);
+                }
+            }
+        }
+        
+        atomic_fetch_sub_explicit(&executor.sleepers, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&executor.lock);
+        idle = 0;
+        
+        if (stop) {
+            break;
+        }
+    }
+    
+    tls_worker = NULL;
+    return NULL;
+}
+
+/**
+ * Wake a worker if any are asleep
+ */
+static inline void executor_wake_sleepers(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&executor.sleepers, memory_order_relaxed) > 0) {
+        executor_notify();
+    }
+}
+
+/**
+ * Hand a slot to the executor
+ */
+static void executor_dispatch(uint32_t slot, task_priority_t priority) {
+    atomic_fetch_add_explicit(&executor.pending, 1, memory_order_relaxed);
+    
+    if (tls_worker) {
+        /* Spawned from a running task: keep it local, others may steal it */
+        deque_push(&tls_worker->deques[priority], slot);
+        executor_wake_sleepers();
+    } else {
+        deque_push(&executor.inject[priority], slot);
+    }
+}
+
 /**
  * Initialize scheduler
  */
@@ -42,50 +699,273 @@ int dtesn_sched_init(void) {
         return 0;
     }
     
-    memset(&scheduler, 0, sizeof(scheduler));
-    scheduler.next_handle = 1;
+    memset(scheduler.tasks, 0, sizeof(scheduler.tasks));
+    
+    for (int prio = 0; prio < PRIORITY_LEVELS; prio++) {
+        for (int wave = 0; wave < DEPTH_WAVES; wave++) {
+            scheduler.ready[prio][wave].head = SLOT_NONE;
+            scheduler.ready[prio][wave].tail = SLOT_NONE;
+            scheduler.ready[prio][wave].edf = false;
+        }
+        scheduler.ready_mask[prio] = 0;
+        scheduler.ready_count[prio] = 0;
+    }
+    
+    /* Chain slots so slot 0 is handed out first */
+    for (uint32_t i = 0; i < MAX_TASKS; i++) {
+        atomic_init(&scheduler.free_next[i], i + 1 < MAX_TASKS ? i + 1 : SLOT_NONE);
+    }
+    atomic_init(&scheduler.free_head, 0);
+    for (uint32_t i = 0; i < MAX_EDGES; i++) {
+        atomic_init(&scheduler.edge_next[i], i + 1 < MAX_EDGES ? i + 1 : EDGE_NONE);
+    }
+    atomic_init(&scheduler.edge_free, 0);
+    atomic_init(&scheduler.submitted, SLOT_NONE);
+    atomic_init(&scheduler.released, SLOT_NONE);
+    atomic_init(&scheduler.task_count, 0);
+    atomic_init(&scheduler.next_handle, 1);
+    
+    timer_init();
+    
     scheduler.initialized = true;
     
     return 0;
 }
 
 /**
- * Schedule a new task
+ * Queue a task whose dependencies are satisfied at submission
  */
-task_handle_t dtesn_sched_task(task_fn_t fn, void* data,
-                                task_priority_t priority, uint32_t depth) {
-    if (!scheduler.initialized) {
-        return 0;
+static void task_enqueue(uint32_t idx, bool next_tick) {
+    if (tls_worker && !next_tick) {
+        executor_dispatch(idx, scheduler.tasks[idx].priority);
+        return;
     }
     
-    if (scheduler.task_count >= MAX_TASKS) {
-        return 0;
+    mpsc_push(&scheduler.submitted, idx);
+    if (atomic_load_explicit(&executor.running, memory_order_acquire) &&
+        executor.mode == SCHED_EXEC_FREE_RUNNING) {
+        executor_wake_sleepers();
     }
     
-    /* Find free slot */
-    size_t idx = 0;
-    for (idx = 0; idx < MAX_TASKS; idx++) {
-        if (!scheduler.tasks[idx].active) {
-            break;
+    /* Tick thread may be blocked in dtesn_sched_wait */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&waiter.waiting, memory_order_relaxed)) {
+        sched_wake();
+    }
+}
+
+/**
+ * Allocate a slot, link dependencies and queue the task
+ * @param next_tick Bypass the worker deque so the task waits for the next tick
+ */
+static int task_submit(task_fn_t fn, void* data, task_priority_t priority,
+                       uint32_t depth, const sched_task_attr_t* attr,
+                       task_handle_t* out, bool next_tick) {
+    const task_handle_t* deps = attr ? attr->deps : NULL;
+    size_t n_deps = attr ? attr->n_deps : 0;
+    
+    if (!scheduler.initialized || !fn) {
+        return SCHED_ERR_INVALID;
+    }
+    
+    if ((unsigned)priority >= PRIORITY_LEVELS || (n_deps > 0 && !deps)) {
+        return SCHED_ERR_INVALID;
+    }
+    
+    for (size_t i = 0; i < n_deps; i++) {
+        if (deps[i] == 0) {
+            return SCHED_ERR_INVALID;
         }
     }
     
-    if (idx >= MAX_TASKS) {
-        return 0;
+    /* Pop free slot: none left means the caller must back off */
+    uint32_t idx = slot_alloc();
+    if (idx == SLOT_NONE) {
+        return SCHED_ERR_FULL;
+    }
+    
+    /* Reserve every edge up front so a full pool never leaves a half-linked task */
+    uint32_t edges = EDGE_NONE;
+    for (size_t i = 0; i < n_deps; i++) {
+        uint32_t edge = stack_pop(&scheduler.edge_free, scheduler.edge_next);
+        if (edge == EDGE_NONE) {
+            while (edges != EDGE_NONE) {
+                uint32_t next = scheduler.edge_succ[edges];
+                stack_push(&scheduler.edge_free, scheduler.edge_next, edges);
+                edges = next;
+            }
+            slot_release(idx);
+            return SCHED_ERR_FULL;
+        }
+        scheduler.edge_succ[edge] = edges;  /* Reservation chain until linked */
+        edges = edge;
     }
     
     /* Initialize task */
     task_t* task = &scheduler.tasks[idx];
+    uint64_t seq = atomic_fetch_add_explicit(&scheduler.next_handle, 1, memory_order_relaxed);
     task->fn = fn;
     task->data = data;
     task->priority = priority;
     task->depth = depth;
-    task->handle = scheduler.next_handle++;
+    task->handle = (seq << SLOT_BITS) | idx;
+    task->deadline_us = attr && attr->deadline_us ? kern_now_us() + attr->deadline_us
+                                                  : NO_DEADLINE;
+    task->cost_us = attr ? attr->cost_us : 0;
     task->active = true;
+    atomic_store_explicit(&task->path_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&task->succ, (handle_tag(task->handle) << 32) | EDGE_NONE,
+                          memory_order_relaxed);
+    
+    /* One extra count keeps the task parked until every edge is linked */
+    atomic_store_explicit(&task->deps_pending, (uint_fast32_t)n_deps + 1, memory_order_relaxed);
+    
+    atomic_fetch_add_explicit(&scheduler.task_count, 1, memory_order_relaxed);
+    
+    if (out) {
+        *out = task->handle;
+    }
+    
+    uint_fast32_t done = 1;
+    for (size_t i = 0; i < n_deps; i++) {
+        uint32_t edge = edges;
+        edges = scheduler.edge_succ[edge];
+        scheduler.edge_succ[edge] = idx;
+        
+        if (!dep_link(deps[i], edge)) {
+            stack_push(&scheduler.edge_free, scheduler.edge_next, edge);
+            done++;
+        }
+    }
+    
+    if (atomic_fetch_sub_explicit(&task->deps_pending, done, memory_order_acq_rel) == done) {
+        task_enqueue(idx, next_tick);
+    }
+    
+    return SCHED_OK;
+}
+
+/**
+ * Submit a new task from any thread
+ */
+int dtesn_sched_submit(task_fn_t fn, void* data, task_priority_t priority,
+                       uint32_t depth, task_handle_t* out) {
+    return dtesn_sched_submit_attr(fn, data, priority, depth, NULL, out);
+}
+
+/**
+ * Submit a task that runs once its dependencies have completed
+ */
+int dtesn_sched_submit_deps(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, const task_handle_t* deps, size_t n_deps,
+                            task_handle_t* out) {
+    sched_task_attr_t attr = {
+        .deps = deps,
+        .n_deps = n_deps,
+    };
+    
+    return dtesn_sched_submit_attr(fn, data, priority, depth, &attr, out);
+}
+
+/**
+ * Submit a task with dependencies, deadline and cost estimate
+ */
+int dtesn_sched_submit_attr(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, const sched_task_attr_t* attr,
+                            task_handle_t* out) {
+    return task_submit(fn, data, priority, depth, attr, out, false);
+}
+
+/**
+ * Submit a task for the next tick, even from inside a running task
+ */
+int dtesn_sched_submit_next(task_fn_t fn, void* data, task_priority_t priority,
+                            uint32_t depth, task_handle_t* out) {
+    return task_submit(fn, data, priority, depth, NULL, out, true);
+}
+
+/**
+ * Schedule a new task
+ */
+task_handle_t dtesn_sched_task(task_fn_t fn, void* data,
+                                task_priority_t priority, uint32_t depth) {
+    task_handle_t handle = 0;
     
-    scheduler.task_count++;
+    if (dtesn_sched_submit(fn, data, priority, depth, &handle) != SCHED_OK) {
+        return 0;
+    }
     
-    return task->handle;
+    return handle;
+}
+
+/**
+ * Tasks scheduled and not yet completed
+ */
+size_t dtesn_sched_pending(void) {
+    return atomic_load_explicit(&scheduler.task_count, memory_order_relaxed);
+}
+
+/**
+ * Start the work-stealing executor
+ */
+int dtesn_sched_exec_start(unsigned n_workers, sched_exec_mode_t mode) {
+    if (!scheduler.initialized || tls_worker) {
+        return -1;
+    }
+    
+    if (n_workers == 0 || n_workers > MAX_WORKERS) {
+        return -1;
+    }
+    
+    if (atomic_load(&executor.running)) {
+        return -1;
+    }
+    
+    executor.workers = (sched_worker_t*)calloc(n_workers, sizeof(sched_worker_t));
+    if (!executor.workers) {
+        return -1;
+    }
+    
+    memset(executor.inject, 0, sizeof(executor.inject));
+    executor.n_workers = n_workers;
+    executor.mode = mode;
+    atomic_store(&executor.pending, 0);
+    atomic_store(&executor.completed, 0);
+    atomic_store(&executor.running, true);
+    
+    for (unsigned i = 0; i < n_workers; i++) {
+        sched_worker_t* w = &executor.workers[i];
+        w->id = i;
+        w->rng = 2463534242u + i * 0x9E3779B9u;
+        
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            executor.n_workers = i;
+            dtesn_sched_exec_stop();
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Stop the executor once queued work has drained
+ */
+void dtesn_sched_exec_stop(void) {
+    if (!atomic_load(&executor.running) || tls_worker) {
+        return;
+    }
+    
+    atomic_store(&executor.running, false);
+    executor_notify();
+    
+    for (unsigned i = 0; i < executor.n_workers; i++) {
+        pthread_join(executor.workers[i].thread, NULL);
+    }
+    
+    free(executor.workers);
+    executor.workers = NULL;
+    executor.n_workers = 0;
 }
 
 /**
@@ -97,40 +977,311 @@ int dtesn_sched_tick(void) {
         return -1;
     }
     
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-    
+    uint64_t start_ns = kern_now_ns();
     int executed = 0;
+    bool parallel = atomic_load_explicit(&executor.running, memory_order_acquire) &&
+                    !tls_worker;
     
-    /* Execute tasks by priority */
-    for (int prio = PRIORITY_CRITICAL; prio <= PRIORITY_LOW; prio++) {
-        for (size_t i = 0; i < MAX_TASKS; i++) {
-            task_t* task = &scheduler.tasks[i];
+    /* Expired timers join this tick's submissions */
+    timer_advance(start_ns / 1000);
+    
+    /* Drain submissions into the ready queues in one batch */
+    uint32_t slot = mpsc_take_all(&scheduler.submitted);
+    while (slot != SLOT_NONE) {
+        uint32_t next = scheduler.tasks[slot].next;
+        ready_enqueue(slot);
+        slot = next;
+    }
+    
+    /*
+     * Execute in waves: highest priority first, then shallowest membrane
+     * depth. Dependents released by a wave join this tick; tasks scheduled
+     * meanwhile wait for the next one. Once the budget is spent only the
+     * levels above DEFER_FROM keep running.
+     */
+    uint64_t budget_ns = (uint64_t)atomic_load_explicit(&budget.budget_us,
+                                                        memory_order_relaxed) * 1000;
+    unsigned lanes = parallel ? executor.n_workers : 1;
+    bool admitted_deferrable = false;
+    bool over_budget = false;
+    uint32_t waves = 0;
+    
+    for (;;) {
+        slot = mpsc_take_all(&scheduler.released);
+        while (slot != SLOT_NONE) {
+            uint32_t next = scheduler.tasks[slot].next;
+            ready_enqueue(slot);
+            slot = next;
+        }
+        
+        int last = over_budget ? DEFER_FROM - 1 : PRIORITY_LOW;
+        int prio = PRIORITY_CRITICAL;
+        while (prio <= last && scheduler.ready_mask[prio] == 0) {
+            prio++;
+        }
+        if (prio > last) {
+            break;
+        }
+        
+        unsigned wave = (unsigned)__builtin_ctz(scheduler.ready_mask[prio]);
+        ready_queue_t* q = &scheduler.ready[prio][wave];
+        if (q->edf) {
+            ready_sort_edf(q);
+        }
+        slot = q->head;
+        uint32_t tail = q->tail;
+        q->head = SLOT_NONE;
+        q->tail = SLOT_NONE;
+        scheduler.ready_mask[prio] &= ~(1u << wave);
+        
+        bool deferrable = budget_ns > 0 && prio >= DEFER_FROM;
+        uint64_t wave_cost_ns = 0;  /* Estimated cost handed to the executor */
+        uint32_t started = 0;
+        
+        while (slot != SLOT_NONE) {
+            task_t* task = &scheduler.tasks[slot];
+            uint32_t next = task->next;
             
-            if (!task->active || task->priority != prio) {
-                continue;
+            /*
+             * Budget admission: defer once the budget is spent, or when the
+             * cost estimate would overrun it (unless nothing deferrable has
+             * run yet this tick, so an oversized task still makes progress)
+             */
+            if (deferrable) {
+                uint64_t cost_ns = (uint64_t)task->cost_us * 1000;
+                uint64_t elapsed = kern_now_ns() - start_ns;
+                uint64_t projected = elapsed + (wave_cost_ns + cost_ns) / lanes;
+                
+                if (elapsed >= budget_ns || (projected > budget_ns && admitted_deferrable)) {
+                    /* Requeue the rest of the wave, in order, for the next tick */
+                    q->head = slot;
+                    q->tail = tail;
+                    scheduler.ready_mask[prio] |= 1u << wave;
+                    over_budget = true;
+                    break;
+                }
+                
+                admitted_deferrable = true;
+                if (parallel) {
+                    wave_cost_ns += cost_ns;
+                }
             }
             
-            /* Execute task */
-            task->fn(task->data);
+            scheduler.ready_count[prio]--;
+            started++;
+            
+            if (parallel) {
+                executor_dispatch(slot, (task_priority_t)prio);
+            } else {
+                task_run(slot);
+                executed++;
+            }
             
-            /* Remove task */
-            task->active = false;
-            scheduler.task_count--;
-            executed++;
+            slot = next;
+        }
+        
+        if (started == 0) {
+            continue;
+        }
+        waves++;
+        
+        if (parallel) {
+            executor_notify();
+            
+            /* Barrier: wait for the wave and anything it spawned */
+            if (executor.mode == SCHED_EXEC_BARRIER) {
+                pthread_mutex_lock(&executor.lock);
+                while (atomic_load_explicit(&executor.pending, memory_order_acquire) > 0) {
+                    pthread_cond_wait(&executor.done_cv, &executor.lock);
+                }
+                pthread_mutex_unlock(&executor.lock);
+            }
         }
     }
     
-    clock_gettime(CLOCK_MONOTONIC, &end);
+    /* Everything still queued at deferrable levels waits for the next tick */
+    if (over_budget) {
+        uint64_t deferred = 0;
+        for (int prio = DEFER_FROM; prio <= PRIORITY_LOW; prio++) {
+            deferred += scheduler.ready_count[prio];
+        }
+        atomic_fetch_add_explicit(&budget.deferred, deferred, memory_order_relaxed);
+    }
     
-    /* Calculate elapsed time in microseconds */
-    long elapsed_us = (end.tv_sec - start.tv_sec) * 1000000 +
-                      (end.tv_nsec - start.tv_nsec) / 1000;
+    if (parallel) {
+        executed = (int)atomic_exchange_explicit(&executor.completed, 0, memory_order_relaxed);
+    }
     
-    /* Warn if exceeding target */
-    if (elapsed_us > SCHED_TICK_TARGET_US) {
-        /* In production, this would log */
+    /* Publish this tick's graph profile */
+    if (atomic_load_explicit(&profile.enabled, memory_order_relaxed)) {
+        pthread_mutex_lock(&profile.lock);
+        profile.last.tasks = profile.tasks;
+        profile.last.waves = waves;
+        profile.last.work_ns = profile.work_ns;
+        profile.last.critical_path_ns = profile.critical_path_ns;
+        profile.last.critical_tail = profile.critical_tail;
+        profile.tasks = 0;
+        profile.work_ns = 0;
+        profile.critical_path_ns = 0;
+        profile.critical_tail = 0;
+        pthread_mutex_unlock(&profile.lock);
+    }
+    
+    /* Count overruns against the budget, or the target when unlimited */
+    uint64_t elapsed_ns = kern_now_ns() - start_ns;
+    uint64_t limit_ns = budget_ns > 0 ? budget_ns : SCHED_TICK_TARGET_US * 1000ull;
+    
+    atomic_fetch_add_explicit(&budget.ticks, 1, memory_order_relaxed);
+    if (elapsed_ns > limit_ns) {
+        atomic_fetch_add_explicit(&budget.overruns, 1, memory_order_relaxed);
+    }
+    if (elapsed_ns / 1000 > atomic_load_explicit(&budget.tick_us_max, memory_order_relaxed)) {
+        atomic_store_explicit(&budget.tick_us_max, elapsed_ns / 1000, memory_order_relaxed);
     }
     
     return executed;
 }
+
+/**
+ * Set the tick budget
+ */
+int dtesn_sched_set_budget(uint32_t budget_us) {
+    if (!scheduler.initialized) {
+        return -1;
+    }
+    
+    atomic_store(&budget.budget_us, budget_us);
+    return 0;
+}
+
+/**
+ * Get tick budget statistics
+ */
+int dtesn_sched_budget_stats(sched_budget_stats_t* stats) {
+    if (!scheduler.initialized || !stats) {
+        return -1;
+    }
+    
+    stats->budget_us = atomic_load(&budget.budget_us);
+    stats->ticks = atomic_load(&budget.ticks);
+    stats->overruns = atomic_load(&budget.overruns);
+    stats->deferred = atomic_load(&budget.deferred);
+    stats->deadline_misses = atomic_load(&budget.deadline_misses);
+    stats->tick_us_max = atomic_load(&budget.tick_us_max);
+    
+    return 0;
+}
+
+/**
+ * Enable or disable task-graph profiling
+ */
+void dtesn_sched_profile(bool enable) {
+    pthread_mutex_lock(&profile.lock);
+    atomic_store(&profile.enabled, enable);
+    profile.tasks = 0;
+    profile.work_ns = 0;
+    profile.critical_path_ns = 0;
+    profile.critical_tail = 0;
+    memset(&profile.last, 0, sizeof(profile.last));
+    pthread_mutex_unlock(&profile.lock);
+}
+
+/**
+ * Get the graph profile of the last tick
+ */
+int dtesn_sched_graph_report(sched_graph_report_t* report) {
+    if (!scheduler.initialized || !report) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&profile.lock);
+    *report = profile.last;
+    pthread_mutex_unlock(&profile.lock);
+    
+    return 0;
+}
+
+/**
+ * Wake a thread blocked in dtesn_sched_wait
+ */
+void sched_wake(void) {
+    pthread_mutex_lock(&waiter.lock);
+    waiter.wake_seq++;
+    pthread_cond_signal(&waiter.cv);
+    pthread_mutex_unlock(&waiter.lock);
+}
+
+/**
+ * Block until the next timer deadline, a submission, or a timeout
+ */
+int dtesn_sched_wait(uint64_t max_wait_us) {
+    if (!scheduler.initialized) {
+        return -1;
+    }
+    
+    uint64_t deadline = timer_next_deadline_us();
+    if (max_wait_us > 0) {
+        uint64_t cap = kern_now_us() + max_wait_us;
+        if (cap < deadline) {
+            deadline = cap;
+        }
+    }
+    
+    pthread_mutex_lock(&waiter.lock);
+    uint64_t seen = waiter.wake_seq;
+    atomic_store_explicit(&waiter.waiting, true, memory_order_seq_cst);
+    
+    /* Re-check after publishing the flag so a racing submit is not missed */
+    while (waiter.wake_seq == seen &&
+           atomic_load_explicit(&scheduler.submitted, memory_order_seq_cst) == SLOT_NONE &&
+           !atomic_load_explicit(&waiter.stop, memory_order_relaxed)) {
+        if (deadline == UINT64_MAX) {
+            pthread_cond_wait(&waiter.cv, &waiter.lock);
+            continue;
+        }
+        
+        uint64_t now = kern_now_us();
+        if (now >= deadline) {
+            break;
+        }
+        
+        /* Condition variables time out on the realtime clock */
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t ns = (uint64_t)ts.tv_nsec + (deadline - now) * 1000;
+        ts.tv_sec += (time_t)(ns / 1000000000);
+        ts.tv_nsec = (long)(ns % 1000000000);
+        pthread_cond_timedwait(&waiter.cv, &waiter.lock, &ts);
+    }
+    
+    atomic_store_explicit(&waiter.waiting, false, memory_order_relaxed);
+    pthread_mutex_unlock(&waiter.lock);
+    
+    return 0;
+}
+
+/**
+ * Run ticks until dtesn_sched_stop, sleeping between them
+ */
+int dtesn_sched_run(void) {
+    if (!scheduler.initialized) {
+        return -1;
+    }
+    
+    while (!atomic_load(&waiter.stop)) {
+        dtesn_sched_tick();
+        dtesn_sched_wait(0);
+    }
+    
+    atomic_store(&waiter.stop, false);
+    
+    return 0;
+}
+
+/**
+ * Make dtesn_sched_run return after its current tick
+ */
+void dtesn_sched_stop(void) {
+    atomic_store(&waiter.stop, true);
+    sched_wake();
+}
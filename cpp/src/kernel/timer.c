@@ -0,0 +1,471 @@
+/**
+ * @file timer.c
+ * @brief Hierarchical timer wheel for delayed and periodic tasks
+ * 
+ * Four levels of 64 slots at SCHED_TIMER_RESOLUTION_US granularity
+ * (about 28 minutes of range; longer delays re-cascade). Insertion,
+ * cancellation and per-slot expiry are O(1); empty stretches of the
+ * wheel are skipped using per-level occupancy masks. Expired timers are
+ * handed to the scheduler through dtesn_sched_submit.
+ */
+
+#include "aichat/kernel.h"
+#include "kernel/internal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_TIMERS 1024
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1u << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define TIMER_NONE UINT32_MAX
+#define LEVEL_DUE WHEEL_LEVELS  /* Pseudo-level: expired, awaiting dispatch */
+
+/* Timer structure */
+typedef struct {
+    task_fn_t fn;
+    void* data;
+    task_priority_t priority;
+    uint32_t depth;
+    uint64_t deadline_us;
+    uint64_t period_us;  /* 0 = one-shot */
+    uint32_t prev;
+    uint32_t next;
+    uint32_t generation;
+    uint8_t level;
+    uint8_t slot;
+    bool armed;
+} sched_timer_t;
+
+/* Timer wheel state */
+static struct {
+    sched_timer_t pool[MAX_TIMERS];
+    uint32_t free_slots[MAX_TIMERS];
+    size_t free_top;
+    uint32_t wheel[WHEEL_LEVELS][WHEEL_SLOTS];  /* Bucket list heads */
+    uint64_t occupied[WHEEL_LEVELS];            /* Non-empty bucket masks */
+    uint32_t due;                               /* Expired, FIFO head */
+    uint32_t due_tail;
+    uint64_t now_tick;
+    size_t armed;
+    uint64_t fired;
+    uint64_t missed_periods;
+    uint64_t late_us_sum;
+    uint64_t late_us_max;
+    pthread_mutex_t lock;
+} timers = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Clock installed by dtesn_sched_set_clock, NULL for CLOCK_MONOTONIC */
+static _Atomic(sched_clock_fn_t) kern_clock = NULL;
+
+/**
+ * Monotonic clock in microseconds
+ */
+uint64_t kern_now_us(void) {
+    return kern_now_ns() / 1000;
+}
+
+/**
+ * Monotonic clock in nanoseconds
+ */
+uint64_t kern_now_ns(void) {
+    sched_clock_fn_t clock = atomic_load_explicit(&kern_clock, memory_order_relaxed);
+    if (clock) {
+        return clock();
+    }
+    
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Replace the clock behind deadlines, timers and the tick budget
+ */
+void dtesn_sched_set_clock(sched_clock_fn_t now_ns) {
+    atomic_store_explicit(&kern_clock, now_ns, memory_order_relaxed);
+}
+
+/**
+ * Unlink a timer from whichever list holds it
+ */
+static void timer_unlink(uint32_t idx) {
+    sched_timer_t* t = &timers.pool[idx];
+    
+    if (t->level == LEVEL_DUE) {
+        if (t->prev != TIMER_NONE) {
+            timers.pool[t->prev].next = t->next;
+        } else {
+            timers.due = t->next;
+        }
+        if (t->next != TIMER_NONE) {
+            timers.pool[t->next].prev = t->prev;
+        } else {
+            timers.due_tail = t->prev;
+        }
+        return;
+    }
+    
+    uint32_t* head = &timers.wheel[t->level][t->slot];
+    if (t->prev != TIMER_NONE) {
+        timers.pool[t->prev].next = t->next;
+    } else {
+        *head = t->next;
+    }
+    if (t->next != TIMER_NONE) {
+        timers.pool[t->next].prev = t->prev;
+    }
+    if (*head == TIMER_NONE) {
+        timers.occupied[t->level] &= ~(1ull << t->slot);
+    }
+}
+
+/**
+ * Append a timer to the due list
+ */
+static void due_push(uint32_t idx) {
+    sched_timer_t* t = &timers.pool[idx];
+    t->level = LEVEL_DUE;
+    t->next = TIMER_NONE;
+    t->prev = timers.due_tail;
+    if (timers.due_tail != TIMER_NONE) {
+        timers.pool[timers.due_tail].next = idx;
+    } else {
+        timers.due = idx;
+    }
+    timers.due_tail = idx;
+}
+
+/**
+ * Place a timer in the wheel according to its deadline
+ */
+static void wheel_insert(uint32_t idx) {
+    sched_timer_t* t = &timers.pool[idx];
+    
+    /* Round up so a timer never fires early */
+    uint64_t expiry = (t->deadline_us + SCHED_TIMER_RESOLUTION_US - 1) /
+                      SCHED_TIMER_RESOLUTION_US;
+    
+    if (expiry <= timers.now_tick) {
+        due_push(idx);
+        return;
+    }
+    
+    uint64_t delta = expiry - timers.now_tick;
+    unsigned level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ull << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    
+    /* Beyond the wheel's range: park in the furthest slot, re-cascade later */
+    if (delta >= (1ull << (WHEEL_BITS * WHEEL_LEVELS))) {
+        expiry = timers.now_tick + (1ull << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+    
+    unsigned slot = (unsigned)(expiry >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    uint32_t* head = &timers.wheel[level][slot];
+    
+    t->level = (uint8_t)level;
+    t->slot = (uint8_t)slot;
+    t->prev = TIMER_NONE;
+    t->next = *head;
+    if (*head != TIMER_NONE) {
+        timers.pool[*head].prev = idx;
+    }
+    *head = idx;
+    timers.occupied[level] |= 1ull << slot;
+}
+
+/**
+ * Move every timer in a bucket to the due list or a lower level
+ */
+static void wheel_cascade(unsigned level, unsigned slot) {
+    uint32_t idx = timers.wheel[level][slot];
+    timers.wheel[level][slot] = TIMER_NONE;
+    timers.occupied[level] &= ~(1ull << slot);
+    
+    while (idx != TIMER_NONE) {
+        uint32_t next = timers.pool[idx].next;
+        wheel_insert(idx);
+        idx = next;
+    }
+}
+
+/**
+ * Advance wheel time to target_tick, collecting expired timers
+ */
+static void wheel_advance(uint64_t target_tick) {
+    while (timers.now_tick < target_tick) {
+        if (timers.occupied[0] == 0) {
+            bool higher = false;
+            for (unsigned level = 1; level < WHEEL_LEVELS; level++) {
+                higher |= timers.occupied[level] != 0;
+            }
+            
+            /* Nothing armed: jump straight to the target */
+            if (!higher) {
+                timers.now_tick = target_tick;
+                break;
+            }
+            
+            /* Nothing expires before the next cascade boundary */
+            uint64_t skip_to = timers.now_tick | WHEEL_MASK;
+            if (skip_to >= target_tick) {
+                timers.now_tick = target_tick;
+                break;
+            }
+            timers.now_tick = skip_to;
+        }
+        
+        uint64_t tick = ++timers.now_tick;
+        
+        for (unsigned level = 1; level < WHEEL_LEVELS; level++) {
+            if (tick & ((1ull << (WHEEL_BITS * level)) - 1)) {
+                break;
+            }
+            wheel_cascade(level, (unsigned)(tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        }
+        
+        wheel_cascade(0, (unsigned)tick & WHEEL_MASK);
+    }
+}
+
+/**
+ * Allocate and arm a timer
+ */
+static timer_handle_t timer_arm(task_fn_t fn, void* data, task_priority_t priority,
+                                uint32_t depth, uint64_t delay_us, uint64_t period_us) {
+    if (!fn || (unsigned)priority > PRIORITY_LOW) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&timers.lock);
+    
+    if (timers.free_top == 0) {
+        pthread_mutex_unlock(&timers.lock);
+        return 0;
+    }
+    
+    uint32_t idx = timers.free_slots[--timers.free_top];
+    sched_timer_t* t = &timers.pool[idx];
+    t->fn = fn;
+    t->data = data;
+    t->priority = priority;
+    t->depth = depth;
+    t->deadline_us = kern_now_us() + delay_us;
+    t->period_us = period_us;
+    t->armed = true;
+    
+    wheel_insert(idx);
+    timers.armed++;
+    
+    timer_handle_t handle = ((uint64_t)t->generation << 32) | (idx + 1);
+    
+    pthread_mutex_unlock(&timers.lock);
+    
+    /* The tick thread may be sleeping past the new deadline */
+    sched_wake();
+    
+    return handle;
+}
+
+/**
+ * Disarm a timer and return its slot (lock held)
+ */
+static void timer_release(uint32_t idx) {
+    sched_timer_t* t = &timers.pool[idx];
+    t->armed = false;
+    t->generation++;
+    timers.free_slots[timers.free_top++] = idx;
+    timers.armed--;
+}
+
+/**
+ * Reset the timer wheel
+ */
+void timer_init(void) {
+    pthread_mutex_lock(&timers.lock);
+    
+    memset(timers.pool, 0, sizeof(timers.pool));
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        timers.free_slots[i] = (uint32_t)(MAX_TIMERS - 1 - i);
+    }
+    timers.free_top = MAX_TIMERS;
+    
+    for (unsigned level = 0; level < WHEEL_LEVELS; level++) {
+        for (unsigned slot = 0; slot < WHEEL_SLOTS; slot++) {
+            timers.wheel[level][slot] = TIMER_NONE;
+        }
+        timers.occupied[level] = 0;
+    }
+    
+    timers.due = TIMER_NONE;
+    timers.due_tail = TIMER_NONE;
+    timers.now_tick = kern_now_us() / SCHED_TIMER_RESOLUTION_US;
+    timers.armed = 0;
+    timers.fired = 0;
+    timers.missed_periods = 0;
+    timers.late_us_sum = 0;
+    timers.late_us_max = 0;
+    
+    pthread_mutex_unlock(&timers.lock);
+}
+
+/**
+ * Dispatch every timer due at now_us
+ */
+int timer_advance(uint64_t now_us) {
+    int dispatched = 0;
+    
+    pthread_mutex_lock(&timers.lock);
+    
+    wheel_advance(now_us / SCHED_TIMER_RESOLUTION_US);
+    
+    while (timers.due != TIMER_NONE) {
+        uint32_t idx = timers.due;
+        sched_timer_t* t = &timers.pool[idx];
+        
+        /* Scheduler full: leave it due and retry next tick */
+        if (dtesn_sched_submit(t->fn, t->data, t->priority, t->depth, NULL) != SCHED_OK) {
+            break;
+        }
+        
+        timer_unlink(idx);
+        dispatched++;
+        
+        uint64_t late_us = now_us > t->deadline_us ? now_us - t->deadline_us : 0;
+        timers.fired++;
+        timers.late_us_sum += late_us;
+        if (late_us > timers.late_us_max) {
+            timers.late_us_max = late_us;
+        }
+        
+        if (t->period_us == 0) {
+            timer_release(idx);
+            continue;
+        }
+        
+        /* Re-arm from the previous deadline so periods do not drift */
+        t->deadline_us += t->period_us;
+        if (t->deadline_us <= now_us) {
+            uint64_t missed = (now_us - t->deadline_us) / t->period_us + 1;
+            t->deadline_us += missed * t->period_us;
+            timers.missed_periods += missed;
+        }
+        wheel_insert(idx);
+    }
+    
+    pthread_mutex_unlock(&timers.lock);
+    
+    return dispatched;
+}
+
+/**
+ * Earliest time the timer wheel needs servicing
+ */
+uint64_t timer_next_deadline_us(void) {
+    pthread_mutex_lock(&timers.lock);
+    
+    uint64_t next_tick = UINT64_MAX;
+    
+    if (timers.due != TIMER_NONE) {
+        next_tick = timers.now_tick;
+    } else {
+        if (timers.occupied[0]) {
+            /* Rotate so bit 0 is the slot for now_tick + 1 */
+            unsigned shift = (unsigned)(timers.now_tick + 1) & WHEEL_MASK;
+            uint64_t mask = timers.occupied[0];
+            uint64_t rot = shift ? (mask >> shift) | (mask << (WHEEL_SLOTS - shift)) : mask;
+            next_tick = timers.now_tick + 1 + (uint64_t)__builtin_ctzll(rot);
+        }
+        
+        for (unsigned level = 1; level < WHEEL_LEVELS; level++) {
+            if (timers.occupied[level]) {
+                uint64_t boundary = (timers.now_tick | WHEEL_MASK) + 1;
+                if (boundary < next_tick) {
+                    next_tick = boundary;
+                }
+                break;
+            }
+        }
+    }
+    
+    pthread_mutex_unlock(&timers.lock);
+    
+    return next_tick == UINT64_MAX ? UINT64_MAX : next_tick * SCHED_TIMER_RESOLUTION_US;
+}
+
+/**
+ * Schedule a task after a delay
+ */
+timer_handle_t dtesn_sched_after(task_fn_t fn, void* data, task_priority_t priority,
+                                 uint32_t depth, uint64_t delay_us) {
+    return timer_arm(fn, data, priority, depth, delay_us, 0);
+}
+
+/**
+ * Schedule a task periodically
+ */
+timer_handle_t dtesn_sched_every(task_fn_t fn, void* data, task_priority_t priority,
+                                 uint32_t depth, uint64_t period_us) {
+    if (period_us == 0) {
+        return 0;
+    }
+    
+    return timer_arm(fn, data, priority, depth, period_us, period_us);
+}
+
+/**
+ * Cancel a delayed or periodic task
+ */
+int dtesn_sched_cancel(timer_handle_t timer) {
+    uint32_t idx = (uint32_t)(timer & 0xFFFFFFFFu);
+    uint32_t generation = (uint32_t)(timer >> 32);
+    
+    if (idx == 0 || idx > MAX_TIMERS) {
+        return -1;
+    }
+    idx--;
+    
+    pthread_mutex_lock(&timers.lock);
+    
+    sched_timer_t* t = &timers.pool[idx];
+    if (!t->armed || t->generation != generation) {
+        pthread_mutex_unlock(&timers.lock);
+        return -1;
+    }
+    
+    timer_unlink(idx);
+    timer_release(idx);
+    
+    pthread_mutex_unlock(&timers.lock);
+    
+    return 0;
+}
+
+/**
+ * Get timer precision statistics
+ */
+int dtesn_sched_timer_stats(sched_timer_stats_t* stats) {
+    if (!stats) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&timers.lock);
+    
+    stats->armed = timers.armed;
+    stats->fired = timers.fired;
+    stats->missed_periods = timers.missed_periods;
+    stats->late_us_max = timers.late_us_max;
+    stats->late_us_mean = timers.fired
+        ? (float)((double)timers.late_us_sum / (double)timers.fired) : 0.0f;
+    
+    pthread_mutex_unlock(&timers.lock);
+    
+    return 0;
+}
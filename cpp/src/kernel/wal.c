@@ -0,0 +1,461 @@
+/**
+ * @file wal.c
+ * @brief HGFS write-ahead log with group commit
+ * 
+ * Records are framed as {size, crc, lsn, type} plus a body padded to
+ * 8 bytes, and appended to an in-memory buffer under a mutex: the
+ * mutating thread never touches the file. A commit thread waits out a
+ * short window so records accumulate, swaps buffers, checksums the
+ * batch, then writes it with one write and one fdatasync and publishes
+ * the durable LSN.
+ * 
+ * Recovery scans the file in order and stops at the first torn or
+ * corrupt record, truncating the tail so new records follow valid data.
+ * LSNs keep increasing across truncation, so a checkpoint can record the
+ * last LSN it contains.
+ */
+
+#include "aichat/kernel.h"
+#include "kernel/internal.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WAL_ALIGN 8
+#define WAL_BUFFER_MAX (16u << 20)  /* Appenders wait for the commit thread beyond this */
+
+/* Record header */
+typedef struct {
+    uint32_t size;                  /* Body bytes, before padding */
+    uint32_t crc;                   /* CRC-32 of lsn, type and body */
+    uint64_t lsn;
+    uint32_t type;
+    uint32_t reserved;
+} wal_header_t;
+
+/* Append buffer */
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+    uint64_t last_lsn;              /* LSN of the newest record in the buffer */
+} wal_buffer_t;
+
+/* Log state */
+static struct {
+    int fd;
+    bool open;
+    uint32_t commit_interval_us;
+    
+    wal_buffer_t buf[2];
+    wal_buffer_t* active;           /* Appended to by callers */
+    wal_buffer_t* flushing;         /* Written by the commit thread */
+    bool writing;                   /* Commit thread is outside the lock with a batch */
+    
+    uint64_t next_lsn;
+    uint64_t durable_lsn;
+    uint64_t commits;
+    size_t log_bytes;
+    bool urgent;                    /* A waiter wants the window cut short */
+    bool failed;                    /* A record was lost (I/O error or out of memory) */
+    bool stop;
+    
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;         /* Records appended, sync requested or stopping */
+    pthread_cond_t durable_cv;      /* durable_lsn advanced */
+} wal = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cv = PTHREAD_COND_INITIALIZER,
+    .durable_cv = PTHREAD_COND_INITIALIZER,
+};
+
+static uint32_t crc_table[256];
+
+/**
+ * Build the CRC-32 (IEEE 802.3) table
+ */
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+/* CRC of a record: lsn and type from the header, then the body */
+static uint32_t record_crc(const wal_header_t* hdr, const void* body) {
+    uint32_t crc = crc_update(0xFFFFFFFFu, &hdr->lsn, sizeof(hdr->lsn));
+    crc = crc_update(crc, &hdr->type, sizeof(hdr->type));
+    crc = crc_update(crc, body, hdr->size);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static size_t record_size(size_t body) {
+    return sizeof(wal_header_t) + ((body + WAL_ALIGN - 1) & ~(size_t)(WAL_ALIGN - 1));
+}
+
+/**
+ * Fill in the checksums of a batch (off the appenders' path)
+ */
+static void batch_seal(wal_buffer_t* batch) {
+    for (size_t pos = 0; pos < batch->len;) {
+        wal_header_t hdr;
+        memcpy(&hdr, batch->data + pos, sizeof(hdr));
+        hdr.crc = record_crc(&hdr, batch->data + pos + sizeof(hdr));
+        memcpy(batch->data + pos, &hdr, sizeof(hdr));
+        pos += record_size(hdr.size);
+    }
+}
+
+/**
+ * Write a whole batch, retrying short writes
+ */
+static bool write_all(int fd, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * Group commit thread
+ */
+static void* commit_main(void* arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&wal.lock);
+    for (;;) {
+        while (wal.active->len == 0 && !wal.stop) {
+            pthread_cond_wait(&wal.work_cv, &wal.lock);
+        }
+        if (wal.active->len == 0) {
+            break;
+        }
+        
+        /* Commit window: let more records join the batch */
+        if (!wal.stop && !wal.urgent && wal.commit_interval_us > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)wal.commit_interval_us * 1000;
+            ts.tv_sec += (time_t)(ns / 1000000000);
+            ts.tv_nsec = (long)(ns % 1000000000);
+            while (!wal.stop && !wal.urgent && wal.active->len < WAL_BUFFER_MAX &&
+                   pthread_cond_timedwait(&wal.work_cv, &wal.lock, &ts) == 0) {
+            }
+        }
+        wal.urgent = false;
+        if (wal.active->len == 0) {
+            continue;               /* Truncated by a checkpoint meanwhile */
+        }
+        
+        wal_buffer_t* batch = wal.active;
+        wal.active = wal.flushing;
+        wal.flushing = batch;
+        wal.writing = true;
+        pthread_mutex_unlock(&wal.lock);
+        
+        batch_seal(batch);
+        bool ok = write_all(wal.fd, batch->data, batch->len) && fdatasync(wal.fd) == 0;
+        
+        pthread_mutex_lock(&wal.lock);
+        if (ok) {
+            wal.durable_lsn = batch->last_lsn;
+            wal.log_bytes += batch->len;
+            wal.commits++;
+        } else {
+            wal.failed = true;
+        }
+        batch->len = 0;
+        wal.writing = false;
+        pthread_cond_broadcast(&wal.durable_cv);
+    }
+    pthread_mutex_unlock(&wal.lock);
+    
+    return NULL;
+}
+
+/**
+ * Replay records after from_lsn; truncate anything past the last valid one
+ */
+static int wal_recover(uint64_t from_lsn, wal_apply_fn apply) {
+    struct stat st;
+    if (fstat(wal.fd, &st) != 0) {
+        return -1;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    size_t pos = 0;
+    uint64_t last_lsn = from_lsn;
+    int ret = 0;
+    
+    if (size > 0) {
+        const uint8_t* map = (const uint8_t*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, wal.fd, 0);
+        if (map == MAP_FAILED) {
+            return -1;
+        }
+        madvise((void*)map, size, MADV_SEQUENTIAL);
+        
+        uint64_t prev = 0;
+        while (size - pos >= sizeof(wal_header_t)) {
+            wal_header_t hdr;
+            memcpy(&hdr, map + pos, sizeof(hdr));
+            
+            size_t rec = record_size(hdr.size);
+            if (hdr.size > size - pos - sizeof(hdr) || rec > size - pos || hdr.lsn <= prev ||
+                record_crc(&hdr, map + pos + sizeof(hdr)) != hdr.crc) {
+                break;
+            }
+            
+            if (hdr.lsn > from_lsn) {
+                if (!apply(hdr.type, map + pos + sizeof(hdr), hdr.size)) {
+                    ret = -1;
+                    break;
+                }
+                last_lsn = hdr.lsn;
+            }
+            prev = hdr.lsn;
+            pos += rec;
+        }
+        
+        munmap((void*)map, size);
+    }
+    
+    if (ret != 0) {
+        return ret;
+    }
+    
+    /* Drop a torn tail */
+    if (pos < size && (ftruncate(wal.fd, (off_t)pos) != 0 || fdatasync(wal.fd) != 0)) {
+        return -1;
+    }
+    
+    wal.next_lsn = last_lsn + 1;
+    wal.durable_lsn = last_lsn;
+    wal.log_bytes = pos;
+    return 0;
+}
+
+/**
+ * Open the log, replay it and start the commit thread
+ */
+int wal_open(const char* path, uint64_t from_lsn, uint32_t commit_interval_us,
+             wal_apply_fn apply) {
+    if (wal.open || !path || !apply) {
+        return -1;
+    }
+    
+    crc_init();
+    
+    wal.fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (wal.fd < 0) {
+        return -1;
+    }
+    
+    wal.active = &wal.buf[0];
+    wal.flushing = &wal.buf[1];
+    wal.commit_interval_us = commit_interval_us;
+    wal.commits = 0;
+    wal.urgent = false;
+    wal.failed = false;
+    wal.stop = false;
+    wal.writing = false;
+    
+    if (wal_recover(from_lsn, apply) != 0 ||
+        pthread_create(&wal.thread, NULL, commit_main, NULL) != 0) {
+        close(wal.fd);
+        wal.fd = -1;
+        return -1;
+    }
+    
+    wal.open = true;
+    return 0;
+}
+
+/**
+ * Commit everything, stop the commit thread and close the log
+ */
+void wal_close(void) {
+    if (!wal.open) {
+        return;
+    }
+    
+    pthread_mutex_lock(&wal.lock);
+    wal.stop = true;
+    pthread_cond_signal(&wal.work_cv);
+    pthread_mutex_unlock(&wal.lock);
+    pthread_join(wal.thread, NULL);
+    
+    close(wal.fd);
+    wal.fd = -1;
+    wal.open = false;
+    
+    for (int i = 0; i < 2; i++) {
+        free(wal.buf[i].data);
+        memset(&wal.buf[i], 0, sizeof(wal.buf[i]));
+    }
+}
+
+bool wal_is_open(void) {
+    return wal.open;
+}
+
+/**
+ * Append a record; the body is body followed by extra
+ */
+uint64_t wal_append(uint32_t type, const void* body, size_t size, const void* extra,
+                    size_t extra_size) {
+    size_t body_size = size + extra_size;
+    size_t rec = record_size(body_size);
+    
+    pthread_mutex_lock(&wal.lock);
+    
+    /* Backpressure only when the commit thread falls far behind */
+    while (wal.active->len >= WAL_BUFFER_MAX && !wal.failed) {
+        wal.urgent = true;
+        pthread_cond_signal(&wal.work_cv);
+        pthread_cond_wait(&wal.durable_cv, &wal.lock);
+    }
+    
+    wal_buffer_t* b = wal.active;
+    if (b->len + rec > b->cap) {
+        size_t cap = b->cap ? b->cap : 64 * 1024;
+        while (cap < b->len + rec) {
+            cap *= 2;
+        }
+        uint8_t* data = (uint8_t*)realloc(b->data, cap);
+        if (!data) {
+            wal.failed = true;
+            pthread_mutex_unlock(&wal.lock);
+            return 0;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    
+    /* The commit thread fills in crc */
+    wal_header_t hdr = {
+        .size = (uint32_t)body_size,
+        .lsn = wal.next_lsn++,
+        .type = type,
+    };
+    
+    uint8_t* p = b->data + b->len;
+    memcpy(p, &hdr, sizeof(hdr));
+    memcpy(p + sizeof(hdr), body, size);
+    if (extra_size > 0) {
+        memcpy(p + sizeof(hdr) + size, extra, extra_size);
+    }
+    memset(p + sizeof(hdr) + body_size, 0, rec - sizeof(hdr) - body_size);
+    
+    bool was_empty = b->len == 0;
+    b->len += rec;
+    b->last_lsn = hdr.lsn;
+    if (was_empty) {
+        pthread_cond_signal(&wal.work_cv);
+    }
+    
+    pthread_mutex_unlock(&wal.lock);
+    return hdr.lsn;
+}
+
+/**
+ * Wait until every appended record is durable
+ */
+int wal_sync(void) {
+    if (!wal.open) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&wal.lock);
+    uint64_t target = wal.next_lsn - 1;
+    while (wal.durable_lsn < target && !wal.failed) {
+        wal.urgent = true;
+        pthread_cond_signal(&wal.work_cv);
+        pthread_cond_wait(&wal.durable_cv, &wal.lock);
+    }
+    int ret = wal.failed ? -1 : 0;
+    pthread_mutex_unlock(&wal.lock);
+    
+    return ret;
+}
+
+/**
+ * Last LSN handed out
+ */
+uint64_t wal_last_lsn(void) {
+    pthread_mutex_lock(&wal.lock);
+    uint64_t lsn = wal.next_lsn - 1;
+    pthread_mutex_unlock(&wal.lock);
+    return lsn;
+}
+
+/**
+ * Empty the log once a checkpoint holds everything up to lsn
+ */
+int wal_truncate(uint64_t lsn) {
+    if (!wal.open) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&wal.lock);
+    
+    /* Records past the checkpoint must survive */
+    if (wal.next_lsn - 1 != lsn) {
+        pthread_mutex_unlock(&wal.lock);
+        return -1;
+    }
+    
+    /* Let an in-flight batch land before cutting the file */
+    while (wal.writing) {
+        pthread_cond_wait(&wal.durable_cv, &wal.lock);
+    }
+    
+    int ret = 0;
+    if (ftruncate(wal.fd, 0) != 0 || fdatasync(wal.fd) != 0) {
+        ret = -1;
+    } else {
+        /* Buffered records are covered by the checkpoint */
+        wal.active->len = 0;
+        wal.durable_lsn = lsn;
+        wal.log_bytes = 0;
+        pthread_cond_broadcast(&wal.durable_cv);
+    }
+    
+    pthread_mutex_unlock(&wal.lock);
+    return ret;
+}
+
+/**
+ * Log counters
+ */
+void wal_get_stats(hgfs_wal_stats_t* stats) {
+    pthread_mutex_lock(&wal.lock);
+    stats->lsn = wal.next_lsn - 1;
+    stats->durable_lsn = wal.durable_lsn;
+    stats->commits = wal.commits;
+    stats->log_bytes = wal.log_bytes;
+    stats->failed = wal.failed;
+    pthread_mutex_unlock(&wal.lock);
+}
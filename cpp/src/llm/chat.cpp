@@ -4,22 +4,19 @@
  */
 
 #include "aichat/llm.h"
+#include "llm/internal.h"
 #include "llama.h"
 #include <cstdlib>
 #include <cstring>
 #include <string>
 #include <sstream>
+#include <vector>
 
 /**
- * Generate chat completion
+ * Format and tokenize a conversation, ending with the assistant turn
  */
-extern "C" char* llm_chat_completion(llm_model_t model, chat_message_t* messages,
-                                     size_t n_messages, generation_params_t* params,
-                                     stream_callback_t callback, void* user_data) {
-    if (!model || !messages || n_messages == 0) {
-        return nullptr;
-    }
-    
+std::vector<llama_token> llm_tokenize_chat(llm_model_t model, const chat_message_t* messages,
+                                           size_t n_messages) {
     /* Build prompt from messages */
     std::ostringstream prompt;
     
@@ -53,7 +50,23 @@ extern "C" char* llm_chat_completion(llm_model_t model, chat_message_t* messages
                                    tokens.data(), tokens.size(), true, true);
     }
     
-    tokens.resize(n_tokens);
+    tokens.resize(n_tokens < 0 ? 0 : n_tokens);
+    
+    return tokens;
+}
+
+/**
+ * Generate chat completion
+ */
+extern "C" char* llm_chat_completion(llm_model_t model, chat_message_t* messages,
+                                     size_t n_messages, generation_params_t* params,
+                                     stream_callback_t callback, void* user_data) {
+    if (!model || !messages || n_messages == 0) {
+        return nullptr;
+    }
+    
+    /* Tokenize prompt */
+    std::vector<llama_token> tokens = llm_tokenize_chat(model, messages, n_messages);
     
     /* Prepare sampling */
     llama_sampling_params sampling_params = llama_sampling_default_params();
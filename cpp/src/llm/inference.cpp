@@ -4,19 +4,13 @@
  */
 
 #include "aichat/llm.h"
+#include "llm/internal.h"
 #include "llama.h"
 #include <cstdlib>
 #include <cstring>
 #include <vector>
 #include <string>
 
-/* LLM Model structure */
-struct llm_model {
-    llama_model* model;
-    llama_context* ctx;
-    std::string model_path;
-};
-
 /**
  * Load LLM model
  */
@@ -41,6 +35,7 @@ extern "C" llm_model_t llm_load_model(const char* model_path) {
     ctx_params.n_ctx = 4096;
     ctx_params.n_batch = 512;
     ctx_params.n_threads = 4;
+    ctx_params.n_seq_max = LLM_SEQ_MAX;
     
     llama_context* ctx = llama_new_context_with_model(model, ctx_params);
     
@@ -54,6 +49,13 @@ extern "C" llm_model_t llm_load_model(const char* model_path) {
     llm->model = model;
     llm->ctx = ctx;
     llm->model_path = model_path;
+    llm->server = llm_server_create(llm);
+    if (!llm->server) {
+        llama_free(ctx);
+        llama_free_model(model);
+        delete llm;
+        return nullptr;
+    }
     
     return llm;
 }
@@ -66,6 +68,8 @@ extern "C" void llm_unload_model(llm_model_t model) {
         return;
     }
     
+    llm_server_destroy(model->server);
+    
     if (model->ctx) {
         llama_free(model->ctx);
     }
@@ -0,0 +1,44 @@
+/**
+ * @file internal.h
+ * @brief LLM-private interfaces shared between LLM translation units
+ */
+
+#ifndef AICHAT_LLM_INTERNAL_H
+#define AICHAT_LLM_INTERNAL_H
+
+#include "aichat/llm.h"
+#include "llama.h"
+#include <string>
+#include <vector>
+
+/** Sequences a context is created with (request slots for the server) */
+#define LLM_SEQ_MAX 8
+
+struct llm_server;
+
+/* LLM Model structure */
+struct llm_model {
+    llama_model* model;
+    llama_context* ctx;
+    std::string model_path;
+    llm_server* server;     /* Request server (serve.cpp) */
+};
+
+/**
+ * Format and tokenize a conversation, ending with the assistant turn
+ */
+std::vector<llama_token> llm_tokenize_chat(llm_model_t model, const chat_message_t* messages,
+                                           size_t n_messages);
+
+/**
+ * Create the request server for a loaded model
+ * @return Server, or nullptr on allocation failure
+ */
+llm_server* llm_server_create(llm_model_t model);
+
+/**
+ * Destroy the request server, failing requests still in flight
+ */
+void llm_server_destroy(llm_server* server);
+
+#endif /* AICHAT_LLM_INTERNAL_H */
@@ -0,0 +1,704 @@
+/**
+ * @file serve.cpp
+ * @brief LLM request server - priority admission and continuous batching
+ * 
+ * Requests are decoded by step tasks on the DTESN scheduler. Each step
+ * packs one llama_batch across every running sequence, in priority then
+ * submission order: decoding sequences contribute one token, prompts are
+ * prefilled in chunks. A step runs at the highest priority with work and
+ * resubmits itself for the next tick, so LOW-only steps are deferrable by
+ * the tick budget while interactive steps are not.
+ * 
+ * While a CRITICAL or HIGH request is active, LOW sequences are paused:
+ * they keep their sequence id and KV cache and resume where they stopped
+ * once interactive load drains. A paused sequence is only evicted (KV
+ * dropped, re-prefilled later) when an interactive request needs its
+ * sequence id or KV space.
+ */
+
+#include "aichat/llm.h"
+#include "aichat/kernel.h"
+#include "llm/internal.h"
+#include "llama.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define SERVE_PREFILL_CHUNK 256     /* Prompt tokens per sequence per step */
+#define SERVE_PRIORITIES (PRIORITY_LOW + 1)
+#define SERVE_IDLE INT_MAX          /* No runnable work */
+
+/* Request */
+struct llm_request {
+    llm_server* server;
+    task_priority_t priority;
+    uint64_t order;                     /* Submission order within a level */
+    std::vector<llama_token> tokens;    /* Prompt, then generated tokens */
+    size_t n_past;                      /* Tokens already in the KV cache */
+    int n_generated;
+    int max_tokens;
+    float temperature;
+    float top_p;
+    int top_k;
+    stream_callback_t callback;
+    void* user_data;
+    std::string response;
+    llama_seq_id seq;                   /* -1 while queued */
+    int n_step;                         /* Tokens in the current batch */
+    int32_t logits_idx;                 /* Batch index of the sampled logits, or -1 */
+    llm_request_state_t state;          /* Written under server->lock */
+    llm_request_state_t outcome;        /* DONE or FAILED, published once out of the active set */
+    bool released;                      /* llm_request_free called while in flight */
+};
+
+/* Request server */
+struct llm_server {
+    llm_model_t model;
+    int32_t n_vocab;
+    int n_batch;
+    
+    std::mutex lock;
+    std::condition_variable done;       /* Request completion / step exit */
+    std::vector<llm_request*> incoming; /* Submitted, not yet seen by a step */
+    std::vector<llm_request*> active;   /* Modified by the running step under lock */
+    int pending[SERVE_PRIORITIES];      /* Step tasks queued per priority */
+    bool stepping;
+    bool stopping;
+    uint64_t next_order;
+    
+    /* Step-private state */
+    std::vector<llama_seq_id> free_seqs;
+    llama_batch batch;
+    std::vector<std::pair<float, llama_token>> candidates;
+    std::mt19937 rng;
+    
+    llm_serve_stats_t stats;
+};
+
+template <int Priority>
+static void serve_step_at(void* data);
+
+/* Step task entry point per priority level */
+static const task_fn_t serve_steps[SERVE_PRIORITIES] = {
+    serve_step_at<PRIORITY_CRITICAL>,
+    serve_step_at<PRIORITY_HIGH>,
+    serve_step_at<PRIORITY_NORMAL>,
+    serve_step_at<PRIORITY_LOW>,
+};
+
+/* Terminal request state */
+static bool request_finished(llm_request_state_t state) {
+    return state == LLM_REQUEST_DONE || state == LLM_REQUEST_FAILED;
+}
+
+/* Interactive requests preempt LOW ones */
+static bool request_interactive(const llm_request* req) {
+    return req->priority <= PRIORITY_HIGH;
+}
+
+/**
+ * Queue a step task at priority unless one at that priority or higher is
+ * already pending (lock held)
+ */
+static void serve_schedule(llm_server* server, int priority, bool next_tick) {
+    if (priority == SERVE_IDLE || server->stopping) {
+        return;
+    }
+    
+    for (int p = PRIORITY_CRITICAL; p <= priority; p++) {
+        if (server->pending[p] > 0) {
+            return;
+        }
+    }
+    
+    task_fn_t step = serve_steps[priority];
+    int ret = next_tick
+        ? dtesn_sched_submit_next(step, server, (task_priority_t)priority, 0, nullptr)
+        : dtesn_sched_submit(step, server, (task_priority_t)priority, 0, nullptr);
+    if (ret == SCHED_OK) {
+        server->pending[priority]++;
+    }
+}
+
+/* Highest priority with runnable work (lock held) */
+static int serve_top_priority(const llm_server* server) {
+    int top = SERVE_IDLE;
+    bool paused = false;
+    
+    for (const llm_request* req : server->incoming) {
+        top = std::min(top, (int)req->priority);
+    }
+    for (const llm_request* req : server->active) {
+        if (req->state == LLM_REQUEST_PAUSED) {
+            paused = true;
+        } else {
+            top = std::min(top, (int)req->priority);
+        }
+    }
+    
+    /* Paused LOW sequences become runnable once no interactive request remains */
+    if (paused && top > PRIORITY_HIGH) {
+        top = std::min(top, (int)PRIORITY_LOW);
+    }
+    
+    return top;
+}
+
+/* Publish a state transition (step thread) */
+static void serve_set_state(llm_server* server, llm_request* req, llm_request_state_t state) {
+    std::lock_guard<std::mutex> guard(server->lock);
+    req->state = state;
+}
+
+/* Drop a sequence's KV cache and return its id to the pool */
+static void serve_release_seq(llm_server* server, llm_request* req) {
+    if (req->seq < 0) {
+        return;
+    }
+    
+    llama_kv_cache_seq_rm(server->model->ctx, req->seq, -1, -1);
+    server->free_seqs.push_back(req->seq);
+    req->seq = -1;
+}
+
+/**
+ * Evict the newest paused LOW sequence to make room for interactive work
+ * @return true if a sequence was freed
+ */
+static bool serve_evict(llm_server* server) {
+    llm_request* victim = nullptr;
+    
+    for (llm_request* req : server->active) {
+        if (req->state == LLM_REQUEST_PAUSED && (!victim || req->order > victim->order)) {
+            victim = req;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    
+    /* Generated tokens stay in req->tokens and are re-prefilled on resume */
+    serve_release_seq(server, victim);
+    victim->n_past = 0;
+    
+    std::lock_guard<std::mutex> guard(server->lock);
+    victim->state = LLM_REQUEST_QUEUED;
+    server->stats.evictions++;
+    return true;
+}
+
+/**
+ * Assign sequence ids and pause or resume LOW sequences
+ */
+static void serve_admit(llm_server* server) {
+    std::vector<llm_request*>& active = server->active;
+    
+    {
+        std::lock_guard<std::mutex> guard(server->lock);
+        std::sort(active.begin(), active.end(),
+                  [](const llm_request* a, const llm_request* b) {
+                      if (a->priority != b->priority) {
+                          return a->priority < b->priority;
+                      }
+                      return a->order < b->order;
+                  });
+    }
+    
+    bool interactive = false;
+    for (const llm_request* req : active) {
+        if (request_interactive(req)) {
+            interactive = true;
+            break;
+        }
+    }
+    
+    for (llm_request* req : active) {
+        bool low = req->priority == PRIORITY_LOW;
+        
+        if (req->state == LLM_REQUEST_QUEUED) {
+            /* LOW requests wait for interactive load to drain */
+            if (low && interactive) {
+                continue;
+            }
+            
+            if (server->free_seqs.empty() && !(request_interactive(req) && serve_evict(server))) {
+                continue;
+            }
+            
+            req->seq = server->free_seqs.back();
+            server->free_seqs.pop_back();
+            serve_set_state(server, req, LLM_REQUEST_RUNNING);
+        } else if (low) {
+            std::lock_guard<std::mutex> guard(server->lock);
+            if (interactive && req->state == LLM_REQUEST_RUNNING) {
+                req->state = LLM_REQUEST_PAUSED;
+                server->stats.preemptions++;
+            } else if (!interactive && req->state == LLM_REQUEST_PAUSED) {
+                req->state = LLM_REQUEST_RUNNING;
+            }
+        }
+    }
+}
+
+/**
+ * Fill the batch from running sequences in priority order
+ * @return Number of tokens packed
+ */
+static int serve_pack(llm_server* server) {
+    llama_batch& batch = server->batch;
+    batch.n_tokens = 0;
+    
+    for (llm_request* req : server->active) {
+        req->n_step = 0;
+        req->logits_idx = -1;
+        
+        int room = server->n_batch - batch.n_tokens;
+        if (req->state != LLM_REQUEST_RUNNING || room == 0) {
+            continue;
+        }
+        
+        size_t left = req->tokens.size() - req->n_past;
+        int n = (int)std::min(left, (size_t)std::min(room, SERVE_PREFILL_CHUNK));
+        
+        for (int i = 0; i < n; i++) {
+            int32_t j = batch.n_tokens++;
+            batch.token[j] = req->tokens[req->n_past + i];
+            batch.pos[j] = (llama_pos)(req->n_past + i);
+            batch.n_seq_id[j] = 1;
+            batch.seq_id[j][0] = req->seq;
+            batch.logits[j] = 0;
+        }
+        
+        /* Logits only once the whole context is in the cache */
+        if ((size_t)n == left) {
+            req->logits_idx = batch.n_tokens - 1;
+            batch.logits[req->logits_idx] = 1;
+        }
+        req->n_step = n;
+    }
+    
+    return batch.n_tokens;
+}
+
+/**
+ * Sample a token (temperature, top-k, top-p)
+ */
+static llama_token serve_sample(llm_server* server, const llm_request* req, const float* logits) {
+    int32_t n_vocab = server->n_vocab;
+    
+    if (req->temperature <= 0.0f) {
+        return (llama_token)(std::max_element(logits, logits + n_vocab) - logits);
+    }
+    
+    std::vector<std::pair<float, llama_token>>& cand = server->candidates;
+    cand.resize(n_vocab);
+    for (int32_t i = 0; i < n_vocab; i++) {
+        cand[i] = {logits[i], i};
+    }
+    
+    size_t k = (req->top_k > 0 && req->top_k < n_vocab) ? (size_t)req->top_k : (size_t)n_vocab;
+    std::partial_sort(cand.begin(), cand.begin() + k, cand.end(),
+                      std::greater<std::pair<float, llama_token>>());
+    
+    /* Softmax over the top k, then cut at cumulative top_p */
+    float max_logit = cand[0].first;
+    float sum = 0.0f;
+    for (size_t i = 0; i < k; i++) {
+        cand[i].first = expf((cand[i].first - max_logit) / req->temperature);
+        sum += cand[i].first;
+    }
+    
+    float cum = 0.0f;
+    size_t n = k;
+    for (size_t i = 0; i < k; i++) {
+        cum += cand[i].first / sum;
+        if (cum >= req->top_p) {
+            n = i + 1;
+            break;
+        }
+    }
+    
+    float total = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        total += cand[i].first;
+    }
+    
+    float r = std::uniform_real_distribution<float>(0.0f, total)(server->rng);
+    for (size_t i = 0; i < n; i++) {
+        r -= cand[i].first;
+        if (r <= 0.0f) {
+            return cand[i].second;
+        }
+    }
+    return cand[n - 1].second;
+}
+
+/**
+ * Advance every sequence in the decoded batch
+ * @return Tokens generated
+ */
+static int serve_advance(llm_server* server) {
+    llm_model_t model = server->model;
+    int generated = 0;
+    
+    for (llm_request* req : server->active) {
+        if (req->n_step == 0) {
+            continue;
+        }
+        
+        req->n_past += req->n_step;
+        if (req->logits_idx < 0) {
+            continue;
+        }
+        
+        const float* logits = llama_get_logits_ith(model->ctx, req->logits_idx);
+        llama_token token = serve_sample(server, req, logits);
+        
+        if (llama_token_is_eog(model->model, token)) {
+            req->outcome = LLM_REQUEST_DONE;
+            continue;
+        }
+        
+        char piece[256];
+        int n_piece = llama_token_to_piece(model->model, token, piece, sizeof(piece), 0, true);
+        if (n_piece > 0) {
+            std::string token_str(piece, n_piece);
+            req->response += token_str;
+            if (req->callback) {
+                req->callback(token_str.c_str(), req->user_data);
+            }
+        }
+        
+        req->tokens.push_back(token);
+        generated++;
+        if (++req->n_generated >= req->max_tokens) {
+            req->outcome = LLM_REQUEST_DONE;
+        }
+    }
+    
+    return generated;
+}
+
+/**
+ * Remove finished and abandoned requests from the active set
+ * 
+ * A finished request is published as DONE or FAILED only after it leaves
+ * the active set: from then on llm_request_free may delete it.
+ */
+static void serve_reap(llm_server* server) {
+    std::vector<llm_request*>& active = server->active;
+    bool notify = false;
+    
+    for (size_t i = 0; i < active.size();) {
+        llm_request* req = active[i];
+        bool finished;
+        {
+            std::lock_guard<std::mutex> guard(server->lock);
+            finished = req->released || request_finished(req->outcome);
+        }
+        if (!finished) {
+            i++;
+            continue;
+        }
+        
+        serve_release_seq(server, req);
+        
+        std::lock_guard<std::mutex> guard(server->lock);
+        active.erase(active.begin() + i);
+        if (req->released) {
+            delete req;
+        } else {
+            /* Last touch: llm_request_free may delete it from here on */
+            req->state = req->outcome;
+            notify = true;
+        }
+    }
+    
+    if (notify) {
+        server->done.notify_all();
+    }
+}
+
+/**
+ * Decode step (scheduler task)
+ */
+template <int Priority>
+static void serve_step_at(void* data) {
+    llm_server* server = (llm_server*)data;
+    
+    {
+        std::unique_lock<std::mutex> guard(server->lock);
+        server->pending[Priority]--;
+        
+        /* Orphaned by llm_server_destroy: the last one frees the server */
+        if (server->stopping) {
+            bool last = true;
+            for (int p = 0; p < SERVE_PRIORITIES; p++) {
+                last = last && server->pending[p] == 0;
+            }
+            guard.unlock();
+            if (last) {
+                delete server;
+            }
+            return;
+        }
+        
+        /* Another step is decoding on a worker: retry next tick */
+        if (server->stepping) {
+            if (dtesn_sched_submit_next(serve_step_at<Priority>, server,
+                                        (task_priority_t)Priority, 0, nullptr) == SCHED_OK) {
+                server->pending[Priority]++;
+            }
+            return;
+        }
+        
+        server->stepping = true;
+        server->active.insert(server->active.end(),
+                              server->incoming.begin(), server->incoming.end());
+        server->incoming.clear();
+    }
+    
+    serve_admit(server);
+    
+    int n_tokens = serve_pack(server);
+    int generated = 0;
+    if (n_tokens > 0) {
+        int ret = llama_decode(server->model->ctx, server->batch);
+        
+        if (ret == 0) {
+            generated = serve_advance(server);
+        } else {
+            /* Roll back the partial batch; retry after evicting, else fail it */
+            bool retry = ret == 1 && serve_evict(server);
+            
+            for (llm_request* req : server->active) {
+                if (req->n_step == 0) {
+                    continue;
+                }
+                llama_kv_cache_seq_rm(server->model->ctx, req->seq, (llama_pos)req->n_past, -1);
+                if (!retry) {
+                    req->outcome = LLM_REQUEST_FAILED;
+                }
+            }
+        }
+    }
+    
+    serve_reap(server);
+    
+    std::lock_guard<std::mutex> guard(server->lock);
+    server->stepping = false;
+    server->stats.steps++;
+    server->stats.tokens += generated;
+    
+    if (server->stopping) {
+        server->done.notify_all();
+        return;
+    }
+    
+    /* Keep stepping while work remains, at its highest priority */
+    serve_schedule(server, serve_top_priority(server), true);
+}
+
+/**
+ * Create the request server for a loaded model
+ */
+llm_server* llm_server_create(llm_model_t model) {
+    llm_server* server = new (std::nothrow) llm_server();
+    if (!server) {
+        return nullptr;
+    }
+    
+    int n_seq = std::min((int)llama_n_seq_max(model->ctx), LLM_SEQ_MAX);
+    
+    server->model = model;
+    server->n_vocab = llama_n_vocab(model->model);
+    server->n_batch = (int)llama_n_batch(model->ctx);
+    server->batch = llama_batch_init(server->n_batch, 0, 1);
+    server->rng.seed(std::random_device()());
+    
+    /* Hand out low ids first */
+    for (int seq = n_seq - 1; seq >= 0; seq--) {
+        server->free_seqs.push_back(seq);
+    }
+    
+    return server;
+}
+
+/**
+ * Destroy the request server, failing requests still in flight
+ * 
+ * Waits for a running step to finish. Step tasks still queued on the
+ * scheduler see the stopping flag; the last one frees the server.
+ */
+void llm_server_destroy(llm_server* server) {
+    if (!server) {
+        return;
+    }
+    
+    std::unique_lock<std::mutex> guard(server->lock);
+    server->stopping = true;
+    server->done.wait(guard, [server] { return !server->stepping; });
+    
+    for (llm_request* req : server->active) {
+        delete req;
+    }
+    for (llm_request* req : server->incoming) {
+        delete req;
+    }
+    server->active.clear();
+    server->incoming.clear();
+    
+    llama_batch_free(server->batch);
+    
+    bool queued = false;
+    for (int p = 0; p < SERVE_PRIORITIES; p++) {
+        queued = queued || server->pending[p] > 0;
+    }
+    guard.unlock();
+    
+    if (!queued) {
+        delete server;
+    }
+}
+
+/**
+ * Submit a chat completion request
+ */
+extern "C" llm_request_t llm_submit(llm_model_t model, const chat_message_t* messages,
+                                    size_t n_messages, const generation_params_t* params,
+                                    task_priority_t priority,
+                                    stream_callback_t callback, void* user_data) {
+    if (!model || !model->server || !messages || n_messages == 0 ||
+        priority < PRIORITY_CRITICAL || priority > PRIORITY_LOW) {
+        return nullptr;
+    }
+    
+    llm_request* req = new llm_request();
+    req->server = model->server;
+    req->priority = priority;
+    req->tokens = llm_tokenize_chat(model, messages, n_messages);
+    req->n_past = 0;
+    req->n_generated = 0;
+    req->max_tokens = params ? params->max_tokens : 512;
+    req->temperature = params ? params->temperature : 0.8f;
+    req->top_p = params ? params->top_p : 0.95f;
+    req->top_k = params ? (int)params->top_k : 40;
+    req->callback = callback;
+    req->user_data = user_data;
+    req->seq = -1;
+    req->n_step = 0;
+    req->logits_idx = -1;
+    req->state = LLM_REQUEST_QUEUED;
+    req->outcome = LLM_REQUEST_QUEUED;
+    req->released = false;
+    
+    if (req->tokens.empty() || req->max_tokens <= 0) {
+        delete req;
+        return nullptr;
+    }
+    
+    llm_server* server = model->server;
+    std::lock_guard<std::mutex> guard(server->lock);
+    if (server->stopping) {
+        delete req;
+        return nullptr;
+    }
+    
+    req->order = server->next_order++;
+    server->incoming.push_back(req);
+    
+    /* Boost: interactive work does not wait behind a LOW step */
+    serve_schedule(server, priority, false);
+    
+    return req;
+}
+
+/**
+ * Get request state
+ */
+extern "C" llm_request_state_t llm_request_state(llm_request_t request) {
+    if (!request) {
+        return LLM_REQUEST_FAILED;
+    }
+    
+    std::lock_guard<std::mutex> guard(request->server->lock);
+    return request->state;
+}
+
+/**
+ * Wait for a request to finish
+ */
+extern "C" char* llm_request_wait(llm_request_t request) {
+    if (!request) {
+        return nullptr;
+    }
+    
+    llm_server* server = request->server;
+    std::unique_lock<std::mutex> guard(server->lock);
+    server->done.wait(guard, [request] { return request_finished(request->state); });
+    
+    if (request->state != LLM_REQUEST_DONE) {
+        return nullptr;
+    }
+    return strdup(request->response.c_str());
+}
+
+/**
+ * Free a request, cancelling it if still in flight
+ */
+extern "C" void llm_request_free(llm_request_t request) {
+    if (!request) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> guard(request->server->lock);
+    if (request_finished(request->state)) {
+        delete request;
+    } else {
+        request->released = true;
+    }
+}
+
+/**
+ * Get request server statistics
+ */
+extern "C" int llm_serve_stats(llm_model_t model, llm_serve_stats_t* stats) {
+    if (!model || !model->server || !stats) {
+        return -1;
+    }
+    
+    llm_server* server = model->server;
+    std::lock_guard<std::mutex> guard(server->lock);
+    
+    *stats = server->stats;
+    stats->queued = (uint32_t)server->incoming.size();
+    stats->running = 0;
+    stats->paused = 0;
+    for (const llm_request* req : server->active) {
+        switch (req->state) {
+        case LLM_REQUEST_QUEUED:
+            stats->queued++;
+            break;
+        case LLM_REQUEST_RUNNING:
+            stats->running++;
+            break;
+        case LLM_REQUEST_PAUSED:
+            stats->paused++;
+            break;
+        default:
+            break;
+        }
+    }
+    
+    return 0;
+}
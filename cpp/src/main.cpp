@@ -22,7 +22,14 @@ int aichat_init(void) {
  * Shutdown AIChat system
  */
 void aichat_shutdown(void) {
-    /* Cleanup would go here */
+    /* Fold the hypergraph log into its file for the next start */
+    const char* path = getenv("AICHAT_HGFS_PATH");
+    if (path) {
+        int ret = hgfs_checkpoint();
+        if (hgfs_wal_stop() != 0 || ret != 0) {
+            fprintf(stderr, "Failed to checkpoint hypergraph file %s\n", path);
+        }
+    }
 }
 
 /**
@@ -6,8 +6,15 @@
 #include "aichat/cognitive.h"
 #include "aichat/kernel.h"
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 /* Test AtomSpace */
 static int test_atomspace(void) {
@@ -32,6 +39,670 @@ static int test_atomspace(void) {
     return 0;
 }
 
+/* Test atom handles and slot reuse */
+static int test_atomspace_handles(void) {
+    printf("Testing AtomSpace handles...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    atom_handle_t a = cog_atom_alloc(ATOM_CONCEPT, "dog");
+    atom_handle_t b = cog_atom_alloc(ATOM_CONCEPT, "mammal");
+    assert(a != 0 && b != 0 && a != b);
+    atom_handle_t new_atom = cog_atom_alloc(ATOM_CONCEPT, "dog");
+    assert(new_atom == a);
+    
+    /* Freed handles go stale; the slot comes back under a new generation */
+    atom_handle_t atoms[2] = {a, b};
+    atom_handle_t new_link = cog_link_create(ATOM_LINK, atoms, 2);
+    assert(new_link != 0);
+    int ret = cog_atom_free(a);
+    assert(ret == 0);
+    ret = cog_atom_free(a);
+    assert(ret != 0);
+    new_link = cog_link_create(ATOM_LINK, atoms, 2);
+    assert(new_link == 0);
+    
+    atom_handle_t c = cog_atom_alloc(ATOM_CONCEPT, "dog");
+    assert(c != 0 && c != a && (uint32_t)c == (uint32_t)a);
+    atoms[0] = c;
+    new_link = cog_link_create(ATOM_LINK, atoms, 2);
+    assert(new_link != 0);
+    
+    /* Fill every slot, then free one to make room for a new link */
+    atoms[0] = b;
+    atoms[1] = c;
+    atom_handle_t last = 0;
+    size_t n = 0;
+    for (atom_handle_t h; (h = cog_atom_alloc(ATOM_NODE, nullptr)) != 0; n++) {
+        last = h;
+    }
+    new_link = cog_link_create(ATOM_LINK, atoms, 2);
+    assert(n > 1000 && new_link == 0);
+    ret = cog_atom_free(last);
+    assert(ret == 0);
+    new_link = cog_link_create(ATOM_LINK, atoms, 2);
+    assert(new_link != 0);
+    
+    printf("  PASS: AtomSpace handles\n");
+    return 0;
+}
+
+/* Test AtomSpace name lookup */
+static int test_atomspace_names(void) {
+    printf("Testing AtomSpace names...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    /* Enough names to grow the index several times */
+    enum { N = 3000 };
+    static char buf[N][24];
+    static const char* names[N];
+    static atom_handle_t expect[N], got[N];
+    for (int i = 0; i < N; i++) {
+        snprintf(buf[i], sizeof(buf[i]), "name-%d", i);
+        names[i] = buf[i];
+        expect[i] = cog_atom_alloc(ATOM_CONCEPT, names[i]);
+        assert(expect[i] != 0);
+    }
+    size_t n_found = cog_atom_lookup(names, N, got);
+    assert(n_found == N);
+    assert(memcmp(got, expect, sizeof(got)) == 0);
+    
+    /* Missing and NULL names come back as 0 */
+    const char* mixed[4] = {"name-7", "missing", nullptr, "name-2999"};
+    atom_handle_t out[4];
+    n_found = cog_atom_lookup(mixed, 4, out);
+    assert(n_found == 2);
+    assert(out[0] == expect[7] && out[1] == 0 && out[2] == 0 && out[3] == expect[2999]);
+    
+    /* A freed name is not found until an atom takes it again */
+    int ret = cog_atom_free(expect[7]);
+    assert(ret == 0);
+    n_found = cog_atom_lookup(mixed, 1, out);
+    assert(n_found == 0 && out[0] == 0);
+    atom_handle_t again = cog_atom_alloc(ATOM_CONCEPT, "name-7");
+    assert(again != 0 && again != expect[7]);
+    n_found = cog_atom_lookup(mixed, 1, out);
+    assert(n_found == 1 && out[0] == again);
+    
+    printf("  PASS: AtomSpace names\n");
+    return 0;
+}
+
+/* Test AtomSpace incoming sets and pattern queries */
+static int test_atomspace_query(void) {
+    printf("Testing AtomSpace queries...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    atom_handle_t dog = cog_atom_alloc(ATOM_CONCEPT, "q-dog");
+    atom_handle_t cat = cog_atom_alloc(ATOM_CONCEPT, "q-cat");
+    atom_handle_t mammal = cog_atom_alloc(ATOM_CONCEPT, "q-mammal");
+    atom_handle_t animal = cog_atom_alloc(ATOM_CONCEPT, "q-animal");
+    atom_handle_t furry = cog_atom_alloc(ATOM_PREDICATE, "q-furry");
+    
+    atom_handle_t pair[2] = {dog, mammal};
+    atom_handle_t dog_mammal = cog_link_create(ATOM_LINK, pair, 2);
+    pair[0] = cat;
+    atom_handle_t cat_mammal = cog_link_create(ATOM_LINK, pair, 2);
+    pair[0] = mammal;
+    pair[1] = animal;
+    atom_handle_t new_link = cog_link_create(ATOM_LINK, pair, 2);
+    assert(new_link != 0);
+    pair[0] = furry;
+    pair[1] = cat;
+    new_link = cog_link_create(ATOM_PREDICATE, pair, 2);
+    assert(new_link != 0);
+    
+    /* Incoming sets are per link type */
+    atom_handle_t links[4];
+    size_t n_incoming = cog_atom_incoming(mammal, ATOM_LINK, links, 4);
+    assert(n_incoming == 3);
+    n_incoming = cog_atom_incoming(cat, ATOM_LINK, links, 4);
+    assert(n_incoming == 1 && links[0] == cat_mammal);
+    n_incoming = cog_atom_incoming(cat, ATOM_PREDICATE, nullptr, 0);
+    assert(n_incoming == 1);
+    
+    /* (LINK $0 $1), (LINK $1 animal) */
+    cog_term_t first[2] = {{0, 0}, {0, 1}};
+    cog_term_t second[2] = {{0, 1}, {animal, 0}};
+    cog_clause_t chain[2] = {{ATOM_LINK, first, 2}, {ATOM_LINK, second, 2}};
+    atom_handle_t results[8];
+    int64_t matches = cog_query(chain, 2, 2, results, 4);
+    assert(matches == 2);
+    for (int i = 0; i < 2; i++) {
+        assert(results[i * 2] == dog || results[i * 2] == cat);
+        assert(results[i * 2 + 1] == mammal);
+    }
+    assert(results[0] != results[2]);
+    
+    /* Add a constraint through another link type: only the cat is furry */
+    cog_term_t third[2] = {{furry, 0}, {0, 0}};
+    cog_clause_t furry_chain[3] = {chain[0], chain[1], {ATOM_PREDICATE, third, 2}};
+    matches = cog_query(furry_chain, 3, 2, results, 4);
+    assert(matches == 1 && results[0] == cat);
+    
+    /* Counting only, and bad variable indices */
+    matches = cog_query(chain, 2, 2, nullptr, 0);
+    assert(matches == 2);
+    matches = cog_query(chain, 2, 1, results, 4);
+    assert(matches < 0);
+    
+    /* Freed links leave incoming sets; freed atoms never bind */
+    int ret = cog_atom_free(cat_mammal);
+    assert(ret == 0);
+    n_incoming = cog_atom_incoming(mammal, ATOM_LINK, links, 4);
+    assert(n_incoming == 2);
+    assert(links[0] == dog_mammal || links[1] == dog_mammal);
+    matches = cog_query(chain, 2, 2, results, 4);
+    assert(matches == 1 && results[0] == dog);
+    ret = cog_atom_free(dog);
+    assert(ret == 0);
+    matches = cog_query(chain, 2, 2, results, 4);
+    assert(matches == 0);
+    
+    printf("  PASS: AtomSpace queries\n");
+    return 0;
+}
+
+/* Test link deduplication */
+static int test_atomspace_links(void) {
+    printf("Testing AtomSpace link dedup...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    atom_handle_t a = cog_atom_alloc(ATOM_CONCEPT, "l-a");
+    atom_handle_t b = cog_atom_alloc(ATOM_CONCEPT, "l-b");
+    atom_handle_t ab[2] = {a, b};
+    atom_handle_t ba[2] = {b, a};
+    
+    /* Same type and outgoing atoms give the same link */
+    atom_handle_t link = cog_link_create(ATOM_LINK, ab, 2);
+    assert(link != 0);
+    atom_handle_t new_link = cog_link_create(ATOM_LINK, ab, 2);
+    assert(new_link == link);
+    new_link = cog_link_create(ATOM_LINK, ba, 2);
+    assert(new_link != link);
+    new_link = cog_link_create(ATOM_PREDICATE, ab, 2);
+    assert(new_link != link);
+    new_link = cog_link_create(ATOM_LINK, ab, 1);
+    assert(new_link != link);
+    size_t n_incoming = cog_atom_incoming(a, ATOM_LINK, nullptr, 0);
+    assert(n_incoming == 3);
+    
+    /* A freed link is made again under a new handle */
+    int ret = cog_atom_free(link);
+    assert(ret == 0);
+    atom_handle_t again = cog_link_create(ATOM_LINK, ab, 2);
+    assert(again != 0 && again != link);
+    new_link = cog_link_create(ATOM_LINK, ab, 2);
+    assert(new_link == again);
+    
+    /* Many links, half freed, then every one asked for again */
+    enum { N = 64, M = 2000 };
+    atom_handle_t nodes[N];
+    for (int i = 0; i < N; i++) {
+        nodes[i] = cog_atom_alloc(ATOM_NODE, nullptr);
+        assert(nodes[i] != 0);
+    }
+    static atom_handle_t made[M];
+    for (int i = 0; i < M; i++) {
+        atom_handle_t pair[2] = {nodes[i % N], nodes[i / N]};
+        made[i] = cog_link_create(ATOM_LINK, pair, 2);
+        assert(made[i] != 0);
+    }
+    for (int i = 0; i < M; i += 2) {
+        ret = cog_atom_free(made[i]);
+        assert(ret == 0);
+    }
+    for (int i = 0; i < M; i++) {
+        atom_handle_t pair[2] = {nodes[i % N], nodes[i / N]};
+        atom_handle_t h = cog_link_create(ATOM_LINK, pair, 2);
+        assert(i % 2 ? h == made[i] : (h != 0 && h != made[i]));
+    }
+    
+    printf("  PASS: AtomSpace link dedup\n");
+    return 0;
+}
+
+/* Write a file for atomspace_load */
+static void write_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    assert(f != nullptr);
+    fputs(text, f);
+    fclose(f);
+}
+
+/* Test batch allocation and bulk import */
+static int test_atomspace_load(void) {
+    printf("Testing AtomSpace bulk import...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    /* A batch returns existing and repeated names as one atom */
+    atom_handle_t cat = cog_atom_alloc(ATOM_CONCEPT, "b-cat");
+    atom_type_t types[4] = {ATOM_CONCEPT, ATOM_CONCEPT, ATOM_NODE, ATOM_CONCEPT};
+    const char* names[4] = {"b-x", "b-cat", nullptr, "b-x"};
+    atom_handle_t got[4];
+    int ret = cog_atom_alloc_batch(types, names, 4, got);
+    assert(ret == 0);
+    assert(got[0] != 0 && got[0] == got[3] && got[1] == cat);
+    assert(got[2] != 0 && got[2] != got[0] && got[2] != cat);
+    ret = cog_atom_alloc_batch(types, nullptr, 2, got);
+    assert(ret == 0 && got[0] != got[1]);
+    
+    /* A batch that does not fit creates nothing */
+    enum { BIG = 9000 };
+    std::vector<atom_type_t> big_types(BIG, ATOM_CONCEPT);
+    std::vector<std::vector<char>> big_names(BIG, std::vector<char>(16));
+    std::vector<const char*> big_ptrs(BIG);
+    for (int i = 0; i < BIG; i++) {
+        snprintf(big_names[i].data(), 16, "big-%d", i);
+        big_ptrs[i] = big_names[i].data();
+    }
+    std::vector<atom_handle_t> big(BIG);
+    ret = cog_atom_alloc_batch(big_types.data(), big_ptrs.data(), BIG, big.data());
+    assert(ret < 0);
+    size_t n_found = cog_atom_lookup(big_ptrs.data(), BIG, big.data());
+    assert(n_found == 0);
+    
+    /* JSON and s-expression lines, mixed */
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_atomspace_%d.txt", (int)getpid());
+    write_file(path,
+        "# concepts\n"
+        "{\"type\": \"concept\", \"name\": \"f-cat\"}\n"
+        "(concept \"f-animal\")\n"
+        "{\"type\": \"link\", \"outgoing\": [{\"type\": \"concept\", \"name\": \"f-cat\"},"
+        " {\"type\": \"concept\", \"name\": \"f-animal\"}],"
+        " \"tv\": {\"s\": 0.9, \"c\": [1, true]}}\n"
+        "(Link (concept \"f-dog\") (concept \"f-animal\"))\r\n"
+        "; links over links\n"
+        "\n"
+        "(predicate (link (concept \"f-cat\") (concept \"f-animal\")) (concept \"f-dog\"))\n"
+        "{\"name\": \"f-\\u00e9t\\\"e\", \"type\": \"concept\"}\n"
+        "(node)");
+    int64_t n_loaded = atomspace_load(path);
+    assert(n_loaded == 7);
+    
+    const char* loaded[4] = {"f-cat", "f-animal", "f-dog", "f-\xc3\xa9t\"e"};
+    atom_handle_t f[4];
+    n_found = cog_atom_lookup(loaded, 4, f);
+    assert(n_found == 4);
+    atom_handle_t cat_animal[2] = {f[0], f[1]};
+    atom_handle_t link = cog_link_create(ATOM_LINK, cat_animal, 2);
+    size_t n_incoming = cog_atom_incoming(f[1], ATOM_LINK, nullptr, 0);
+    assert(n_incoming == 2);
+    atom_handle_t pred[1];
+    n_incoming = cog_atom_incoming(f[2], ATOM_PREDICATE, pred, 1);
+    assert(n_incoming == 1);
+    n_incoming = cog_atom_incoming(link, ATOM_PREDICATE, nullptr, 0);
+    assert(n_incoming == 1);
+    
+    /* A file that does not parse loads nothing */
+    write_file(path, "(concept \"x-good\")\n(concept \"x-bad)\n");
+    n_loaded = atomspace_load(path);
+    assert(n_loaded < 0);
+    const char* good = "x-good";
+    n_found = cog_atom_lookup(&good, 1, f);
+    assert(n_found == 0);
+    write_file(path, "(concept \"x-good\")\n"
+        "{\"type\": \"concept\", \"name\": \"x\", \"outgoing\": [{\"type\": \"node\"}]}\n");
+    n_loaded = atomspace_load(path);
+    assert(n_loaded < 0);
+    write_file(path, "(concept \"x-good\")\n(colour \"red\")\n");
+    n_loaded = atomspace_load(path);
+    assert(n_loaded < 0);
+    n_loaded = atomspace_load("/nonexistent/atoms.txt");
+    assert(n_loaded < 0);
+    
+    /* Several chunks: 40 names repeated over 60000 lines, 1600 distinct links */
+    FILE* file = fopen(path, "w");
+    assert(file != nullptr);
+    enum { LINES = 60000, K = 40 };
+    for (int i = 0; i < LINES; i++) {
+        fprintf(file, "(link (concept \"m-%d\") (concept \"m-%d\"))\n", i % K, (i / K) % K);
+    }
+    fclose(file);
+    n_loaded = atomspace_load(path);
+    assert(n_loaded == LINES);
+    const char* m0 = "m-0";
+    n_found = cog_atom_lookup(&m0, 1, f);
+    assert(n_found == 1);
+    n_incoming = cog_atom_incoming(f[0], ATOM_LINK, nullptr, 0);
+    assert(n_incoming == 2 * K - 1);
+    
+    unlink(path);
+    
+    printf("  PASS: AtomSpace bulk import\n");
+    return 0;
+}
+
+/* Test AtomSpace writers and readers on several threads */
+static int test_atomspace_concurrent(void) {
+    printf("Testing AtomSpace concurrency...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    enum { WRITERS = 4, NAMES = 300, ROUNDS = 3, SHARED = 100 };
+    atom_handle_t hub = cog_atom_alloc(ATOM_CONCEPT, "mt-hub");
+    assert(hub != 0);
+    static atom_handle_t shared[WRITERS][SHARED];
+    std::atomic<bool> stop{false};
+    
+    /* Each writer links its own names to the hub, frees them all and makes them again,
+       and races the others to make the same shared names */
+    auto writer = [&](int t) {
+        char name[32];
+        std::vector<atom_handle_t> mine(NAMES);
+        float vec[COG_EMBED_DIM] = {};
+        for (int round = 0; round < ROUNDS; round++) {
+            for (int i = 0; i < NAMES; i++) {
+                snprintf(name, sizeof(name), "mt-%d-%d", t, i);
+                mine[i] = cog_atom_alloc(ATOM_CONCEPT, name);
+                atom_handle_t pair[2] = {hub, mine[i]};
+                atom_handle_t new_link = cog_link_create(ATOM_LINK, pair, 2);
+                assert(mine[i] != 0 && new_link != 0);
+                vec[t] = (float)i;
+                int ret = cog_atom_set_embedding(mine[i], vec);
+                assert(ret == 0);
+            }
+            for (int i = 0; i < SHARED; i++) {
+                snprintf(name, sizeof(name), "mt-shared-%d", (i + t * 7) % SHARED);
+                shared[t][(i + t * 7) % SHARED] = cog_atom_alloc(ATOM_NODE, name);
+            }
+            if (round == ROUNDS - 1) {
+                break;
+            }
+            for (int i = 0; i < NAMES; i++) {
+                atom_handle_t pair[2] = {hub, mine[i]};
+                atom_handle_t link = cog_link_create(ATOM_LINK, pair, 2);
+                int ret = cog_atom_free(link);
+                int rc = cog_atom_free(mine[i]);
+                assert(ret == 0 && rc == 0);
+            }
+        }
+    };
+    
+    /* Readers resolve names, walk the hub's incoming set, query and search meanwhile */
+    std::atomic<size_t> reads{0};
+    auto reader = [&]() {
+        const char* probe[2] = {"mt-hub", "mt-0-0"};
+        atom_handle_t found[2];
+        atom_handle_t links[16];
+        cog_term_t terms[2] = {{hub, 0}, {0, 0}};
+        cog_clause_t clause = {ATOM_LINK, terms, 2};
+        float query[COG_EMBED_DIM] = {1.0f};
+        atom_handle_t best[4];
+        while (!stop.load()) {
+            size_t n_found = cog_atom_lookup(probe, 2, found);
+            assert(n_found >= 1 && found[0] == hub);
+            cog_atom_incoming(hub, ATOM_LINK, links, 16);
+            int64_t matches = cog_query(&clause, 1, 1, nullptr, 0);
+            assert(matches <= WRITERS * NAMES);
+            int ret = cog_embed_topk(query, 1, 4, COG_SIM_DOT, best, nullptr);
+            assert(ret >= 0);
+            reads++;
+        }
+    };
+    
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; r++) {
+        readers.emplace_back(reader);
+    }
+    std::vector<std::thread> writers;
+    for (int t = 0; t < WRITERS; t++) {
+        writers.emplace_back(writer, t);
+    }
+    for (std::thread& w : writers) {
+        w.join();
+    }
+    stop = true;
+    for (std::thread& r : readers) {
+        r.join();
+    }
+    assert(reads > 0);
+    
+    /* Every writer got the same shared atoms; the last round's links all stand */
+    for (int t = 1; t < WRITERS; t++) {
+        assert(memcmp(shared[t], shared[0], sizeof(shared[0])) == 0);
+    }
+    size_t n_incoming = cog_atom_incoming(hub, ATOM_LINK, nullptr, 0);
+    assert(n_incoming == WRITERS * NAMES);
+    for (int t = 0; t < WRITERS; t++) {
+        char name[32];
+        snprintf(name, sizeof(name), "mt-%d-%d", t, NAMES - 1);
+        const char* probe = name;
+        atom_handle_t atom;
+        float vec[COG_EMBED_DIM];
+        size_t n_found = cog_atom_lookup(&probe, 1, &atom);
+        assert(n_found == 1);
+        int ret = cog_atom_embedding(atom, vec);
+        assert(ret == 0 && vec[t] == (float)(NAMES - 1));
+        n_incoming = cog_atom_incoming(atom, ATOM_LINK, nullptr, 0);
+        assert(n_incoming == 1);
+    }
+    
+    /* A link that repeats its target joins the target's incoming set once, even while
+       links in other shards join that set between the repeats */
+    enum { REPEATS = 300, SPAN = 64 };
+    atom_handle_t target = cog_atom_alloc(ATOM_CONCEPT, "mt-target");
+    assert(target != 0);
+    std::vector<atom_handle_t> repeated(REPEATS), plain(REPEATS);
+    auto repeater = [&]() {
+        char name[32];
+        atom_handle_t outgoing[SPAN + 3];
+        for (int i = 0; i < REPEATS; i++) {
+            snprintf(name, sizeof(name), "mt-rep-%d", i);
+            outgoing[0] = target;
+            memcpy(&outgoing[1], shared[0], SPAN * sizeof(atom_handle_t));
+            outgoing[SPAN + 1] = target;
+            outgoing[SPAN + 2] = cog_atom_alloc(ATOM_CONCEPT, name);
+            repeated[i] = cog_link_create(ATOM_LINK, outgoing, SPAN + 3);
+            assert(repeated[i] != 0);
+        }
+    };
+    auto plainer = [&]() {
+        char name[32];
+        for (int i = 0; i < REPEATS; i++) {
+            snprintf(name, sizeof(name), "mt-plain-%d", i);
+            atom_handle_t pair[2] = {target, cog_atom_alloc(ATOM_CONCEPT, name)};
+            plain[i] = cog_link_create(ATOM_LINK, pair, 2);
+            assert(plain[i] != 0);
+        }
+    };
+    std::thread rep_thread(repeater), plain_thread(plainer);
+    rep_thread.join();
+    plain_thread.join();
+    
+    std::vector<atom_handle_t> incoming(4 * REPEATS);
+    n_incoming = cog_atom_incoming(target, ATOM_LINK, incoming.data(), incoming.size());
+    assert(n_incoming == 2 * REPEATS);
+    for (int i = 0; i < REPEATS; i++) {
+        int ret = cog_atom_free(repeated[i]);
+        assert(ret == 0);
+    }
+    n_incoming = cog_atom_incoming(target, ATOM_LINK, incoming.data(), incoming.size());
+    assert(n_incoming == REPEATS);
+    std::sort(incoming.begin(), incoming.begin() + REPEATS);
+    std::sort(plain.begin(), plain.end());
+    assert(std::equal(plain.begin(), plain.end(), incoming.begin()));
+    
+    printf("  PASS: AtomSpace concurrency\n");
+    return 0;
+}
+
+/* Test embedding search */
+static int test_embedding(void) {
+    printf("Testing embedding search...\n");
+    
+    kern_bootstrap_init(STAGE3_COGNITIVE);
+    
+    /* Random unit-scale embeddings */
+    enum { N = 1500, Q = 50, K = 10 };
+    std::vector<atom_handle_t> atoms(N);
+    std::vector<float> vecs((size_t)N * COG_EMBED_DIM);
+    uint32_t x = 12345u;
+    for (size_t i = 0; i < vecs.size(); i++) {
+        x = x * 1664525u + 1013904223u;
+        vecs[i] = (float)(x >> 8) / (float)(1u << 24) - 0.5f;
+    }
+    std::vector<float> got(COG_EMBED_DIM, 1.0f);
+    for (int i = 0; i < N; i++) {
+        atoms[i] = cog_atom_alloc(ATOM_NODE, nullptr);
+        assert(atoms[i] != 0);
+        int ret = cog_atom_embedding(atoms[i], got.data());
+        assert(ret == 0);
+        assert(got[0] == 0.0f && got[COG_EMBED_DIM - 1] == 0.0f);
+        ret = cog_atom_set_embedding(atoms[i], &vecs[(size_t)i * COG_EMBED_DIM]);
+        assert(ret == 0);
+    }
+    
+    /* Each atom's own vector finds it first, at cosine 1 */
+    atom_handle_t top[Q * K];
+    float scores[Q * K];
+    int ret = cog_embed_topk(vecs.data(), Q, K, COG_SIM_COSINE, top, scores);
+    assert(ret == K);
+    for (int q = 0; q < Q; q++) {
+        assert(top[q * K] == atoms[q] && fabsf(scores[q * K] - 1.0f) < 1e-4f);
+        for (int i = 1; i < K; i++) {
+            assert(scores[q * K + i] <= scores[q * K + i - 1]);
+        }
+    }
+    
+    /* A batch gives the same results as one query at a time */
+    atom_handle_t one[K];
+    ret = cog_embed_topk(&vecs[7 * COG_EMBED_DIM], 1, K, COG_SIM_DOT, one, nullptr);
+    assert(ret == K);
+    ret = cog_embed_topk(vecs.data(), Q, K, COG_SIM_DOT, top, nullptr);
+    assert(ret == K);
+    assert(memcmp(one, &top[7 * K], sizeof(one)) == 0);
+    
+    /* The approximate index agrees with the exact search on most results */
+    cog_hnsw_params_t params = COG_HNSW_DEFAULT;
+    ret = cog_embed_index_search(vecs.data(), 1, K, one, nullptr);
+    assert(ret < 0);
+    ret = cog_embed_index_build(&params);
+    assert(ret == 0);
+    atom_handle_t approx[Q * K];
+    ret = cog_embed_topk(vecs.data(), Q, K, COG_SIM_COSINE, top, nullptr);
+    assert(ret == K);
+    ret = cog_embed_index_search(vecs.data(), Q, K, approx, nullptr);
+    assert(ret == K);
+    int hits = 0;
+    for (int q = 0; q < Q; q++) {
+        assert(approx[q * K] == atoms[q]);
+        for (int i = 0; i < K; i++) {
+            for (int j = 0; j < K; j++) {
+                hits += approx[q * K + i] == top[q * K + j];
+            }
+        }
+    }
+    assert(hits >= Q * K * 8 / 10);
+    
+    /* Freed atoms leave both searches; moved embeddings are found at their new place */
+    ret = cog_atom_free(atoms[3]);
+    assert(ret == 0);
+    ret = cog_embed_topk(&vecs[3 * COG_EMBED_DIM], 1, K, COG_SIM_COSINE, one, nullptr);
+    assert(ret == K);
+    assert(one[0] != atoms[3]);
+    ret = cog_embed_index_search(&vecs[3 * COG_EMBED_DIM], 1, K, one, nullptr);
+    assert(ret == K);
+    assert(one[0] != atoms[3]);
+    ret = cog_atom_set_embedding(atoms[4], &vecs[3 * COG_EMBED_DIM]);
+    assert(ret == 0);
+    ret = cog_embed_index_set_ef(128);
+    assert(ret == 0);
+    ret = cog_embed_index_search(&vecs[3 * COG_EMBED_DIM], 1, K, one, scores);
+    assert(ret == K);
+    assert(one[0] == atoms[4] && fabsf(scores[0] - 1.0f) < 1e-4f);
+    
+    cog_embed_index_destroy();
+    ret = cog_embed_index_search(vecs.data(), 1, K, one, nullptr);
+    assert(ret < 0);
+    
+    /* Matrix blocks go back to the tensor pool with their last row, and come back from it */
+    mem_stats_t stats;
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.live_tensors == (N + 255) / 256);
+    for (int i = 0; i < N; i++) {
+        cog_atom_free(atoms[i]);
+    }
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.live_tensors == 0);
+    uint64_t reused = stats.tensors.reused_count;
+    atoms[0] = cog_atom_alloc(ATOM_NODE, nullptr);
+    ret = cog_atom_set_embedding(atoms[0], vecs.data());
+    assert(ret == 0);
+    ret = cog_atom_embedding(atoms[0], got.data());
+    assert(ret == 0 && got[5] == vecs[5]);
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.live_tensors == 1 && stats.tensors.reused_count == reused + 1);
+    
+    printf("  PASS: Embedding search\n");
+    return 0;
+}
+
+/* Test quantized embedding storage */
+static int test_embedding_quant(const char* type, float tolerance) {
+    printf("Testing %s embeddings...\n", type);
+    
+    setenv("AICHAT_EMBED_TYPE", type, 1);
+    int ret = kern_bootstrap_init(STAGE3_COGNITIVE);
+    assert(ret == 0);
+    
+    enum { N = 300, K = 5 };
+    std::vector<atom_handle_t> atoms(N);
+    std::vector<float> vecs((size_t)N * COG_EMBED_DIM);
+    uint32_t x = 777u;
+    for (size_t i = 0; i < vecs.size(); i++) {
+        x = x * 1664525u + 1013904223u;
+        vecs[i] = (float)(x >> 8) / (float)(1u << 24) - 0.5f;
+    }
+    
+    /* Atoms without an embedding are never results */
+    atom_handle_t bare = cog_atom_alloc(ATOM_NODE, nullptr);
+    for (int i = 0; i < N; i++) {
+        atoms[i] = cog_atom_alloc(ATOM_NODE, nullptr);
+        ret = cog_atom_set_embedding(atoms[i], &vecs[(size_t)i * COG_EMBED_DIM]);
+        assert(ret == 0);
+    }
+    
+    /* Stored values come back within the type's precision */
+    std::vector<float> got(COG_EMBED_DIM);
+    ret = cog_atom_embedding(atoms[9], got.data());
+    assert(ret == 0);
+    for (int d = 0; d < COG_EMBED_DIM; d++) {
+        assert(fabsf(got[d] - vecs[9 * COG_EMBED_DIM + d]) <= tolerance);
+    }
+    
+    /* Search runs on the stored rows and still finds each atom first */
+    atom_handle_t top[N * K];
+    float scores[N * K];
+    ret = cog_embed_topk(vecs.data(), N, K, COG_SIM_COSINE, top, scores);
+    assert(ret == K);
+    for (int q = 0; q < N; q++) {
+        assert(top[q * K] == atoms[q] && fabsf(scores[q * K] - 1.0f) < 0.01f);
+        for (int i = 0; i < K; i++) {
+            assert(top[q * K + i] != bare);
+        }
+    }
+    
+    ret = cog_embed_index_build(nullptr);
+    assert(ret == 0);
+    ret = cog_embed_index_search(vecs.data(), N, K, top, nullptr);
+    assert(ret == K);
+    int first = 0;
+    for (int q = 0; q < N; q++) {
+        first += top[q * K] == atoms[q];
+    }
+    assert(first >= N * 95 / 100);
+    cog_embed_index_destroy();
+    
+    printf("  PASS: %s embeddings\n", type);
+    return 0;
+}
+
 /* Test ECAN */
 static int test_ecan(void) {
     printf("Testing ECAN...\n");
@@ -95,6 +766,24 @@ int main(int argc, char** argv) {
     
     if (strcmp(argv[1], "atomspace") == 0) {
         ret = test_atomspace();
+    } else if (strcmp(argv[1], "atomspace_handles") == 0) {
+        ret = test_atomspace_handles();
+    } else if (strcmp(argv[1], "atomspace_names") == 0) {
+        ret = test_atomspace_names();
+    } else if (strcmp(argv[1], "atomspace_query") == 0) {
+        ret = test_atomspace_query();
+    } else if (strcmp(argv[1], "atomspace_links") == 0) {
+        ret = test_atomspace_links();
+    } else if (strcmp(argv[1], "atomspace_load") == 0) {
+        ret = test_atomspace_load();
+    } else if (strcmp(argv[1], "atomspace_concurrent") == 0) {
+        ret = test_atomspace_concurrent();
+    } else if (strcmp(argv[1], "embedding") == 0) {
+        ret = test_embedding();
+    } else if (strcmp(argv[1], "embedding_f16") == 0) {
+        ret = test_embedding_quant("f16", 1e-3f);
+    } else if (strcmp(argv[1], "embedding_q8_0") == 0) {
+        ret = test_embedding_quant("q8_0", 0.5f / 127.0f);
     } else if (strcmp(argv[1], "ecan") == 0) {
         ret = test_ecan();
     } else if (strcmp(argv[1], "pln") == 0) {
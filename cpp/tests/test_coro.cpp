@@ -0,0 +1,242 @@
+/**
+ * @file test_coro.cpp
+ * @brief Cooperative coroutine task tests
+ */
+
+#include "aichat/coro.h"
+#include "aichat/kernel.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+/* Live heap bytes, to check that frames are returned */
+static size_t heap_live(void) {
+    mem_stats_t stats;
+    dtesn_mem_stats(&stats);
+    return stats.regions[MEM_REGION_HEAP].live_bytes;
+}
+
+/* Test yielding between ticks */
+static int yield_log[16];
+static int yield_len = 0;
+
+static aichat::coro_task yield_loop(int id, int steps) {
+    for (int i = 0; i < steps; i++) {
+        yield_log[yield_len++] = id * 10 + i;
+        bool yielded = co_await aichat::yield();
+        assert(yielded);
+    }
+}
+
+static int test_coro_yield(void) {
+    printf("Testing coroutine yield...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    ret = dtesn_mem_init(0);
+    assert(ret == 0);
+    size_t live = heap_live();
+    
+    ret = aichat::spawn(yield_loop(1, 3), PRIORITY_NORMAL, 0);
+    assert(ret == SCHED_OK);
+    ret = aichat::spawn(yield_loop(2, 3), PRIORITY_NORMAL, 0);
+    assert(ret == SCHED_OK);
+    assert(heap_live() > live);
+    
+    /* One step of each coroutine per tick */
+    int executed = dtesn_sched_tick();
+    assert(executed == 2);
+    assert(yield_len == 2);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    size_t pending = dtesn_sched_pending();
+    assert(pending == 0);
+    
+    const int expected[6] = {10, 20, 11, 21, 12, 22};
+    assert(yield_len == 6);
+    assert(memcmp(yield_log, expected, sizeof(expected)) == 0);
+    
+    /* Finished frames free themselves */
+    assert(heap_live() == live);
+    
+    /* An unspawned task frees its frame on destruction */
+    {
+        aichat::coro_task unused = yield_loop(3, 1);
+        assert(unused);
+    }
+    assert(heap_live() == live);
+    ret = aichat::spawn(aichat::coro_task(), PRIORITY_NORMAL, 0);
+    assert(ret == SCHED_ERR_INVALID);
+    
+    printf("  PASS: Coroutine yield\n");
+    return 0;
+}
+
+/* Test awaiting timers, tasks and child coroutines */
+static int await_step = 0;
+static int await_count = 0;
+static std::atomic<uint64_t> await_now_ns{1000000000};
+
+/* Manual clock: sleep_for only fires once the test has stepped time past it */
+static uint64_t await_clock(void) {
+    return await_now_ns.load();
+}
+
+/* Advance the manual clock by us microseconds, ticking at every timer slot */
+static void await_advance(uint64_t us) {
+    for (uint64_t t = 0; t < us; t += SCHED_TIMER_RESOLUTION_US) {
+        await_now_ns += SCHED_TIMER_RESOLUTION_US * 1000;
+        dtesn_sched_tick();
+    }
+}
+
+static void await_task(void* data) {
+    (void)data;
+    await_count++;
+}
+
+static aichat::coro_task await_child(int* trace) {
+    *trace = *trace * 10 + 2;
+    co_await aichat::yield();
+    *trace = *trace * 10 + 3;
+}
+
+static aichat::coro_task await_parent(task_handle_t task, int* trace) {
+    /* Scheduled task completion */
+    bool resumed = co_await aichat::after(task);
+    assert(resumed);
+    assert(await_count == 1);
+    await_step = 1;
+    
+    /* Timer */
+    sched_timer_stats_t timers;
+    dtesn_sched_timer_stats(&timers);
+    uint64_t fired = timers.fired;
+    resumed = co_await aichat::sleep_for(2000);
+    assert(resumed);
+    dtesn_sched_timer_stats(&timers);
+    assert(timers.fired == fired + 1);
+    await_step = 2;
+    
+    /* Child coroutine runs to completion before the parent resumes */
+    *trace = 1;
+    bool ran = co_await await_child(trace);
+    assert(ran);
+    *trace = *trace * 10 + 4;
+    await_step = 3;
+}
+
+static int test_coro_await(void) {
+    printf("Testing coroutine await...\n");
+    
+    dtesn_sched_set_clock(await_clock);
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    size_t live = heap_live();
+    
+    int trace = 0;
+    task_handle_t task = dtesn_sched_task(await_task, nullptr, PRIORITY_LOW, 0);
+    assert(task != 0);
+    ret = aichat::spawn(await_parent(task, &trace), PRIORITY_HIGH, 1);
+    assert(ret == SCHED_OK);
+    
+    /* The coroutine is released by the LOW task within the same tick */
+    dtesn_sched_tick();
+    assert(await_step == 1);
+    
+    /* The 2ms sleep ends on its slot, not before */
+    await_advance(1900);
+    assert(await_step == 1);
+    await_advance(100);
+    assert(await_step == 2);
+    
+    /* The child's yield takes a tick, then the parent resumes */
+    for (int i = 0; i < 4 && await_step < 3; i++) {
+        dtesn_sched_tick();
+    }
+    assert(await_step == 3);
+    assert(trace == 1234);
+    size_t pending = dtesn_sched_pending();
+    assert(pending == 0);
+    assert(heap_live() == live);
+    
+    dtesn_sched_set_clock(nullptr);
+    
+    printf("  PASS: Coroutine await\n");
+    return 0;
+}
+
+/* Test coroutines on the work-stealing executor */
+#define EXEC_COROS 64
+#define EXEC_STEPS 10
+
+static std::atomic<int> exec_steps{0};
+static std::atomic<int> exec_done{0};
+
+static aichat::coro_task exec_loop(void) {
+    for (int i = 0; i < EXEC_STEPS; i++) {
+        exec_steps.fetch_add(1);
+        co_await aichat::yield();
+    }
+    exec_done.fetch_add(1);
+}
+
+static int test_coro_exec(void) {
+    printf("Testing coroutines on the executor...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    size_t live = heap_live();
+    
+    ret = dtesn_sched_exec_start(4, SCHED_EXEC_BARRIER);
+    assert(ret == 0);
+    
+    for (int i = 0; i < EXEC_COROS; i++) {
+        ret = aichat::spawn(exec_loop(), (task_priority_t)(i % 4), 0);
+        assert(ret == SCHED_OK);
+    }
+    
+    /* A yield on a worker still waits for the next tick */
+    int ticks = 0;
+    while (exec_done.load() < EXEC_COROS) {
+        dtesn_sched_tick();
+        ticks++;
+        assert(exec_steps.load() <= EXEC_COROS * ticks);
+    }
+    
+    dtesn_sched_exec_stop();
+    
+    assert(ticks == EXEC_STEPS + 1);
+    assert(exec_steps.load() == EXEC_COROS * EXEC_STEPS);
+    assert(heap_live() == live);
+    
+    printf("  PASS: Coroutines on the executor\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <test>\n", argv[0]);
+        return 1;
+    }
+    
+    int ret = 0;
+    
+    if (strcmp(argv[1], "yield") == 0) {
+        ret = test_coro_yield();
+    } else if (strcmp(argv[1], "await") == 0) {
+        ret = test_coro_await();
+    } else if (strcmp(argv[1], "exec") == 0) {
+        ret = test_coro_exec();
+    } else {
+        fprintf(stderr, "Unknown test: %s\n", argv[1]);
+        return 1;
+    }
+    
+    return ret;
+}
@@ -4,8 +4,15 @@
  */
 
 #include "aichat/kernel.h"
+#include <ggml.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <assert.h>
 
 /* Test bootstrap */
@@ -43,6 +50,590 @@ static int test_scheduler(void) {
     return 0;
 }
 
+/* Test scheduler ready queues */
+static int order_log[8];
+static int order_len = 0;
+
+static void order_task(void* data) {
+    order_log[order_len++] = (int)(intptr_t)data;
+}
+
+static int test_sched_queue(void) {
+    printf("Testing scheduler ready queues...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    /* FIFO within a level, higher levels first */
+    dtesn_sched_task(order_task, (void*)(intptr_t)1, PRIORITY_LOW, 0);
+    dtesn_sched_task(order_task, (void*)(intptr_t)2, PRIORITY_NORMAL, 0);
+    dtesn_sched_task(order_task, (void*)(intptr_t)3, PRIORITY_CRITICAL, 0);
+    dtesn_sched_task(order_task, (void*)(intptr_t)4, PRIORITY_NORMAL, 0);
+    dtesn_sched_task(order_task, (void*)(intptr_t)5, PRIORITY_CRITICAL, 0);
+    
+    int executed = dtesn_sched_tick();
+    assert(executed == 5);
+    
+    const int expected[5] = {3, 5, 2, 4, 1};
+    for (int i = 0; i < 5; i++) {
+        assert(order_log[i] == expected[i]);
+    }
+    
+    /* Empty tick */
+    int ran = dtesn_sched_tick();
+    assert(ran == 0);
+    
+    /* Fill to capacity, then slots are reused after a tick */
+    int count = 0;
+    int scheduled = 0;
+    while (dtesn_sched_task(test_task, &count, PRIORITY_HIGH, 0) != 0) {
+        scheduled++;
+    }
+    assert(scheduled > 0);
+    task_handle_t task = dtesn_sched_task(test_task, &count, PRIORITY_HIGH, 0);
+    assert(task == 0);
+    ran = dtesn_sched_tick();
+    assert(ran == scheduled);
+    assert(count == scheduled);
+    task = dtesn_sched_task(test_task, &count, PRIORITY_HIGH, 0);
+    assert(task != 0);
+    ran = dtesn_sched_tick();
+    assert(ran == 1);
+    
+    /* Invalid priority */
+    task = dtesn_sched_task(test_task, &count, (task_priority_t)7, 0);
+    assert(task == 0);
+    
+    printf("  PASS: Scheduler ready queues\n");
+    return 0;
+}
+
+/* Test work-stealing executor */
+static atomic_int exec_count;
+
+static void exec_leaf(void* data) {
+    (void)data;
+    atomic_fetch_add(&exec_count, 1);
+}
+
+static void exec_parent(void* data) {
+    (void)data;
+    atomic_fetch_add(&exec_count, 1);
+    
+    /* Children land on this worker's deque and may be stolen */
+    for (int i = 0; i < 4; i++) {
+        task_handle_t h = dtesn_sched_task(exec_leaf, NULL, PRIORITY_NORMAL, 1);
+        assert(h != 0);
+    }
+}
+
+static int test_sched_exec(void) {
+    printf("Testing scheduler executor...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    ret = dtesn_sched_exec_start(4, SCHED_EXEC_BARRIER);
+    assert(ret == 0);
+    int rc = dtesn_sched_exec_start(4, SCHED_EXEC_BARRIER);
+    assert(rc != 0);
+    
+    /* Barrier mode: tick waits for tasks and their children */
+    for (int round = 0; round < 50; round++) {
+        atomic_store(&exec_count, 0);
+        for (int i = 0; i < 100; i++) {
+            task_handle_t h = dtesn_sched_task(exec_parent, NULL,
+                                               (task_priority_t)(i % 4), 0);
+            assert(h != 0);
+        }
+        int executed = dtesn_sched_tick();
+        assert(executed == 500);
+        assert(atomic_load(&exec_count) == 500);
+    }
+    
+    dtesn_sched_exec_stop();
+    
+    /* Free-running mode: tasks run without a tick */
+    ret = dtesn_sched_exec_start(2, SCHED_EXEC_FREE_RUNNING);
+    assert(ret == 0);
+    
+    atomic_store(&exec_count, 0);
+    for (int i = 0; i < 100; i++) {
+        task_handle_t task = dtesn_sched_task(exec_leaf, NULL, PRIORITY_HIGH, 0);
+        assert(task != 0);
+    }
+    
+    /* Stop drains queued work before joining */
+    dtesn_sched_exec_stop();
+    assert(atomic_load(&exec_count) == 100);
+    
+    /* Inline execution resumes after stop */
+    int count = 0;
+    task_handle_t task = dtesn_sched_task(test_task, &count, PRIORITY_NORMAL, 0);
+    assert(task != 0);
+    int ran = dtesn_sched_tick();
+    assert(ran == 1);
+    assert(count == 1);
+    
+    printf("  PASS: Scheduler executor\n");
+    return 0;
+}
+
+/* Test multi-producer submission */
+#define SUBMIT_THREADS 4
+#define SUBMIT_PER_THREAD 5000
+
+static atomic_int submit_done;
+static atomic_int submit_runs;
+
+static void submit_task(void* data) {
+    (void)data;
+    atomic_fetch_add(&submit_runs, 1);
+}
+
+static void* submit_producer(void* arg) {
+    (void)arg;
+    for (int i = 0; i < SUBMIT_PER_THREAD; i++) {
+        /* Back off on a full queue instead of dropping the task */
+        while (dtesn_sched_submit(submit_task, NULL, (task_priority_t)(i % 4), 0, NULL)
+               == SCHED_ERR_FULL) {
+            sched_yield();
+        }
+    }
+    atomic_fetch_add(&submit_done, 1);
+    return NULL;
+}
+
+static int test_sched_submit(void) {
+    printf("Testing scheduler submission...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    /* Back-pressure: the slot that does not fit is reported, not dropped */
+    int scheduled = 0;
+    while (dtesn_sched_submit(submit_task, NULL, PRIORITY_LOW, 0, NULL) == SCHED_OK) {
+        scheduled++;
+    }
+    int rc = dtesn_sched_submit(submit_task, NULL, PRIORITY_LOW, 0, NULL);
+    assert(rc == SCHED_ERR_FULL);
+    size_t pending = dtesn_sched_pending();
+    assert(pending == (size_t)scheduled);
+    int ran = dtesn_sched_tick();
+    assert(ran == scheduled);
+    pending = dtesn_sched_pending();
+    assert(pending == 0);
+    rc = dtesn_sched_submit(NULL, NULL, PRIORITY_LOW, 0, NULL);
+    assert(rc == SCHED_ERR_INVALID);
+    
+    /* Producers race the tick thread */
+    atomic_store(&submit_done, 0);
+    atomic_store(&submit_runs, 0);
+    
+    pthread_t threads[SUBMIT_THREADS];
+    for (int i = 0; i < SUBMIT_THREADS; i++) {
+        pthread_create(&threads[i], NULL, submit_producer, NULL);
+    }
+    
+    int executed = 0;
+    while (atomic_load(&submit_done) < SUBMIT_THREADS || dtesn_sched_pending() > 0) {
+        executed += dtesn_sched_tick();
+    }
+    
+    for (int i = 0; i < SUBMIT_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    assert(executed == SUBMIT_THREADS * SUBMIT_PER_THREAD);
+    assert(atomic_load(&submit_runs) == SUBMIT_THREADS * SUBMIT_PER_THREAD);
+    
+    printf("  PASS: Scheduler submission\n");
+    return 0;
+}
+
+/* Test dependency graphs */
+static atomic_int dag_clock;
+static int dag_stamp[8];
+
+static void dag_task(void* data) {
+    dag_stamp[(intptr_t)data] = atomic_fetch_add(&dag_clock, 1);
+}
+
+/* Diamond a -> (b, c) -> d, plus an independent task e beside a */
+static void dag_diamond(task_handle_t* tail) {
+    task_handle_t a, b, c, d;
+    
+    int ret = dtesn_sched_submit(dag_task, (void*)(intptr_t)0, PRIORITY_NORMAL, 0, &a);
+    assert(ret == SCHED_OK);
+    ret = dtesn_sched_submit_deps(dag_task, (void*)(intptr_t)1, PRIORITY_NORMAL, 1, &a, 1, &b);
+    assert(ret == SCHED_OK);
+    ret = dtesn_sched_submit_deps(dag_task, (void*)(intptr_t)2, PRIORITY_NORMAL, 1, &a, 1, &c);
+    assert(ret == SCHED_OK);
+    task_handle_t bc[2] = {b, c};
+    ret = dtesn_sched_submit_deps(dag_task, (void*)(intptr_t)3, PRIORITY_NORMAL, 2, bc, 2, &d);
+    assert(ret == SCHED_OK);
+    ret = dtesn_sched_submit(dag_task, (void*)(intptr_t)4, PRIORITY_NORMAL, 0, NULL);
+    assert(ret == SCHED_OK);
+    
+    if (tail) {
+        *tail = d;
+    }
+}
+
+static void dag_check_diamond(bool waves) {
+    assert(dag_stamp[0] < dag_stamp[1] && dag_stamp[0] < dag_stamp[2]);
+    assert(dag_stamp[1] < dag_stamp[3] && dag_stamp[2] < dag_stamp[3]);
+    if (waves) {
+        assert(dag_stamp[4] < dag_stamp[1] && dag_stamp[4] < dag_stamp[2]);
+    }
+}
+
+static int test_sched_dag(void) {
+    printf("Testing scheduler dependency graphs...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    /* The whole graph runs in one tick, one wave per depth */
+    task_handle_t tail;
+    dtesn_sched_profile(true);
+    dag_diamond(&tail);
+    size_t pending = dtesn_sched_pending();
+    assert(pending == 5);
+    int executed = dtesn_sched_tick();
+    assert(executed == 5);
+    dag_check_diamond(true);
+    
+    sched_graph_report_t report;
+    int rc = dtesn_sched_graph_report(&report);
+    assert(rc == 0);
+    assert(report.tasks == 5);
+    assert(report.waves == 3);
+    assert(report.critical_tail == tail);
+    assert(report.critical_path_ns > 0 && report.critical_path_ns <= report.work_ns);
+    dtesn_sched_profile(false);
+    
+    /* Completed dependencies count as satisfied */
+    task_handle_t done = tail;
+    rc = dtesn_sched_submit_deps(dag_task, (void*)(intptr_t)5, PRIORITY_NORMAL, 0, &done, 1, NULL);
+    assert(rc == SCHED_OK);
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    
+    /* Shallower depth first within a priority level */
+    rc = dtesn_sched_submit(dag_task, (void*)(intptr_t)6, PRIORITY_HIGH, 3, NULL);
+    assert(rc == SCHED_OK);
+    rc = dtesn_sched_submit(dag_task, (void*)(intptr_t)7, PRIORITY_HIGH, 1, NULL);
+    assert(rc == SCHED_OK);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    assert(dag_stamp[7] < dag_stamp[6]);
+    
+    /* Invalid dependency handles are rejected */
+    task_handle_t zero = 0;
+    rc = dtesn_sched_submit_deps(dag_task, NULL, PRIORITY_LOW, 0, &zero, 1, NULL);
+    assert(rc == SCHED_ERR_INVALID);
+    rc = dtesn_sched_submit_deps(dag_task, NULL, PRIORITY_LOW, 0, NULL, 1, NULL);
+    assert(rc == SCHED_ERR_INVALID);
+    
+    /* Waves run in parallel on the executor, in the same order */
+    ret = dtesn_sched_exec_start(4, SCHED_EXEC_BARRIER);
+    assert(ret == 0);
+    for (int round = 0; round < 50; round++) {
+        dag_diamond(NULL);
+        executed = dtesn_sched_tick();
+        assert(executed == 5);
+        dag_check_diamond(true);
+    }
+    dtesn_sched_exec_stop();
+    
+    /* Free-running: dependents are released straight onto the workers */
+    ret = dtesn_sched_exec_start(2, SCHED_EXEC_FREE_RUNNING);
+    assert(ret == 0);
+    dag_diamond(NULL);
+    dtesn_sched_exec_stop();
+    pending = dtesn_sched_pending();
+    assert(pending == 0);
+    dag_check_diamond(false);
+    
+    printf("  PASS: Scheduler dependency graphs\n");
+    return 0;
+}
+
+/* Test tick budget and deadline ordering */
+static int budget_log[8];
+static int budget_len = 0;
+
+static void budget_order(void* data) {
+    budget_log[budget_len++] = (int)(intptr_t)data;
+}
+
+static atomic_uint_fast64_t budget_now_ns;
+
+/* Manual clock: only tasks move it, so elapsed tick time is exact */
+static uint64_t budget_clock(void) {
+    return atomic_load(&budget_now_ns);
+}
+
+/* Take data microseconds of (manual clock) time */
+static void budget_work(void* data) {
+    atomic_fetch_add(&budget_now_ns, (uint64_t)(intptr_t)data * 1000);
+}
+
+static int test_sched_budget(void) {
+    printf("Testing scheduler tick budget...\n");
+    
+    atomic_store(&budget_now_ns, 1000000000ull);
+    dtesn_sched_set_clock(budget_clock);
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    /* Earliest deadline first within a wave; no deadline runs last, in order */
+    sched_task_attr_t attr = {0};
+    int rc = dtesn_sched_submit(budget_order, (void*)(intptr_t)4, PRIORITY_NORMAL, 0, NULL);
+    assert(rc == SCHED_OK);
+    attr.deadline_us = 300000;
+    dtesn_sched_submit_attr(budget_order, (void*)(intptr_t)3, PRIORITY_NORMAL, 0, &attr, NULL);
+    attr.deadline_us = 100000;
+    dtesn_sched_submit_attr(budget_order, (void*)(intptr_t)1, PRIORITY_NORMAL, 0, &attr, NULL);
+    rc = dtesn_sched_submit(budget_order, (void*)(intptr_t)5, PRIORITY_NORMAL, 0, NULL);
+    assert(rc == SCHED_OK);
+    attr.deadline_us = 200000;
+    dtesn_sched_submit_attr(budget_order, (void*)(intptr_t)2, PRIORITY_NORMAL, 0, &attr, NULL);
+    
+    int executed = dtesn_sched_tick();
+    assert(executed == 5);
+    for (int i = 0; i < 5; i++) {
+        assert(budget_log[i] == i + 1);
+    }
+    
+    /* A spent budget defers LOW work but never CRITICAL */
+    sched_budget_stats_t before, after;
+    rc = dtesn_sched_set_budget(1000);
+    assert(rc == 0);
+    rc = dtesn_sched_budget_stats(&before);
+    assert(rc == 0);
+    assert(before.budget_us == 1000);
+    
+    int count = 0;
+    task_handle_t handle = dtesn_sched_task(budget_work, (void*)(intptr_t)2000,
+                                            PRIORITY_CRITICAL, 0);
+    assert(handle != 0);
+    for (int i = 0; i < 10; i++) {
+        handle = dtesn_sched_task(test_task, &count, PRIORITY_LOW, 0);
+        assert(handle != 0);
+    }
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    assert(count == 0);
+    size_t pending = dtesn_sched_pending();
+    assert(pending == 10);
+    executed = dtesn_sched_tick();
+    assert(executed == 10);
+    assert(count == 10);
+    
+    rc = dtesn_sched_budget_stats(&after);
+    assert(rc == 0);
+    assert(after.deferred - before.deferred == 10);
+    assert(after.overruns == before.overruns + 1);
+    assert(after.tick_us_max == 2000);
+    
+    /* Cost estimates defer a task that would not fit */
+    attr.deadline_us = 0;
+    attr.cost_us = 600;
+    for (int i = 0; i < 3; i++) {
+        dtesn_sched_submit_attr(budget_work, (void*)(intptr_t)600, PRIORITY_NORMAL, 0,
+                                &attr, NULL);
+    }
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    
+    /*
+     * The filler behind the spender in its wave finds the budget spent. The
+     * CRITICAL dependent the spender released still runs this tick; NORMAL waits.
+     */
+    int critical = 0, normal = 0, filler = 0;
+    task_handle_t spender;
+    rc = dtesn_sched_submit(budget_work, (void*)(intptr_t)2000, PRIORITY_NORMAL, 0, &spender);
+    assert(rc == SCHED_OK);
+    rc = dtesn_sched_submit(test_task, &filler, PRIORITY_NORMAL, 0, NULL);
+    assert(rc == SCHED_OK);
+    rc = dtesn_sched_submit_deps(test_task, &critical, PRIORITY_CRITICAL, 0, &spender, 1, NULL);
+    assert(rc == SCHED_OK);
+    rc = dtesn_sched_submit_deps(test_task, &normal, PRIORITY_NORMAL, 0, &spender, 1, NULL);
+    assert(rc == SCHED_OK);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    assert(critical == 1 && normal == 0 && filler == 0);
+    executed = dtesn_sched_tick();
+    assert(executed == 2);
+    assert(normal == 1 && filler == 1);
+    
+    /* Deadline misses are counted when the task finishes late */
+    attr.deadline_us = 1;
+    attr.cost_us = 0;
+    dtesn_sched_submit_attr(budget_work, (void*)(intptr_t)100, PRIORITY_HIGH, 0, &attr, NULL);
+    executed = dtesn_sched_tick();
+    assert(executed == 1);
+    rc = dtesn_sched_budget_stats(&after);
+    assert(rc == 0);
+    assert(after.deadline_misses == before.deadline_misses + 1);
+    
+    /* Unlimited budget runs everything again */
+    rc = dtesn_sched_set_budget(0);
+    assert(rc == 0);
+    for (int i = 0; i < 3; i++) {
+        dtesn_sched_submit_attr(budget_work, (void*)(intptr_t)30, PRIORITY_LOW, 0, &attr, NULL);
+    }
+    executed = dtesn_sched_tick();
+    assert(executed == 3);
+    
+    dtesn_sched_set_clock(NULL);
+    
+    printf("  PASS: Scheduler tick budget\n");
+    return 0;
+}
+
+/* Test timer wheel */
+static atomic_int timer_periodic;
+static atomic_int timer_oneshot;
+static atomic_int timer_cancelled;
+static atomic_uint_fast64_t timer_now_ns;
+
+static void timer_count(void* data) {
+    atomic_fetch_add((atomic_int*)data, 1);
+}
+
+/* Manual clock: time only moves when the test advances it */
+static uint64_t timer_clock(void) {
+    return atomic_load(&timer_now_ns);
+}
+
+/* Advance the manual clock by us microseconds, one 100µs step at a time */
+static void timer_step(uint64_t us) {
+    for (uint64_t t = 0; t < us; t += SCHED_TIMER_RESOLUTION_US) {
+        atomic_fetch_add(&timer_now_ns, SCHED_TIMER_RESOLUTION_US * 1000ull);
+        dtesn_sched_tick();
+    }
+}
+
+static void* timer_runner(void* arg) {
+    (void)arg;
+    dtesn_sched_run();
+    return NULL;
+}
+
+static int test_sched_timer(void) {
+    printf("Testing scheduler timers...\n");
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    
+    atomic_store(&timer_periodic, 0);
+    atomic_store(&timer_oneshot, 0);
+    atomic_store(&timer_cancelled, 0);
+    
+    /* On the system clock, dtesn_sched_run sleeps until a timer is due */
+    timer_handle_t oneshot = dtesn_sched_after(timer_count, &timer_oneshot,
+                                               PRIORITY_NORMAL, 0, 2000);
+    assert(oneshot != 0);
+    
+    pthread_t runner;
+    pthread_create(&runner, NULL, timer_runner, NULL);
+    while (atomic_load(&timer_oneshot) == 0) {
+        sched_yield();
+    }
+    dtesn_sched_stop();
+    pthread_join(runner, NULL);
+    atomic_store(&timer_oneshot, 0);
+    
+    /* From here time only moves in timer_step, carrying on from the system clock */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now_us = (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+    atomic_store(&timer_now_ns, now_us / SCHED_TIMER_RESOLUTION_US * SCHED_TIMER_RESOLUTION_US
+                                * 1000ull + 100000ull);
+    dtesn_sched_set_clock(timer_clock);
+    
+    /* 5ms period; 20ms one-shot lands on a higher wheel level */
+    timer_handle_t periodic = dtesn_sched_every(timer_count, &timer_periodic,
+                                                PRIORITY_LOW, 0, 5000);
+    oneshot = dtesn_sched_after(timer_count, &timer_oneshot, PRIORITY_NORMAL, 0, 20000);
+    timer_handle_t cancelled = dtesn_sched_after(timer_count, &timer_cancelled,
+                                                 PRIORITY_NORMAL, 0, 10000);
+    assert(periodic && oneshot && cancelled);
+    int rc = dtesn_sched_cancel(cancelled);
+    assert(rc == 0);
+    rc = dtesn_sched_cancel(cancelled);
+    assert(rc != 0);
+    
+    /* Not due yet, and not a step early */
+    dtesn_sched_tick();
+    timer_step(19900);
+    assert(atomic_load(&timer_oneshot) == 0);
+    assert(atomic_load(&timer_periodic) == 3);
+    timer_step(100);
+    assert(atomic_load(&timer_oneshot) == 1);
+    assert(atomic_load(&timer_periodic) == 4);
+    
+    /* 100ms in all: the period fired every 5ms */
+    timer_step(80000);
+    assert(atomic_load(&timer_oneshot) == 1);
+    assert(atomic_load(&timer_cancelled) == 0);
+    int fired = atomic_load(&timer_periodic);
+    assert(fired == 20);
+    
+    /* A stalled tick loop catches up with one run, counting the missed periods */
+    atomic_fetch_add(&timer_now_ns, 12000000ull);
+    dtesn_sched_tick();
+    fired = atomic_load(&timer_periodic);
+    assert(fired == 21);
+    
+    rc = dtesn_sched_cancel(periodic);
+    assert(rc == 0);
+    rc = dtesn_sched_cancel(oneshot);
+    assert(rc != 0);  /* Already fired */
+    
+    sched_timer_stats_t stats;
+    rc = dtesn_sched_timer_stats(&stats);
+    assert(rc == 0);
+    assert(stats.armed == 0);
+    assert(stats.fired == (uint64_t)fired + 2);
+    assert(stats.missed_periods == 1);
+    
+    dtesn_sched_set_clock(NULL);
+    
+    printf("  PASS: Scheduler timers\n");
+    return 0;
+}
+
+#define MEM_THREADS 4
+#define MEM_ROUNDS 2000
+
+static void* mem_worker(void* arg) {
+    uint8_t tag = (uint8_t)(uintptr_t)arg;
+    void* held[8] = {0};
+    for (int i = 0; i < MEM_ROUNDS; i++) {
+        int k = i % 8;
+        if (held[k]) {
+            /* Nobody else may have been handed an overlapping block */
+            assert(((uint8_t*)held[k])[0] == tag && ((uint8_t*)held[k])[63] == tag);
+            dtesn_mem_free(held[k]);
+        }
+        held[k] = dtesn_mem_alloc(64 + (size_t)(i % 5) * 64, MEM_REGION_HEAP);
+        assert(held[k] != NULL);
+        memset(held[k], tag, 64);
+    }
+    for (int k = 0; k < 8; k++) {
+        dtesn_mem_free(held[k]);
+    }
+    return NULL;
+}
+
 /* Test memory */
 static int test_memory(void) {
     printf("Testing memory...\n");
@@ -55,10 +646,155 @@ static int test_memory(void) {
     
     dtesn_mem_free(ptr);
     
+    /* Threads share the heap without any locking of their own */
+    pthread_t threads[MEM_THREADS];
+    for (int i = 0; i < MEM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, mem_worker, (void*)(uintptr_t)(i + 1));
+    }
+    for (int i = 0; i < MEM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    mem_stats_t stats;
+    ret = dtesn_mem_stats(&stats);
+    assert(ret == 0);
+    assert(stats.free_block_count == 1 && stats.block_count == 1);
+    
     printf("  PASS: Memory allocation\n");
     return 0;
 }
 
+static void* mem_free_elsewhere(void* ptr) {
+    dtesn_mem_free(ptr);
+    return NULL;
+}
+
+/* Test memory statistics */
+static int test_mem_stats(void) {
+    printf("Testing memory statistics...\n");
+    
+    int ret = dtesn_mem_init(1024 * 1024);
+    assert(ret == 0);
+    
+    dtesn_mem_stats_histogram(true);
+    
+    mem_stats_t before;
+    ret = dtesn_mem_stats(&before);
+    assert(ret == 0);
+    
+    void* a = dtesn_mem_alloc(256, MEM_REGION_TENSOR);
+    void* b = dtesn_mem_alloc(1000, MEM_REGION_DATA);
+    void* c = dtesn_mem_alloc(256, MEM_REGION_TENSOR);
+    assert(a && b && c);
+    
+    mem_stats_t stats;
+    dtesn_mem_stats(&stats);
+    assert(stats.regions[MEM_REGION_TENSOR].live_bytes == 512);
+    assert(stats.regions[MEM_REGION_DATA].live_bytes == 1024);
+    assert(stats.alloc_count == before.alloc_count + 3);
+    assert(stats.size_histogram[8] >= 2);
+    
+    /* Free the middle block: leaves a hole, fragmentation rises */
+    dtesn_mem_free(b);
+    dtesn_mem_stats(&stats);
+    assert(stats.regions[MEM_REGION_DATA].live_bytes == 0);
+    assert(stats.regions[MEM_REGION_DATA].peak_bytes == 1024);
+    assert(stats.free_block_count >= 2);
+    assert(stats.fragmentation > 0.0f);
+    assert(stats.largest_free_block < stats.free_bytes);
+    
+    dtesn_mem_free(a);
+    dtesn_mem_free(c);
+    dtesn_mem_stats(&stats);
+    assert(stats.free_count == before.free_count + 3);
+    assert(stats.free_block_count == 1);
+    assert(stats.fragmentation == 0.0f);
+    
+    /* Freed on another thread: live and peak stay those of one block */
+    for (int i = 0; i < 200; i++) {
+        void* block = dtesn_mem_alloc(64, MEM_REGION_CODE);
+        assert(block != NULL);
+        pthread_t freer;
+        pthread_create(&freer, NULL, mem_free_elsewhere, block);
+        pthread_join(freer, NULL);
+    }
+    dtesn_mem_stats(&stats);
+    assert(stats.regions[MEM_REGION_CODE].live_bytes == 0);
+    assert(stats.regions[MEM_REGION_CODE].peak_bytes == 64);
+    assert(stats.regions[MEM_REGION_CODE].free_count == 200);
+    
+    printf("  PASS: Memory statistics\n");
+    return 0;
+}
+
+/* Test the tensor pool */
+static int test_mem_tensor(void) {
+    printf("Testing tensor pool...\n");
+    
+    int ret = dtesn_mem_init(1024 * 1024);
+    assert(ret == 0);
+    struct ggml_tensor* bad = dtesn_mem_tensor_alloc(GGML_TYPE_F32, 0, 1);
+    assert(bad == NULL);
+    bad = dtesn_mem_tensor_alloc(GGML_TYPE_Q8_0, 33, 1);
+    assert(bad == NULL);  /* Not whole blocks */
+    
+    struct ggml_tensor* a = dtesn_mem_tensor_alloc(GGML_TYPE_F32, 100, 3);
+    assert(a && a->data && ggml_nbytes(a) == 1200);
+    assert(((uintptr_t)a->data & 63) == 0);
+    memset(a->data, 0xab, ggml_nbytes(a));
+    
+    mem_stats_t stats;
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.live_tensors == 1);
+    assert(stats.tensors.live_bytes == 2048);
+    assert(stats.regions[MEM_REGION_TENSOR].live_bytes == 2048);
+    
+    /* A slot of the same class comes back with the new type and shape, and a clean header */
+    a->op = GGML_OP_ADD;
+    a->src[0] = a;
+    a->view_src = a;
+    a->flags = 1;
+    ggml_set_name(a, "previous");
+    void* data = a->data;
+    dtesn_mem_tensor_free(a);
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.free_slots[11] == 1);
+    assert(stats.tensors.free_bytes == 2048);
+    
+    struct ggml_tensor* b = dtesn_mem_tensor_alloc(GGML_TYPE_F16, 512, 2);
+    assert(b && b->data == data);
+    assert(b->type == GGML_TYPE_F16 && b->ne[0] == 512 && b->ne[1] == 2);
+    assert(ggml_nbytes(b) == 2048);
+    assert(b->op == GGML_OP_NONE && b->src[0] == NULL && b->view_src == NULL);
+    assert(b->flags == 0 && b->name[0] == '\0');
+    dtesn_mem_stats(&stats);
+    assert(stats.tensors.reused_count == 1);
+    assert(stats.tensors.free_slots[11] == 0);
+    dtesn_mem_tensor_free(b);
+    
+    /* Churn stays within the slabs reserved by the first round */
+    struct ggml_tensor* t[64];
+    size_t slab_bytes = 0;
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < 64; i++) {
+            t[i] = dtesn_mem_tensor_alloc(GGML_TYPE_F32, 16 << (i % 8), 1 + i % 3);
+            assert(t[i] != NULL);
+        }
+        for (int i = 0; i < 64; i++) {
+            dtesn_mem_tensor_free(t[i]);
+        }
+        dtesn_mem_stats(&stats);
+        if (round == 0) {
+            slab_bytes = stats.tensors.slab_bytes;
+        }
+        assert(stats.tensors.slab_bytes == slab_bytes);
+        assert(stats.tensors.live_tensors == 0);
+    }
+    
+    printf("  PASS: Tensor pool\n");
+    return 0;
+}
+
 /* Test HGFS */
 static int test_hgfs(void) {
     printf("Testing hypergraph FS...\n");
@@ -75,10 +811,958 @@ static int test_hgfs(void) {
     uint64_t edge = hgfs_edge(node1, node2, 1.0f);
     assert(edge != 0);
     
+    /* Handle <-> data lookups */
+    uint64_t h1 = hgfs_handle(node1);
+    uint64_t h2 = hgfs_handle(node2);
+    assert(h1 != 0 && h2 != 0 && h1 != h2);
+    void* payload = hgfs_data(h1);
+    assert(payload == node1);
+    payload = hgfs_data(h2);
+    assert(payload == node2);
+    payload = hgfs_data(0);
+    assert(payload == NULL);
+    payload = hgfs_data(h2 + 1000);
+    assert(payload == NULL);
+    
+    /* Only pointers returned by hgfs_alloc resolve */
+    int local = 0;
+    uint64_t handle = hgfs_handle(&local);
+    assert(handle == 0);
+    handle = hgfs_handle((char*)node1 + 4);
+    assert(handle == 0);
+    handle = hgfs_handle(NULL);
+    assert(handle == 0);
+    uint64_t new_edge = hgfs_edge(node1, &local, 1.0f);
+    assert(new_edge == 0);
+    
+    /* Many nodes: every one resolves, edges chain them */
+    enum { N = 1024 };
+    static void* nodes[N];
+    for (int i = 0; i < N; i++) {
+        nodes[i] = hgfs_alloc(16, (uint32_t)(i % 4));
+        assert(nodes[i] != NULL);
+    }
+    for (int i = 0; i < N; i++) {
+        payload = hgfs_data(hgfs_handle(nodes[i]));
+        assert(payload == nodes[i]);
+        if (i > 0) {
+            uint64_t e = hgfs_edge(nodes[i - 1], nodes[i], 0.5f);
+            assert(e > edge);
+            edge = e;
+        }
+    }
+    
     printf("  PASS: Hypergraph allocation\n");
     return 0;
 }
 
+/* Test HGFS adjacency queries and traversal */
+static bool contains(const uint64_t* handles, size_t n, uint64_t handle) {
+    for (size_t i = 0; i < n; i++) {
+        if (handles[i] == handle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int test_hgfs_adj(void) {
+    printf("Testing hypergraph adjacency...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    /* a -> b, a -> c (twice), b -> d, c -> d, d -> a */
+    uint64_t h[4];
+    void* p[4];
+    for (int i = 0; i < 4; i++) {
+        p[i] = hgfs_alloc(16, 0);
+        h[i] = hgfs_handle(p[i]);
+        assert(h[i] != 0);
+    }
+    uint64_t ab = hgfs_edge(p[0], p[1], 0.5f);
+    assert(ab != 0);
+    uint64_t edge = hgfs_edge(p[0], p[2], 1.0f);
+    assert(edge != 0);
+    edge = hgfs_edge(p[0], p[2], 2.0f);
+    assert(edge != 0);
+    edge = hgfs_edge(p[1], p[3], 1.0f);
+    assert(edge != 0);
+    edge = hgfs_edge(p[2], p[3], 1.0f);
+    assert(edge != 0);
+    edge = hgfs_edge(p[3], p[0], 1.0f);
+    assert(edge != 0);
+    
+    hgfs_edge_info_t edges[8];
+    size_t n_edges = hgfs_out_edges(h[0], edges, 8);
+    assert(n_edges == 3);
+    bool found = false;
+    for (int i = 0; i < 3; i++) {
+        assert(edges[i].src == h[0]);
+        if (edges[i].handle == ab) {
+            assert(edges[i].dst == h[1] && edges[i].weight == 0.5f);
+            found = true;
+        }
+    }
+    assert(found);
+    n_edges = hgfs_in_edges(h[3], edges, 8);
+    assert(n_edges == 2);
+    assert(edges[0].dst == h[3] && edges[1].dst == h[3]);
+    n_edges = hgfs_in_edges(h[0], NULL, 0);
+    assert(n_edges == 1);
+    n_edges = hgfs_out_edges(h[0], edges, 1);
+    assert(n_edges == 3);
+    n_edges = hgfs_out_edges(0, edges, 8);
+    assert(n_edges == 0);
+    
+    /* Neighbors are distinct */
+    uint64_t nb[8];
+    size_t n_neighbors = hgfs_neighbors(h[0], HGFS_DIR_OUT, nb, 8);
+    assert(n_neighbors == 2);
+    assert(contains(nb, 2, h[1]) && contains(nb, 2, h[2]));
+    n_neighbors = hgfs_neighbors(h[0], HGFS_DIR_IN, nb, 8);
+    assert(n_neighbors == 1 && nb[0] == h[3]);
+    n_neighbors = hgfs_neighbors(h[0], HGFS_DIR_BOTH, nb, 8);
+    assert(n_neighbors == 3);
+    n_neighbors = hgfs_neighbors(h[3], HGFS_DIR_BOTH, NULL, 0);
+    assert(n_neighbors == 3);
+    
+    /* BFS: levels in order */
+    uint64_t node;
+    uint32_t depth;
+    uint32_t last_depth = 0;
+    uint64_t seen[8];
+    size_t n_seen = 0;
+    hgfs_iter_t* it = hgfs_iter_begin(h[0], HGFS_WALK_BFS, HGFS_DIR_OUT, UINT32_MAX);
+    assert(it != NULL);
+    while (hgfs_iter_next(it, &node, &depth)) {
+        assert(depth >= last_depth);
+        last_depth = depth;
+        assert(!contains(seen, n_seen, node));
+        seen[n_seen++] = node;
+        assert(depth == (node == h[0] ? 0u : node == h[3] ? 2u : 1u));
+    }
+    hgfs_iter_end(it);
+    assert(n_seen == 4 && seen[0] == h[0]);
+    
+    /* k-hop: one hop out of a */
+    n_seen = 0;
+    it = hgfs_iter_begin(h[0], HGFS_WALK_BFS, HGFS_DIR_OUT, 1);
+    while (hgfs_iter_next(it, &node, NULL)) {
+        seen[n_seen++] = node;
+    }
+    hgfs_iter_end(it);
+    assert(n_seen == 3 && !contains(seen, n_seen, h[3]));
+    
+    /* DFS: preorder, each child one level below some earlier node */
+    uint32_t depths[8];
+    n_seen = 0;
+    it = hgfs_iter_begin(h[3], HGFS_WALK_DFS, HGFS_DIR_OUT, UINT32_MAX);
+    while (hgfs_iter_next(it, &node, &depth)) {
+        assert(!contains(seen, n_seen, node));
+        assert(n_seen == 0 ? depth == 0 : depth >= 1 && depth <= depths[n_seen - 1] + 1);
+        depths[n_seen] = depth;
+        seen[n_seen++] = node;
+    }
+    hgfs_iter_end(it);
+    assert(n_seen == 4 && seen[0] == h[3] && seen[1] == h[0] && depths[3] == 2);
+    
+    hgfs_iter_t* iter = hgfs_iter_begin(0, HGFS_WALK_BFS, HGFS_DIR_OUT, 1);
+    assert(iter == NULL);
+    iter = hgfs_iter_begin(h[0], HGFS_WALK_BFS, (hgfs_dir_t)0, 1);
+    assert(iter == NULL);
+    
+    /* Enough inserts to fold the delta log into the CSR */
+    enum { CHAIN = 600 };
+    static void* chain[CHAIN];
+    chain[0] = p[3];
+    for (int i = 1; i < CHAIN; i++) {
+        chain[i] = hgfs_alloc(16, 1);
+        assert(chain[i] != NULL);
+        edge = hgfs_edge(chain[i - 1], chain[i], 1.0f);
+        assert(edge != 0);
+    }
+    n_edges = hgfs_out_edges(h[3], NULL, 0);
+    assert(n_edges == 2);
+    n_edges = hgfs_in_edges(h[3], NULL, 0);
+    assert(n_edges == 2);
+    edge = hgfs_edge(p[0], chain[CHAIN - 1], 1.0f);
+    assert(edge != 0);
+    n_edges = hgfs_out_edges(h[0], edges, 8);
+    assert(n_edges == 4);
+    
+    /* The whole chain is reachable; 3 hops from d stay on the chain */
+    size_t count = 0;
+    it = hgfs_iter_begin(h[0], HGFS_WALK_DFS, HGFS_DIR_OUT, UINT32_MAX);
+    while (hgfs_iter_next(it, NULL, NULL)) {
+        count++;
+    }
+    hgfs_iter_end(it);
+    assert(count == 4 + CHAIN - 1);
+    
+    count = 0;
+    it = hgfs_iter_begin(h[3], HGFS_WALK_BFS, HGFS_DIR_OUT, 3);
+    while (hgfs_iter_next(it, &node, &depth)) {
+        count++;
+    }
+    hgfs_iter_end(it);
+    assert(count == 8);  /* d; a, chain[1]; b, c, chain[last], chain[2]; chain[3] */
+    
+    printf("  PASS: Hypergraph adjacency\n");
+    return 0;
+}
+
+/* Test HGFS growth, deletion and compaction */
+static int test_hgfs_slab(void) {
+    printf("Testing hypergraph storage...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    /* Grow well past one chunk of nodes and edges */
+    enum { N = 10000 };
+    static void* p[N];
+    static uint64_t h[N];
+    for (int i = 0; i < N; i++) {
+        p[i] = hgfs_alloc(16, (uint32_t)(i % 4));
+        assert(p[i] != NULL);
+        h[i] = hgfs_handle(p[i]);
+    }
+    for (int i = 0; i < N; i++) {
+        uint64_t edge = hgfs_edge(p[i], p[(i + 1) % N], 1.0f);
+        assert(edge != 0);
+        edge = hgfs_edge(p[i], p[(i * 7) % N], 0.5f);
+        assert(edge != 0);
+    }
+    
+    hgfs_stats_t stats;
+    int ret = hgfs_stats(&stats);
+    assert(ret == 0);
+    assert(stats.nodes == N && stats.edges == 2 * N);
+    assert(stats.node_chunks >= 3 && stats.edge_chunks >= 5);
+    
+    /* Edge delete: handle goes stale, adjacency forgets it */
+    hgfs_edge_info_t out[4];
+    size_t n_edges = hgfs_out_edges(h[1], out, 4);
+    assert(n_edges == 2);
+    uint64_t e = out[0].dst == h[2] ? out[1].handle : out[0].handle;  /* 1 -> 7 */
+    ret = hgfs_edge_remove(e);
+    assert(ret == 0);
+    ret = hgfs_edge_remove(e);
+    assert(ret != 0);
+    n_edges = hgfs_out_edges(h[1], out, 4);
+    assert(n_edges == 1 && out[0].handle != e);
+    
+    /* Node delete: incident edges go with it */
+    size_t in2 = hgfs_in_edges(h[2], NULL, 0);     /* Includes 1 -> 2 */
+    ret = hgfs_free(p[1]);
+    assert(ret == 0);
+    ret = hgfs_free(p[1]);
+    assert(ret != 0);
+    void* payload = hgfs_data(h[1]);
+    assert(payload == NULL);
+    uint64_t node_handle = hgfs_handle(p[1]);
+    assert(node_handle == 0);
+    n_edges = hgfs_out_edges(h[0], NULL, 0);
+    assert(n_edges == 1);     /* 0 -> 1 gone, 0 -> 0 left */
+    n_edges = hgfs_in_edges(h[2], NULL, 0);
+    assert(n_edges == in2 - 1);
+    ret = hgfs_stats(&stats);
+    assert(ret == 0);
+    assert(stats.nodes == N - 1 && stats.edges == 2 * N - 4);
+    
+    /* Slot reuse: same slot and id, new generation */
+    size_t slots = stats.node_slots;
+    void* q = hgfs_alloc(16, 0);
+    uint64_t hq = hgfs_handle(q);
+    assert(q != NULL && hq != h[1] && (uint32_t)hq == (uint32_t)h[1]);
+    payload = hgfs_data(h[1]);
+    void* ptr = hgfs_data(hq);
+    assert(payload == NULL && ptr == q);
+    ret = hgfs_stats(&stats);
+    assert(ret == 0 && stats.node_slots == slots);
+    ret = hgfs_free(q);
+    assert(ret == 0);
+    
+    /* Delete most of the graph, then compact */
+    for (int i = 2; i < N; i++) {
+        if (i % 4 != 0) {
+            ret = hgfs_free(p[i]);
+            assert(ret == 0);
+            h[i] = 0;
+        }
+    }
+    h[1] = 0;
+    
+    size_t degree[N];
+    for (int i = 0; i < N; i++) {
+        degree[i] = h[i] ? hgfs_out_edges(h[i], NULL, 0) + hgfs_in_edges(h[i], NULL, 0) : 0;
+    }
+    
+    hgfs_iter_t* it = hgfs_iter_begin(h[0], HGFS_WALK_BFS, HGFS_DIR_BOTH, 1);
+    ret = hgfs_compact();
+    assert(ret != 0);
+    ret = hgfs_free(p[0]);
+    assert(ret != 0);
+    hgfs_iter_end(it);
+    
+    ret = hgfs_compact();
+    assert(ret == 0);
+    ret = hgfs_stats(&stats);
+    assert(ret == 0);
+    assert(stats.nodes == N / 4 && stats.node_slots == stats.nodes);
+    assert(stats.edge_slots == stats.edges && stats.delta_edges == 0);
+    assert(stats.node_chunks == 1);
+    
+    /* Handles, data and adjacency survive relocation */
+    for (int i = 0; i < N; i += 4) {
+        payload = hgfs_data(h[i]);
+        assert(payload == p[i]);
+        node_handle = hgfs_handle(p[i]);
+        assert(node_handle == h[i]);
+        n_edges = hgfs_out_edges(h[i], NULL, 0);
+        size_t n_in = hgfs_in_edges(h[i], NULL, 0);
+        assert(n_edges + n_in == degree[i]);
+    }
+    n_edges = hgfs_out_edges(h[0], out, 4);
+    assert(n_edges == 1 && out[0].dst == h[0]);
+    
+    /* Storage keeps working after compaction */
+    void* r = hgfs_alloc(16, 0);
+    uint64_t edge = hgfs_edge(r, p[4], 1.0f);
+    assert(r != NULL && edge != 0);
+    n_edges = hgfs_in_edges(h[4], NULL, 0);
+    size_t n_out = hgfs_out_edges(h[4], NULL, 0);
+    assert(n_edges == degree[4] - n_out + 1);
+    
+    printf("  PASS: Hypergraph storage\n");
+    return 0;
+}
+
+/* Test hypergraph save and open */
+static void hgfs_reopen(const char* path) {
+    int ret = hgfs_close();
+    assert(ret == 0);
+    ret = hgfs_init(kern_get_ggml_context());
+    assert(ret == 0);
+    if (path) {
+        ret = hgfs_open(path);
+        assert(ret == 0);
+    }
+}
+
+static int test_hgfs_file(void) {
+    printf("Testing hypergraph file...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hgfs_%d.hgfs", (int)getpid());
+    
+    /* Payloads of 1-7 floats with recognizable contents */
+    enum { N = 6000 };
+    static float* p[N];
+    static uint64_t h[N];
+    for (int i = 0; i < N; i++) {
+        p[i] = (float*)hgfs_alloc((size_t)(i % 7 + 1) * sizeof(float), (uint32_t)(i % 4));
+        assert(p[i] != NULL);
+        h[i] = hgfs_handle(p[i]);
+        for (int k = 0; k <= i % 7; k++) {
+            p[i][k] = (float)(i * 10 + k);
+        }
+    }
+    for (int i = 0; i < N; i++) {
+        uint64_t edge = hgfs_edge(p[i], p[(i + 1) % N], (float)i);
+        assert(edge != 0);
+    }
+    
+    /* Holes and bumped generations are saved too */
+    uint64_t stale = h[3];
+    int ret = hgfs_free(p[3]);
+    assert(ret == 0);
+    h[3] = 0;
+    uint64_t e = hgfs_edge(p[0], p[2], 2.0f);
+    ret = hgfs_edge_remove(e);
+    assert(ret == 0);
+    
+    hgfs_stats_t before;
+    ret = hgfs_stats(&before);
+    assert(ret == 0);
+    ret = hgfs_save(path);
+    assert(ret == 0);
+    
+    /* Only an empty graph opens a file */
+    ret = hgfs_open(path);
+    assert(ret != 0);
+    
+    hgfs_reopen(path);
+    hgfs_stats_t stats;
+    ret = hgfs_stats(&stats);
+    assert(ret == 0);
+    assert(stats.nodes == before.nodes && stats.edges == before.edges);
+    assert(stats.node_slots == stats.nodes && stats.delta_edges == 0);
+    assert(stats.mapped_bytes > 0);
+    
+    /* Handles, payloads and adjacency come back */
+    for (int i = 0; i < N; i++) {
+        if (!h[i]) {
+            continue;
+        }
+        float* q = (float*)hgfs_data(h[i]);
+        uint64_t handle = hgfs_handle(q);
+        assert(q != NULL && handle == h[i]);
+        for (int k = 0; k <= i % 7; k++) {
+            assert(q[k] == (float)(i * 10 + k));
+        }
+    }
+    void* data = hgfs_data(stale);
+    assert(data == NULL);
+    
+    hgfs_edge_info_t out[2];
+    size_t n_edges = hgfs_out_edges(h[5], out, 2);
+    assert(n_edges == 1);
+    assert(out[0].dst == h[6] && out[0].weight == 5.0f);
+    n_edges = hgfs_out_edges(h[0], NULL, 0);
+    assert(n_edges == 1);
+    n_edges = hgfs_out_edges(h[2], NULL, 0);
+    assert(n_edges == 0);     /* 2 -> 3 went with node 3 */
+    n_edges = hgfs_in_edges(h[4], NULL, 0);
+    assert(n_edges == 0);
+    
+    /* The mapping is writable but the file only changes on save */
+    float* q0 = (float*)hgfs_data(h[0]);
+    q0[0] = -1.0f;
+    void* r = hgfs_alloc(64, 1);
+    uint64_t hr = hgfs_handle(r);
+    assert(r != NULL && (uint32_t)hr == (uint32_t)stale && hr != stale);
+    uint64_t edge = hgfs_edge(r, q0, 1.0f);
+    assert(edge != 0);
+    
+    hgfs_reopen(path);
+    q0 = (float*)hgfs_data(h[0]);
+    assert(q0[0] == 0.0f);
+    data = hgfs_data(hr);
+    assert(data == NULL);
+    
+    /* Saving over the open file keeps this mapping intact */
+    q0[0] = -2.0f;
+    ret = hgfs_save(path);
+    assert(ret == 0);
+    data = hgfs_data(h[N - 1]);
+    assert(q0[0] == -2.0f && data != NULL);
+    
+    hgfs_reopen(path);
+    data = hgfs_data(h[0]);
+    assert(((float*)data)[0] == -2.0f);
+    
+    /* Invalid files are rejected and leave an empty graph */
+    hgfs_reopen(NULL);
+    FILE* f = fopen(path, "r+b");
+    assert(f != NULL);
+    uint32_t id;
+    ret = fseek(f, 4096, SEEK_SET);
+    size_t n_read = fread(&id, sizeof(id), 1, f);
+    assert(ret == 0 && n_read == 1);
+    ret = fseek(f, 4096 + 24, SEEK_SET);
+    size_t written = fwrite(&id, sizeof(id), 1, f);
+    assert(ret == 0 && written == 1);
+    ret = fclose(f);
+    assert(ret == 0);
+    ret = hgfs_open(path);
+    assert(ret != 0);                   /* Duplicate node id */
+    
+    ret = hgfs_stats(&stats);
+    assert(ret == 0 && stats.nodes == 0 && stats.mapped_bytes == 0);
+    ret = truncate(path, 8192);
+    assert(ret == 0);
+    ret = hgfs_open(path);
+    assert(ret != 0);
+    ret = hgfs_open("/nonexistent/test.hgfs");
+    assert(ret != 0);
+    void* block = hgfs_alloc(16, 0);
+    assert(block != NULL);
+    
+    unlink(path);
+    
+    printf("  PASS: Hypergraph file\n");
+    return 0;
+}
+
+/* Test hypergraph write-ahead log */
+static void hgfs_wal_check(const uint64_t* h, const float* value, int n) {
+    for (int i = 0; i < n; i++) {
+        float* q = (float*)hgfs_data(h[i]);
+        if (value[i] < 0.0f) {
+            assert(q == NULL);
+        } else {
+            uint64_t handle = hgfs_handle(q);
+            assert(q != NULL && handle == h[i] && q[0] == value[i]);
+        }
+    }
+}
+
+static int test_hgfs_wal(void) {
+    printf("Testing hypergraph write-ahead log...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    char path[64], log[80];
+    snprintf(path, sizeof(path), "/tmp/test_hgfs_wal_%d.hgfs", (int)getpid());
+    snprintf(log, sizeof(log), "%s.wal", path);
+    unlink(path);
+    unlink(log);
+    
+    hgfs_wal_config_t config = {.commit_interval_us = 500};
+    int ret = hgfs_sync();
+    assert(ret != 0);
+    ret = hgfs_wal_start(path, &config);
+    assert(ret == 0);
+    ret = hgfs_wal_start(path, &config);
+    assert(ret != 0);
+    
+    /* Nodes with logged contents (value < 0: deleted) */
+    enum { N = 2000 };
+    static uint64_t h[N];
+    static float value[N];
+    static float* p[N];
+    for (int i = 0; i < N; i++) {
+        p[i] = (float*)hgfs_alloc(8, (uint32_t)(i % 4));
+        assert(p[i] != NULL);
+        h[i] = hgfs_handle(p[i]);
+        p[i][0] = value[i] = (float)i;
+        if (i % 2 == 0) {
+            ret = hgfs_log_data(p[i]);
+            assert(ret == 0);
+        } else {
+            value[i] = 0.0f;                        /* Not logged: replays as zero */
+        }
+        if (i > 0) {
+            uint64_t edge = hgfs_edge(p[i - 1], p[i], 1.0f);
+            assert(edge != 0);
+        }
+    }
+    uint64_t e = hgfs_edge(p[0], p[5], 0.5f);
+    ret = hgfs_edge_remove(e);
+    assert(ret == 0);
+    ret = hgfs_free(p[7]);
+    assert(ret == 0);
+    value[7] = -1.0f;
+    
+    /* Group commit: far fewer fdatasyncs than records */
+    ret = hgfs_sync();
+    assert(ret == 0);
+    hgfs_wal_stats_t stats;
+    ret = hgfs_wal_stats(&stats);
+    assert(ret == 0);
+    assert(stats.lsn == (uint64_t)(N + N / 2 + N - 1 + 3));
+    assert(stats.durable_lsn == stats.lsn && stats.checkpoint_lsn == 0);
+    assert(stats.commits >= 1 && stats.commits < stats.lsn / 10);
+    assert(stats.log_bytes > 0 && !stats.checkpoint_due && !stats.failed);
+    
+    /* Recovery without a checkpoint: the log alone rebuilds the graph */
+    hgfs_reopen(NULL);
+    ret = hgfs_wal_start(path, &config);
+    assert(ret == 0);
+    hgfs_wal_check(h, value, N);
+    size_t n_edges = hgfs_out_edges(h[0], NULL, 0);
+    assert(n_edges == 1);
+    n_edges = hgfs_in_edges(h[8], NULL, 0);
+    size_t n_out = hgfs_out_edges(h[6], NULL, 0);
+    assert(n_edges == 0 && n_out == 0);
+    
+    /* New ids continue after the replayed ones; deleted ids are reused */
+    void* r = hgfs_alloc(8, 0);
+    uint64_t hr = hgfs_handle(r);
+    assert((uint32_t)hr == (uint32_t)h[7] && hr != h[7]);
+    ret = hgfs_free(r);
+    assert(ret == 0);
+    
+    /* Checkpoint: the file takes over and the log empties */
+    ret = hgfs_checkpoint();
+    assert(ret == 0);
+    ret = hgfs_wal_stats(&stats);
+    assert(ret == 0);
+    assert(stats.checkpoint_lsn == stats.lsn && stats.checkpoints == 1);
+    assert(stats.log_bytes == 0);
+    ret = access(path, F_OK);
+    assert(ret == 0);
+    
+    /* Changes after the checkpoint, with a torn record at the end */
+    p[1] = (float*)hgfs_data(h[1]);
+    p[1][0] = value[1] = 11.0f;
+    ret = hgfs_log_data(p[1]);
+    assert(ret == 0);
+    ret = hgfs_free(hgfs_data(h[2]));
+    assert(ret == 0);
+    value[2] = -1.0f;
+    ret = hgfs_wal_stop();
+    assert(ret == 0);
+    
+    FILE* f = fopen(log, "ab");
+    assert(f != NULL);
+    static const uint8_t torn[20] = {40, 0, 0, 0, 1, 2, 3, 4};
+    size_t written = fwrite(torn, 1, sizeof(torn), f);
+    assert(written == sizeof(torn));
+    ret = fclose(f);
+    assert(ret == 0);
+    
+    hgfs_reopen(path);
+    ret = hgfs_wal_start(path, &config);
+    assert(ret == 0);
+    hgfs_wal_check(h, value, N);
+    ret = hgfs_wal_stats(&stats);
+    assert(ret == 0 && stats.lsn == stats.checkpoint_lsn + 2);
+    
+    /* A crash between saving and emptying the log replays nothing twice */
+    uint64_t edge = hgfs_edge(hgfs_data(h[3]), hgfs_data(h[9]), 2.0f);
+    assert(edge != 0);
+    ret = hgfs_save(path);
+    assert(ret == 0);
+    ret = hgfs_wal_stop();
+    assert(ret == 0);
+    hgfs_reopen(path);
+    ret = hgfs_wal_start(path, &config);
+    assert(ret == 0);
+    hgfs_wal_check(h, value, N);
+    n_edges = hgfs_out_edges(h[3], NULL, 0);
+    assert(n_edges == 2);
+    
+    /* Due once the log passes its size limit */
+    ret = hgfs_wal_stop();
+    assert(ret == 0);
+    config.checkpoint_bytes = 1;
+    ret = hgfs_wal_start(path, &config);
+    assert(ret == 0);
+    ret = hgfs_log_data(hgfs_data(h[0]));
+    assert(ret == 0);
+    ret = hgfs_sync();
+    assert(ret == 0);
+    ret = hgfs_wal_stats(&stats);
+    assert(ret == 0 && stats.checkpoint_due);
+    ret = hgfs_checkpoint();
+    assert(ret == 0);
+    ret = hgfs_wal_stats(&stats);
+    assert(ret == 0 && !stats.checkpoint_due);
+    
+    ret = hgfs_close();
+    assert(ret == 0);
+    unlink(path);
+    unlink(log);
+    
+    printf("  PASS: Hypergraph write-ahead log\n");
+    return 0;
+}
+
+/* Test depth pools */
+static void hgfs_depth_check(uint32_t depth, size_t count) {
+    hgfs_depth_view_t view;
+    int ret = hgfs_depth_view(depth, &view);
+    assert(ret == 0 && view.count == count);
+    for (size_t i = 0; i < view.count; i++) {
+        void* data = hgfs_data(view.handles[i]);
+        assert(data == view.data[i]);
+        uint64_t handle = hgfs_handle(view.data[i]);
+        assert(handle == view.handles[i]);
+        assert(view.sizes[i] >= 16);
+    }
+}
+
+static int test_hgfs_depth(void) {
+    printf("Testing hypergraph depth pools...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hgfs_depth_%d.hgfs", (int)getpid());
+    
+    /* Interleaved allocation still packs each depth */
+    enum { N = 200 };
+    static void* p[N];
+    for (int i = 0; i < N; i++) {
+        uint32_t depth = i % 4 == 3 ? 5 : (uint32_t)(i % 2 + 1);
+        p[i] = hgfs_alloc(16, depth);
+        assert(p[i] != NULL);
+        *(int*)p[i] = i;
+    }
+    
+    uint32_t depths[8];
+    size_t n_depths = hgfs_depths(depths, 8);
+    assert(n_depths == 3);
+    assert(depths[0] == 1 && depths[1] == 2 && depths[2] == 5);
+    
+    hgfs_depth_view_t view;
+    int ret = hgfs_depth_view(0, &view);
+    assert(ret == 0 && view.count == 0);
+    ret = hgfs_depth_view(1, &view);
+    assert(ret == 0 && view.count == N / 2);
+    for (size_t i = 1; i < view.count; i++) {
+        assert((char*)view.data[i] == (char*)view.data[i - 1] + 16);
+        assert(*(int*)view.data[i] == *(int*)view.data[i - 1] + 2);
+    }
+    hgfs_depth_check(1, N / 2);
+    hgfs_depth_check(2, N / 4);
+    hgfs_depth_check(5, N / 4);
+    
+    hgfs_stats_t stats;
+    ret = hgfs_stats(&stats);
+    assert(ret == 0);
+    assert(stats.depths == 3 && stats.pool_bytes >= N * 16);
+    
+    /* Deleted payloads are reused by the same depth */
+    ret = hgfs_free(p[2]);
+    assert(ret == 0);
+    hgfs_depth_check(1, N / 2 - 1);
+    void* q = hgfs_alloc(12, 1);
+    assert(q == p[2]);
+    ret = hgfs_free(p[4]);
+    assert(ret == 0);
+    void* node = hgfs_alloc(16, 2);
+    assert(node != p[4]);
+    hgfs_depth_check(1, N / 2 - 1);
+    hgfs_depth_check(2, N / 4 + 1);
+    
+    /* Compaction puts members in address order */
+    for (int i = 6; i < N; i += 8) {
+        ret = hgfs_free(p[i]);
+        assert(ret == 0);
+    }
+    node = hgfs_alloc(16, 1);
+    assert(node != NULL);
+    ret = hgfs_compact();
+    assert(ret == 0);
+    ret = hgfs_depth_view(1, &view);
+    assert(ret == 0);
+    for (size_t i = 1; i < view.count; i++) {
+        assert(view.data[i] > view.data[i - 1]);
+    }
+    hgfs_depth_check(1, view.count);
+    
+    /* The file groups payloads by depth */
+    ret = hgfs_save(path);
+    assert(ret == 0);
+    hgfs_reopen(path);
+    n_depths = hgfs_depths(NULL, 0);
+    assert(n_depths == 3);
+    hgfs_depth_view_t shallow, deep;
+    ret = hgfs_depth_view(1, &shallow);
+    int rc = hgfs_depth_view(2, &deep);
+    assert(ret == 0 && rc == 0);
+    assert(shallow.count == view.count && deep.count == N / 4 + 1);
+    for (size_t i = 1; i < shallow.count; i++) {
+        assert(shallow.data[i] > shallow.data[i - 1]);
+    }
+    assert(shallow.data[shallow.count - 1] < deep.data[0]);
+    hgfs_depth_check(1, shallow.count);
+    
+    /* Mapped payloads are recycled like pooled ones */
+    void* mapped = shallow.data[0];
+    ret = hgfs_free(mapped);
+    assert(ret == 0);
+    node = hgfs_alloc(16, 1);
+    assert(node == mapped);
+    
+    ret = hgfs_close();
+    assert(ret == 0);
+    unlink(path);
+    
+    printf("  PASS: Hypergraph depth pools\n");
+    return 0;
+}
+
+/* Test adjacency matrix export */
+static void hgfs_matrix_check(hgfs_matrix_t* m, hgfs_dir_t dir, hgfs_matrix_info_t* info) {
+    int ret = hgfs_matrix_sync(m, info);
+    assert(ret == 0);
+    assert((uint32_t)((const int32_t*)info->row_ptr->data)[info->rows] == info->nnz);
+    
+    const int32_t* row_ptr = (const int32_t*)info->row_ptr->data;
+    const int32_t* cols = (const int32_t*)info->cols->data;
+    const float* values = (const float*)info->values->data;
+    static float expect[1024];
+    static hgfs_edge_info_t edges[256];
+    assert(info->rows <= 1024);
+    
+    for (uint32_t r = 0; r < info->rows; r++) {
+        memset(expect, 0, info->rows * sizeof(float));
+        uint64_t node = hgfs_matrix_node(m, r);
+        if (node) {
+            uint32_t row = hgfs_matrix_row(m, node);
+            assert(row == r);
+            size_t n = hgfs_out_edges(node, edges, 256);
+            for (size_t i = 0; i < n && (dir & HGFS_DIR_OUT); i++) {
+                uint32_t c = hgfs_matrix_row(m, edges[i].dst);
+                if (c != UINT32_MAX) {
+                    expect[c] += edges[i].weight;
+                }
+            }
+            n = hgfs_in_edges(node, edges, 256);
+            for (size_t i = 0; i < n && (dir & HGFS_DIR_IN); i++) {
+                uint32_t c = hgfs_matrix_row(m, edges[i].src);
+                if (c != UINT32_MAX && !(edges[i].src == node && (dir & HGFS_DIR_OUT))) {
+                    expect[c] += edges[i].weight;
+                }
+            }
+        }
+        
+        /* Stored entries ascend and match; the rest are zero */
+        for (int32_t p = row_ptr[r]; p < row_ptr[r + 1]; p++) {
+            assert(p == row_ptr[r] || cols[p] > cols[p - 1]);
+            assert(fabsf(values[p] - expect[cols[p]]) < 1e-4f);
+            expect[cols[p]] = 0.0f;
+        }
+        for (uint32_t c = 0; c < info->rows; c++) {
+            assert(fabsf(expect[c]) < 1e-4f);
+        }
+        
+        if (info->dense) {
+            const float* dense = (const float*)info->dense->data;
+            int64_t pad = info->dense->ne[0];
+            assert(pad % HGFS_MATRIX_BLOCK == 0 && pad >= info->rows);
+            float sum = 0.0f;
+            for (int32_t p = row_ptr[r]; p < row_ptr[r + 1]; p++) {
+                assert(fabsf(dense[r * pad + cols[p]] - values[p]) < 1e-4f);
+                sum += values[p];
+            }
+            float dense_sum = 0.0f;
+            for (int64_t c = 0; c < pad; c++) {
+                dense_sum += dense[r * pad + c];
+            }
+            assert(fabsf(dense_sum - sum) < 1e-3f);
+        }
+    }
+}
+
+static int test_hgfs_matrix(void) {
+    printf("Testing hypergraph matrix export...\n");
+    
+    kern_bootstrap_init(STAGE1_HYPERGRAPH);
+    
+    /* Depths 0-2; depth 0 stays out of the exports */
+    enum { N = 600 };
+    static void* p[N];
+    static uint64_t h[N];
+    for (int i = 0; i < N; i++) {
+        p[i] = hgfs_alloc(4, (uint32_t)(i % 3));
+        assert(p[i] != NULL);
+        h[i] = hgfs_handle(p[i]);
+    }
+    uint32_t seed = 7;
+    for (int i = 0; i < 3 * N; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int a = (int)((seed >> 8) % N);
+        int b = (int)((seed >> 20) % N);
+        uint64_t edge = hgfs_edge(p[a], p[b], (float)(i % 5) - 1.5f);
+        assert(edge != 0);
+    }
+    uint64_t edge = hgfs_edge(p[1], p[1], 2.0f);
+    assert(edge != 0);          /* Self loop */
+    edge = hgfs_edge(p[1], p[2], 1.0f);
+    assert(edge != 0);          /* Parallel edges sum */
+    edge = hgfs_edge(p[1], p[2], 0.25f);
+    assert(edge != 0);
+    
+    hgfs_matrix_t* m = hgfs_matrix_create(2, 1, HGFS_DIR_OUT, 0);
+    assert(m == NULL);
+    m = hgfs_matrix_create(0, 1, (hgfs_dir_t)0, 0);
+    assert(m == NULL);
+    hgfs_matrix_t* out = hgfs_matrix_create(1, 2, HGFS_DIR_OUT, HGFS_MATRIX_DENSE);
+    hgfs_matrix_t* both = hgfs_matrix_create(1, 2, HGFS_DIR_BOTH, 0);
+    assert(out != NULL && both != NULL);
+    
+    hgfs_matrix_info_t info, info_both;
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    hgfs_matrix_check(both, HGFS_DIR_BOTH, &info_both);
+    assert(info.rows == 2 * N / 3 && info.dense != NULL && info_both.dense == NULL);
+    uint32_t row = hgfs_matrix_row(out, h[0]);
+    assert(row == UINT32_MAX);
+    uint64_t node = hgfs_matrix_node(out, info.rows);
+    assert(node == 0);
+    uint32_t r1 = hgfs_matrix_row(out, h[1]);
+    uint32_t r2 = hgfs_matrix_row(out, h[2]);
+    node = hgfs_matrix_node(out, r1);
+    assert(node == h[1]);
+    
+    /* Existing entry: patched in place, no merge needed */
+    uint64_t version = info.version;
+    struct ggml_tensor* values = info.values;
+    uint32_t nnz = info.nnz;
+    const int32_t* cols = (const int32_t*)info.cols->data;
+    int32_t p12 = ((const int32_t*)info.row_ptr->data)[r1];
+    while ((uint32_t)cols[p12] != r2) {
+        p12++;
+    }
+    float w12 = ((const float*)values->data)[p12];
+    uint64_t e = hgfs_edge(p[1], p[2], 4.0f);
+    assert(((const float*)values->data)[p12] == w12 + 4.0f);
+    assert(((const float*)info.dense->data)[r1 * info.dense->ne[0] + r2] == w12 + 4.0f);
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    assert(info.nnz == nnz && info.values == values && info.version == version);
+    
+    /* New entries, rows and removals are merged without renumbering */
+    void* q[40];
+    for (int i = 0; i < 40; i++) {
+        q[i] = hgfs_alloc(4, (uint32_t)(i % 3));
+        edge = hgfs_edge(q[i], p[(i * 13) % N], 0.5f);
+        assert(edge != 0);
+        edge = hgfs_edge(p[(i * 17) % N], q[i], -0.75f);
+        assert(edge != 0);
+    }
+    int ret = hgfs_edge_remove(e);
+    assert(ret == 0);
+    ret = hgfs_free(p[4]);
+    assert(ret == 0);
+    ret = hgfs_free(q[1]);
+    assert(ret == 0);
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    hgfs_matrix_check(both, HGFS_DIR_BOTH, &info_both);
+    assert(info.version == version && info.nnz > nnz);
+    assert(info.rows == 2 * N / 3 + 2 * 40 / 3);
+    node = hgfs_matrix_node(out, hgfs_matrix_row(out, hgfs_handle(q[2])));
+    uint64_t handle = hgfs_handle(q[2]);
+    assert(node == handle);
+    row = hgfs_matrix_row(out, h[4]);
+    assert(row == UINT32_MAX);
+    
+    /* Compaction keeps rows; mass deletion renumbers them */
+    ret = hgfs_compact();
+    assert(ret == 0);
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    assert(info.version == version);
+    for (int i = 5; i < N; i++) {
+        if (i % 2 == 1) {
+            ret = hgfs_free(p[i]);
+            assert(ret == 0);
+        }
+    }
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    hgfs_matrix_check(both, HGFS_DIR_BOTH, &info_both);
+    assert(info.version != version);
+    for (uint32_t r = 0; r < info.rows; r++) {
+        node = hgfs_matrix_node(out, r);
+        assert(node != 0);
+    }
+    
+    /* The dense tensor grows in blocks as rows are added */
+    int64_t pad = info.dense->ne[0];
+    for (int i = 0; i < (int)pad; i++) {
+        void* n = hgfs_alloc(4, 1);
+        edge = hgfs_edge(n, p[2], 1.0f);
+        assert(n != NULL && edge != 0);
+    }
+    hgfs_matrix_check(out, HGFS_DIR_OUT, &info);
+    assert(info.dense->ne[0] > pad);
+    
+    /* Exports stop following a closed graph */
+    hgfs_matrix_destroy(both);
+    hgfs_reopen(NULL);
+    ret = hgfs_matrix_sync(out, &info);
+    assert(ret != 0);
+    row = hgfs_matrix_row(out, h[2]);
+    assert(row == UINT32_MAX);
+    hgfs_matrix_destroy(out);
+    
+    printf("  PASS: Hypergraph matrix export\n");
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         fprintf(stderr, "Usage: %s <test>\n", argv[0]);
@@ -91,10 +1775,38 @@ int main(int argc, char** argv) {
         ret = test_bootstrap();
     } else if (strcmp(argv[1], "scheduler") == 0) {
         ret = test_scheduler();
+    } else if (strcmp(argv[1], "sched_queue") == 0) {
+        ret = test_sched_queue();
+    } else if (strcmp(argv[1], "sched_exec") == 0) {
+        ret = test_sched_exec();
+    } else if (strcmp(argv[1], "sched_submit") == 0) {
+        ret = test_sched_submit();
+    } else if (strcmp(argv[1], "sched_dag") == 0) {
+        ret = test_sched_dag();
+    } else if (strcmp(argv[1], "sched_budget") == 0) {
+        ret = test_sched_budget();
+    } else if (strcmp(argv[1], "sched_timer") == 0) {
+        ret = test_sched_timer();
     } else if (strcmp(argv[1], "memory") == 0) {
         ret = test_memory();
+    } else if (strcmp(argv[1], "mem_stats") == 0) {
+        ret = test_mem_stats();
+    } else if (strcmp(argv[1], "mem_tensor") == 0) {
+        ret = test_mem_tensor();
     } else if (strcmp(argv[1], "hgfs") == 0) {
         ret = test_hgfs();
+    } else if (strcmp(argv[1], "hgfs_adj") == 0) {
+        ret = test_hgfs_adj();
+    } else if (strcmp(argv[1], "hgfs_slab") == 0) {
+        ret = test_hgfs_slab();
+    } else if (strcmp(argv[1], "hgfs_file") == 0) {
+        ret = test_hgfs_file();
+    } else if (strcmp(argv[1], "hgfs_wal") == 0) {
+        ret = test_hgfs_wal();
+    } else if (strcmp(argv[1], "hgfs_depth") == 0) {
+        ret = test_hgfs_depth();
+    } else if (strcmp(argv[1], "hgfs_matrix") == 0) {
+        ret = test_hgfs_matrix();
     } else {
         fprintf(stderr, "Unknown test: %s\n", argv[1]);
         return 1;
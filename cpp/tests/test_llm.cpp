@@ -0,0 +1,458 @@
+/**
+ * @file test_llm.cpp
+ * @brief LLM request server tests
+ * 
+ * The server runs against a scripted llama backend defined below, so no
+ * model is needed. Every prompt character is one token, and the logits
+ * always pick the letter after the last token, so a request with
+ * max_tokens = n answers with the first n letters of the alphabet. The
+ * backend checks that each sequence's positions continue its KV cache.
+ */
+
+#include "aichat/llm.h"
+#include "aichat/kernel.h"
+#include "llama.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define FAKE_VOCAB 128
+
+/* Scripted llama backend */
+struct llama_model {
+    int unused;
+};
+
+struct llama_context {
+    std::vector<float> logits;          /* FAKE_VOCAB per batch token */
+    std::vector<llama_pos> kv;          /* Tokens cached per sequence */
+};
+
+static struct {
+    llama_model model;
+    llama_context ctx;
+    uint32_t n_seq;                     /* Sequences the context holds */
+    int32_t fail_decode;                /* Returned by the next llama_decode, 0 = decode */
+    std::vector<std::vector<llama_seq_id>> batches;  /* Sequence of each token, per decode */
+} fake;
+
+/* The letter after a token */
+static llama_token fake_next(llama_token token) {
+    return token >= 'a' && token < 'z' ? token + 1 : 'a';
+}
+
+extern "C" {
+
+void llama_backend_init(void) {}
+void llama_backend_free(void) {}
+
+llama_model_params llama_model_default_params(void) {
+    return {};
+}
+
+llama_context_params llama_context_default_params(void) {
+    return {};
+}
+
+llama_model* llama_load_model_from_file(const char*, llama_model_params) {
+    return &fake.model;
+}
+
+llama_context* llama_new_context_with_model(llama_model*, llama_context_params) {
+    fake.ctx.kv.assign(fake.n_seq, 0);
+    return &fake.ctx;
+}
+
+void llama_free_model(llama_model*) {}
+void llama_free(llama_context*) {}
+
+int32_t llama_tokenize(const llama_model*, const char* text, int32_t text_len,
+                       llama_token* tokens, int32_t n_tokens_max, bool, bool) {
+    if (text_len > n_tokens_max) {
+        return -text_len;
+    }
+    for (int32_t i = 0; i < text_len; i++) {
+        tokens[i] = (unsigned char)text[i] % FAKE_VOCAB;
+    }
+    return text_len;
+}
+
+int32_t llama_token_to_piece(const llama_model*, llama_token token, char* buf, int32_t length,
+                             int32_t, bool) {
+    if (length < 1) {
+        return -1;
+    }
+    buf[0] = (char)token;
+    return 1;
+}
+
+bool llama_token_is_eog(const llama_model*, llama_token) {
+    return false;
+}
+
+int32_t llama_decode(llama_context* ctx, llama_batch batch) {
+    if (fake.fail_decode != 0) {
+        int32_t ret = fake.fail_decode;
+        fake.fail_decode = 0;
+        return ret;
+    }
+    
+    std::vector<llama_seq_id> seqs;
+    ctx->logits.assign((size_t)batch.n_tokens * FAKE_VOCAB, 0.0f);
+    for (int32_t i = 0; i < batch.n_tokens; i++) {
+        llama_seq_id seq = batch.seq_id[i][0];
+        assert(batch.n_seq_id[i] == 1 && seq >= 0 && (uint32_t)seq < fake.n_seq);
+        assert(batch.pos[i] == ctx->kv[seq]);
+        ctx->kv[seq]++;
+        ctx->logits[(size_t)i * FAKE_VOCAB + fake_next(batch.token[i])] = 1.0f;
+        seqs.push_back(seq);
+    }
+    fake.batches.push_back(seqs);
+    return 0;
+}
+
+llama_batch llama_batch_get_one(llama_token* tokens, int32_t n_tokens, llama_pos, llama_seq_id) {
+    llama_batch batch = {};
+    batch.token = tokens;
+    batch.n_tokens = n_tokens;
+    return batch;
+}
+
+llama_batch llama_batch_init(int32_t n_tokens, int32_t, int32_t n_seq_max) {
+    llama_batch batch = {};
+    batch.token = new llama_token[n_tokens];
+    batch.pos = new llama_pos[n_tokens];
+    batch.n_seq_id = new int32_t[n_tokens];
+    batch.seq_id = new llama_seq_id*[n_tokens];
+    batch.seq_id[0] = new llama_seq_id[(size_t)n_tokens * n_seq_max];
+    for (int32_t i = 1; i < n_tokens; i++) {
+        batch.seq_id[i] = batch.seq_id[0] + (size_t)i * n_seq_max;
+    }
+    batch.logits = new int8_t[n_tokens];
+    return batch;
+}
+
+void llama_batch_free(llama_batch batch) {
+    delete[] batch.token;
+    delete[] batch.pos;
+    delete[] batch.n_seq_id;
+    delete[] batch.seq_id[0];
+    delete[] batch.seq_id;
+    delete[] batch.logits;
+}
+
+bool llama_kv_cache_seq_rm(llama_context* ctx, llama_seq_id seq, llama_pos p0, llama_pos) {
+    ctx->kv[seq] = p0 < 0 ? 0 : std::min(ctx->kv[seq], p0);
+    return true;
+}
+
+float* llama_get_logits_ith(llama_context* ctx, int32_t i) {
+    return &ctx->logits[(size_t)i * FAKE_VOCAB];
+}
+
+int32_t llama_n_vocab(const llama_model*) {
+    return FAKE_VOCAB;
+}
+
+uint32_t llama_n_ctx(const llama_context*) {
+    return 4096;
+}
+
+uint32_t llama_n_batch(const llama_context*) {
+    return 512;
+}
+
+uint32_t llama_n_seq_max(const llama_context*) {
+    return fake.n_seq;
+}
+
+/* Direct decoding (llm_chat_completion) is not exercised here */
+llama_sampling_params llama_sampling_default_params(void) {
+    return {};
+}
+
+llama_sampling_context* llama_sampling_init(llama_sampling_params) {
+    return nullptr;
+}
+
+llama_token llama_sampling_sample(llama_sampling_context*, llama_context*, llama_context*) {
+    return 'a';
+}
+
+void llama_sampling_accept(llama_sampling_context*, llama_context*, llama_token, bool) {}
+void llama_sampling_free(llama_sampling_context*) {}
+
+}
+
+/* Load the fake model on a fresh scheduler */
+static llm_model_t serve_open(uint32_t n_seq) {
+    fake.n_seq = n_seq;
+    fake.fail_decode = 0;
+    fake.batches.clear();
+    
+    int ret = dtesn_sched_init();
+    assert(ret == 0);
+    llm_model_t model = llm_load_model("fake.gguf");
+    assert(model != nullptr);
+    return model;
+}
+
+/* Submit a greedy request */
+static llm_request_t serve_submit(llm_model_t model, task_priority_t priority, int max_tokens,
+                                  stream_callback_t callback = nullptr) {
+    static const chat_message_t message = {ROLE_USER, "hi"};
+    generation_params_t params = {max_tokens, 0.0f, 1.0f, 0.0f, false};
+    llm_request_t req = llm_submit(model, &message, 1, &params, priority, callback, nullptr);
+    assert(req != nullptr);
+    return req;
+}
+
+/* Tick until a request finishes */
+static void serve_finish(llm_request_t req) {
+    for (int i = 0; i < 1000 && llm_request_state(req) < LLM_REQUEST_DONE; i++) {
+        dtesn_sched_tick();
+    }
+    llm_request_state_t state = llm_request_state(req);
+    assert(state == LLM_REQUEST_DONE);
+}
+
+/* Wait for a request and check its answer, then free it */
+static void serve_check(llm_request_t req, const char* expected) {
+    serve_finish(req);
+    char* response = llm_request_wait(req);
+    assert(response != nullptr && strcmp(response, expected) == 0);
+    free(response);
+    llm_request_free(req);
+}
+
+/* Sequences of a decode in batch order, each run of tokens collapsed to one entry */
+static std::vector<llama_seq_id> batch_runs(const std::vector<llama_seq_id>& seqs) {
+    std::vector<llama_seq_id> runs;
+    for (llama_seq_id seq : seqs) {
+        if (runs.empty() || runs.back() != seq) {
+            runs.push_back(seq);
+        }
+    }
+    return runs;
+}
+
+/* Test batch packing order */
+static int test_serve_pack(void) {
+    printf("Testing LLM request packing...\n");
+    
+    llm_model_t model = serve_open(4);
+    llm_request_t low = serve_submit(model, PRIORITY_LOW, 4);
+    llm_request_t normal = serve_submit(model, PRIORITY_NORMAL, 4);
+    llm_request_t high = serve_submit(model, PRIORITY_HIGH, 4);
+    llm_request_t normal2 = serve_submit(model, PRIORITY_NORMAL, 4);
+    
+    /* Priority then submission order; LOW waits for the interactive request */
+    int executed = dtesn_sched_tick();
+    assert(executed > 0);
+    assert(!fake.batches.empty());
+    std::vector<llama_seq_id> first = batch_runs(fake.batches[0]);
+    assert(first.size() == 3);
+    assert(first[0] == 0 && first[1] == 1 && first[2] == 2);
+    assert(fake.batches[0].size() > 3);
+    llm_request_state_t state = llm_request_state(low);
+    assert(state == LLM_REQUEST_QUEUED);
+    
+    /* Once prompts are cached, one token per sequence per step */
+    size_t decoded = fake.batches.size();
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    assert(fake.batches.size() > decoded && fake.batches[decoded].size() == 3);
+    
+    serve_check(high, "abcd");
+    serve_check(normal, "abcd");
+    serve_check(normal2, "abcd");
+    serve_check(low, "abcd");
+    
+    llm_serve_stats_t stats;
+    int ret = llm_serve_stats(model, &stats);
+    assert(ret == 0);
+    assert(stats.tokens == 16 && stats.preemptions == 0 && stats.evictions == 0);
+    assert(stats.queued == 0 && stats.running == 0 && stats.paused == 0);
+    
+    llm_unload_model(model);
+    
+    printf("  PASS: Priority-ordered batches\n");
+    return 0;
+}
+
+/* Test LOW preemption and resume */
+static int test_serve_preempt(void) {
+    printf("Testing LLM request preemption...\n");
+    
+    llm_model_t model = serve_open(4);
+    llm_request_t low = serve_submit(model, PRIORITY_LOW, 6);
+    llm_request_t low2 = serve_submit(model, PRIORITY_LOW, 6);
+    int executed = dtesn_sched_tick();
+    assert(executed > 0);
+    
+    llm_serve_stats_t stats;
+    int ret = llm_serve_stats(model, &stats);
+    assert(ret == 0 && stats.running == 2);
+    
+    /* Interactive work pauses both and decodes alone */
+    llm_request_t high = serve_submit(model, PRIORITY_HIGH, 3);
+    size_t decoded = fake.batches.size();
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    ret = llm_serve_stats(model, &stats);
+    assert(ret == 0);
+    assert(stats.paused == 2 && stats.running == 1 && stats.preemptions == 2);
+    
+    serve_finish(high);
+    for (size_t b = decoded; b < fake.batches.size(); b++) {
+        for (llama_seq_id seq : fake.batches[b]) {
+            assert(seq == 2);
+        }
+    }
+    serve_check(high, "abc");
+    
+    /* Paused requests resume with their cache once interactive load drains */
+    serve_check(low, "abcdef");
+    serve_check(low2, "abcdef");
+    ret = llm_serve_stats(model, &stats);
+    assert(ret == 0 && stats.evictions == 0 && stats.paused == 0);
+    
+    llm_unload_model(model);
+    
+    printf("  PASS: LOW requests pause and resume\n");
+    return 0;
+}
+
+/* Test eviction of paused sequences */
+static int test_serve_evict(void) {
+    printf("Testing LLM request eviction...\n");
+    
+    /* Every sequence is held by a LOW request: the newest is evicted */
+    llm_model_t model = serve_open(2);
+    llm_request_t low = serve_submit(model, PRIORITY_LOW, 6);
+    llm_request_t low2 = serve_submit(model, PRIORITY_LOW, 6);
+    int executed = dtesn_sched_tick();
+    assert(executed > 0);
+    
+    llm_request_t high = serve_submit(model, PRIORITY_HIGH, 3);
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_serve_stats_t stats;
+    int ret = llm_serve_stats(model, &stats);
+    assert(ret == 0);
+    assert(stats.evictions == 1 && stats.paused == 1 && stats.queued == 1);
+    llm_request_state_t state = llm_request_state(low);
+    assert(state == LLM_REQUEST_PAUSED);
+    state = llm_request_state(low2);
+    assert(state == LLM_REQUEST_QUEUED);
+    
+    /* The evicted request is prefilled again, generated tokens included */
+    serve_check(high, "abc");
+    serve_check(low, "abcdef");
+    serve_check(low2, "abcdef");
+    
+    /* A decode that runs out of KV space evicts a paused sequence and retries */
+    llm_request_t low3 = serve_submit(model, PRIORITY_LOW, 4);
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_request_t high2 = serve_submit(model, PRIORITY_HIGH, 2);
+    fake.fail_decode = 1;
+    serve_check(high2, "ab");
+    serve_check(low3, "abcd");
+    ret = llm_serve_stats(model, &stats);
+    assert(ret == 0 && stats.evictions == 2);
+    
+    llm_unload_model(model);
+    
+    printf("  PASS: Paused sequences evicted for interactive work\n");
+    return 0;
+}
+
+/* Test freeing requests */
+static void serve_slow_token(const char*, void*) {
+    usleep(500);
+}
+
+static int test_serve_free(void) {
+    printf("Testing LLM request release...\n");
+    
+    llm_model_t model = serve_open(4);
+    
+    /* Free as soon as DONE is seen, while later requests of the same step still decode */
+    std::thread ticker([] { dtesn_sched_run(); });
+    for (int round = 0; round < 20; round++) {
+        llm_request_t quick = serve_submit(model, PRIORITY_NORMAL, 1);
+        llm_request_t slow = serve_submit(model, PRIORITY_NORMAL, 3, serve_slow_token);
+        while (llm_request_state(quick) != LLM_REQUEST_DONE) {
+            std::this_thread::yield();
+        }
+        llm_request_free(quick);
+        char* response = llm_request_wait(slow);
+        assert(response != nullptr && strcmp(response, "abc") == 0);
+        free(response);
+        llm_request_free(slow);
+    }
+    dtesn_sched_stop();
+    ticker.join();
+    
+    /* Freeing an in-flight request cancels it */
+    llm_request_t cancel = serve_submit(model, PRIORITY_NORMAL, 100);
+    int executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_request_free(cancel);
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_serve_stats_t stats;
+    int ret = llm_serve_stats(model, &stats);
+    assert(ret == 0 && stats.running == 0 && stats.queued == 0);
+    
+    /* A failed decode fails the batch */
+    llm_request_t failed = serve_submit(model, PRIORITY_NORMAL, 4);
+    fake.fail_decode = -1;
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_request_state_t state = llm_request_state(failed);
+    assert(state == LLM_REQUEST_FAILED);
+    char* response = llm_request_wait(failed);
+    assert(response == nullptr);
+    llm_request_free(failed);
+    
+    /* Unloading frees requests still in flight */
+    serve_submit(model, PRIORITY_LOW, 100);
+    executed = dtesn_sched_tick();
+    assert(executed > 0);
+    llm_unload_model(model);
+    dtesn_sched_tick();
+    
+    printf("  PASS: Requests freed after, during and without decoding\n");
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <test>\n", argv[0]);
+        return 1;
+    }
+    
+    int ret = 0;
+    
+    if (strcmp(argv[1], "serve_pack") == 0) {
+        ret = test_serve_pack();
+    } else if (strcmp(argv[1], "serve_preempt") == 0) {
+        ret = test_serve_preempt();
+    } else if (strcmp(argv[1], "serve_evict") == 0) {
+        ret = test_serve_evict();
+    } else if (strcmp(argv[1], "serve_free") == 0) {
+        ret = test_serve_free();
+    } else {
+        fprintf(stderr, "Unknown test: %s\n", argv[1]);
+        return 1;
+    }
+    
+    return ret;
+}